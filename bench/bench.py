@@ -0,0 +1,268 @@
+# -*- coding: utf-8 -*-
+
+"""Benchmark suite for the distance package.
+
+Usage:
+
+	python bench/bench.py run [-o results.json] [-k PATTERN] [--quick] [--all]
+	python bench/bench.py compare base.json new.json [--threshold 0.10]
+	python bench/bench.py list
+
+`run` measures every kernel for every sequence type, dataset regime and
+implementation (C and pure Python), and writes the results as JSON, to the
+standard output or to the file given with `-o`. Benchmarks are named like
+`levenshtein/bytes/names-near/c`; `-k` selects them with a shell-style
+pattern, and can be repeated.
+
+`compare` matches the benchmarks of two result files by name, and reports
+those which got slower by more than `threshold` (a fraction, 0.10 meaning
+10%). It exits with status 1 if it found any regression.
+
+The C extension is imported from the source tree, so build it in place
+before running the suite:
+
+	python setup.py build_ext --inplace --with-c
+"""
+
+import os, sys, json, time, fnmatch, platform, argparse
+
+this_dir = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.dirname(this_dir))
+sys.path.insert(0, this_dir)
+
+import datasets
+from distance import _pyimports as pydistance
+try:
+	from distance import cdistance
+except ImportError:
+	cdistance = None
+
+if sys.version_info[0] < 3:
+	t_bytes = lambda s: s
+	t_unicode = lambda s: s.decode()
+	perf_counter = time.time
+else:
+	t_bytes = lambda s: s.encode()
+	t_unicode = lambda s: s
+	perf_counter = time.perf_counter
+
+# sequence types, for each kind of dataset
+TYPES = {
+	"chars": [("unicode", t_unicode), ("bytes", t_bytes), ("tuple", tuple), ("list", list)],
+	"tokens": [("tuple", tuple), ("list", list)],
+}
+
+# pairwise kernels: name -> (function name, keyword arguments, prepare)
+# `prepare` adapts a pair to the requirements of the function, if any
+
+def _same_length(seq1, seq2):
+	n = min(len(seq1), len(seq2))
+	return seq1[:n], seq2[:n]
+
+KERNELS = [
+	("hamming", "hamming", {}, _same_length),
+	("levenshtein", "levenshtein", {}, None),
+	("levenshtein-max2", "levenshtein", {"max_dist": 2}, None),
+	("nlevenshtein-1", "nlevenshtein", {"method": 1}, None),
+	("nlevenshtein-2", "nlevenshtein", {"method": 2}, None),
+	("fast_comp", "fast_comp", {}, None),
+	("fast_comp-transpos", "fast_comp", {"transpositions": True}, None),
+	("lcsubstrings", "lcsubstrings", {"positions": True}, None),
+	("jaro", "jaro", {}, None),
+	("jaro_winkler", "jaro_winkler", {}, None),
+]
+
+# one-vs-many iterators; they are run with each query against all the
+# candidates of the dataset, and their timings are given per candidate
+ITERATORS = [
+	("ilevenshtein", "ilevenshtein", {"max_dist": 2}),
+	("ifast_comp", "ifast_comp", {}),
+	("ijaro_winkler", "ijaro_winkler", {"min_score": 0.9}),
+]
+ITERATOR_REGIMES = ["short", "names", "sentences"]
+ITERATOR_QUERIES = 5
+
+# the pure Python implementations are way too slow for these
+SLOW_REGIMES = ["documents"]
+
+
+def implementations():
+	impls = [("py", pydistance)]
+	if cdistance is not None:
+		impls.insert(0, ("c", cdistance))
+	return impls
+
+
+def benchmarks(include_slow=False):
+	"""Yield all the benchmarks as tuples (name, callable, operations count),
+	where the callable runs the operations once."""
+	for regime in datasets.regime_names():
+		kind = datasets.kind(regime)
+		for near in (True, False):
+			pairs = datasets.load(regime, near)
+			label = "%s-%s" % (regime, "near" if near else "random")
+			for tname, conv in TYPES[kind]:
+				typed = [(conv(s1), conv(s2)) for s1, s2 in pairs]
+				for impl, module in implementations():
+					if impl == "py" and regime in SLOW_REGIMES and not include_slow:
+						continue
+					for bname, fname, kwargs, prepare in KERNELS:
+						args = typed
+						if prepare is not None:
+							args = [prepare(s1, s2) for s1, s2 in typed]
+						name = "/".join((bname, tname, label, impl))
+						yield name, _pairwise(getattr(module, fname), args, kwargs), len(args)
+					if regime not in ITERATOR_REGIMES:
+						continue
+					queries = [s1 for s1, _ in typed[:ITERATOR_QUERIES]]
+					candidates = [s2 for _, s2 in typed]
+					for bname, fname, kwargs in ITERATORS:
+						name = "/".join((bname, tname, label, impl))
+						yield name, _iterator(getattr(module, fname), queries, candidates, kwargs), \
+							len(queries) * len(candidates)
+
+
+def _pairwise(func, pairs, kwargs):
+	def run():
+		for seq1, seq2 in pairs:
+			func(seq1, seq2, **kwargs)
+	return run
+
+
+def _iterator(func, queries, candidates, kwargs):
+	def run():
+		for query in queries:
+			for _ in func(query, candidates, **kwargs):
+				pass
+	return run
+
+
+def measure(run, min_time, repeat):
+	"""Return the timings, in seconds, of `repeat` rounds of calls to `run`,
+	together with the number of calls per round. The number of calls is chosen
+	so that a round lasts at least `min_time` seconds."""
+	start = perf_counter()
+	run()
+	elapsed = perf_counter() - start
+	number = max(1, int(min_time / elapsed)) if elapsed > 0 else 1000
+	timings = []
+	for _ in range(repeat):
+		start = perf_counter()
+		for _ in range(number):
+			run()
+		timings.append(perf_counter() - start)
+	return timings, number
+
+
+def metadata():
+	return {
+		"python": platform.python_version(),
+		"implementation": platform.python_implementation(),
+		"platform": platform.platform(),
+		"machine": platform.machine(),
+		"c_extension": cdistance is not None,
+		"isa": cdistance.cpu_features()["isa"] if cdistance else None,
+		"seed": datasets.SEED,
+		"time": time.strftime("%Y-%m-%dT%H:%M:%S"),
+	}
+
+
+def cmd_run(args):
+	results = []
+	for name, run, nops in benchmarks(args.all):
+		if args.k and not any(fnmatch.fnmatch(name, pat) for pat in args.k):
+			continue
+		timings, number = measure(run, args.min_time, args.repeat)
+		timings = sorted(t / (number * nops) * 1e9 for t in timings)
+		result = {
+			"name": name,
+			"ns_per_op": timings[0],
+			"ns_per_op_median": timings[len(timings) // 2],
+			"ops": nops * number,
+			"repeat": args.repeat,
+		}
+		results.append(result)
+		sys.stderr.write("%-50s %12.1f ns/op\n" % (name, result["ns_per_op"]))
+
+	report = {"meta": metadata(), "results": results}
+	if args.output:
+		with open(args.output, "w") as f:
+			json.dump(report, f, indent=1, sort_keys=True)
+	else:
+		json.dump(report, sys.stdout, indent=1, sort_keys=True)
+		sys.stdout.write("\n")
+
+
+def cmd_compare(args):
+	with open(args.base) as f:
+		base = dict((r["name"], r) for r in json.load(f)["results"])
+	with open(args.new) as f:
+		new = dict((r["name"], r) for r in json.load(f)["results"])
+
+	regressions = 0
+	for name in sorted(set(base) & set(new)):
+		ratio = new[name]["ns_per_op"] / base[name]["ns_per_op"]
+		flag = ""
+		if ratio > 1 + args.threshold:
+			flag = "REGRESSION"
+			regressions += 1
+		elif ratio < 1 - args.threshold:
+			flag = "improvement"
+		if flag or args.verbose:
+			print("%-50s %12.1f %12.1f %7.2fx  %s" % (name, base[name]["ns_per_op"],
+				new[name]["ns_per_op"], ratio, flag))
+	for name in sorted(set(base) - set(new)):
+		print("%-50s missing from %s" % (name, args.new))
+	for name in sorted(set(new) - set(base)):
+		print("%-50s missing from %s" % (name, args.base))
+
+	print("%d benchmarks compared, %d regressions" % (len(set(base) & set(new)), regressions))
+	return 1 if regressions else 0
+
+
+def cmd_list(args):
+	for regime in datasets.regime_names():
+		print("%-10s %s" % (regime, datasets.describe(regime)))
+	print("")
+	for name, _, nops in benchmarks(args.all):
+		print(name)
+
+
+def main(argv):
+	parser = argparse.ArgumentParser(description="Benchmark suite for the distance package.")
+	sub = parser.add_subparsers(dest="command")
+
+	run = sub.add_parser("run", help="run the benchmarks")
+	run.add_argument("-o", "--output", help="write the results to this file")
+	run.add_argument("-k", action="append", help="only run the benchmarks matching this pattern")
+	run.add_argument("--repeat", type=int, default=5, help="number of rounds per benchmark")
+	run.add_argument("--min-time", type=float, default=0.2, help="minimum duration of a round")
+	run.add_argument("--quick", action="store_true", help="shortcut for --repeat 3 --min-time 0.05")
+	run.add_argument("--all", action="store_true",
+		help="also run the pure Python implementations on long documents")
+
+	cmp = sub.add_parser("compare", help="compare two result files")
+	cmp.add_argument("base")
+	cmp.add_argument("new")
+	cmp.add_argument("--threshold", type=float, default=0.10,
+		help="relative slowdown above which a benchmark is flagged")
+	cmp.add_argument("-v", "--verbose", action="store_true", help="show all the benchmarks")
+
+	lst = sub.add_parser("list", help="list the datasets and benchmarks")
+	lst.add_argument("--all", action="store_true")
+
+	args = parser.parse_args(argv)
+	if args.command == "run":
+		if args.quick:
+			args.repeat, args.min_time = 3, 0.05
+		return cmd_run(args)
+	if args.command == "compare":
+		return cmd_compare(args)
+	if args.command == "list":
+		return cmd_list(args)
+	parser.print_help()
+	return 2
+
+
+if __name__ == "__main__":
+	sys.exit(main(sys.argv[1:]))
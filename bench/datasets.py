@@ -0,0 +1,114 @@
+# -*- coding: utf-8 -*-
+
+"""Reproducible datasets for the benchmarks.
+
+Every dataset is generated from a fixed seed, so that two runs of the suite,
+possibly on different machines, always measure the same inputs. A dataset is
+a list of pairs of strings (or of lists of words for the "tokens" regimes);
+they are converted to the sequence type under test by the benchmark runner.
+"""
+
+import random
+
+SEED = 20131120
+
+LETTERS = "abcdefghijklmnopqrstuvwxyz"
+SYLLABLES = ["an", "be", "ca", "de", "el", "fi", "go", "ha", "in", "jo", "ka",
+	"li", "ma", "ne", "ol", "pa", "ra", "si", "ta", "ur", "va", "wi", "xa", "yo", "ze"]
+
+
+def _word(rnd, lo=3, hi=8):
+	return "".join(rnd.choice(LETTERS) for _ in range(rnd.randint(lo, hi)))
+
+
+def _name(rnd):
+	parts = []
+	for _ in range(2):
+		part = "".join(rnd.choice(SYLLABLES) for _ in range(rnd.randint(2, 4)))
+		parts.append(part.capitalize())
+	return " ".join(parts)
+
+
+def _words(rnd, nwords, vocab):
+	return [rnd.choice(vocab) for _ in range(nwords)]
+
+
+def _mutate(rnd, seq, nedits, alphabet):
+	"""Apply `nedits` random edit operations to the string or list `seq`."""
+	seq = list(seq)
+	for _ in range(nedits):
+		op = rnd.randint(0, 2)
+		pos = rnd.randint(0, max(len(seq) - 1, 0))
+		if op == 0 or not seq:
+			seq.insert(pos, rnd.choice(alphabet))
+		elif op == 1:
+			del seq[pos]
+		else:
+			seq[pos] = rnd.choice(alphabet)
+	return seq
+
+
+def _pairs(rnd, make, count, near, nedits, alphabet, join):
+	pairs = []
+	for _ in range(count):
+		seq1 = make()
+		if near:
+			seq2 = _mutate(rnd, seq1, rnd.randint(0, nedits), alphabet)
+		else:
+			seq2 = make()
+		pairs.append((join(seq1), join(seq2)))
+	return pairs
+
+
+def _vocabulary(rnd, size=2000):
+	return [_word(rnd, 2, 10) for _ in range(size)]
+
+
+# name -> (description, pair generator, kind); kind is "chars" for strings,
+# and "tokens" for lists of words
+
+def _regimes():
+	def chars(make, count, nedits):
+		return lambda rnd, near: _pairs(rnd, lambda: list(make(rnd)), count, near,
+			nedits, LETTERS, "".join)
+
+	def tokens(nwords, count, nedits):
+		def gen(rnd, near):
+			vocab = _vocabulary(rnd)
+			return _pairs(rnd, lambda: _words(rnd, rnd.randint(*nwords), vocab),
+				count, near, nedits, vocab, list)
+		return gen
+
+	return {
+		"short": ("short tokens, 3-8 chars", chars(_word, 500, 2), "chars"),
+		"names": ("person names, 10-30 chars", chars(_name, 500, 3), "chars"),
+		"sentences": ("sentences, 60-150 chars",
+			chars(lambda rnd: " ".join(_words(rnd, rnd.randint(10, 25),
+				[_word(rnd) for _ in range(50)])), 100, 8), "chars"),
+		"documents": ("long documents, 1500-2500 chars",
+			chars(lambda rnd: " ".join(_words(rnd, rnd.randint(250, 420),
+				[_word(rnd) for _ in range(300)])), 4, 40), "chars"),
+		"tokens": ("token lists, 10-40 words", tokens((10, 40), 100, 4), "tokens"),
+	}
+
+REGIMES = _regimes()
+
+
+def regime_names():
+	return sorted(REGIMES)
+
+
+def load(regime, near):
+	"""Return the list of pairs of the dataset `regime`, with near-identical
+	pairs if `near` is true, or with independent random pairs otherwise."""
+	_, gen, _ = REGIMES[regime]
+	rnd = random.Random("%s-%s-%d" % (regime, near, SEED))
+	return gen(rnd, near)
+
+
+def kind(regime):
+	return REGIMES[regime][2]
+
+
+def describe(regime):
+	return REGIMES[regime][0]
@@ -0,0 +1,361 @@
+/* Native microbenchmark for libdistance.
+
+Usage: microbench [-k SUBSTRING] [-r REPEAT] [-t MIN_TIME] [-o FILE]
+
+Measures the kernels directly, without the Python interpreter, on datasets
+generated from a fixed seed, for 8 and 32 bits items. The results are written
+as JSON in the same format as `bench/bench.py run`, so that they can be
+compared with `bench/bench.py compare`. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "libdistance.h"
+
+#ifdef _WIN32
+	#include <windows.h>
+#endif
+
+
+static double
+now(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER freq, count;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return count.QuadPart / (double)freq.QuadPart;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+
+// Datasets
+
+static uint64_t rng_state = 20131120;
+
+static uint32_t
+rng(void)
+{
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 7;
+	rng_state ^= rng_state << 17;
+	return (uint32_t)(rng_state >> 16);
+}
+
+static dist_ssize_t
+rng_range(dist_ssize_t lo, dist_ssize_t hi)
+{
+	return lo + rng() % (hi - lo + 1);
+}
+
+struct regime {
+	const char *name;
+	dist_ssize_t min_len, max_len;
+	int npairs;
+	int max_edits;			// for near-identical pairs
+};
+
+static const struct regime regimes[] = {
+	{"short", 3, 8, 500, 2},
+	{"names", 10, 30, 500, 3},
+	{"sentences", 60, 150, 100, 8},
+	{"documents", 1500, 2500, 4, 40},
+};
+
+#define NREGIMES (sizeof(regimes) / sizeof(regimes[0]))
+
+struct dataset {
+	char label[64];
+	int npairs;
+	dist_ssize_t *len1, *len2;
+	uint8_t **b1, **b2;
+	uint32_t **u1, **u2;
+};
+
+
+static dist_ssize_t
+make_string(uint8_t *buf, dist_ssize_t len)
+{
+	dist_ssize_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = (rng() % 6 == 0 ? ' ' : 'a' + rng() % 26);
+	return len;
+}
+
+
+static dist_ssize_t
+mutate(const uint8_t *src, dist_ssize_t len, uint8_t *dst, int nedits)
+{
+	dist_ssize_t pos, n = len;
+
+	memcpy(dst, src, len);
+	while (nedits--) {
+		pos = (n ? rng_range(0, n - 1) : 0);
+		switch (rng() % 3) {
+			case 0:
+				memmove(dst + pos + 1, dst + pos, n - pos);
+				dst[pos] = 'a' + rng() % 26;
+				n++;
+				break;
+			case 1:
+				if (n) {
+					memmove(dst + pos, dst + pos + 1, n - pos - 1);
+					n--;
+				}
+				break;
+			default:
+				if (n)
+					dst[pos] = 'a' + rng() % 26;
+		}
+	}
+	return n;
+}
+
+
+static uint32_t *
+widen(const uint8_t *src, dist_ssize_t len)
+{
+	uint32_t *dst = (uint32_t *)malloc((len + 1) * sizeof(uint32_t));
+	dist_ssize_t i;
+
+	for (i = 0; i < len; i++)
+		dst[i] = src[i];
+	return dst;
+}
+
+
+static void
+make_dataset(struct dataset *ds, const struct regime *rg, int near)
+{
+	int k;
+	dist_ssize_t cap = rg->max_len + rg->max_edits + 1;
+
+	sprintf(ds->label, "%s-%s", rg->name, near ? "near" : "random");
+	ds->npairs = rg->npairs;
+	ds->len1 = (dist_ssize_t *)malloc(rg->npairs * sizeof(dist_ssize_t));
+	ds->len2 = (dist_ssize_t *)malloc(rg->npairs * sizeof(dist_ssize_t));
+	ds->b1 = (uint8_t **)malloc(rg->npairs * sizeof(uint8_t *));
+	ds->b2 = (uint8_t **)malloc(rg->npairs * sizeof(uint8_t *));
+	ds->u1 = (uint32_t **)malloc(rg->npairs * sizeof(uint32_t *));
+	ds->u2 = (uint32_t **)malloc(rg->npairs * sizeof(uint32_t *));
+
+	for (k = 0; k < rg->npairs; k++) {
+		ds->b1[k] = (uint8_t *)malloc(cap);
+		ds->b2[k] = (uint8_t *)malloc(cap);
+		ds->len1[k] = make_string(ds->b1[k], rng_range(rg->min_len, rg->max_len));
+		if (near)
+			ds->len2[k] = mutate(ds->b1[k], ds->len1[k], ds->b2[k], (int)rng_range(0, rg->max_edits));
+		else
+			ds->len2[k] = make_string(ds->b2[k], rng_range(rg->min_len, rg->max_len));
+		ds->u1[k] = widen(ds->b1[k], ds->len1[k]);
+		ds->u2[k] = widen(ds->b2[k], ds->len2[k]);
+	}
+}
+
+
+static void
+free_dataset(struct dataset *ds)
+{
+	int k;
+
+	for (k = 0; k < ds->npairs; k++) {
+		free(ds->b1[k]);
+		free(ds->b2[k]);
+		free(ds->u1[k]);
+		free(ds->u2[k]);
+	}
+	free(ds->len1);
+	free(ds->len2);
+	free(ds->b1);
+	free(ds->b2);
+	free(ds->u1);
+	free(ds->u2);
+}
+
+
+// Kernels. Each one runs over all the pairs of a dataset once.
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+#define KERNELS(sfx, T, seq1, seq2)															\
+																							\
+static void hamming_##sfx(const struct dataset *ds)										\
+{																							\
+	dist_ssize_t dist;																		\
+	int k;																					\
+	for (k = 0; k < ds->npairs; k++)														\
+		distance_hamming_##sfx(ds->seq1[k], ds->seq2[k], MIN(ds->len1[k], ds->len2[k]), &dist);	\
+}																							\
+																							\
+static void levenshtein_##sfx(const struct dataset *ds)									\
+{																							\
+	dist_ssize_t dist;																		\
+	int k;																					\
+	for (k = 0; k < ds->npairs; k++)														\
+		distance_levenshtein_##sfx(ds->seq1[k], ds->seq2[k], ds->len1[k], ds->len2[k], -1, &dist);	\
+}																							\
+																							\
+static void levenshtein_max2_##sfx(const struct dataset *ds)								\
+{																							\
+	dist_ssize_t dist;																		\
+	int k;																					\
+	for (k = 0; k < ds->npairs; k++)														\
+		distance_levenshtein_##sfx(ds->seq1[k], ds->seq2[k], ds->len1[k], ds->len2[k], 2, &dist);	\
+}																							\
+																							\
+static void nlevenshtein_2_##sfx(const struct dataset *ds)								\
+{																							\
+	double dist;																			\
+	int k;																					\
+	for (k = 0; k < ds->npairs; k++)														\
+		distance_nlevenshtein_##sfx(ds->seq1[k], ds->seq2[k], ds->len1[k], ds->len2[k], 2, &dist);	\
+}																							\
+																							\
+static void fastcomp_##sfx(const struct dataset *ds)										\
+{																							\
+	int k, dist;																			\
+	for (k = 0; k < ds->npairs; k++)														\
+		distance_fastcomp_##sfx(ds->seq1[k], ds->seq2[k], ds->len1[k], ds->len2[k], 0, &dist);	\
+}																							\
+																							\
+static void lcsubstrings_##sfx(const struct dataset *ds)									\
+{																							\
+	struct distance_pair *pairs;															\
+	dist_ssize_t mlen, npairs;																\
+	int k;																					\
+	for (k = 0; k < ds->npairs; k++) {														\
+		distance_lcsubstrings_##sfx(ds->seq1[k], ds->seq2[k], ds->len1[k], ds->len2[k],	\
+			&mlen, &pairs, &npairs);														\
+		distance_free(pairs);																\
+	}																						\
+}																							\
+																							\
+static void jaro_winkler_##sfx(const struct dataset *ds)									\
+{																							\
+	double score;																			\
+	int k;																					\
+	for (k = 0; k < ds->npairs; k++)														\
+		distance_jaro_##sfx(ds->seq1[k], ds->seq2[k], ds->len1[k], ds->len2[k], 0.1, -1.0, &score);	\
+}
+
+KERNELS(u8, uint8_t, b1, b2)
+KERNELS(u32, uint32_t, u1, u2)
+
+struct kernel {
+	const char *name;
+	const char *type;
+	void (*run)(const struct dataset *);
+};
+
+static const struct kernel kernels[] = {
+	{"hamming", "u8", hamming_u8},
+	{"hamming", "u32", hamming_u32},
+	{"levenshtein", "u8", levenshtein_u8},
+	{"levenshtein", "u32", levenshtein_u32},
+	{"levenshtein-max2", "u8", levenshtein_max2_u8},
+	{"levenshtein-max2", "u32", levenshtein_max2_u32},
+	{"nlevenshtein-2", "u8", nlevenshtein_2_u8},
+	{"nlevenshtein-2", "u32", nlevenshtein_2_u32},
+	{"fast_comp", "u8", fastcomp_u8},
+	{"fast_comp", "u32", fastcomp_u32},
+	{"lcsubstrings", "u8", lcsubstrings_u8},
+	{"lcsubstrings", "u32", lcsubstrings_u32},
+	{"jaro_winkler", "u8", jaro_winkler_u8},
+	{"jaro_winkler", "u32", jaro_winkler_u32},
+};
+
+#define NKERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+
+static int
+compare_doubles(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+
+int
+main(int argc, char **argv)
+{
+	const char *filter = NULL, *output = NULL;
+	int repeat = 5, first = 1;
+	double min_time = 0.2;
+	struct dataset ds;
+	unsigned r, near, k;
+	int i, number, round;
+	double start, elapsed, timings[64];
+	char name[128];
+	FILE *out = stdout;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-k") && i + 1 < argc)
+			filter = argv[++i];
+		else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+			repeat = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+			min_time = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+			output = argv[++i];
+		else {
+			fprintf(stderr, "usage: %s [-k SUBSTRING] [-r REPEAT] [-t MIN_TIME] [-o FILE]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (repeat < 1 || repeat > 64)
+		repeat = 5;
+	if (output && (out = fopen(output, "w")) == NULL) {
+		perror(output);
+		return 1;
+	}
+
+	fprintf(out, "{\n \"meta\": {\"implementation\": \"native\", \"seed\": 20131120},\n \"results\": [");
+
+	for (r = 0; r < NREGIMES; r++) {
+		for (near = 0; near < 2; near++) {
+			make_dataset(&ds, &regimes[r], !near);
+			for (k = 0; k < NKERNELS; k++) {
+				sprintf(name, "%s/%s/%s/native", kernels[k].name, kernels[k].type, ds.label);
+				if (filter && !strstr(name, filter))
+					continue;
+
+				start = now();
+				kernels[k].run(&ds);
+				elapsed = now() - start;
+				number = (elapsed > 0 ? (int)(min_time / elapsed) : 1000);
+				if (number < 1)
+					number = 1;
+
+				for (round = 0; round < repeat; round++) {
+					start = now();
+					for (i = 0; i < number; i++)
+						kernels[k].run(&ds);
+					timings[round] = (now() - start) / ((double)number * ds.npairs) * 1e9;
+				}
+				qsort(timings, repeat, sizeof(double), compare_doubles);
+
+				fprintf(stderr, "%-50s %12.1f ns/op\n", name, timings[0]);
+				fprintf(out, "%s\n  {\"name\": \"%s\", \"ns_per_op\": %.3f, \"ns_per_op_median\": %.3f, "
+					"\"ops\": %d, \"repeat\": %d}", first ? "" : ",", name, timings[0],
+					timings[repeat / 2], number * ds.npairs, repeat);
+				first = 0;
+			}
+			free_dataset(&ds);
+		}
+	}
+
+	fprintf(out, "\n ]\n}\n");
+	if (output)
+		fclose(out);
+	return 0;
+}
@@ -0,0 +1,296 @@
+#define DISTANCE_BUILD
+#include "core.h"
+
+/* The q-grams of a sequence are represented by hashes of their items, sorted
+(see `qgram_profile` in libdistance.c), so that the number of q-grams two
+sequences share is found by merging their profiles. Collisions can only make
+two sequences look closer than they are, so that no candidate is wrongly
+rejected. */
+
+// Length up to which levenshtein uses the bit-parallel kernel.
+#define CANDIDATES_FILTER_MIN 64
+
+struct candidate {
+	const void *items;
+	dist_ssize_t len;
+	int width;
+	dist_ssize_t grams;			// offset of its profile in `grams`
+};
+
+struct bucket {
+	dist_ssize_t *index;		// of the candidates of a given length
+	dist_ssize_t count, cap;
+};
+
+struct distance_candidates {
+	int q;
+	struct candidate *items;
+	dist_ssize_t count, cap;
+	uint32_t *grams;			// profiles, len - q + 1 hashes per candidate
+	dist_ssize_t ngrams, grams_cap;
+	struct bucket *buckets;		// by length
+	dist_ssize_t nbuckets;
+};
+
+
+/* Whether two profiles share at least `needed` q-grams. The merge is written
+without branches on the hashes, which are unpredictable; it stops as soon as
+the result is known. */
+
+static int
+enough_grams(const uint32_t *g1, dist_ssize_t n1, const uint32_t *g2, dist_ssize_t n2,
+	dist_ssize_t needed)
+{
+	dist_ssize_t i = 0, j = 0, common = 0;
+	uint32_t a, b;
+
+	if (n1 < needed || n2 < needed)
+		return 0;
+	while (i < n1 && j < n2) {
+		a = g1[i];
+		b = g2[j];
+		common += (a == b);
+		i += (a <= b);
+		j += (a >= b);
+		if (common >= needed)
+			return 1;
+		if (common + (n1 - i < n2 - j ? n1 - i : n2 - j) < needed)
+			return 0;
+	}
+	return common >= needed;
+}
+
+
+DISTANCE_API int
+distance_candidates_new(int q, struct distance_candidates **cs)
+{
+	if (q < 1 || q > QGRAMS_MAX_Q)
+		return DISTANCE_EINVAL;
+	if ((*cs = (struct distance_candidates *)calloc(1, sizeof(struct distance_candidates))) == NULL)
+		return DISTANCE_ENOMEM;
+	(*cs)->q = q;
+	return DISTANCE_OK;
+}
+
+
+DISTANCE_API void
+distance_candidates_free(struct distance_candidates *cs)
+{
+	dist_ssize_t i;
+
+	if (cs == NULL)
+		return;
+	for (i = 0; i < cs->nbuckets; i++)
+		free(cs->buckets[i].index);
+	free(cs->buckets);
+	free(cs->grams);
+	free(cs->items);
+	free(cs);
+}
+
+
+// Grows an array to hold at least `needed` elements of `size` bytes.
+
+static int
+grow(void *array, dist_ssize_t *cap, dist_ssize_t needed, size_t size)
+{
+	dist_ssize_t n = (*cap ? *cap : 16);
+	void *tmp;
+
+	if (needed <= *cap)
+		return DISTANCE_OK;
+	while (n < needed)
+		n *= 2;
+	if ((tmp = realloc(*(void **)array, n * size)) == NULL)
+		return DISTANCE_ENOMEM;
+	*(void **)array = tmp;
+	*cap = n;
+	return DISTANCE_OK;
+}
+
+
+DISTANCE_API int
+distance_candidates_add(struct distance_candidates *cs,
+	const void *items, int width, dist_ssize_t len)
+{
+	struct candidate *c;
+	struct bucket *b, *tmp;
+	dist_ssize_t n = (len >= cs->q ? len - cs->q + 1 : 0), i;
+
+	if (len < 0 || (width != 1 && width != 2 && width != 4))
+		return DISTANCE_EINVAL;
+
+	if (len >= cs->nbuckets) {
+		if ((tmp = (struct bucket *)realloc(cs->buckets, (len + 1) * sizeof(struct bucket))) == NULL)
+			return DISTANCE_ENOMEM;
+		for (i = cs->nbuckets; i <= len; i++)
+			memset(&tmp[i], 0, sizeof(struct bucket));
+		cs->buckets = tmp;
+		cs->nbuckets = len + 1;
+	}
+	b = &cs->buckets[len];
+	if (grow(&cs->items, &cs->cap, cs->count + 1, sizeof(struct candidate)) != DISTANCE_OK
+		|| grow(&cs->grams, &cs->grams_cap, cs->ngrams + n, sizeof(uint32_t)) != DISTANCE_OK
+		|| grow(&b->index, &b->cap, b->count + 1, sizeof(dist_ssize_t)) != DISTANCE_OK)
+		return DISTANCE_ENOMEM;
+
+	c = &cs->items[cs->count];
+	c->items = items;
+	c->len = len;
+	c->width = width;
+	c->grams = cs->ngrams;
+	qgram_profile(cs->grams + cs->ngrams, cs->q, items, width, len);
+	cs->ngrams += n;
+	b->index[b->count++] = cs->count++;
+	return DISTANCE_OK;
+}
+
+
+DISTANCE_API dist_ssize_t
+distance_candidates_size(const struct distance_candidates *cs)
+{
+	return cs->count;
+}
+
+
+static int
+hit_cmp(const void *a, const void *b)
+{
+	dist_ssize_t x = ((const struct distance_hit *)a)->index;
+	dist_ssize_t y = ((const struct distance_hit *)b)->index;
+
+	return (x > y) - (x < y);
+}
+
+
+/* Searches for `query`, or for the query of `pat` if it isn't NULL, in which
+case its q-gram profile is used if it has the right `q`, and the Levenshtein
+distances are computed with its match vectors. */
+
+static int
+candidates_search(const struct distance_candidates *cs, const struct distance_pattern *pat,
+	const void *query, int width, dist_ssize_t len, int metric, dist_ssize_t max_dist,
+	struct distance_hit **hits, dist_ssize_t *nhits)
+{
+	dist_ssize_t bound = metric_bound(metric, max_dist), nq, lo, hi, l, k, needed, dist, cap = 0;
+	const struct candidate *c;
+	const struct bucket *b;
+	const void *seq1, *seq2;
+	void *wide[5] = {NULL}, *scratch = NULL;
+	const uint32_t *grams;
+	uint32_t *qgrams = NULL;
+	int w, q, filter, per_edit, status = DISTANCE_OK;
+
+	if (len < 0 || (width != 1 && width != 2 && width != 4)
+		|| metric < DISTANCE_METRIC_LEVENSHTEIN || metric > DISTANCE_METRIC_FASTCOMP_TRANSPOSITIONS)
+		return DISTANCE_EINVAL;
+
+	*hits = NULL;
+	*nhits = 0;
+
+	if (cs->nbuckets == 0 || !metric_lengths(metric, len, max_dist, cs->nbuckets - 1, &lo, &hi))
+		return DISTANCE_OK;
+
+	/* The filter only pays off before the dynamic programming: hamming and
+	fastcomp are linear, and so is levenshtein when a sequence is short enough
+	for the bit-parallel kernel. A transposition can alter one more q-gram
+	than the other edits. */
+	filter = (bound >= 0 && metric == DISTANCE_METRIC_LEVENSHTEIN && len > CANDIDATES_FILTER_MIN);
+	per_edit = cs->q + (metric == DISTANCE_METRIC_FASTCOMP_TRANSPOSITIONS);
+	if ((scratch = malloc((cs->nbuckets + 1) * 4)) == NULL) {
+		status = DISTANCE_ENOMEM;
+		goto On_Exit;
+	}
+	if (pat == NULL || (grams = distance_pattern_qgrams(pat, &q, &nq)) == NULL || q != cs->q) {
+		nq = (len >= cs->q ? len - cs->q + 1 : 0);
+		if ((qgrams = (uint32_t *)malloc((nq + 1) * sizeof(uint32_t))) == NULL) {
+			status = DISTANCE_ENOMEM;
+			goto On_Exit;
+		}
+		qgram_profile(qgrams, cs->q, query, width, len);
+		grams = qgrams;
+	}
+
+	for (l = lo; l <= hi; l++) {
+		b = &cs->buckets[l];
+		for (k = 0; k < b->count; k++) {
+			c = &cs->items[b->index[k]];
+
+			needed = (len > l ? len : l) - cs->q + 1 - bound * per_edit;
+			if (filter && needed > 0 && l > CANDIDATES_FILTER_MIN &&
+				!enough_grams(grams, nq, cs->grams + c->grams, l - cs->q + 1, needed))
+				continue;
+
+			if (pat != NULL && metric == DISTANCE_METRIC_LEVENSHTEIN) {
+				if ((status = distance_pattern_levenshtein(pat, c->items, c->width, l,
+					max_dist, &dist)) != DISTANCE_OK)
+					goto On_Exit;
+				if (dist != -1 && (status = hits_append(hits, nhits, &cap, b->index[k], dist)) != DISTANCE_OK)
+					goto On_Exit;
+				continue;
+			}
+
+			// both sequences with the width of the widest
+			seq1 = query;
+			seq2 = c->items;
+			w = (width > c->width ? width : c->width);
+			if (c->width < w) {
+				items_widen(scratch, w, c->items, c->width, l);
+				seq2 = scratch;
+			}
+			else if (width < w) {
+				if (wide[w] == NULL) {
+					if ((wide[w] = malloc((len + 1) * w)) == NULL) {
+						status = DISTANCE_ENOMEM;
+						goto On_Exit;
+					}
+					items_widen(wide[w], w, query, width, len);
+				}
+				seq1 = wide[w];
+			}
+
+			if ((status = items_compare(metric, w, seq1, len, seq2, l, max_dist, &dist)) != DISTANCE_OK)
+				goto On_Exit;
+			if (dist == -1 || (max_dist >= 0 && dist > max_dist))
+				continue;
+			if ((status = hits_append(hits, nhits, &cap, b->index[k], dist)) != DISTANCE_OK)
+				goto On_Exit;
+		}
+	}
+	if (*nhits)
+		qsort(*hits, *nhits, sizeof(struct distance_hit), hit_cmp);
+
+	On_Exit:
+		free(qgrams);
+		free(scratch);
+		free(wide[2]);
+		free(wide[4]);
+		if (status != DISTANCE_OK) {
+			free(*hits);
+			*hits = NULL;
+			*nhits = 0;
+		}
+		return status;
+}
+
+
+DISTANCE_API int
+distance_candidates_search(const struct distance_candidates *cs,
+	const void *query, int width, dist_ssize_t len, int metric, dist_ssize_t max_dist,
+	struct distance_hit **hits, dist_ssize_t *nhits)
+{
+	return candidates_search(cs, NULL, query, width, len, metric, max_dist, hits, nhits);
+}
+
+
+DISTANCE_API int
+distance_candidates_search_pattern(const struct distance_candidates *cs,
+	const struct distance_pattern *pat, int metric, dist_ssize_t max_dist,
+	struct distance_hit **hits, dist_ssize_t *nhits)
+{
+	dist_ssize_t len;
+	int width;
+	const void *query = distance_pattern_query(pat, &width, &len);
+
+	return candidates_search(cs, pat, query, width, len, metric, max_dist, hits, nhits);
+}
@@ -0,0 +1,150 @@
+#ifndef CORE_H
+#define CORE_H
+
+/* Internal header shared by the kernels. It must not depend on Python, so that
+the kernels can be compiled into libdistance on their own. */
+
+#include "libdistance.h"
+#include "stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Debugging.
+
+#ifdef DISTANCE_DEBUG
+	#undef NDEBUG
+#endif
+#include <assert.h>
+
+
+#define SWAP(type, a, b)								\
+do {															\
+	type a##_tmp = a;										\
+	a = b;													\
+	b = a##_tmp;											\
+} while (0)
+
+
+/* The kernels are compiled for several instruction set levels with GCC on x86
+(libdistance.c); `cpu_level` is the one in use (cpu.c). */
+
+#if defined(__GNUC__) && !defined(__clang__) && (defined(__x86_64__) || defined(__i386__))
+	#define DISTANCE_MULTIVERSION
+#endif
+
+extern int cpu_level;
+
+
+/* Used by the searches over lexicons, candidate sets and patterns
+(libdistance.c).
+
+items_widen: copies `len` items of `from` bytes into `dst`, as items of `to`
+bytes, which must be wider.
+
+items_compare: distance between two sequences of items of `width` bytes,
+with one of the metrics of `enum distance_metric`.
+
+metric_bound: highest distance a search can return, -1 if there is none.
+
+metric_lengths: range of lengths of the sequences which can be at distance
+`max_dist` of a sequence of length `len`, capped to `max_len`; returns 0 if it
+is empty.
+
+hits_append: appends a hit to an array of `*cap` hits, growing it if needed.
+
+qgram_profile: stores the sorted hashes of the `len - q + 1` q-grams of a
+sequence into `grams`. Items are hashed by value whatever their width, so
+that strings of different widths can be compared. */
+
+void items_widen(void *dst, int to, const void *src, int from, dist_ssize_t len);
+int items_compare(int metric, int width, const void *seq1, dist_ssize_t len1,
+	const void *seq2, dist_ssize_t len2, dist_ssize_t max_dist, dist_ssize_t *dist);
+
+#define metric_bound(metric, max_dist)												\
+	((metric) >= DISTANCE_METRIC_FASTCOMP && ((max_dist) < 0 || (max_dist) > 2)	\
+		? 2 : (max_dist))
+
+int metric_lengths(int metric, dist_ssize_t len, dist_ssize_t max_dist, dist_ssize_t max_len,
+	dist_ssize_t *lo, dist_ssize_t *hi);
+int hits_append(struct distance_hit **hits, dist_ssize_t *nhits, dist_ssize_t *cap,
+	dist_ssize_t index, dist_ssize_t dist);
+
+#define QGRAMS_MAX_Q 8
+
+void qgram_profile(uint32_t *grams, int q, const void *items, int width, dist_ssize_t len);
+
+
+/* levenshtein tries the diagonal-transition algorithm (levenshtein_diag) first
+when the distance is known, or expected, to be at most the length of the
+shorter sequence divided by DIAG_RATIO. */
+
+#define DIAG_RATIO 16
+
+
+/* A file mapped in memory, read-only (mapping.c). Empty files aren't mapped,
+and have a NULL `data`. file_map returns DISTANCE_EIO if the file can't be
+read, with errno set. */
+
+struct file_map {
+	const unsigned char *data;
+	size_t size;
+#ifdef _WIN32
+	void *mapping;
+#endif
+};
+
+int file_map(struct file_map *map, const char *path);
+void file_unmap(struct file_map *map);
+void file_sequential(struct file_map *map);
+
+
+// Keeps a function which is seldom called, or costly anyway, out of its
+// callers, e.g. an alternative algorithm tried by a kernel.
+
+#if defined(__GNUC__)
+	#define NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+	#define NOINLINE __declspec(noinline)
+#else
+	#define NOINLINE
+#endif
+
+// Index of the lowest bit set in a non-zero 64 bits word. Used for
+// bit-parallel algorithms.
+
+#if defined(__GNUC__)
+	#define CTZ64(x) __builtin_ctzll(x)
+#else
+static int
+CTZ64(uint64_t x)
+{
+	int n = 0;
+
+	while (!(x & 1)) {
+		x >>= 1;
+		n++;
+	}
+	return n;
+}
+#endif
+
+// Number of bits set in a 64 bits word.
+
+#if defined(__GNUC__)
+	#define POPCOUNT64(x) __builtin_popcountll(x)
+#else
+static int
+POPCOUNT64(uint64_t x)
+{
+	int n = 0;
+
+	while (x) {
+		x &= x - 1;
+		n++;
+	}
+	return n;
+}
+#endif
+
+#endif
@@ -0,0 +1,110 @@
+#define DISTANCE_BUILD
+#include "core.h"
+
+/* Selection of the instruction set level of the kernels. The kernels are
+compiled once per level (see libdistance.c), and the entry points call those of
+`cpu_level`, which is set once when the library is loaded: to the highest level
+supported by the CPU, or to the one named by the environment variable
+DISTANCE_ISA if it is lower. */
+
+static const char *isa_names[] = {"baseline", "sse4.2", "avx2"};
+
+#define NLEVELS (sizeof(isa_names) / sizeof(isa_names[0]))
+
+int cpu_level = DISTANCE_ISA_BASELINE;
+static int cpu_max = DISTANCE_ISA_BASELINE;
+static unsigned cpu_flags;
+
+
+#ifdef DISTANCE_MULTIVERSION
+
+static void
+cpu_detect(void)
+{
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("popcnt"))
+		cpu_flags |= DISTANCE_CPU_POPCNT;
+	if (__builtin_cpu_supports("sse4.2"))
+		cpu_flags |= DISTANCE_CPU_SSE42;
+	if (__builtin_cpu_supports("avx2"))
+		cpu_flags |= DISTANCE_CPU_AVX2;
+	if (__builtin_cpu_supports("bmi2"))
+		cpu_flags |= DISTANCE_CPU_BMI2;
+	if (__builtin_cpu_supports("avx512f"))
+		cpu_flags |= DISTANCE_CPU_AVX512F;
+
+	if ((cpu_flags & DISTANCE_CPU_POPCNT) && (cpu_flags & DISTANCE_CPU_SSE42))
+		cpu_max = DISTANCE_ISA_SSE42;
+	// the avx2 kernels are also compiled with bmi and bmi2, which come with it
+	if (cpu_max == DISTANCE_ISA_SSE42 && (cpu_flags & DISTANCE_CPU_AVX2)
+		&& (cpu_flags & DISTANCE_CPU_BMI2))
+		cpu_max = DISTANCE_ISA_AVX2;
+}
+
+
+__attribute__((constructor)) static void
+cpu_init(void)
+{
+	const char *env = getenv("DISTANCE_ISA");
+	int level;
+
+	cpu_detect();
+	cpu_level = cpu_max;
+	if (env && (level = distance_isa_level(env)) >= 0 && level < cpu_max)
+		cpu_level = level;
+}
+
+#endif
+
+
+DISTANCE_API int
+distance_isa(void)
+{
+	return cpu_level;
+}
+
+
+DISTANCE_API int
+distance_isa_max(void)
+{
+	return cpu_max;
+}
+
+
+DISTANCE_API int
+distance_set_isa(int level)
+{
+	if (level < 0 || level > cpu_max)
+		return DISTANCE_EINVAL;
+	cpu_level = level;
+	return DISTANCE_OK;
+}
+
+
+DISTANCE_API const char *
+distance_isa_name(int level)
+{
+	if (level < 0 || level >= (int)NLEVELS)
+		return NULL;
+	return isa_names[level];
+}
+
+
+DISTANCE_API int
+distance_isa_level(const char *name)
+{
+	int level;
+
+	for (level = 0; level < (int)NLEVELS; level++) {
+		if (strcmp(name, isa_names[level]) == 0)
+			return level;
+	}
+	return -1;
+}
+
+
+DISTANCE_API unsigned
+distance_cpu_features(void)
+{
+	return cpu_flags;
+}
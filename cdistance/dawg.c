@@ -0,0 +1,420 @@
+#define DISTANCE_BUILD
+#include "core.h"
+
+/* See distance/_dawg.py for the layout of the file. As for lexicons, the
+integers are read as they are, so that only little-endian hosts are supported.
+
+Opening a file only checks its header and the sizes of its tables; the edges
+are checked as they are followed. A path can't be longer than the longest
+word, which stops the walks of the files with cycles. */
+
+#define DAWG_MAGIC "DISTDAWG"
+#define DAWG_VERSION 1
+#define DAWG_VALUES 1
+
+struct dawg_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t flags;
+	uint64_t nstates;
+	uint64_t nedges;
+	uint64_t count;
+	uint64_t max_len;
+};
+
+struct distance_dawg {
+	struct file_map file;
+	dist_ssize_t nstates;
+	dist_ssize_t nedges;
+	dist_ssize_t count;
+	dist_ssize_t max_len;
+	const uint32_t *first;		// nstates + 1: first edge of each state
+	const uint32_t *info;		// words accepted from each state << 1 | final
+	const uint32_t *labels;		// nedges, sorted for each state
+	const uint32_t *targets;
+	const int64_t *values;		// NULL if the file has none
+};
+
+
+static int
+dawg_parse(struct distance_dawg *dawg)
+{
+	const struct dawg_header *h = (const struct dawg_header *)dawg->file.data;
+	uint64_t room, words;
+
+	if (dawg->file.size < sizeof(struct dawg_header))
+		return DISTANCE_EFORMAT;
+	room = dawg->file.size - sizeof(struct dawg_header);
+	if (memcmp(h->magic, DAWG_MAGIC, 8) || h->version != DAWG_VERSION
+		|| (h->flags & ~DAWG_VALUES))
+		return DISTANCE_EFORMAT;
+	// no path is longer than the number of states
+	if (h->nstates == 0 || h->nstates > UINT32_MAX || h->nedges > UINT32_MAX
+		|| h->max_len >= h->nstates)
+		return DISTANCE_EFORMAT;
+	// tables sizes, in 4 bytes words, rounded up to 8 bytes before the values
+	words = 2 * h->nstates + 1 + 2 * h->nedges;
+	if (h->flags & DAWG_VALUES)
+		words += words & 1;
+	if (words > room / 4)
+		return DISTANCE_EFORMAT;
+	room -= words * 4;
+
+	dawg->nstates = (dist_ssize_t)h->nstates;
+	dawg->nedges = (dist_ssize_t)h->nedges;
+	dawg->max_len = (dist_ssize_t)h->max_len;
+	dawg->first = (const uint32_t *)(dawg->file.data + sizeof(struct dawg_header));
+	dawg->info = dawg->first + dawg->nstates + 1;
+	dawg->labels = dawg->info + dawg->nstates;
+	dawg->targets = dawg->labels + dawg->nedges;
+	// the words accepted from the root are all the words
+	if (h->count != dawg->info[0] >> 1)
+		return DISTANCE_EFORMAT;
+	dawg->count = (dist_ssize_t)h->count;
+	dawg->values = NULL;
+	if (h->flags & DAWG_VALUES) {
+		if (h->count > room / 8)
+			return DISTANCE_EFORMAT;
+		dawg->values = (const int64_t *)(dawg->first + words);
+	}
+	return DISTANCE_OK;
+}
+
+
+// Edges of the state `s`, from `*start` to `*end`; returns 0 if they aren't
+// in the file.
+
+static int
+dawg_edges(const struct distance_dawg *dawg, uint32_t s, uint32_t *start, uint32_t *end)
+{
+	*start = dawg->first[s];
+	*end = dawg->first[s + 1];
+	return *start <= *end && *end <= dawg->nedges;
+}
+
+
+DISTANCE_API int
+distance_dawg_open(const char *path, struct distance_dawg **dawg)
+{
+	struct distance_dawg *d;
+	int status;
+
+	if ((d = (struct distance_dawg *)calloc(1, sizeof(struct distance_dawg))) == NULL)
+		return DISTANCE_ENOMEM;
+	if ((status = file_map(&d->file, path)) != DISTANCE_OK) {
+		free(d);
+		return status;
+	}
+	if ((status = dawg_parse(d)) != DISTANCE_OK) {
+		file_unmap(&d->file);
+		free(d);
+		return status;
+	}
+	*dawg = d;
+	return DISTANCE_OK;
+}
+
+
+DISTANCE_API void
+distance_dawg_close(struct distance_dawg *dawg)
+{
+	if (dawg == NULL)
+		return;
+	file_unmap(&dawg->file);
+	free(dawg);
+}
+
+
+DISTANCE_API dist_ssize_t
+distance_dawg_size(const struct distance_dawg *dawg)
+{
+	return dawg->count;
+}
+
+
+DISTANCE_API dist_ssize_t
+distance_dawg_max_len(const struct distance_dawg *dawg)
+{
+	return dawg->max_len;
+}
+
+
+DISTANCE_API const int64_t *
+distance_dawg_values(const struct distance_dawg *dawg)
+{
+	return dawg->values;
+}
+
+
+static uint32_t
+key_item(const void *key, int width, dist_ssize_t j)
+{
+	switch (width) {
+		case 1:
+			return ((const uint8_t *)key)[j];
+		case 2:
+			return ((const uint16_t *)key)[j];
+	}
+	return ((const uint32_t *)key)[j];
+}
+
+
+DISTANCE_API int
+distance_dawg_find(const struct distance_dawg *dawg, const void *key, int width,
+	dist_ssize_t len, dist_ssize_t *rank)
+{
+	dist_ssize_t j, r = 0;
+	uint32_t s = 0, e, start, end, item;
+
+	if (len < 0 || (width != 1 && width != 2 && width != 4))
+		return DISTANCE_EINVAL;
+
+	*rank = -1;
+	if (len > dawg->max_len)
+		return DISTANCE_OK;
+	for (j = 0; j < len; j++) {
+		if (!dawg_edges(dawg, s, &start, &end))
+			return DISTANCE_EFORMAT;
+		item = key_item(key, width, j);
+		// the words of the state, and of the edges before `item`, come first
+		r += dawg->info[s] & 1;
+		for (e = start; e < end && dawg->labels[e] < item; e++) {
+			if (dawg->targets[e] >= dawg->nstates)
+				return DISTANCE_EFORMAT;
+			r += dawg->info[dawg->targets[e]] >> 1;
+		}
+		if (e == end || dawg->labels[e] != item)
+			return DISTANCE_OK;
+		if ((s = dawg->targets[e]) >= dawg->nstates)
+			return DISTANCE_EFORMAT;
+	}
+	if (dawg->info[s] & 1) {
+		if (r >= dawg->count)
+			return DISTANCE_EFORMAT;
+		*rank = r;
+	}
+	return DISTANCE_OK;
+}
+
+
+DISTANCE_API int
+distance_dawg_word(const struct distance_dawg *dawg, dist_ssize_t rank, uint32_t *items,
+	dist_ssize_t *len)
+{
+	dist_ssize_t j, words;
+	uint32_t s = 0, e, start, end;
+
+	if (rank < 0 || rank >= dawg->count)
+		return DISTANCE_EINVAL;
+
+	for (j = 0; j <= dawg->max_len; j++) {
+		if (dawg->info[s] & 1) {
+			if (rank == 0) {
+				*len = j;
+				return DISTANCE_OK;
+			}
+			rank--;
+		}
+		if (!dawg_edges(dawg, s, &start, &end))
+			return DISTANCE_EFORMAT;
+		for (e = start; e < end; e++) {
+			if (dawg->targets[e] >= dawg->nstates)
+				return DISTANCE_EFORMAT;
+			words = dawg->info[dawg->targets[e]] >> 1;
+			if (rank < words)
+				break;
+			rank -= words;
+		}
+		if (e == end || j == dawg->max_len)
+			break;
+		items[j] = dawg->labels[e];
+		s = dawg->targets[e];
+	}
+	return DISTANCE_EFORMAT;
+}
+
+
+/* The search walks the automaton depth-first, in the lexicographic order of
+the words, keeping the rows of the Levenshtein matrix in a stack indexed by
+depth as the trie search does, and counting the words it goes past, which
+gives the number of each word found. */
+
+struct dawg_walk {
+	const struct distance_dawg *dawg;
+	dist_ssize_t len;
+	dist_ssize_t max_dist;
+	int prefix;
+	dist_ssize_t rank;			// number of the words seen so far
+	struct distance_hit **hits;
+	dist_ssize_t *nhits;
+	dist_ssize_t cap;
+};
+
+struct dawg_frame {
+	uint32_t state;
+	uint32_t edge;			// next edge to follow
+	uint32_t end;
+	dist_ssize_t best;		// lowest distance of the prefixes down to the state
+};
+
+
+/* Visits the state `s`, which last cell is `dist` and lowest cell `min`:
+appends its hits, and returns 1 if its edges are to be followed, 0 if its
+words were all counted, or a status. */
+
+static int
+dawg_visit(struct dawg_walk *w, uint32_t s, dist_ssize_t dist, dist_ssize_t min,
+	dist_ssize_t *best)
+{
+	dist_ssize_t i, words = w->dawg->info[s] >> 1;
+	int status;
+
+	if (words > w->dawg->count - w->rank)
+		return DISTANCE_EFORMAT;
+	if (w->prefix) {
+		if (dist < *best)
+			*best = dist;
+		// the deeper prefixes can't be closer: all the words below match
+		if ((w->max_dist < 0 || *best <= w->max_dist) && min >= *best) {
+			for (i = 0; i < words; i++) {
+				if ((status = hits_append(w->hits, w->nhits, &w->cap, w->rank + i, *best)) != DISTANCE_OK)
+					return status;
+			}
+			w->rank += words;
+			return 0;
+		}
+		dist = *best;
+	}
+	// no word below this state is close enough
+	if (w->max_dist >= 0 && min > w->max_dist) {
+		w->rank += words;
+		return 0;
+	}
+	if (w->dawg->info[s] & 1) {
+		if ((w->max_dist < 0 || dist <= w->max_dist)
+			&& (status = hits_append(w->hits, w->nhits, &w->cap, w->rank, dist)) != DISTANCE_OK)
+			return status;
+		w->rank++;
+	}
+	return 1;
+}
+
+
+DISTANCE_API int
+distance_dawg_search(const struct distance_dawg *dawg, const void *query, int width,
+	dist_ssize_t len, dist_ssize_t max_dist, int prefix, struct distance_hit **hits,
+	dist_ssize_t *nhits)
+{
+	struct dawg_walk w = {dawg, len, max_dist, prefix, 0, hits, nhits, 0};
+	struct dawg_frame *frames = NULL;
+	dist_ssize_t rows, d, j, lo, hi, min, cost, inf, best;
+	dist_ssize_t *stack = NULL, *prev, *row;
+	uint32_t *q = NULL, item, t, e, start, end;
+	int status = DISTANCE_ENOMEM;
+
+	if (len < 0 || (width != 1 && width != 2 && width != 4))
+		return DISTANCE_EINVAL;
+
+	*hits = NULL;
+	*nhits = 0;
+
+	// with a bound, the states deeper than `len + max_dist + 1` are never reached
+	rows = dawg->max_len;
+	if (max_dist >= 0 && max_dist < rows && len + max_dist + 1 < rows)
+		rows = len + max_dist + 1;
+	inf = (max_dist >= 0 ? max_dist + 1 : len + rows + 1);
+	if ((stack = (dist_ssize_t *)malloc((rows + 1) * (len + 2) * sizeof(dist_ssize_t))) == NULL
+		|| (frames = (struct dawg_frame *)malloc((rows + 1) * sizeof(struct dawg_frame))) == NULL
+		|| (q = (uint32_t *)malloc((len + 1) * sizeof(uint32_t))) == NULL)
+		goto On_Exit;
+	if (width < 4)
+		items_widen(q, 4, query, width, len);
+	else
+		memcpy(q, query, len * sizeof(uint32_t));
+
+	// row of the root; each row has a sentinel after its last cell
+	for (j = 0; j <= len; j++)
+		stack[j] = j;
+	stack[len + 1] = inf;
+	best = len + rows + 1;
+	if ((status = dawg_visit(&w, 0, len, 0, &best)) <= 0)
+		goto On_Exit;
+	frames[0].state = 0;
+	frames[0].best = best;
+	if (!dawg_edges(dawg, 0, &frames[0].edge, &frames[0].end)) {
+		status = DISTANCE_EFORMAT;
+		goto On_Exit;
+	}
+
+	for (d = 0; d >= 0; ) {
+		if (frames[d].edge == frames[d].end) {
+			d--;
+			continue;
+		}
+		e = frames[d].edge++;
+		item = dawg->labels[e];
+		if ((t = dawg->targets[e]) >= dawg->nstates || d + 1 > rows) {
+			status = DISTANCE_EFORMAT;
+			goto On_Exit;
+		}
+		prev = stack + d * (len + 2);
+		row = prev + (len + 2);
+		d++;
+
+		// only the cells at most `max_dist` away from the diagonal are computed
+		lo = 1;
+		hi = len;
+		if (max_dist >= 0) {
+			lo = (d > max_dist ? d - max_dist : 1);
+			hi = (d + max_dist < len ? d + max_dist : len);
+		}
+		row[0] = d;
+		min = (lo == 1 ? d : inf);
+		if (lo > 1)
+			row[lo - 1] = inf;
+		for (j = lo; j <= hi; j++) {
+			cost = prev[j - 1] + (q[j - 1] != item);
+			if (prev[j] + 1 < cost)
+				cost = prev[j] + 1;
+			if (row[j - 1] + 1 < cost)
+				cost = row[j - 1] + 1;
+			if (max_dist >= 0 && cost > inf)
+				cost = inf;
+			row[j] = cost;
+			if (cost < min)
+				min = cost;
+		}
+		row[hi + 1] = inf;
+
+		// the last cell is out of the band when the state is too shallow
+		best = frames[d - 1].best;
+		status = dawg_visit(&w, t, (hi == len ? row[len] : inf), min, &best);
+		if (status < 0)
+			goto On_Exit;
+		if (status == 0) {
+			d--;
+			continue;
+		}
+		if (!dawg_edges(dawg, t, &start, &end)) {
+			status = DISTANCE_EFORMAT;
+			goto On_Exit;
+		}
+		frames[d].state = t;
+		frames[d].edge = start;
+		frames[d].end = end;
+		frames[d].best = best;
+	}
+	status = DISTANCE_OK;
+
+	On_Exit:
+		free(stack);
+		free(frames);
+		free(q);
+		if (status < 0) {
+			free(*hits);
+			*hits = NULL;
+			*nhits = 0;
+			return status;
+		}
+		return DISTANCE_OK;
+}
@@ -1,44 +1,353 @@
 #include "distance.h"
 #include "includes.h"
+#include "pool.h"
 
 
-static unicode *
-get_unicode(PyObject *obj, Py_ssize_t *len)
+// Kernels for Python sequences, e.g. `levenshtein_seq`.
+
+#define SEQUENCE_COMP(s1, i1, s2, i2)									\
+	PyObject_RichCompareBool(											\
+		PySequence_Fast_GET_ITEM((s1), (i1)),							\
+		PySequence_Fast_GET_ITEM((s2), (i2)),							\
+		Py_EQ)
+
+#define KERNEL_ITEM PyObject
+#define KERNEL_SUFFIX seq
+#define KERNEL_TYPE DISTANCE_STATS_SEQ
+#include "kernels.h"
+#undef KERNEL_ITEM
+#undef KERNEL_SUFFIX
+#undef KERNEL_TYPE
+#undef SEQUENCE_COMP
+
+
+// Raises the exception corresponding to a libdistance status code.
+
+static PyObject *
+set_error(int status)
 {
-	unicode *u;
-	
-	if ((u = PyUnicode_AS_UNICODE(obj)) == NULL) {
+	switch (status) {
+		case DISTANCE_ENOMEM:
+			return PyErr_NoMemory();
+		case DISTANCE_ECOMPARE:
+			return NULL; // the comparison raised an exception already
+	}
+	PyErr_SetString(PyExc_ValueError, distance_strerror(status));
+	return NULL;
+}
+
+
+/* A `Pattern` (see compile_query) can be passed wherever a sequence is
+expected first, and stands for its query. */
+
+typedef struct {
+	PyObject_HEAD
+	PyObject *seq;					// the query, as a tuple for lists and tuples
+	PyObject *metrics;				// names of the metrics it was compiled for
+	int q;
+	char seqtype;					// 'u', 'b', 'i' or 'a'
+	Py_ssize_t len;
+	struct distance_pattern *pat;	// NULL for other sequences than strings and arrays
+} PatternObject;
+
+extern PyTypeObject Pattern_Type;
+
+#define PATTERN_CHECK(obj) PyObject_TypeCheck((obj), &Pattern_Type)
+#define QUERY(obj) (PATTERN_CHECK(obj) ? ((PatternObject *)(obj))->seq : (obj))
+#define COMPILED(obj) (PATTERN_CHECK(obj) ? ((PatternObject *)(obj))->pat : NULL)
+
+
+/* A `PackedDNA` (see dna.c). hamming and levenshtein compare two of them, or
+one of them with a string of bases, which is then packed, with the packed
+kernels. */
+
+typedef struct {
+	PyObject_HEAD
+	struct distance_dna dna;
+} PackedDNAObject;
+
+extern PyTypeObject PackedDNA_Type;
+
+#define DNA_CHECK(obj) PyObject_TypeCheck((obj), &PackedDNA_Type)
+
+
+static int
+get_unicode(PyObject *obj, sequence *seq, Py_ssize_t *len)
+{
+#if PY_VERSION_HEX >= 0x03030000
+	if (PyUnicode_READY(obj) == -1)
+		return 0;
+	seq->width = PyUnicode_KIND(obj);	// 1, 2 or 4 bytes
+	seq->items = PyUnicode_DATA(obj);
+#else
+	seq->width = Py_UNICODE_SIZE;
+	if ((seq->items = PyUnicode_AS_UNICODE(obj)) == NULL) {
 		PyErr_Format(PyExc_RuntimeError, "failed to get unicode representation of object");
-		return NULL;
+		return 0;
 	}
+#endif
+	seq->copy = NULL;
+	seq->view.obj = NULL;
 	*len = PyUnicode_GET_LENGTH(obj);
 	
-	return u;
+	return 1;
 }
 
 
-static byte *
-get_byte(PyObject *obj, Py_ssize_t *len)
+static int
+get_byte(PyObject *obj, sequence *seq, Py_ssize_t *len)
 {
-	byte *b;
-
-	b = PyBytes_AS_STRING(obj);
+	seq->width = 1;
+	seq->items = PyBytes_AS_STRING(obj);
+	seq->copy = NULL;
+	seq->view.obj = NULL;
 	*len = PyBytes_GET_SIZE(obj);
 	
-	return b;
+	return 1;
 }
 
 
-static array *
-get_array(PyObject *obj, Py_ssize_t *len)
+static int
+get_array(PyObject *obj, sequence *seq, Py_ssize_t *len)
 {
-	array *a;
+	seq->width = 0;
+	seq->copy = NULL;
+	seq->view.obj = NULL;
+	if ((seq->a = PySequence_Fast(obj, "we got a problem")) == NULL)
+		return 0;
+	*len = PySequence_Fast_GET_SIZE(seq->a);
 	
-	if ((a = PySequence_Fast(obj, "we got a problem")) == NULL)
+	return 1;
+}
+
+
+/* Objects supporting the buffer protocol, e.g. `array.array("I")` or the
+arrays returned by `Vocabulary.encode`, are passed to the kernels as is if
+they are one-dimensional arrays of unsigned integers of 8, 16 or 32 bits, in
+native byte order. Returns 0, without error, for other objects. */
+
+static int
+get_ints(PyObject *obj, sequence *seq, Py_ssize_t *len)
+{
+	const char *format;
+	
+	if (!PyObject_CheckBuffer(obj))
+		return 0;
+	if (PyObject_GetBuffer(obj, &seq->view, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) == -1) {
+		PyErr_Clear();
+		return 0;
+	}
+	format = (seq->view.format ? seq->view.format : "B");
+	if (*format == '@' || *format == '=')
+		format++;
+	if (seq->view.ndim != 1 || format[0] == '\0' || format[1] != '\0'
+		|| !strchr("BHIL", format[0])
+		|| (seq->view.itemsize != 1 && seq->view.itemsize != 2 && seq->view.itemsize != 4)) {
+		PyBuffer_Release(&seq->view);
+		seq->view.obj = NULL;
+		return 0;
+	}
+	seq->width = (int)seq->view.itemsize;
+	seq->items = seq->view.buf;
+	seq->copy = NULL;
+	*len = seq->view.len / seq->view.itemsize;
+	
+	return 1;
+}
+
+
+// Copies `len` items of `from` bytes into a new buffer of items of `to` bytes,
+// which must be wider.
+
+static void *
+widen_items(const void *items, int from, Py_ssize_t len, int to)
+{
+	void *copy;
+	Py_ssize_t i;
+
+	if ((copy = malloc((len + 1) * to)) == NULL) {
+		PyErr_NoMemory();
 		return NULL;
-	*len = PySequence_Fast_GET_SIZE(a);
+	}
+	for (i = 0; i < len; i++) {
+		if (to == 4)
+			((uint32_t *)copy)[i] = (from == 1 ? ((uint8_t *)items)[i] : ((uint16_t *)items)[i]);
+		else
+			((uint16_t *)copy)[i] = ((uint8_t *)items)[i];
+	}
+	return copy;
+}
+
+
+/* Unicode strings may have items of different widths; the narrowest one is
+then copied with the width of the other one, so that both can be passed to the
+same kernel. The copy, which replaces the folded items if any, is freed by
+`release_sequence`. */
+
+static int
+match_widths(sequence *seq1, sequence *seq2, Py_ssize_t len1, Py_ssize_t len2)
+{
+	sequence *seq = seq1;
+	Py_ssize_t len = len1;
+	int width = seq2->width;
+	void *wide;
+
+	if (seq1->width == seq2->width)
+		return 1;
+	if (seq1->width > seq2->width) {
+		seq = seq2;
+		len = len2;
+		width = seq1->width;
+	}
+
+	if ((wide = widen_items(seq->items, seq->width, len, width)) == NULL)
+		return 0;
+	free(seq->copy);
+	seq->copy = seq->items = wide;
+	seq->width = width;
+	
+	return 1;
+}
+
+
+static void
+release_sequence(sequence *seq)
+{
+	free(seq->copy);
+	seq->copy = NULL;
+	if (seq->view.obj != NULL)
+		PyBuffer_Release(&seq->view);
+	else if (seq->width == 0)
+		Py_DECREF(seq->a);
+}
+
+
+// Names of the `fold` options, in the order of `enum distance_fold_mode`.
+
+static const char *fold_modes[] = {"none", "ascii", "simple"};
+
+
+static int
+get_fold(const char *name)
+{
+	int fold;
+	
+	for (fold = 0; fold < 3; fold++) {
+		if (strcmp(name, fold_modes[fold]) == 0)
+			return fold;
+	}
+	PyErr_SetString(PyExc_ValueError, "expected one of none, ascii, simple for `fold`");
+	return -1;
+}
+
+
+// Number of threads of a single comparison: 0 means one per CPU.
+
+static int
+get_workers(int workers)
+{
+	if (workers < 0) {
+		PyErr_SetString(PyExc_ValueError, "expected a positive number of workers, or 0");
+		return -1;
+	}
+	return (workers == 0 ? pool_cpu_count() : workers);
+}
+
+
+/* Buffer reused for folding many sequences, e.g. the candidates of an
+iterator, instead of allocating a copy of each: `size` bytes at `items`, which
+are reallocated if too small, unless `fixed`. */
+
+struct fold_buffer {
+	void *items;
+	size_t size;
+	int fixed;
+};
+
+/* Per thread buffers of the functions comparing two strings, which fold the
+shorter ones; the allocation of a copy of the longer ones costs little next
+to their comparison. The buffers are only used until the function returns, and
+the calling thread waits for the workers, if any, which read them. */
+
+#define FOLD_SCRATCH 1024
+
+static THREAD_LOCAL uint32_t fold_scratch[2][FOLD_SCRATCH / 4];
+
+
+/* Replaces the items of `seq`, a string of type `type`, with their folded
+case (see distance_fold). They are folded into `buffer` if any, and else
+into a copy, freed by `release_sequence`. Byte strings are only folded as
+ASCII, as their encoding is unknown. Other sequences can't be folded. */
+
+static int
+fold_sequence(sequence *seq, Py_ssize_t len, char type, int fold, struct fold_buffer *buffer)
+{
+	void *folded;
+	size_t size;
+	int width, status;
+	
+	if (fold == DISTANCE_FOLD_NONE)
+		return 1;
+	if (type != 'u' && type != 'b') {
+		PyErr_SetString(PyExc_ValueError, "expected strings, for folding their case");
+		return 0;
+	}
+	if (type == 'b')
+		fold = DISTANCE_FOLD_ASCII;
+	
+	size = DISTANCE_FOLD_SIZE(len, seq->width);
+	if (buffer && size > buffer->size && !buffer->fixed) {
+		if ((folded = realloc(buffer->items, size)) == NULL) {
+			PyErr_NoMemory();
+			return 0;
+		}
+		buffer->items = folded;
+		buffer->size = size;
+	}
+	if (buffer && size <= buffer->size) {
+		if ((status = distance_fold_into(seq->items, seq->width, len, fold, buffer->items, &width)) != DISTANCE_OK) {
+			set_error(status);
+			return 0;
+		}
+		if (width == 0)
+			return 1;
+		free(seq->copy);
+		seq->copy = NULL;
+		seq->items = buffer->items;
+		seq->width = width;
+		return 1;
+	}
+	
+	if ((status = distance_fold(seq->items, seq->width, len, fold, &folded, &width)) != DISTANCE_OK) {
+		set_error(status);
+		return 0;
+	}
+	if (folded == NULL)
+		return 1;
+	free(seq->copy);
+	seq->copy = seq->items = folded;
+	seq->width = width;
+	return 1;
+}
+
+
+// Gives `seq` a copy of its items if they were folded into the buffers of
+// the thread, for the sequences kept beyond the call.
+
+static int
+keep_sequence(sequence *seq, Py_ssize_t len)
+{
+	void *copy;
 	
-	return a;
+	if (seq->items != fold_scratch[0] && seq->items != fold_scratch[1])
+		return 1;
+	if ((copy = malloc((len + 1) * seq->width)) == NULL) {
+		PyErr_NoMemory();
+		return 0;
+	}
+	memcpy(copy, seq->items, len * seq->width);
+	seq->copy = seq->items = copy;
+	return 1;
 }
 
 
@@ -47,17 +356,20 @@ get_sequence(PyObject *obj, sequence *seq, Py_ssize_t *len, char type)
 {
 	char t = '\0';
 	
+	obj = QUERY(obj);
 	if (PyUnicode_Check(obj)) {
 		t = 'u';
-		if ((seq->u = get_unicode(obj, len)) == NULL)
+		if (!get_unicode(obj, seq, len))
 			return '\0';
 	} else if (PyBytes_Check(obj)) {
 		t = 'b';
-		if ((seq->b = get_byte(obj, len)) == NULL)
+		if (!get_byte(obj, seq, len))
 			return '\0';
+	} else if (get_ints(obj, seq, len)) {
+		t = 'i';
 	} else if (PySequence_Check(obj)) {
 		t = 'a';
-		if ((seq->a = get_array(obj, len)) == NULL)
+		if (!get_array(obj, seq, len))
 			return '\0';
 	}
 	
@@ -69,39 +381,78 @@ get_sequence(PyObject *obj, sequence *seq, Py_ssize_t *len, char type)
 		PyErr_SetString(PyExc_ValueError, "type mismatch between the "
 			"value provided as left argument and one of the elements in "
 			"the right one, can't process the later");
-		if (t == 'a')
-			Py_DECREF(seq->a);
+		if (t == 'a' || t == 'i')
+			release_sequence(seq);
 		return '\0';
 	}
 	return t;
 }
 
 
+// Reads two sequences, with their case folded as per `fold` (see
+// fold_sequence), which only applies to two strings of the same type.
+
 static char
 get_sequences(PyObject *arg1, PyObject *arg2, sequence *seq1, sequence *seq2,
-              Py_ssize_t *len1, Py_ssize_t *len2)
+              Py_ssize_t *len1, Py_ssize_t *len2, int fold)
 {
+	struct fold_buffer scratch[2] = {
+		{fold_scratch[0], sizeof(fold_scratch[0]), 1},
+		{fold_scratch[1], sizeof(fold_scratch[1]), 1}
+	};
+	
+	arg1 = QUERY(arg1);
+	arg2 = QUERY(arg2);
 	if (PyUnicode_Check(arg1) && PyUnicode_Check(arg2)) {
 		
-		if ((seq1->u = get_unicode(arg1, len1)) == NULL)
+		if (!get_unicode(arg1, seq1, len1) || !get_unicode(arg2, seq2, len2))
 			return '\0';
-		if ((seq2->u = get_unicode(arg2, len2)) == NULL)
+		if (!fold_sequence(seq1, *len1, 'u', fold, &scratch[0])
+			|| !fold_sequence(seq2, *len2, 'u', fold, &scratch[1])
+			|| !match_widths(seq1, seq2, *len1, *len2)) {
+			release_sequence(seq1);
+			release_sequence(seq2);
 			return '\0';
+		}
 		return 'u';
 		
 	} else if (PyBytes_Check(arg1) && PyBytes_Check(arg2)) {
 	
-		if ((seq1->b = get_byte(arg1, len1)) == NULL)
-			return '\0';
-		if ((seq2->b = get_byte(arg2, len2)) == NULL)
+		get_byte(arg1, seq1, len1);
+		get_byte(arg2, seq2, len2);
+		if (!fold_sequence(seq1, *len1, 'b', fold, &scratch[0])
+			|| !fold_sequence(seq2, *len2, 'b', fold, &scratch[1])) {
+			release_sequence(seq1);
+			release_sequence(seq2);
 			return '\0';
+		}
 		return 'b';
 		
-	} else if (PySequence_Check(arg1) && PySequence_Check(arg2)) {
+	} else if (fold != DISTANCE_FOLD_NONE) {
+		
+		PyErr_SetString(PyExc_ValueError, "expected two strings of the same type, "
+			"for folding their case");
+		return '\0';
+		
+	} else if (get_ints(arg1, seq1, len1)) {
+	
+		// arrays of integers, or an array compared with another sequence
+		if (get_ints(arg2, seq2, len2)) {
+			if (!match_widths(seq1, seq2, *len1, *len2)) {
+				release_sequence(seq1);
+				release_sequence(seq2);
+				return '\0';
+			}
+			return 'i';
+		}
+		release_sequence(seq1);
+	}
 	
-		if ((seq1->a = get_array(arg1, len1)) == NULL)
+	if (PySequence_Check(arg1) && PySequence_Check(arg2)) {
+	
+		if (!get_array(arg1, seq1, len1))
 			return '\0';
-		if ((seq2->a = get_array(arg2, len2)) == NULL) {
+		if (!get_array(arg2, seq2, len2)) {
 			Py_DECREF(seq1->a);				/* warning ! */
 			return '\0';
 		}
@@ -113,52 +464,138 @@ get_sequences(PyObject *arg1, PyObject *arg2, sequence *seq1, sequence *seq2,
 }
 
 
+
+/* Reads `obj` for a comparison with the compiled query of `pattern`, which
+must be a string of the same type, or an array. Returns 0, without error,
+if they can't be compared this way, and -1 on error. */
+
+static int
+pattern_sequence(PyObject *pattern, PyObject *obj, sequence *seq, Py_ssize_t *len)
+{
+	if (COMPILED(pattern) == NULL)
+		return 0;
+	switch (((PatternObject *)pattern)->seqtype) {
+		case 'u':
+			if (!PyUnicode_Check(obj))
+				return 0;
+			return (get_unicode(obj, seq, len) ? 1 : -1);
+		case 'b':
+			if (!PyBytes_Check(obj))
+				return 0;
+			get_byte(obj, seq, len);
+			return 1;
+	}
+	return get_ints(obj, seq, len);
+}
+
+/* Packs `obj`, a string of bases, into `dna`. Returns 0 with an exception if
+it isn't one. */
+
+static int
+dna_pack_object(PyObject *obj, struct distance_dna *dna)
+{
+	sequence seq;
+	Py_ssize_t len, bad;
+	int status;
+	
+	if (PyUnicode_Check(obj)) {
+		if (!get_unicode(obj, &seq, &len))
+			return 0;
+	} else if (PyBytes_Check(obj))
+		get_byte(obj, &seq, &len);
+	else {
+		PyErr_SetString(PyExc_ValueError, "expected a PackedDNA, or a string of bases");
+		return 0;
+	}
+	status = distance_dna_pack(seq.items, seq.width, len, dna, &bad);
+	if (status == DISTANCE_EINVAL) {
+		PyErr_Format(PyExc_ValueError, "expected A, C, G, T or N at position %zd", bad);
+		return 0;
+	}
+	if (status != DISTANCE_OK) {
+		set_error(status);
+		return 0;
+	}
+	return 1;
+}
+
+
+/* If one of `arg1` and `arg2` is a PackedDNA, stores the two packed sequences
+in `dna1` and `dna2`, the other one being packed into `tmp` if needed, which
+must then be released. Returns 0 if neither is a PackedDNA, and -1 on
+error. */
+
+static int
+get_dna_pair(PyObject *arg1, PyObject *arg2, const struct distance_dna **dna1,
+	const struct distance_dna **dna2, struct distance_dna *tmp)
+{
+	tmp->bits = tmp->n = NULL;
+	if (!DNA_CHECK(arg1) && !DNA_CHECK(arg2))
+		return 0;
+	*dna1 = (DNA_CHECK(arg1) ? &((PackedDNAObject *)arg1)->dna : tmp);
+	*dna2 = (DNA_CHECK(arg2) ? &((PackedDNAObject *)arg2)->dna : tmp);
+	if (!DNA_CHECK(arg1) && !dna_pack_object(arg1, tmp))
+		return -1;
+	if (!DNA_CHECK(arg2) && !dna_pack_object(arg2, tmp))
+		return -1;
+	return 1;
+}
+
+
 static PyObject *
 hamming_py(PyObject *self, PyObject *args, PyObject *kwargs)
 {
 	PyObject *arg1, *arg2, *odo_normalize = NULL;
-	int do_normalize = 0;
-	static char *keywords[] = {"seq1", "seq2", "normalized", NULL};
+	const char *fold_name = "none";
+	int do_normalize = 0, fold;
+	static char *keywords[] = {"seq1", "seq2", "normalized", "fold", NULL};
 
 	char type;
 	sequence seq1, seq2;
 	Py_ssize_t len1, len2;
 	Py_ssize_t dist;
+	const struct distance_dna *dna1, *dna2;
+	struct distance_dna tmp;
+	int status, packed;
 
 	if (!PyArg_ParseTupleAndKeywords(args, kwargs,
-		"OO|O:hamming", keywords, &arg1, &arg2, &odo_normalize))
+		"OO|Os:hamming", keywords, &arg1, &arg2, &odo_normalize, &fold_name))
+		return NULL;
+	if ((fold = get_fold(fold_name)) == -1)
 		return NULL;
 
 	if (odo_normalize && (do_normalize = PyObject_IsTrue(odo_normalize)) == -1)
 		return NULL;
 	
-	if ((type = get_sequences(arg1, arg2, &seq1, &seq2, &len1, &len2)) == '\0')
+	if ((packed = get_dna_pair(arg1, arg2, &dna1, &dna2, &tmp)) == -1)
 		return NULL;
-	
-	if (len1 != len2) {
-		PyErr_SetString(PyExc_ValueError, "expected two objects of the same length");
-		if (type == 'a') {
-			Py_DECREF(seq1.a);
-			Py_DECREF(seq2.a);
+	if (packed) {
+		len1 = dna1->len;
+		status = distance_dna_hamming(dna1, dna2, &dist);
+		distance_dna_release(&tmp);
+		if (status == DISTANCE_EINVAL) {
+			PyErr_SetString(PyExc_ValueError, "expected two objects of the same length");
+			return NULL;
 		}
-		return NULL;
 	}
-	
-	switch(type) {
-		case 'u':
-			dist = uhamming(seq1.u, seq2.u, len1);
-			break;
-		case 'b':
-			dist = bhamming(seq1.b, seq2.b, len1);
-			break;
-		default:
-			dist = ahamming(seq1.a, seq2.a, len1);
-			Py_DECREF(seq1.a);
-			Py_DECREF(seq2.a);
+	else {
+		if ((type = get_sequences(arg1, arg2, &seq1, &seq2, &len1, &len2, fold)) == '\0')
+			return NULL;
+		
+		if (len1 != len2) {
+			PyErr_SetString(PyExc_ValueError, "expected two objects of the same length");
+			release_sequence(&seq1);
+			release_sequence(&seq2);
+			return NULL;
+		}
+		
+		DISPATCH(status, hamming, seq1, seq2, len1, &dist);
+		release_sequence(&seq1);
+		release_sequence(&seq2);
 	}
 	
-	if (dist == -1) // comparison failed
-		return NULL;
+	if (status != DISTANCE_OK)
+		return set_error(status);
 	
 	if (do_normalize) {
 		if (len1 == 0)
@@ -171,63 +608,61 @@ hamming_py(PyObject *self, PyObject *args, PyObject *kwargs)
 
 
 static PyObject *
-lcsubstrings_py_make_set(PyObject *arg1, PyObject *arg2, UT_array *stack, Py_ssize_t mlen)
+lcsubstrings_py_make_set(PyObject *arg1, PyObject *arg2, struct distance_pair *pairs,
+                         Py_ssize_t npairs, Py_ssize_t mlen)
 {
 	PyObject *set, *ss;
-	struct pair_t *pair;
+	Py_ssize_t i;
 	
 	if ((set = PySet_New(NULL)) == NULL) {
-		utarray_free(stack);
+		distance_free(pairs);
 		return NULL;
 	}
 
-	for (pair = (struct pair_t*)utarray_front(stack);
-		pair != NULL;
-		pair = (struct pair_t*)utarray_next(stack, pair)) {
-		
-		ss = PySequence_GetSlice(arg2, pair->j - mlen + 1, pair->j + 1);
+	for (i = 0; i < npairs; i++) {
+		ss = PySequence_GetSlice(arg2, pairs[i].j, pairs[i].j + mlen);
 		if (ss == NULL)
 			goto On_Error;
-		if ((PySet_Add(set, ss)) == -1)
+		if ((PySet_Add(set, ss)) == -1) {
+			Py_DECREF(ss);
 			goto On_Error;
+		}
+		Py_DECREF(ss);
 	}
 
-	utarray_free(stack);
+	distance_free(pairs);
 	return set;
 	
 	On_Error:
 		PySet_Clear(set);
 		Py_DECREF(set);
-		utarray_free(stack);
+		distance_free(pairs);
 		return NULL;
 }
 
 
 static PyObject *
-lcsubstrings_py_make_tuple(PyObject *arg1, PyObject *arg2, UT_array *stack, Py_ssize_t mlen)
+lcsubstrings_py_make_tuple(PyObject *arg1, PyObject *arg2, struct distance_pair *pairs,
+                           Py_ssize_t npairs, Py_ssize_t mlen)
 {
 	PyObject *tp, *stp;
 	Py_ssize_t i;
-	struct pair_t *pair;
 	
-	if ((stp = PyTuple_New(utarray_len(stack))) == NULL) {
-		utarray_free(stack);
+	if ((stp = PyTuple_New(npairs)) == NULL) {
+		distance_free(pairs);
 		return NULL;
 	}
-	for (i = 0, pair = (struct pair_t*)utarray_front(stack);
-		pair != NULL;
-		++i, pair = (struct pair_t*)utarray_next(stack, pair)) {
-		PyTuple_SET_ITEM(stp, i, Py_BuildValue("(nn)", pair->i - mlen + 1, pair->j - mlen + 1));
-	}
+	for (i = 0; i < npairs; i++)
+		PyTuple_SET_ITEM(stp, i, Py_BuildValue("(nn)", pairs[i].i, pairs[i].j));
 	if ((tp = PyTuple_New(2)) == NULL) {
-		utarray_free(stack);
+		distance_free(pairs);
 		Py_DECREF(stp);
 		return NULL;
 	}
 	PyTuple_SET_ITEM(tp, 0, Py_BuildValue("n", mlen));
 	PyTuple_SET_ITEM(tp, 1, stp);
 	
-	utarray_free(stack);
+	distance_free(pairs);
 	
 	return tp;
 }
@@ -237,22 +672,28 @@ static PyObject *
 lcsubstrings_py(PyObject *self, PyObject *args, PyObject *kwargs)
 {
 	PyObject *arg1, *arg2, *opos = NULL;
-	int positions = 0;
-	static char *keywords[] = {"seq1", "seq2", "positions", NULL};
+	const char *fold_name = "none";
+	int positions = 0, fold, workers = 1;
+	static char *keywords[] = {"seq1", "seq2", "positions", "fold", "workers", NULL};
 	
 	char type;
 	sequence seq1, seq2;
 	Py_ssize_t len1, len2;
-	UT_array *stack;
-	Py_ssize_t mlen = -1;
+	struct distance_pair *pairs;
+	Py_ssize_t npairs, mlen;
+	int status;
 	
 	if (!PyArg_ParseTupleAndKeywords(args, kwargs,
-		"OO|O:lcsubstrings", keywords, &arg1, &arg2, &opos))
+		"OO|Osi:lcsubstrings", keywords, &arg1, &arg2, &opos, &fold_name, &workers))
 		return NULL;
+	if ((fold = get_fold(fold_name)) == -1 || (workers = get_workers(workers)) == -1)
+		return NULL;
+	arg1 = QUERY(arg1);
+	arg2 = QUERY(arg2);
 	if (opos && (positions = PyObject_IsTrue(opos)) == -1)
 		return NULL;
 
-	if ((type = get_sequences(arg1, arg2, &seq1, &seq2, &len1, &len2)) == '\0')
+	if ((type = get_sequences(arg1, arg2, &seq1, &seq2, &len1, &len2, fold)) == '\0')
 		return NULL;
 	
 	// special case
@@ -269,179 +710,521 @@ lcsubstrings_py(PyObject *self, PyObject *args, PyObject *kwargs)
 		SWAP(Py_ssize_t, len1, len2);
 	}
 
-	switch(type) {
-		case 'u':
-			stack = ulcsubstrings(seq1.u, seq2.u, len1, len2, &mlen);
-			break;
-		case 'b':
-			stack = blcsubstrings(seq1.b, seq2.b, len1, len2, &mlen);
-			break;
-		default:
-			stack = alcsubstrings(seq1.a, seq2.a, len1, len2, &mlen);
-			Py_DECREF(seq1.a);
-			Py_DECREF(seq2.a);
+	// strings are compared without the GIL by several threads
+	if (workers > 1 && seq1.width) {
+		Py_BEGIN_ALLOW_THREADS
+		status = distance_lcsubstrings_parallel(seq1.items, seq2.items, seq1.width, len1, len2,
+			workers, &mlen, &pairs, &npairs);
+		Py_END_ALLOW_THREADS
 	}
+	else
+		DISPATCH(status, lcsubstrings, seq1, seq2, len1, len2, &mlen, &pairs, &npairs);
+	release_sequence(&seq1);
+	release_sequence(&seq2);
 	
-	if (stack == NULL) {
-		/* memory allocation failed */
-		return PyErr_NoMemory();
-	}
+	if (status != DISTANCE_OK)
+		return set_error(status);
 	
 	if (positions)
-		return lcsubstrings_py_make_tuple(arg1, arg2, stack, mlen);
-	return lcsubstrings_py_make_set(arg1, arg2, stack, mlen);
+		return lcsubstrings_py_make_tuple(arg1, arg2, pairs, npairs, mlen);
+	return lcsubstrings_py_make_set(arg1, arg2, pairs, npairs, mlen);
 }
 
 
-static PyObject *
-nlevenshtein_py(PyObject *self, PyObject *args, PyObject *kwargs)
-{
-	PyObject *arg1, *arg2;
-	short method = 1;
-	static char *keywords[] = {"seq1", "seq2", "method", NULL};
+/* Iterator over the maximal common substrings of two sequences (see
+`common_substrings` in lcsubstrings.c). Lists are copied into tuples, so that
+they can't change while they are scanned. */
 
-	char type;
+typedef struct {
+	PyObject_HEAD
+	PyObject *arg1, *arg2;
 	sequence seq1, seq2;
 	Py_ssize_t len1, len2;
-	double dist;
+	Py_ssize_t min_len;
+	struct distance_cursor cursor;
+	int busy;				// scanning without the GIL
+} SubstringsState;
+
+
+static PyObject *
+substrings_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+	PyObject *arg1, *arg2;
+	Py_ssize_t min_len = 1;
+	const char *fold_name = "none";
+	static char *keywords[] = {"seq1", "seq2", "min_len", "fold", NULL};
+	SubstringsState *state;
+	int fold;
 	
-	if (!PyArg_ParseTupleAndKeywords(args, kwargs,
-		"OO|h:nlevenshtein", keywords, &arg1, &arg2, &method))
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|ns:common_substrings",
+		keywords, &arg1, &arg2, &min_len, &fold_name))
 		return NULL;
-	
-	if (method != 1 && method != 2) {
-		PyErr_SetString(PyExc_ValueError, "expected either 1 or 2 for `method` parameter");
+	if ((fold = get_fold(fold_name)) == -1)
 		return NULL;
-	}
-	
-	if ((type = get_sequences(arg1, arg2, &seq1, &seq2, &len1, &len2)) == '\0')
+	arg1 = QUERY(arg1);
+	arg2 = QUERY(arg2);
+	if (min_len < 1) {
+		PyErr_SetString(PyExc_ValueError, "expected a positive `min_len`");
 		return NULL;
-	
-	if (len1 < len2) {
-		SWAP(sequence,   seq1, seq2);
-		SWAP(Py_ssize_t, len1, len2);
 	}
+	if ((state = (SubstringsState *)type->tp_alloc(type, 0)) == NULL)
+		return NULL;
+	state->seq1.width = state->seq2.width = -1;		// nothing to release yet
 	
-	switch(type) {
-		case 'u':
-			dist = unlevenshtein(seq1.u, seq2.u, len1, len2, method);
-			break;
-		case 'b':
-			dist = bnlevenshtein(seq1.b, seq2.b, len1, len2, method);
-			break;
-		default:
-			dist = anlevenshtein(seq1.a, seq2.a, len1, len2, method);
-			Py_DECREF(seq1.a);
-			Py_DECREF(seq2.a);
+	if (PyList_Check(arg1))
+		state->arg1 = PySequence_Tuple(arg1);
+	else {
+		Py_INCREF(arg1);
+		state->arg1 = arg1;
 	}
-	
-	if (dist < 0) {
-		if (dist == -1) // memory allocation failed
-			return PyErr_NoMemory();
-		return NULL;    // comparison failed
+	if (PyList_Check(arg2))
+		state->arg2 = PySequence_Tuple(arg2);
+	else {
+		Py_INCREF(arg2);
+		state->arg2 = arg2;
 	}
-	
-	return Py_BuildValue("d", dist);	
-}
-
-
-static PyObject *
-levenshtein_py(PyObject *self, PyObject *args, PyObject *kwargs)
-{
-	PyObject *arg1, *arg2, *onorm = NULL;
-	Py_ssize_t dist = -1;
-	Py_ssize_t max_dist = -1;
-	int normalized = 0;
-	static char *keywords[] = {"seq1", "seq2", "normalized", "max_dist", NULL};
-
-	char type;
-	sequence seq1, seq2;
-	Py_ssize_t len1, len2;
-	
-	if (!PyArg_ParseTupleAndKeywords(args, kwargs,
-		"OO|On:levenshtein", keywords, &arg1, &arg2, &onorm, &max_dist))
+	if (state->arg1 == NULL || state->arg2 == NULL) {
+		Py_DECREF(state);
 		return NULL;
-	if (onorm && (normalized = PyObject_IsTrue(onorm)) == -1)
+	}
+	if (get_sequences(state->arg1, state->arg2, &state->seq1, &state->seq2,
+		&state->len1, &state->len2, fold) == '\0') {
+		state->seq1.width = state->seq2.width = -1;
+		Py_DECREF(state);
 		return NULL;
-	
-	if (normalized) {
-		onorm = NULL;
-		return nlevenshtein_py(self, args, onorm);
 	}
-
-	if ((type = get_sequences(arg1, arg2, &seq1, &seq2, &len1, &len2)) == '\0')
+	if (!keep_sequence(&state->seq1, state->len1) || !keep_sequence(&state->seq2, state->len2)) {
+		Py_DECREF(state);
 		return NULL;
-	
-	switch(type) {
-		case 'u':
-			dist = ulevenshtein(seq1.u, seq2.u, len1, len2, max_dist);
-			break;
-		case 'b':
-			dist = blevenshtein(seq1.b, seq2.b, len1, len2, max_dist);
-			break;
-		default:
-			dist = alevenshtein(seq1.a, seq2.a, len1, len2, max_dist);
-			Py_DECREF(seq1.a);
-			Py_DECREF(seq2.a);
 	}
-	
-	if (dist < -1) {
-		if (dist == -2)
-			return PyErr_NoMemory(); // memory allocation failed
-		return NULL; // comparison failed
+	state->min_len = min_len;
+	return (PyObject *)state;
+}
+
+
+static void
+substrings_dealloc(SubstringsState *state)
+{
+	if (state->seq1.width != -1) {
+		release_sequence(&state->seq1);
+		release_sequence(&state->seq2);
 	}
-	return Py_BuildValue("n", dist);
+	Py_XDECREF(state->arg1);
+	Py_XDECREF(state->arg2);
+	Py_TYPE(state)->tp_free(state);
 }
 
 
 static PyObject *
-fastcomp_py(PyObject *self, PyObject *args, PyObject *kwargs)
+substrings_next(SubstringsState *state)
 {
-	PyObject *arg1, *arg2, *otr = NULL;
-	int transpositions = 0;
-	static char *keywords[] = {"seq1", "seq2", "transpositions", NULL};
+	struct distance_pair pos;
+	Py_ssize_t len;
+	int status;
 	
-	char type;
-	sequence seq1, seq2;
-	Py_ssize_t len1, len2;
-	short dist;
-
-	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|O:fast_comp",
-		keywords, &arg1, &arg2, &transpositions))
+	if (state->busy) {
+		PyErr_SetString(PyExc_ValueError, "common_substrings iterator already executing");
 		return NULL;
-	if (otr && (transpositions = PyObject_IsTrue(otr)) == -1)
+	}
+	// the items of strings are compared without the GIL
+	state->busy = 1;
+	if (state->seq1.width) {
+		Py_BEGIN_ALLOW_THREADS
+		DISPATCH(status, common_substrings, state->seq1, state->seq2, state->len1, state->len2,
+			state->min_len, &state->cursor, &pos, &len);
+		Py_END_ALLOW_THREADS
+	}
+	else
+		DISPATCH(status, common_substrings, state->seq1, state->seq2, state->len1, state->len2,
+			state->min_len, &state->cursor, &pos, &len);
+	state->busy = 0;
+	
+	if (status != DISTANCE_OK)
+		return set_error(status);
+	if (len == 0)
 		return NULL;
+	return Py_BuildValue("(nnn)", pos.i, pos.j, len);
+}
 
-	if ((type = get_sequences(arg1, arg2, &seq1, &seq2, &len1, &len2)) == '\0')
-		return NULL;
-	
-	if (len1 < len2) {
-		SWAP(sequence,   seq1, seq2);
-		SWAP(Py_ssize_t, len1, len2);
-	}
 
-	switch(type) {
-		case 'u':
-			dist = ufastcomp(seq1.u, seq2.u, len1, len2, transpositions);
-			break;
-		case 'b':
-			dist = bfastcomp(seq1.b, seq2.b, len1, len2, transpositions);
-			break;
-		default:
-			dist = afastcomp(seq1.a, seq2.a, len1, len2, transpositions);
-			Py_DECREF(seq1.a);
-			Py_DECREF(seq2.a);
+PyTypeObject CommonSubstrings_Type = {
+	PyVarObject_HEAD_INIT(&PyType_Type, 0)
+	"distance.common_substrings", /* tp_name */
+	sizeof(SubstringsState), /* tp_basicsize */
+	0, /* tp_itemsize */
+	(destructor)substrings_dealloc, /* tp_dealloc */
+	0, /* tp_print */
+	0, /* tp_getattr */
+	0, /* tp_setattr */
+	0, /* tp_reserved */
+	0, /* tp_repr */
+	0, /* tp_as_number */
+	0, /* tp_as_sequence */
+	0, /* tp_as_mapping */
+	0, /* tp_hash */
+	0, /* tp_call */
+	0, /* tp_str */
+	0, /* tp_getattro */
+	0, /* tp_setattro */
+	0, /* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT, /* tp_flags */
+	common_substrings_doc, /* tp_doc */
+	0, /* tp_traverse */
+	0, /* tp_clear */
+	0, /* tp_richcompare */
+	0, /* tp_weaklistoffset */
+	PyObject_SelfIter, /* tp_iter */
+	(iternextfunc)substrings_next, /* tp_iternext */
+	0, /* tp_methods */
+	0, /* tp_members */
+	0, /* tp_getset */
+	0, /* tp_base */
+	0, /* tp_dict */
+	0, /* tp_descr_get */
+	0, /* tp_descr_set */
+	0, /* tp_dictoffset */
+	0, /* tp_init */
+	PyType_GenericAlloc, /* tp_alloc */
+	substrings_new, /* tp_new */
+};
+
+
+static PyObject *
+nlevenshtein_dispatch(PyObject *arg1, PyObject *arg2, short method, int fold)
+{
+	char type;
+	sequence seq1, seq2;
+	Py_ssize_t len1, len2;
+	double dist;
+	int status;
+	
+	if (method != 1 && method != 2) {
+		PyErr_SetString(PyExc_ValueError, "expected either 1 or 2 for `method` parameter");
+		return NULL;
+	}
+	
+	if ((type = get_sequences(arg1, arg2, &seq1, &seq2, &len1, &len2, fold)) == '\0')
+		return NULL;
+	
+	DISPATCH(status, nlevenshtein, seq1, seq2, len1, len2, method, &dist);
+	release_sequence(&seq1);
+	release_sequence(&seq2);
+	
+	if (status != DISTANCE_OK)
+		return set_error(status);
+	
+	return Py_BuildValue("d", dist);	
+}
+
+
+static PyObject *
+nlevenshtein_py(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	PyObject *arg1, *arg2;
+	short method = 1;
+	const char *fold_name = "none";
+	static char *keywords[] = {"seq1", "seq2", "method", "fold", NULL};
+	int fold;
+	
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs,
+		"OO|hs:nlevenshtein", keywords, &arg1, &arg2, &method, &fold_name))
+		return NULL;
+	if ((fold = get_fold(fold_name)) == -1)
+		return NULL;
+	
+	return nlevenshtein_dispatch(arg1, arg2, method, fold);
+}
+
+
+static PyObject *
+levenshtein_py(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	PyObject *arg1, *arg2, *onorm = NULL;
+	Py_ssize_t dist = -1;
+	Py_ssize_t max_dist = -1;
+	const char *fold_name = "none";
+	int normalized = 0, fold, workers = 1;
+	static char *keywords[] = {"seq1", "seq2", "normalized", "max_dist", "fold", "workers",
+		NULL};
+
+	char type;
+	sequence seq1, seq2;
+	Py_ssize_t len1, len2;
+	const struct distance_dna *dna1, *dna2;
+	struct distance_dna tmp;
+	int status, compiled, packed;
+	
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs,
+		"OO|Onsi:levenshtein", keywords, &arg1, &arg2, &onorm, &max_dist, &fold_name,
+		&workers))
+		return NULL;
+	if (onorm && (normalized = PyObject_IsTrue(onorm)) == -1)
+		return NULL;
+	if ((fold = get_fold(fold_name)) == -1 || (workers = get_workers(workers)) == -1)
+		return NULL;
+	
+	if ((packed = get_dna_pair(arg1, arg2, &dna1, &dna2, &tmp)) == -1)
+		return NULL;
+	if (packed) {
+		len1 = (dna1->len > dna2->len ? dna1->len : dna2->len);
+		status = distance_dna_levenshtein(dna1, dna2, (normalized ? -1 : max_dist), &dist);
+		distance_dna_release(&tmp);
+		if (status != DISTANCE_OK)
+			return set_error(status);
+		if (normalized)
+			return Py_BuildValue("d", len1 ? dist / (double)len1 : 0.0);
+		return Py_BuildValue("n", dist);
+	}
+
+	if (normalized)
+		return nlevenshtein_dispatch(arg1, arg2, 1, fold);
+
+	// the compiled patterns hold the items as they are
+	if ((compiled = (fold ? 0 : pattern_sequence(arg1, arg2, &seq2, &len2))) == -1)
+		return NULL;
+	if (compiled) {
+		status = distance_pattern_levenshtein(COMPILED(arg1), seq2.items, seq2.width, len2,
+			max_dist, &dist);
+		release_sequence(&seq2);
+		if (status != DISTANCE_OK)
+			return set_error(status);
+		return Py_BuildValue("n", dist);
+	}
+
+	if ((type = get_sequences(arg1, arg2, &seq1, &seq2, &len1, &len2, fold)) == '\0')
+		return NULL;
+	
+	// strings are compared without the GIL by several threads
+	if (workers > 1 && seq1.width) {
+		Py_BEGIN_ALLOW_THREADS
+		status = distance_levenshtein_parallel(seq1.items, seq2.items, seq1.width, len1, len2,
+			max_dist, workers, &dist);
+		Py_END_ALLOW_THREADS
+	}
+	else
+		DISPATCH(status, levenshtein, seq1, seq2, len1, len2, max_dist, &dist);
+	release_sequence(&seq1);
+	release_sequence(&seq2);
+	
+	if (status != DISTANCE_OK)
+		return set_error(status);
+	return Py_BuildValue("n", dist);
+}
+
+
+static PyObject *
+fastcomp_py(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	PyObject *arg1, *arg2, *otr = NULL;
+	const char *fold_name = "none";
+	int transpositions = 0, fold;
+	static char *keywords[] = {"seq1", "seq2", "transpositions", "fold", NULL};
+	
+	char type;
+	sequence seq1, seq2;
+	Py_ssize_t len1, len2;
+	int dist, status;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|Os:fast_comp",
+		keywords, &arg1, &arg2, &otr, &fold_name))
+		return NULL;
+	if (otr && (transpositions = PyObject_IsTrue(otr)) == -1)
+		return NULL;
+	if ((fold = get_fold(fold_name)) == -1)
+		return NULL;
+
+	if ((type = get_sequences(arg1, arg2, &seq1, &seq2, &len1, &len2, fold)) == '\0')
+		return NULL;
+	
+	DISPATCH(status, fastcomp, seq1, seq2, len1, len2, transpositions, &dist);
+	release_sequence(&seq1);
+	release_sequence(&seq2);
+	
+	if (status != DISTANCE_OK)
+		return set_error(status);
+	
+	return Py_BuildValue("i", dist);	
+}
+
+
+static PyObject *
+lcs_length_py(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	PyObject *arg1, *arg2;
+	const char *fold_name = "none";
+	static char *keywords[] = {"seq1", "seq2", "fold", NULL};
+	
+	char type;
+	sequence seq1, seq2;
+	Py_ssize_t len1, len2, len;
+	int status, compiled, fold;
+	
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|s:lcs_length", keywords, &arg1, &arg2,
+		&fold_name))
+		return NULL;
+	if ((fold = get_fold(fold_name)) == -1)
+		return NULL;
+	
+	if ((compiled = (fold ? 0 : pattern_sequence(arg1, arg2, &seq2, &len2))) == -1)
+		return NULL;
+	if (compiled) {
+		status = distance_pattern_lcs(COMPILED(arg1), seq2.items, seq2.width, len2, &len);
+		release_sequence(&seq2);
+		if (status != DISTANCE_OK)
+			return set_error(status);
+		return Py_BuildValue("n", len);
 	}
 	
-	if (dist == -2)	// comparison failed
+	if ((type = get_sequences(arg1, arg2, &seq1, &seq2, &len1, &len2, fold)) == '\0')
+		return NULL;
+	
+	DISPATCH(status, lcs, seq1, seq2, len1, len2, &len);
+	release_sequence(&seq1);
+	release_sequence(&seq2);
+	
+	if (status != DISTANCE_OK)
+		return set_error(status);
+	return Py_BuildValue("n", len);
+}
+
+
+static PyObject *
+indel_distance_py(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	PyObject *arg1, *arg2, *onorm = NULL;
+	Py_ssize_t max_dist = -1, dist = -1;
+	const char *fold_name = "none";
+	int normalized = 0, fold;
+	static char *keywords[] = {"seq1", "seq2", "normalized", "max_dist", "fold", NULL};
+	
+	char type;
+	sequence seq1, seq2;
+	Py_ssize_t len1, len2;
+	int status, compiled;
+	
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs,
+		"OO|Ons:indel_distance", keywords, &arg1, &arg2, &onorm, &max_dist, &fold_name))
+		return NULL;
+	if (onorm && (normalized = PyObject_IsTrue(onorm)) == -1)
+		return NULL;
+	if ((fold = get_fold(fold_name)) == -1)
+		return NULL;
+	
+	// the bound is for the plain distance only
+	if ((compiled = (fold ? 0 : pattern_sequence(arg1, arg2, &seq2, &len2))) == -1)
 		return NULL;
+	if (compiled) {
+		len1 = ((PatternObject *)arg1)->len;
+		status = distance_pattern_indel(COMPILED(arg1), seq2.items, seq2.width, len2,
+			(normalized ? -1 : max_dist), &dist);
+		release_sequence(&seq2);
+	}
+	else {
+		if ((type = get_sequences(arg1, arg2, &seq1, &seq2, &len1, &len2, fold)) == '\0')
+			return NULL;
+		DISPATCH(status, indel, seq1, seq2, len1, len2, (normalized ? -1 : max_dist), &dist);
+		release_sequence(&seq1);
+		release_sequence(&seq2);
+	}
 	
-	return Py_BuildValue("h", dist);	
+	if (status != DISTANCE_OK)
+		return set_error(status);
+	
+	if (normalized) {
+		if (len1 + len2 == 0)
+			return Py_BuildValue("d", 0.0);
+		return Py_BuildValue("d", dist / (double)(len1 + len2));
+	}
+	return Py_BuildValue("n", dist);
+}
+
+
+static int
+get_jaro_params(double *prefix_weight, PyObject *omin_score, double *min_score)
+{
+	if (*prefix_weight < 0.0 || *prefix_weight > 0.25) {
+		PyErr_SetString(PyExc_ValueError, "expected a value between 0 and 0.25 for `prefix_weight`");
+		return 0;
+	}
+	*min_score = -1.0;
+	if (omin_score && omin_score != Py_None) {
+		*min_score = PyFloat_AsDouble(omin_score);
+		if (*min_score == -1.0 && PyErr_Occurred())
+			return 0;
+	}
+	return 1;
+}
+
+
+static PyObject *
+jaro_winkler_dispatch(PyObject *arg1, PyObject *arg2, double prefix_weight, double min_score,
+	int fold)
+{
+	char type;
+	sequence seq1, seq2;
+	Py_ssize_t len1, len2;
+	double score;
+	int status;
+
+	if ((type = get_sequences(arg1, arg2, &seq1, &seq2, &len1, &len2, fold)) == '\0')
+		return NULL;
+
+	DISPATCH(status, jaro, seq1, seq2, len1, len2, prefix_weight, min_score, &score);
+	release_sequence(&seq1);
+	release_sequence(&seq2);
+
+	if (status != DISTANCE_OK)
+		return set_error(status);
+	return Py_BuildValue("d", score);
+}
+
+
+static PyObject *
+jaro_py(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	PyObject *arg1, *arg2, *omin_score = NULL;
+	double prefix_weight = 0.0, min_score;
+	const char *fold_name = "none";
+	static char *keywords[] = {"seq1", "seq2", "min_score", "fold", NULL};
+	int fold;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs,
+		"OO|Os:jaro", keywords, &arg1, &arg2, &omin_score, &fold_name))
+		return NULL;
+	if (!get_jaro_params(&prefix_weight, omin_score, &min_score))
+		return NULL;
+	if ((fold = get_fold(fold_name)) == -1)
+		return NULL;
+
+	return jaro_winkler_dispatch(arg1, arg2, prefix_weight, min_score, fold);
+}
+
+
+static PyObject *
+jaro_winkler_py(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	PyObject *arg1, *arg2, *omin_score = NULL;
+	double prefix_weight = 0.1, min_score;
+	const char *fold_name = "none";
+	static char *keywords[] = {"seq1", "seq2", "prefix_weight", "min_score", "fold", NULL};
+	int fold;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|dOs:jaro_winkler", keywords,
+		&arg1, &arg2, &prefix_weight, &omin_score, &fold_name))
+		return NULL;
+	if (!get_jaro_params(&prefix_weight, omin_score, &min_score))
+		return NULL;
+	if ((fold = get_fold(fold_name)) == -1)
+		return NULL;
+
+	return jaro_winkler_dispatch(arg1, arg2, prefix_weight, min_score, fold);
 }
 
 
 
-// Iterators (for levenshtein and fastcomp). They share the same structure.
+// Iterators (for levenshtein, fastcomp and jaro). They share the same structure.
+
+struct itor_batch;
 
 typedef struct {
 	PyObject_HEAD
@@ -452,254 +1235,4443 @@ typedef struct {
 	PyObject *object;		// the corresponding pyobject
 	int transpos;			// only valable for fastcomp
 	Py_ssize_t max_dist;	// only for levenshtein
+	double prefix_weight;	// only for jaro
+	double min_score;		// only for jaro
+	struct distance_pattern *pattern;	// compiled query, if `object` is a pattern
+	Py_ssize_t count;		// number of candidates read
+	int dense;				// also return the candidates beyond the bound
+	Py_buffer out[2];		// indices and distances, with `out` (see itor_next)
+	PyObject *error[3];		// exception deferred by itor_next, if any
+	
+	// with several workers (see itor_parallel_step)
+	struct pool *pool;
+	struct itor_batch *batches;		// two of them
+	int current;			// batch being consumed
+	int ordered;
+	Py_ssize_t chunk_size;
+	int exhausted;			// no more candidates to read
+	void *wide1[5];			// seq1 widened to 2 or 4 bytes items, if needed
+	int fold;				// case folding of the candidates
+	void *folded1;			// the folded items of seq1, if any
+	struct fold_buffer folded2;		// the folded candidate, with one worker
+	void (*run)(void *batch, dist_ssize_t i);
 } ItorState;
 
 
-static void itor_dealloc(ItorState *state)
+/* With more than one worker, candidates are read by chunks, in batches. While
+the results of a batch are consumed, the next batch is computed by the pool of
+workers, without holding the GIL. This is only possible for strings, as the
+items of other sequences are compared with the Python API; the iterators over
+other sequences ignore the number of workers. */
+
+struct itor_item {
+	PyObject *object;		// the candidate
+	sequence seq2;
+	Py_ssize_t len2;
+	void *items1;			// the items of seq1, with the width of seq2
+	Py_ssize_t dist;
+	int status;
+	struct fold_buffer folded;		// reused by the candidates of the next batches
+};
+
+struct itor_batch {
+	struct pool_job job;
+	ItorState *state;
+	struct itor_item *items;
+	Py_ssize_t size;		// number of candidates
+	Py_ssize_t base;		// index of the first one among all the candidates
+	Py_ssize_t *order;		// completion order, when unordered
+	Py_ssize_t pos;			// next result to consume
+	Py_ssize_t ready;		// number of results known to be computed
+	int active;				// submitted, and not consumed yet
+	PyObject *exc_type, *exc_value, *exc_tb;	// error while reading the candidates
+};
+
+
+static void
+itor_batch_release(struct itor_batch *batch)
+{
+	Py_ssize_t i;
+
+	for (i = 0; i < batch->size; i++) {
+		Py_DECREF(batch->items[i].object);
+		release_sequence(&batch->items[i].seq2);
+	}
+	batch->size = 0;
+	batch->active = 0;
+	Py_CLEAR(batch->exc_type);
+	Py_CLEAR(batch->exc_value);
+	Py_CLEAR(batch->exc_tb);
+}
+
+
+static void itor_dealloc(ItorState *state)
+{
+	Py_ssize_t j;
+	int i;
+	
+	if (state->pool) {
+		for (i = 0; i < 2; i++) {
+			if (!state->batches[i].active)
+				continue;
+			Py_BEGIN_ALLOW_THREADS
+			pool_wait(state->pool, &state->batches[i].job, state->batches[i].size);
+			Py_END_ALLOW_THREADS
+			itor_batch_release(&state->batches[i]);
+		}
+		pool_free(state->pool);
+	}
+	if (state->batches) {
+		for (i = 0; i < 2; i++) {
+			for (j = 0; state->batches[i].items && j < state->chunk_size; j++)
+				free(state->batches[i].items[j].folded.items);
+			free(state->batches[i].items);
+			free(state->batches[i].order);
+		}
+		free(state->batches);
+	}
+	for (i = 0; i < 5; i++)
+		free(state->wide1[i]);
+	free(state->folded1);
+	free(state->folded2.items);
+	for (i = 0; i < 2; i++) {
+		if (state->out[i].obj)
+			PyBuffer_Release(&state->out[i]);
+	}
+	for (i = 0; i < 3; i++)
+		Py_XDECREF(state->error[i]);
+	
+	// we got two references for tuples and lists, one for the original python object,
+	// and one returned by `PySequence_fast`
+	if (state->seqtype == 'a')
+		Py_XDECREF(state->seq1.a);
+	else if (state->seqtype == 'i')
+		release_sequence(&state->seq1);
+	Py_XDECREF(state->object);
+	Py_XDECREF(state->itor);
+	Py_TYPE(state)->tp_free(state);
+}
+
+
+static void
+ilevenshtein_run(void *arg, dist_ssize_t i)
+{
+	struct itor_batch *batch = (struct itor_batch *)arg;
+	struct itor_item *item = &batch->items[i];
+	sequence seq1 = batch->state->seq1;
+	
+	if (batch->state->pattern) {
+		item->status = distance_pattern_levenshtein(batch->state->pattern, item->seq2.items,
+			item->seq2.width, item->len2, batch->state->max_dist, &item->dist);
+		return;
+	}
+	seq1.items = item->items1;
+	seq1.width = item->seq2.width;
+	DISPATCH(item->status, levenshtein, seq1, item->seq2, batch->state->len1, item->len2,
+		batch->state->max_dist, &item->dist);
+}
+
+
+static void
+ifastcomp_run(void *arg, dist_ssize_t i)
+{
+	struct itor_batch *batch = (struct itor_batch *)arg;
+	struct itor_item *item = &batch->items[i];
+	sequence seq1 = batch->state->seq1;
+	int dist = -1;
+	
+	seq1.items = item->items1;
+	seq1.width = item->seq2.width;
+	DISPATCH(item->status, fastcomp, seq1, item->seq2, batch->state->len1, item->len2,
+		batch->state->transpos, &dist);
+	item->dist = dist;
+}
+
+
+static void
+iindel_run(void *arg, dist_ssize_t i)
+{
+	struct itor_batch *batch = (struct itor_batch *)arg;
+	struct itor_item *item = &batch->items[i];
+	sequence seq1 = batch->state->seq1;
+	
+	if (batch->state->pattern) {
+		item->status = distance_pattern_indel(batch->state->pattern, item->seq2.items,
+			item->seq2.width, item->len2, batch->state->max_dist, &item->dist);
+		return;
+	}
+	seq1.items = item->items1;
+	seq1.width = item->seq2.width;
+	DISPATCH(item->status, indel, seq1, item->seq2, batch->state->len1, item->len2,
+		batch->state->max_dist, &item->dist);
+}
+
+
+// Parses the options of the parallel mode, and starts the pool if needed.
+
+static int
+itor_parallel_init(ItorState *state, int workers, PyObject *oordered, Py_ssize_t chunk_size,
+                   void (*run)(void *, dist_ssize_t))
+{
+	int i, status;
+	
+	if (workers < 0) {
+		PyErr_SetString(PyExc_ValueError, "expected a positive number of workers, or 0");
+		return 0;
+	}
+	if (chunk_size < 1) {
+		PyErr_SetString(PyExc_ValueError, "expected a positive `chunk_size`");
+		return 0;
+	}
+	if (oordered && (state->ordered = PyObject_IsTrue(oordered)) == -1)
+		return 0;
+	state->run = run;
+	if (workers == 0)
+		workers = pool_cpu_count();
+	if (workers == 1 || state->seqtype == 'a')
+		return 1;
+	
+	state->chunk_size = chunk_size;
+	if ((state->batches = (struct itor_batch *)calloc(2, sizeof(struct itor_batch))) == NULL) {
+		PyErr_NoMemory();
+		return 0;
+	}
+	for (i = 0; i < 2; i++) {
+		state->batches[i].state = state;
+		state->batches[i].items = (struct itor_item *)calloc(chunk_size, sizeof(struct itor_item));
+		state->batches[i].order = (Py_ssize_t *)malloc(chunk_size * sizeof(Py_ssize_t));
+		if (state->batches[i].items == NULL || state->batches[i].order == NULL) {
+			PyErr_NoMemory();
+			return 0;
+		}
+	}
+	if ((status = pool_new(&state->pool, workers)) != DISTANCE_OK) {
+		set_error(status);
+		return 0;
+	}
+	return 1;
+}
+
+
+// Reads the next chunk of candidates into a batch, and submits it.
+
+static void
+itor_batch_fill(ItorState *state, struct itor_batch *batch)
+{
+	struct itor_item *item;
+	PyObject *arg2;
+	void *wide;
+	int width;
+	
+	batch->size = batch->pos = batch->ready = 0;
+	while (batch->size < state->chunk_size) {
+		if ((arg2 = PyIter_Next(state->itor)) == NULL) {
+			state->exhausted = 1;
+			break;
+		}
+		item = &batch->items[batch->size];
+		if (get_sequence(arg2, &item->seq2, &item->len2, state->seqtype) == '\0') {
+			Py_DECREF(arg2);
+			state->exhausted = 1;
+			break;
+		}
+		if (!fold_sequence(&item->seq2, item->len2, state->seqtype, state->fold, &item->folded)) {
+			release_sequence(&item->seq2);
+			Py_DECREF(arg2);
+			state->exhausted = 1;
+			break;
+		}
+		
+		// seq1 and seq2 with the same width
+		width = state->seq1.width;
+		item->items1 = state->seq1.items;
+		if (item->seq2.width < width) {
+			if ((wide = widen_items(item->seq2.items, item->seq2.width, item->len2, width)) == NULL) {
+				release_sequence(&item->seq2);
+				Py_DECREF(arg2);
+				state->exhausted = 1;
+				break;
+			}
+			free(item->seq2.copy);
+			item->seq2.copy = item->seq2.items = wide;
+			item->seq2.width = width;
+		}
+		else if (item->seq2.width > width) {
+			width = item->seq2.width;
+			if (state->wide1[width] == NULL &&
+				(state->wide1[width] = widen_items(state->seq1.items, state->seq1.width, state->len1, width)) == NULL) {
+				release_sequence(&item->seq2);
+				Py_DECREF(arg2);
+				state->exhausted = 1;
+				break;
+			}
+			item->items1 = state->wide1[width];
+		}
+		item->object = arg2;
+		batch->size++;
+	}
+	batch->base = state->count;
+	state->count += batch->size;
+	
+	// kept until the results which precede the error are consumed
+	if (PyErr_Occurred())
+		PyErr_Fetch(&batch->exc_type, &batch->exc_value, &batch->exc_tb);
+	
+	batch->job.run = state->run;
+	batch->job.arg = batch;
+	batch->job.size = batch->size;
+	batch->job.order = (state->ordered ? NULL : batch->order);
+	batch->active = 1;
+	pool_submit(state->pool, &batch->job);
+}
+
+
+/* Stores the next result computed by the workers in `object` (a new
+reference), `index` and `dist`. Returns 1, or 0 at the end of the candidates
+or on error. */
+
+static int
+itor_parallel_step(ItorState *state, PyObject **object, Py_ssize_t *index, Py_ssize_t *dist)
+{
+	struct itor_batch *batch, *other;
+	struct itor_item *item;
+	Py_ssize_t needed, i;
+	
+	for (;;) {
+		batch = &state->batches[state->current];
+		other = &state->batches[!state->current];
+		
+		if (!batch->active) {
+			if (state->exhausted)
+				return 0;
+			itor_batch_fill(state, batch);
+		}
+		// computed while the current batch is consumed
+		if (!other->active && !state->exhausted)
+			itor_batch_fill(state, other);
+		
+		while (batch->pos < batch->size) {
+			if (batch->pos >= batch->ready) {
+				// in order, the results are available once the batch is done
+				needed = (state->ordered ? batch->size : batch->pos + 1);
+				Py_BEGIN_ALLOW_THREADS
+				batch->ready = pool_wait(state->pool, &batch->job, needed);
+				Py_END_ALLOW_THREADS
+			}
+			i = (state->ordered ? batch->pos : batch->order[batch->pos]);
+			item = &batch->items[i];
+			batch->pos++;
+			if (item->status != DISTANCE_OK) {
+				state->exhausted = 1;
+				set_error(item->status);
+				return 0;
+			}
+			if (item->dist != -1 || state->dense) {
+				Py_INCREF(item->object);
+				*object = item->object;
+				*index = batch->base + i;
+				*dist = item->dist;
+				return 1;
+			}
+		}
+		
+		if (batch->exc_type) {
+			PyErr_Restore(batch->exc_type, batch->exc_value, batch->exc_tb);
+			batch->exc_type = batch->exc_value = batch->exc_tb = NULL;
+			itor_batch_release(batch);
+			return 0;
+		}
+		itor_batch_release(batch);
+		state->current = !state->current;
+	}
+}
+
+
+// The same, for a single worker: the candidates are compared in the calling
+// thread, as they are read.
+
+static int
+itor_serial_step(ItorState *state, PyObject **object, Py_ssize_t *index, Py_ssize_t *dist)
+{
+	struct itor_batch one;
+	struct itor_item item;
+	sequence seq1;
+	PyObject *arg2;
+	
+	one.state = state;
+	one.items = &item;
+	while ((arg2 = PyIter_Next(state->itor)) != NULL) {
+		if (get_sequence(arg2, &item.seq2, &item.len2, state->seqtype) == '\0') {
+			Py_DECREF(arg2);
+			return 0;
+		}
+		if (!fold_sequence(&item.seq2, item.len2, state->seqtype, state->fold, &state->folded2)) {
+			release_sequence(&item.seq2);
+			Py_DECREF(arg2);
+			return 0;
+		}
+		seq1 = state->seq1;
+		if (!state->pattern && !match_widths(&seq1, &item.seq2, state->len1, item.len2)) {
+			release_sequence(&item.seq2);
+			Py_DECREF(arg2);
+			return 0;
+		}
+		item.items1 = seq1.items;
+		state->run(&one, 0);
+		free(seq1.copy);
+		release_sequence(&item.seq2);
+		if (item.status != DISTANCE_OK) {
+			Py_DECREF(arg2);
+			set_error(item.status);
+			return 0;
+		}
+		*index = state->count++;
+		if (item.dist != -1 || state->dense) {
+			*object = arg2;
+			*dist = item.dist;
+			return 1;
+		}
+		Py_DECREF(arg2);
+	}
+	return 0;
+}
+
+
+// Checks that `obj` is a writable array of signed integers, for `out`.
+
+static int
+get_output(PyObject *obj, Py_buffer *view)
+{
+	const char *format;
+	
+	if (PyObject_GetBuffer(obj, view, PyBUF_WRITABLE | PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) == -1)
+		return 0;
+	format = (view->format ? view->format : "B");
+	if (*format == '@' || *format == '=')
+		format++;
+	if (view->ndim != 1 || format[0] == '\0' || format[1] != '\0'
+		|| !strchr("hilqn", format[0])
+		|| (view->itemsize != 2 && view->itemsize != 4 && view->itemsize != 8)) {
+		PyBuffer_Release(view);
+		view->obj = NULL;
+		PyErr_SetString(PyExc_ValueError, "expected writable arrays of signed integers for `out`");
+		return 0;
+	}
+	return 1;
+}
+
+
+// Largest value an array of `out` can hold.
+
+static Py_ssize_t
+output_max(Py_buffer *view)
+{
+	switch (view->itemsize) {
+		case 2:
+			return INT16_MAX;
+		case 4:
+			return (Py_ssize_t)(INT32_MAX < PY_SSIZE_T_MAX ? INT32_MAX : PY_SSIZE_T_MAX);
+	}
+	return PY_SSIZE_T_MAX;
+}
+
+
+// Stores a result, or none of its two values if one of them doesn't fit.
+
+static int
+store_output(ItorState *state, Py_ssize_t i, Py_ssize_t index, Py_ssize_t dist)
+{
+	if (index > output_max(&state->out[0]) || dist > output_max(&state->out[1])) {
+		PyErr_SetString(PyExc_OverflowError, "value too large for the arrays of `out`");
+		return 0;
+	}
+	switch (state->out[0].itemsize) {
+		case 2:
+			((int16_t *)state->out[0].buf)[i] = (int16_t)index;
+			break;
+		case 4:
+			((int32_t *)state->out[0].buf)[i] = (int32_t)index;
+			break;
+		default:
+			((int64_t *)state->out[0].buf)[i] = index;
+	}
+	switch (state->out[1].itemsize) {
+		case 2:
+			((int16_t *)state->out[1].buf)[i] = (int16_t)dist;
+			break;
+		case 4:
+			((int32_t *)state->out[1].buf)[i] = (int32_t)dist;
+			break;
+		default:
+			((int64_t *)state->out[1].buf)[i] = dist;
+	}
+	return 1;
+}
+
+
+/* Parses the `out` and `dense` options. When `seqs` has a length, the array
+of indices must be able to hold the index of its last sequence; otherwise,
+an index too large is only detected when it is written. */
+
+static int
+itor_output_init(ItorState *state, PyObject *out, PyObject *odense, PyObject *seqs)
+{
+	Py_ssize_t count;
+	
+	if (odense && (state->dense = PyObject_IsTrue(odense)) == -1)
+		return 0;
+	if (out == NULL || out == Py_None)
+		return 1;
+	if (!PyTuple_Check(out) || PyTuple_GET_SIZE(out) != 2) {
+		PyErr_SetString(PyExc_ValueError, "expected a pair of arrays (indices, distances) for `out`");
+		return 0;
+	}
+	if (!get_output(PyTuple_GET_ITEM(out, 0), &state->out[0])
+		|| !get_output(PyTuple_GET_ITEM(out, 1), &state->out[1]))
+		return 0;
+	if (state->out[0].len / state->out[0].itemsize != state->out[1].len / state->out[1].itemsize
+		|| state->out[0].len == 0) {
+		PyErr_SetString(PyExc_ValueError, "expected two arrays of the same non-zero length for `out`");
+		return 0;
+	}
+	if (state->out[0].itemsize < 8) {
+		if ((count = PyObject_Size(seqs)) == -1) {
+			if (!PyErr_ExceptionMatches(PyExc_TypeError))
+				return 0;
+			PyErr_Clear();
+		}
+		else if (count - 1 > output_max(&state->out[0])) {
+			PyErr_SetString(PyExc_ValueError, "the array of indices of `out` is too narrow for `seqs`");
+			return 0;
+		}
+	}
+	return 1;
+}
+
+
+/* Returns the next pair (distance, candidate). With `out`, the indices of the
+candidates among `seqs` and their distances are written to the two arrays
+instead, until they are full, and the number of results written is returned,
+so that no object is created for each result. An error met after some results
+were written is raised by the next call, so that these results aren't lost. */
+
+static PyObject *
+itor_next(ItorState *state)
+{
+	PyObject *object, *rv;
+	Py_ssize_t index, dist, size, n = 0;
+	int (*step)(ItorState *, PyObject **, Py_ssize_t *, Py_ssize_t *);
+	
+	if (state->error[0]) {
+		PyErr_Restore(state->error[0], state->error[1], state->error[2]);
+		state->error[0] = state->error[1] = state->error[2] = NULL;
+		return NULL;
+	}
+	step = (state->pool ? itor_parallel_step : itor_serial_step);
+	if (state->out[0].obj == NULL) {
+		if (!step(state, &object, &index, &dist))
+			return NULL;
+		rv = Py_BuildValue("(nO)", dist, object);
+		Py_DECREF(object);
+		return rv;
+	}
+	
+	size = state->out[0].len / state->out[0].itemsize;
+	while (n < size && step(state, &object, &index, &dist)) {
+		Py_DECREF(object);
+		if (!store_output(state, n, index, dist))
+			break;
+		n++;
+	}
+	if (PyErr_Occurred()) {
+		if (n == 0)
+			return NULL;
+		PyErr_Fetch(&state->error[0], &state->error[1], &state->error[2]);
+	}
+	if (n == 0)
+		return NULL;
+	return PyLong_FromSsize_t(n);
+}
+
+
+static PyObject *
+ifastcomp_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+	PyObject *arg1, *arg2, *itor, *otr = NULL, *oordered = NULL, *out = NULL, *odense = NULL;
+	int transpositions = 0, workers = 1, fold;
+	Py_ssize_t chunk_size = 1024;
+	const char *fold_name = "none";
+	static char *keywords[] = {"seq1", "seqs", "transpositions", "workers", "ordered",
+		"chunk_size", "out", "dense", "fold", NULL};
+	
+	char seqtype;
+	sequence seq1;
+	Py_ssize_t len1;
+	
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|OiOnOOs:ifast_comp", keywords, &arg1,
+		&arg2, &otr, &workers, &oordered, &chunk_size, &out, &odense, &fold_name))
+		return NULL;
+	if (otr && (transpositions = PyObject_IsTrue(otr)) == -1)
+		return NULL;
+	if ((fold = get_fold(fold_name)) == -1)
+		return NULL;
+	
+	if ((seqtype = get_sequence(arg1, &seq1, &len1, '\0')) == '\0')
+		return NULL;
+	if (!fold_sequence(&seq1, len1, seqtype, fold, NULL)) {
+		release_sequence(&seq1);
+		return NULL;
+	}
+	
+	if ((itor = PyObject_GetIter(arg2)) == NULL) {
+		release_sequence(&seq1);
+		PyErr_SetString(PyExc_ValueError, "expected an iterable as second argument");
+		return NULL;
+	}
+
+	ItorState *state = (ItorState *)type->tp_alloc(type, 0);
+	if (state == NULL) {
+		release_sequence(&seq1);
+		Py_DECREF(itor);
+		return NULL;
+	}
+
+	Py_INCREF(arg1);
+
+	state->itor = itor;
+	state->seqtype = seqtype;
+	state->seq1 = seq1;
+	state->seq1.copy = NULL;
+	state->folded1 = seq1.copy;
+	state->fold = fold;
+	state->object = arg1;
+	state->len1 = len1;
+	state->transpos = transpositions;
+	state->ordered = 1;
+	
+	if (!itor_output_init(state, out, odense, arg2)
+		|| !itor_parallel_init(state, workers, oordered, chunk_size, ifastcomp_run)) {
+		Py_DECREF(state);
+		return NULL;
+	}
+	
+	return (PyObject *)state;
+}
+
+
+static PyObject *
+ilevenshtein_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+	PyObject *arg1, *arg2, *itor, *oordered = NULL, *out = NULL, *odense = NULL;
+	Py_ssize_t max_dist = -1, chunk_size = 1024;
+	int workers = 1, fold;
+	const char *fold_name = "none";
+	static char *keywords[] = {"seq1", "seqs", "max_dist", "workers", "ordered",
+		"chunk_size", "out", "dense", "fold", NULL};
+	
+	char seqtype;
+	sequence seq1;
+	Py_ssize_t len1;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|niOnOOs:ilevenshtein", keywords, &arg1,
+		&arg2, &max_dist, &workers, &oordered, &chunk_size, &out, &odense, &fold_name))
+		return NULL;
+	if ((fold = get_fold(fold_name)) == -1)
+		return NULL;
+
+	if ((seqtype = get_sequence(arg1, &seq1, &len1, '\0')) == '\0')
+		return NULL;
+	if (!fold_sequence(&seq1, len1, seqtype, fold, NULL)) {
+		release_sequence(&seq1);
+		return NULL;
+	}
+	
+	if ((itor = PyObject_GetIter(arg2)) == NULL) {
+		release_sequence(&seq1);
+		PyErr_SetString(PyExc_ValueError, "expected an iterable as second argument");
+		return NULL;
+	}
+
+	ItorState *state = (ItorState *)type->tp_alloc(type, 0);
+	if (state == NULL) {
+		release_sequence(&seq1);
+		Py_DECREF(itor);
+		return NULL;
+	}
+
+	Py_INCREF(arg1);
+
+	state->itor = itor;
+	state->seqtype = seqtype;
+	state->seq1 = seq1;
+	state->seq1.copy = NULL;
+	state->folded1 = seq1.copy;
+	state->fold = fold;
+	state->object = arg1;
+	state->len1 = len1;
+	state->max_dist = max_dist;
+	state->pattern = (fold ? NULL : COMPILED(arg1));
+	state->ordered = 1;
+	
+	if (!itor_output_init(state, out, odense, arg2)
+		|| !itor_parallel_init(state, workers, oordered, chunk_size, ilevenshtein_run)) {
+		Py_DECREF(state);
+		return NULL;
+	}
+	
+	return (PyObject *)state;
+}
+
+
+static PyObject *
+iindel_distance_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+	PyObject *arg1, *arg2, *itor, *oordered = NULL, *out = NULL, *odense = NULL;
+	Py_ssize_t max_dist = -1, chunk_size = 1024;
+	int workers = 1, fold;
+	const char *fold_name = "none";
+	static char *keywords[] = {"seq1", "seqs", "max_dist", "workers", "ordered",
+		"chunk_size", "out", "dense", "fold", NULL};
+	
+	char seqtype;
+	sequence seq1;
+	Py_ssize_t len1;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|niOnOOs:iindel_distance", keywords, &arg1,
+		&arg2, &max_dist, &workers, &oordered, &chunk_size, &out, &odense, &fold_name))
+		return NULL;
+	if ((fold = get_fold(fold_name)) == -1)
+		return NULL;
+
+	if ((seqtype = get_sequence(arg1, &seq1, &len1, '\0')) == '\0')
+		return NULL;
+	if (!fold_sequence(&seq1, len1, seqtype, fold, NULL)) {
+		release_sequence(&seq1);
+		return NULL;
+	}
+	
+	if ((itor = PyObject_GetIter(arg2)) == NULL) {
+		release_sequence(&seq1);
+		PyErr_SetString(PyExc_ValueError, "expected an iterable as second argument");
+		return NULL;
+	}
+
+	ItorState *state = (ItorState *)type->tp_alloc(type, 0);
+	if (state == NULL) {
+		release_sequence(&seq1);
+		Py_DECREF(itor);
+		return NULL;
+	}
+
+	Py_INCREF(arg1);
+
+	state->itor = itor;
+	state->seqtype = seqtype;
+	state->seq1 = seq1;
+	state->seq1.copy = NULL;
+	state->folded1 = seq1.copy;
+	state->fold = fold;
+	state->object = arg1;
+	state->len1 = len1;
+	state->max_dist = max_dist;
+	state->pattern = (fold ? NULL : COMPILED(arg1));
+	state->ordered = 1;
+	
+	if (!itor_output_init(state, out, odense, arg2)
+		|| !itor_parallel_init(state, workers, oordered, chunk_size, iindel_run)) {
+		Py_DECREF(state);
+		return NULL;
+	}
+	
+	return (PyObject *)state;
+}
+
+
+static PyObject *
+ijaro_state_new(PyTypeObject *type, PyObject *arg1, PyObject *arg2,
+                double prefix_weight, double min_score, int fold)
+{
+	PyObject *itor;
+	char seqtype;
+	sequence seq1;
+	Py_ssize_t len1;
+
+	if ((seqtype = get_sequence(arg1, &seq1, &len1, '\0')) == '\0')
+		return NULL;
+	if (!fold_sequence(&seq1, len1, seqtype, fold, NULL)) {
+		release_sequence(&seq1);
+		return NULL;
+	}
+
+	if ((itor = PyObject_GetIter(arg2)) == NULL) {
+		release_sequence(&seq1);
+		PyErr_SetString(PyExc_ValueError, "expected an iterable as second argument");
+		return NULL;
+	}
+
+	ItorState *state = (ItorState *)type->tp_alloc(type, 0);
+	if (state == NULL) {
+		release_sequence(&seq1);
+		Py_DECREF(itor);
+		return NULL;
+	}
+
+	Py_INCREF(arg1);
+
+	state->itor = itor;
+	state->seqtype = seqtype;
+	state->seq1 = seq1;
+	state->seq1.copy = NULL;
+	state->folded1 = seq1.copy;
+	state->fold = fold;
+	state->object = arg1;
+	state->len1 = len1;
+	state->prefix_weight = prefix_weight;
+	state->min_score = min_score;
+
+	return (PyObject *)state;
+}
+
+
+static PyObject *
+ijaro_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+	PyObject *arg1, *arg2, *omin_score = NULL;
+	double prefix_weight = 0.0, min_score;
+	const char *fold_name = "none";
+	static char *keywords[] = {"seq1", "seqs", "min_score", "fold", NULL};
+	int fold;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs,
+		"OO|Os:ijaro", keywords, &arg1, &arg2, &omin_score, &fold_name))
+		return NULL;
+	if (!get_jaro_params(&prefix_weight, omin_score, &min_score))
+		return NULL;
+	if ((fold = get_fold(fold_name)) == -1)
+		return NULL;
+
+	return ijaro_state_new(type, arg1, arg2, prefix_weight, min_score, fold);
+}
+
+
+static PyObject *
+ijaro_winkler_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+	PyObject *arg1, *arg2, *omin_score = NULL;
+	double prefix_weight = 0.1, min_score;
+	const char *fold_name = "none";
+	static char *keywords[] = {"seq1", "seqs", "prefix_weight", "min_score", "fold", NULL};
+	int fold;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|dOs:ijaro_winkler", keywords,
+		&arg1, &arg2, &prefix_weight, &omin_score, &fold_name))
+		return NULL;
+	if (!get_jaro_params(&prefix_weight, omin_score, &min_score))
+		return NULL;
+	if ((fold = get_fold(fold_name)) == -1)
+		return NULL;
+
+	return ijaro_state_new(type, arg1, arg2, prefix_weight, min_score, fold);
+}
+
+
+static PyObject *
+ijaro_next(ItorState *state)
+{
+	PyObject *arg2;
+	sequence seq1, seq2;
+	Py_ssize_t len2;
+	
+	double score = -1.0;
+	int status;
+	PyObject *rv;
+
+	while ((arg2 = PyIter_Next(state->itor)) != NULL) {
+	
+		if (get_sequence(arg2, &seq2, &len2, state->seqtype) == '\0') {
+			Py_DECREF(arg2);
+			return NULL;
+		}
+		if (!fold_sequence(&seq2, len2, state->seqtype, state->fold, &state->folded2)) {
+			release_sequence(&seq2);
+			Py_DECREF(arg2);
+			return NULL;
+		}
+		seq1 = state->seq1;
+		if (!match_widths(&seq1, &seq2, state->len1, len2)) {
+			release_sequence(&seq2);
+			Py_DECREF(arg2);
+			return NULL;
+		}
+		DISPATCH(status, jaro, seq1, seq2, state->len1, len2, state->prefix_weight, state->min_score, &score);
+		free(seq1.copy);
+		release_sequence(&seq2);
+		if (status != DISTANCE_OK) {
+			Py_DECREF(arg2);
+			return set_error(status);
+		}
+		if (score != -1.0) {
+			rv = Py_BuildValue("(dO)", score, arg2);
+			Py_DECREF(arg2);
+			return rv;
+		}
+		Py_DECREF(arg2);
+	}
+	
+	return NULL;
+}
+
+
+PyTypeObject IFastComp_Type = {
+	PyVarObject_HEAD_INIT(&PyType_Type, 0)
+	"distance.ifast_comp", /* tp_name */
+	sizeof(ItorState), /* tp_basicsize */
+	0, /* tp_itemsize */
+	(destructor)itor_dealloc, /* tp_dealloc */
+	0, /* tp_print */
+	0, /* tp_getattr */
+	0, /* tp_setattr */
+	0, /* tp_reserved */
+	0, /* tp_repr */
+	0, /* tp_as_number */
+	0, /* tp_as_sequence */
+	0, /* tp_as_mapping */
+	0, /* tp_hash */
+	0, /* tp_call */
+	0, /* tp_str */
+	0, /* tp_getattro */
+	0, /* tp_setattro */
+	0, /* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT, /* tp_flags */
+	ifast_comp_doc, /* tp_doc */
+	0, /* tp_traverse */
+	0, /* tp_clear */
+	0, /* tp_richcompare */
+	0, /* tp_weaklistoffset */
+	PyObject_SelfIter, /* tp_iter */
+	(iternextfunc)itor_next, /* tp_iternext */
+	0, /* tp_methods */
+	0, /* tp_members */
+	0, /* tp_getset */
+	0, /* tp_base */
+	0, /* tp_dict */
+	0, /* tp_descr_get */
+	0, /* tp_descr_set */
+	0, /* tp_dictoffset */
+	0, /* tp_init */
+	PyType_GenericAlloc, /* tp_alloc */
+	ifastcomp_new, /* tp_new */
+};
+
+
+PyTypeObject ILevenshtein_Type = {
+	PyVarObject_HEAD_INIT(&PyType_Type, 0)
+	"distance.ilevenshtein", /* tp_name */
+	sizeof(ItorState), /* tp_basicsize */
+	0, /* tp_itemsize */
+	(destructor)itor_dealloc, /* tp_dealloc */
+	0, /* tp_print */
+	0, /* tp_getattr */
+	0, /* tp_setattr */
+	0, /* tp_reserved */
+	0, /* tp_repr */
+	0, /* tp_as_number */
+	0, /* tp_as_sequence */
+	0, /* tp_as_mapping */
+	0, /* tp_hash */
+	0, /* tp_call */
+	0, /* tp_str */
+	0, /* tp_getattro */
+	0, /* tp_setattro */
+	0, /* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT, /* tp_flags */
+	ilevenshtein_doc, /* tp_doc */
+	0, /* tp_traverse */
+	0, /* tp_clear */
+	0, /* tp_richcompare */
+	0, /* tp_weaklistoffset */
+	PyObject_SelfIter, /* tp_iter */
+	(iternextfunc)itor_next, /* tp_iternext */
+	0, /* tp_methods */
+	0, /* tp_members */
+	0, /* tp_getset */
+	0, /* tp_base */
+	0, /* tp_dict */
+	0, /* tp_descr_get */
+	0, /* tp_descr_set */
+	0, /* tp_dictoffset */
+	0, /* tp_init */
+	PyType_GenericAlloc, /* tp_alloc */
+	ilevenshtein_new, /* tp_new */
+};
+
+
+PyTypeObject IIndel_Type = {
+	PyVarObject_HEAD_INIT(&PyType_Type, 0)
+	"distance.iindel_distance", /* tp_name */
+	sizeof(ItorState), /* tp_basicsize */
+	0, /* tp_itemsize */
+	(destructor)itor_dealloc, /* tp_dealloc */
+	0, /* tp_print */
+	0, /* tp_getattr */
+	0, /* tp_setattr */
+	0, /* tp_reserved */
+	0, /* tp_repr */
+	0, /* tp_as_number */
+	0, /* tp_as_sequence */
+	0, /* tp_as_mapping */
+	0, /* tp_hash */
+	0, /* tp_call */
+	0, /* tp_str */
+	0, /* tp_getattro */
+	0, /* tp_setattro */
+	0, /* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT, /* tp_flags */
+	iindel_distance_doc, /* tp_doc */
+	0, /* tp_traverse */
+	0, /* tp_clear */
+	0, /* tp_richcompare */
+	0, /* tp_weaklistoffset */
+	PyObject_SelfIter, /* tp_iter */
+	(iternextfunc)itor_next, /* tp_iternext */
+	0, /* tp_methods */
+	0, /* tp_members */
+	0, /* tp_getset */
+	0, /* tp_base */
+	0, /* tp_dict */
+	0, /* tp_descr_get */
+	0, /* tp_descr_set */
+	0, /* tp_dictoffset */
+	0, /* tp_init */
+	PyType_GenericAlloc, /* tp_alloc */
+	iindel_distance_new, /* tp_new */
+};
+
+
+PyTypeObject IJaro_Type = {
+	PyVarObject_HEAD_INIT(&PyType_Type, 0)
+	"distance.ijaro", /* tp_name */
+	sizeof(ItorState), /* tp_basicsize */
+	0, /* tp_itemsize */
+	(destructor)itor_dealloc, /* tp_dealloc */
+	0, /* tp_print */
+	0, /* tp_getattr */
+	0, /* tp_setattr */
+	0, /* tp_reserved */
+	0, /* tp_repr */
+	0, /* tp_as_number */
+	0, /* tp_as_sequence */
+	0, /* tp_as_mapping */
+	0, /* tp_hash */
+	0, /* tp_call */
+	0, /* tp_str */
+	0, /* tp_getattro */
+	0, /* tp_setattro */
+	0, /* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT, /* tp_flags */
+	ijaro_doc, /* tp_doc */
+	0, /* tp_traverse */
+	0, /* tp_clear */
+	0, /* tp_richcompare */
+	0, /* tp_weaklistoffset */
+	PyObject_SelfIter, /* tp_iter */
+	(iternextfunc)ijaro_next, /* tp_iternext */
+	0, /* tp_methods */
+	0, /* tp_members */
+	0, /* tp_getset */
+	0, /* tp_base */
+	0, /* tp_dict */
+	0, /* tp_descr_get */
+	0, /* tp_descr_set */
+	0, /* tp_dictoffset */
+	0, /* tp_init */
+	PyType_GenericAlloc, /* tp_alloc */
+	ijaro_new, /* tp_new */
+};
+
+
+PyTypeObject IJaroWinkler_Type = {
+	PyVarObject_HEAD_INIT(&PyType_Type, 0)
+	"distance.ijaro_winkler", /* tp_name */
+	sizeof(ItorState), /* tp_basicsize */
+	0, /* tp_itemsize */
+	(destructor)itor_dealloc, /* tp_dealloc */
+	0, /* tp_print */
+	0, /* tp_getattr */
+	0, /* tp_setattr */
+	0, /* tp_reserved */
+	0, /* tp_repr */
+	0, /* tp_as_number */
+	0, /* tp_as_sequence */
+	0, /* tp_as_mapping */
+	0, /* tp_hash */
+	0, /* tp_call */
+	0, /* tp_str */
+	0, /* tp_getattro */
+	0, /* tp_setattro */
+	0, /* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT, /* tp_flags */
+	ijaro_winkler_doc, /* tp_doc */
+	0, /* tp_traverse */
+	0, /* tp_clear */
+	0, /* tp_richcompare */
+	0, /* tp_weaklistoffset */
+	PyObject_SelfIter, /* tp_iter */
+	(iternextfunc)ijaro_next, /* tp_iternext */
+	0, /* tp_methods */
+	0, /* tp_members */
+	0, /* tp_getset */
+	0, /* tp_base */
+	0, /* tp_dict */
+	0, /* tp_descr_get */
+	0, /* tp_descr_set */
+	0, /* tp_dictoffset */
+	0, /* tp_init */
+	PyType_GenericAlloc, /* tp_alloc */
+	ijaro_winkler_new, /* tp_new */
+};
+
+
+// Lexicons (see lexicon.c).
+
+typedef struct {
+	PyObject_HEAD
+	struct distance_lexicon *lex;
+	int scans;				// scans running without the GIL
+} LexiconObject;
+
+
+static PyObject *
+lexicon_closed(void)
+{
+	PyErr_SetString(PyExc_ValueError, "operation on a closed lexicon");
+	return NULL;
+}
+
+
+static PyObject *
+lexicon_word(LexiconObject *self, Py_ssize_t i)
+{
+	const void *items;
+	dist_ssize_t len;
+#if PY_VERSION_HEX < 0x03030000
+	int byteorder = -1;
+#endif
+	
+	if ((items = distance_lexicon_word(self->lex, i, &len)) == NULL)
+		return set_error(DISTANCE_EFORMAT);
+#if PY_VERSION_HEX >= 0x03030000
+	return PyUnicode_FromKindAndData(distance_lexicon_width(self->lex), items, len);
+#else
+	switch (distance_lexicon_width(self->lex)) {
+		case 1:
+			return PyUnicode_DecodeLatin1((const char *)items, len, NULL);
+		case 2:
+			return PyUnicode_DecodeUTF16((const char *)items, 2 * len, NULL, &byteorder);
+	}
+	return PyUnicode_DecodeUTF32((const char *)items, 4 * len, NULL, &byteorder);
+#endif
+}
+
+
+static PyObject *
+lexicon_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+	LexiconObject *self;
+	struct distance_lexicon *lex = NULL;
+	static char *keywords[] = {"path", NULL};
+	const char *path;
+	int status;
+#if PY_MAJOR_VERSION >= 3
+	PyObject *opath;
+	
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O&:Lexicon", keywords,
+		PyUnicode_FSConverter, &opath))
+		return NULL;
+	path = PyBytes_AS_STRING(opath);
+#else
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s:Lexicon", keywords, &path))
+		return NULL;
+#endif
+	
+	Py_BEGIN_ALLOW_THREADS
+	status = distance_lexicon_open(path, &lex);
+	Py_END_ALLOW_THREADS
+	if (status == DISTANCE_EIO)
+		PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+	else if (status != DISTANCE_OK)
+		set_error(status);
+#if PY_MAJOR_VERSION >= 3
+	Py_DECREF(opath);
+#endif
+	if (status != DISTANCE_OK)
+		return NULL;
+	
+	if ((self = (LexiconObject *)type->tp_alloc(type, 0)) == NULL) {
+		distance_lexicon_close(lex);
+		return NULL;
+	}
+	self->lex = lex;
+	return (PyObject *)self;
+}
+
+
+static void
+lexicon_dealloc(LexiconObject *self)
+{
+	distance_lexicon_close(self->lex);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+
+static PyObject *
+lexicon_open_py(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+	return lexicon_new(type, args, kwargs);
+}
+
+
+static PyObject *
+lexicon_close_py(LexiconObject *self)
+{
+	if (self->scans) {
+		PyErr_SetString(PyExc_ValueError, "can't close a lexicon while it is scanned");
+		return NULL;
+	}
+	distance_lexicon_close(self->lex);
+	self->lex = NULL;
+	Py_RETURN_NONE;
+}
+
+
+static PyObject *
+lexicon_enter_py(LexiconObject *self)
+{
+	if (self->lex == NULL)
+		return lexicon_closed();
+	Py_INCREF(self);
+	return (PyObject *)self;
+}
+
+
+static PyObject *
+lexicon_exit_py(LexiconObject *self, PyObject *args)
+{
+	return lexicon_close_py(self);
+}
+
+
+static Py_ssize_t
+lexicon_length(LexiconObject *self)
+{
+	if (self->lex == NULL) {
+		lexicon_closed();
+		return -1;
+	}
+	return distance_lexicon_size(self->lex);
+}
+
+
+static PyObject *
+lexicon_item(LexiconObject *self, Py_ssize_t i)
+{
+	if (self->lex == NULL)
+		return lexicon_closed();
+	if (i < 0 || i >= distance_lexicon_size(self->lex)) {
+		PyErr_SetString(PyExc_IndexError, "lexicon index out of range");
+		return NULL;
+	}
+	return lexicon_word(self, i);
+}
+
+
+// Metrics of the searches over lexicons and candidate sets, in the order of
+// `enum distance_metric`.
+
+static const char *search_metrics[] = {"levenshtein", "hamming", "fast_comp"};
+
+
+static int
+get_metric(const char *name)
+{
+	int metric;
+	
+	for (metric = 0; metric < 3; metric++) {
+		if (strcmp(name, search_metrics[metric]) == 0)
+			return metric;
+	}
+	PyErr_SetString(PyExc_ValueError,
+		"expected one of levenshtein, hamming, fast_comp for `metric`");
+	return -1;
+}
+
+
+static PyObject *
+lexicon_scan_py(LexiconObject *self, PyObject *args, PyObject *kwargs)
+{
+	PyObject *arg1, *rv, *word, *hit;
+	const char *metric_name = "levenshtein";
+	Py_ssize_t max_dist = -1, len1, nhits = 0, i;
+	static char *keywords[] = {"query", "metric", "max_dist", NULL};
+	struct distance_hit *hits = NULL;
+	sequence seq1;
+	int metric, status;
+	
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|sn:scan", keywords,
+		&arg1, &metric_name, &max_dist))
+		return NULL;
+	if (self->lex == NULL)
+		return lexicon_closed();
+	arg1 = QUERY(arg1);
+	if (!PyUnicode_Check(arg1)) {
+		PyErr_SetString(PyExc_ValueError, "expected a unicode string as query");
+		return NULL;
+	}
+	if ((metric = get_metric(metric_name)) == -1)
+		return NULL;
+	if (!get_unicode(arg1, &seq1, &len1))
+		return NULL;
+	
+	self->scans++;
+	Py_BEGIN_ALLOW_THREADS
+	status = distance_lexicon_scan(self->lex, seq1.items, seq1.width, len1, metric,
+		max_dist, &hits, &nhits);
+	Py_END_ALLOW_THREADS
+	self->scans--;
+	if (status != DISTANCE_OK)
+		return set_error(status);
+	
+	if ((rv = PyList_New(nhits)) == NULL)
+		goto On_Error;
+	for (i = 0; i < nhits; i++) {
+		if ((word = lexicon_word(self, hits[i].index)) == NULL)
+			goto On_Error;
+		hit = Py_BuildValue("(nN)", hits[i].dist, word);
+		if (hit == NULL)
+			goto On_Error;
+		PyList_SET_ITEM(rv, i, hit);
+	}
+	distance_free(hits);
+	return rv;
+	
+	On_Error:
+		Py_XDECREF(rv);
+		distance_free(hits);
+		return NULL;
+}
+
+
+static PySequenceMethods lexicon_as_sequence = {
+	(lenfunc)lexicon_length, /* sq_length */
+	0, /* sq_concat */
+	0, /* sq_repeat */
+	(ssizeargfunc)lexicon_item, /* sq_item */
+};
+
+
+static PyMethodDef lexicon_methods[] = {
+	{"open", (PyCFunction)lexicon_open_py, METH_VARARGS | METH_KEYWORDS | METH_CLASS, Lexicon_open_doc},
+	{"scan", (PyCFunction)lexicon_scan_py, METH_VARARGS | METH_KEYWORDS, Lexicon_scan_doc},
+	{"close", (PyCFunction)lexicon_close_py, METH_NOARGS, Lexicon_close_doc},
+	{"__enter__", (PyCFunction)lexicon_enter_py, METH_NOARGS, NULL},
+	{"__exit__", (PyCFunction)lexicon_exit_py, METH_VARARGS, NULL},
+	{NULL, NULL, 0, NULL}
+};
+
+
+PyTypeObject Lexicon_Type = {
+	PyVarObject_HEAD_INIT(&PyType_Type, 0)
+	"distance.Lexicon", /* tp_name */
+	sizeof(LexiconObject), /* tp_basicsize */
+	0, /* tp_itemsize */
+	(destructor)lexicon_dealloc, /* tp_dealloc */
+	0, /* tp_print */
+	0, /* tp_getattr */
+	0, /* tp_setattr */
+	0, /* tp_reserved */
+	0, /* tp_repr */
+	0, /* tp_as_number */
+	&lexicon_as_sequence, /* tp_as_sequence */
+	0, /* tp_as_mapping */
+	0, /* tp_hash */
+	0, /* tp_call */
+	0, /* tp_str */
+	0, /* tp_getattro */
+	0, /* tp_setattro */
+	0, /* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT, /* tp_flags */
+	Lexicon_doc, /* tp_doc */
+	0, /* tp_traverse */
+	0, /* tp_clear */
+	0, /* tp_richcompare */
+	0, /* tp_weaklistoffset */
+	0, /* tp_iter */
+	0, /* tp_iternext */
+	lexicon_methods, /* tp_methods */
+	0, /* tp_members */
+	0, /* tp_getset */
+	0, /* tp_base */
+	0, /* tp_dict */
+	0, /* tp_descr_get */
+	0, /* tp_descr_set */
+	0, /* tp_dictoffset */
+	0, /* tp_init */
+	PyType_GenericAlloc, /* tp_alloc */
+	lexicon_new, /* tp_new */
+};
+
+
+// Candidate sets (see candidates.c).
+
+typedef struct {
+	PyObject_HEAD
+	struct distance_candidates *cs;
+	PyObject *objects;		// the candidates, which items are referenced by `cs`
+	char seqtype;			// 'u' or 'b', '\0' while the set is empty
+	int searches;			// searches running without the GIL
+} CandidateSetObject;
+
+
+static char
+candidate_sequence(CandidateSetObject *self, PyObject *obj, sequence *seq, Py_ssize_t *len)
+{
+	char t;
+	
+	obj = QUERY(obj);
+	if (PyUnicode_Check(obj)) {
+		t = 'u';
+		if (!get_unicode(obj, seq, len))
+			return 0;
+	}
+	else if (PyBytes_Check(obj)) {
+		t = 'b';
+		get_byte(obj, seq, len);
+	}
+	else {
+		PyErr_SetString(PyExc_ValueError, "expected unicode or byte strings");
+		return 0;
+	}
+	if (self->seqtype && t != self->seqtype) {
+		PyErr_SetString(PyExc_ValueError, "type mismatch between the strings of the set");
+		return 0;
+	}
+	return t;
+}
+
+
+static PyObject *
+candidates_add_py(CandidateSetObject *self, PyObject *obj)
+{
+	sequence seq;
+	Py_ssize_t len, n = PyList_GET_SIZE(self->objects);
+	int status;
+	char t;
+	
+	if (self->searches) {
+		PyErr_SetString(PyExc_ValueError, "can't add to a candidate set while it is searched");
+		return NULL;
+	}
+	if ((t = candidate_sequence(self, obj, &seq, &len)) == '\0')
+		return NULL;
+	if (PyList_Append(self->objects, obj) == -1)
+		return NULL;
+	if ((status = distance_candidates_add(self->cs, seq.items, seq.width, len)) != DISTANCE_OK) {
+		PyList_SetSlice(self->objects, n, n + 1, NULL);
+		return set_error(status);
+	}
+	self->seqtype = t;
+	Py_RETURN_NONE;
+}
+
+
+static PyObject *
+candidates_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+	CandidateSetObject *self;
+	PyObject *arg, *itor, *obj, *rv;
+	int q = 2, status;
+	static char *keywords[] = {"seqs", "q", NULL};
+	
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|i:CandidateSet", keywords, &arg, &q))
+		return NULL;
+	if ((itor = PyObject_GetIter(arg)) == NULL)
+		return NULL;
+	if ((self = (CandidateSetObject *)type->tp_alloc(type, 0)) == NULL) {
+		Py_DECREF(itor);
+		return NULL;
+	}
+	if ((status = distance_candidates_new(q, &self->cs)) != DISTANCE_OK) {
+		if (status == DISTANCE_EINVAL)
+			PyErr_SetString(PyExc_ValueError, "expected a value between 1 and 8 for `q`");
+		else
+			set_error(status);
+		goto On_Error;
+	}
+	if ((self->objects = PyList_New(0)) == NULL)
+		goto On_Error;
+	
+	while ((obj = PyIter_Next(itor)) != NULL) {
+		rv = candidates_add_py(self, obj);
+		Py_DECREF(obj);
+		if (rv == NULL)
+			goto On_Error;
+		Py_DECREF(rv);
+	}
+	if (PyErr_Occurred())
+		goto On_Error;
+	Py_DECREF(itor);
+	return (PyObject *)self;
+	
+	On_Error:
+		Py_DECREF(itor);
+		Py_DECREF(self);
+		return NULL;
+}
+
+
+static void
+candidates_dealloc(CandidateSetObject *self)
+{
+	distance_candidates_free(self->cs);
+	Py_XDECREF(self->objects);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+
+static Py_ssize_t
+candidates_length(CandidateSetObject *self)
+{
+	return PyList_GET_SIZE(self->objects);
+}
+
+
+static PyObject *
+candidates_item(CandidateSetObject *self, Py_ssize_t i)
+{
+	if (i < 0 || i >= PyList_GET_SIZE(self->objects)) {
+		PyErr_SetString(PyExc_IndexError, "candidate set index out of range");
+		return NULL;
+	}
+	Py_INCREF(PyList_GET_ITEM(self->objects, i));
+	return PyList_GET_ITEM(self->objects, i);
+}
+
+
+static PyObject *
+candidates_search_py(CandidateSetObject *self, PyObject *args, PyObject *kwargs)
+{
+	PyObject *arg1, *rv = NULL, *hit;
+	const char *metric_name = "levenshtein";
+	Py_ssize_t max_dist = -1, len1, nhits = 0, i;
+	static char *keywords[] = {"query", "max_dist", "metric", NULL};
+	struct distance_hit *hits = NULL;
+	struct distance_pattern *pat;
+	sequence seq1;
+	int metric, status;
+	
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|ns:search", keywords,
+		&arg1, &max_dist, &metric_name))
+		return NULL;
+	if ((metric = get_metric(metric_name)) == -1)
+		return NULL;
+	if (!candidate_sequence(self, arg1, &seq1, &len1))
+		return NULL;
+	
+	// a pattern is kept alive by `args`
+	pat = COMPILED(arg1);
+	self->searches++;
+	Py_BEGIN_ALLOW_THREADS
+	if (pat != NULL)
+		status = distance_candidates_search_pattern(self->cs, pat, metric, max_dist, &hits, &nhits);
+	else
+		status = distance_candidates_search(self->cs, seq1.items, seq1.width, len1, metric,
+			max_dist, &hits, &nhits);
+	Py_END_ALLOW_THREADS
+	self->searches--;
+	if (status != DISTANCE_OK)
+		return set_error(status);
+	
+	if ((rv = PyList_New(nhits)) == NULL)
+		goto On_Error;
+	for (i = 0; i < nhits; i++) {
+		hit = Py_BuildValue("(nO)", hits[i].dist, PyList_GET_ITEM(self->objects, hits[i].index));
+		if (hit == NULL)
+			goto On_Error;
+		PyList_SET_ITEM(rv, i, hit);
+	}
+	distance_free(hits);
+	return rv;
+	
+	On_Error:
+		Py_XDECREF(rv);
+		distance_free(hits);
+		return NULL;
+}
+
+
+static PySequenceMethods candidates_as_sequence = {
+	(lenfunc)candidates_length, /* sq_length */
+	0, /* sq_concat */
+	0, /* sq_repeat */
+	(ssizeargfunc)candidates_item, /* sq_item */
+};
+
+
+static PyMethodDef candidates_methods[] = {
+	{"add", (PyCFunction)candidates_add_py, METH_O, CandidateSet_add_doc},
+	{"search", (PyCFunction)candidates_search_py, METH_VARARGS | METH_KEYWORDS, CandidateSet_search_doc},
+	{NULL, NULL, 0, NULL}
+};
+
+
+PyTypeObject CandidateSet_Type = {
+	PyVarObject_HEAD_INIT(&PyType_Type, 0)
+	"distance.CandidateSet", /* tp_name */
+	sizeof(CandidateSetObject), /* tp_basicsize */
+	0, /* tp_itemsize */
+	(destructor)candidates_dealloc, /* tp_dealloc */
+	0, /* tp_print */
+	0, /* tp_getattr */
+	0, /* tp_setattr */
+	0, /* tp_reserved */
+	0, /* tp_repr */
+	0, /* tp_as_number */
+	&candidates_as_sequence, /* tp_as_sequence */
+	0, /* tp_as_mapping */
+	0, /* tp_hash */
+	0, /* tp_call */
+	0, /* tp_str */
+	0, /* tp_getattro */
+	0, /* tp_setattro */
+	0, /* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT, /* tp_flags */
+	CandidateSet_doc, /* tp_doc */
+	0, /* tp_traverse */
+	0, /* tp_clear */
+	0, /* tp_richcompare */
+	0, /* tp_weaklistoffset */
+	0, /* tp_iter */
+	0, /* tp_iternext */
+	candidates_methods, /* tp_methods */
+	0, /* tp_members */
+	0, /* tp_getset */
+	0, /* tp_base */
+	0, /* tp_dict */
+	0, /* tp_descr_get */
+	0, /* tp_descr_set */
+	0, /* tp_dictoffset */
+	0, /* tp_init */
+	PyType_GenericAlloc, /* tp_alloc */
+	candidates_new, /* tp_new */
+};
+
+
+// Tries (see trie.c).
+
+typedef struct {
+	PyObject_HEAD
+	struct distance_trie *trie;
+	PyObject *objects;		// the strings, as given
+	char seqtype;			// 'u' or 'b', '\0' if the trie is empty
+} TrieObject;
+
+
+static char
+trie_sequence(PyObject *obj, char seqtype, sequence *seq, Py_ssize_t *len)
+{
+	char t;
+	
+	obj = QUERY(obj);
+	if (PyUnicode_Check(obj)) {
+		t = 'u';
+		if (!get_unicode(obj, seq, len))
+			return 0;
+	}
+	else if (PyBytes_Check(obj)) {
+		t = 'b';
+		get_byte(obj, seq, len);
+	}
+	else {
+		PyErr_SetString(PyExc_ValueError, "expected unicode or byte strings");
+		return 0;
+	}
+	if (seqtype && t != seqtype) {
+		PyErr_SetString(PyExc_ValueError, "type mismatch between the strings of the trie");
+		return 0;
+	}
+	return t;
+}
+
+
+static PyObject *
+trie_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+	TrieObject *self;
+	PyObject *arg;
+	Py_ssize_t count, len, i;
+	const void **items = NULL;
+	dist_ssize_t *lens = NULL;
+	int *widths = NULL, status;
+	sequence seq;
+	static char *keywords[] = {"seqs", NULL};
+	
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O:Trie", keywords, &arg))
+		return NULL;
+	if ((self = (TrieObject *)type->tp_alloc(type, 0)) == NULL)
+		return NULL;
+	if ((self->objects = PySequence_List(arg)) == NULL)
+		goto On_Error;
+	
+	count = PyList_GET_SIZE(self->objects);
+	items = (const void **)PyMem_Malloc((count + 1) * sizeof(void *));
+	lens = (dist_ssize_t *)PyMem_Malloc((count + 1) * sizeof(dist_ssize_t));
+	widths = (int *)PyMem_Malloc((count + 1) * sizeof(int));
+	if (items == NULL || lens == NULL || widths == NULL) {
+		PyErr_NoMemory();
+		goto On_Error;
+	}
+	for (i = 0; i < count; i++) {
+		self->seqtype = trie_sequence(PyList_GET_ITEM(self->objects, i), self->seqtype,
+			&seq, &len);
+		if (self->seqtype == '\0')
+			goto On_Error;
+		items[i] = seq.items;
+		lens[i] = len;
+		widths[i] = seq.width;
+	}
+	
+	Py_BEGIN_ALLOW_THREADS
+	status = distance_trie_build(items, lens, widths, 1, count, &self->trie);
+	Py_END_ALLOW_THREADS
+	if (status != DISTANCE_OK) {
+		set_error(status);
+		goto On_Error;
+	}
+	PyMem_Free(items);
+	PyMem_Free(lens);
+	PyMem_Free(widths);
+	return (PyObject *)self;
+	
+	On_Error:
+		PyMem_Free(items);
+		PyMem_Free(lens);
+		PyMem_Free(widths);
+		Py_DECREF(self);
+		return NULL;
+}
+
+
+static void
+trie_dealloc(TrieObject *self)
+{
+	distance_trie_free(self->trie);
+	Py_XDECREF(self->objects);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+
+static Py_ssize_t
+trie_length(TrieObject *self)
+{
+	return PyList_GET_SIZE(self->objects);
+}
+
+
+static PyObject *
+trie_item(TrieObject *self, Py_ssize_t i)
+{
+	if (i < 0 || i >= PyList_GET_SIZE(self->objects)) {
+		PyErr_SetString(PyExc_IndexError, "trie index out of range");
+		return NULL;
+	}
+	Py_INCREF(PyList_GET_ITEM(self->objects, i));
+	return PyList_GET_ITEM(self->objects, i);
+}
+
+
+static PyObject *
+trie_search_py(TrieObject *self, PyObject *args, PyObject *kwargs)
+{
+	PyObject *arg1, *rv = NULL, *hit;
+	Py_ssize_t max_dist = -1, len1, nhits = 0, i;
+	static char *keywords[] = {"query", "max_dist", NULL};
+	struct distance_hit *hits = NULL;
+	sequence seq1;
+	int status;
+	
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|n:search", keywords, &arg1, &max_dist))
+		return NULL;
+	if (!trie_sequence(arg1, self->seqtype, &seq1, &len1))
+		return NULL;
+	
+	// the trie is never modified, and the query is kept alive by `args`
+	Py_BEGIN_ALLOW_THREADS
+	status = distance_trie_search(self->trie, seq1.items, seq1.width, len1, max_dist,
+		&hits, &nhits);
+	Py_END_ALLOW_THREADS
+	if (status != DISTANCE_OK)
+		return set_error(status);
+	
+	if ((rv = PyList_New(nhits)) == NULL)
+		goto On_Error;
+	for (i = 0; i < nhits; i++) {
+		hit = Py_BuildValue("(nO)", hits[i].dist, PyList_GET_ITEM(self->objects, hits[i].index));
+		if (hit == NULL)
+			goto On_Error;
+		PyList_SET_ITEM(rv, i, hit);
+	}
+	distance_free(hits);
+	return rv;
+	
+	On_Error:
+		Py_XDECREF(rv);
+		distance_free(hits);
+		return NULL;
+}
+
+
+static PySequenceMethods trie_as_sequence = {
+	(lenfunc)trie_length, /* sq_length */
+	0, /* sq_concat */
+	0, /* sq_repeat */
+	(ssizeargfunc)trie_item, /* sq_item */
+};
+
+
+static PyMethodDef trie_methods[] = {
+	{"search", (PyCFunction)trie_search_py, METH_VARARGS | METH_KEYWORDS, Trie_search_doc},
+	{NULL, NULL, 0, NULL}
+};
+
+
+PyTypeObject Trie_Type = {
+	PyVarObject_HEAD_INIT(&PyType_Type, 0)
+	"distance.Trie", /* tp_name */
+	sizeof(TrieObject), /* tp_basicsize */
+	0, /* tp_itemsize */
+	(destructor)trie_dealloc, /* tp_dealloc */
+	0, /* tp_print */
+	0, /* tp_getattr */
+	0, /* tp_setattr */
+	0, /* tp_reserved */
+	0, /* tp_repr */
+	0, /* tp_as_number */
+	&trie_as_sequence, /* tp_as_sequence */
+	0, /* tp_as_mapping */
+	0, /* tp_hash */
+	0, /* tp_call */
+	0, /* tp_str */
+	0, /* tp_getattro */
+	0, /* tp_setattro */
+	0, /* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT, /* tp_flags */
+	Trie_doc, /* tp_doc */
+	0, /* tp_traverse */
+	0, /* tp_clear */
+	0, /* tp_richcompare */
+	0, /* tp_weaklistoffset */
+	0, /* tp_iter */
+	0, /* tp_iternext */
+	trie_methods, /* tp_methods */
+	0, /* tp_members */
+	0, /* tp_getset */
+	0, /* tp_base */
+	0, /* tp_dict */
+	0, /* tp_descr_get */
+	0, /* tp_descr_set */
+	0, /* tp_dictoffset */
+	0, /* tp_init */
+	PyType_GenericAlloc, /* tp_alloc */
+	trie_new, /* tp_new */
+};
+
+
+// Vocabularies of tokens, mapped to dense ids.
+
+/* The ids are kept in an open addressing hash table, with the hash of their
+token; the tokens themselves are in a list, indexed by id. A slot holds 0 when
+it is empty, and the id plus one otherwise. */
+
+struct vocab_slot {
+	Py_hash_t hash;
+	uint32_t id;
+};
+
+typedef struct {
+	PyObject_HEAD
+	PyObject *tokens;			// list, the token of each id
+	struct vocab_slot *slots;
+	Py_ssize_t mask;			// number of slots minus one
+} VocabularyObject;
+
+
+// Rebuilds the table with `size` slots, a power of two.
+
+static int
+vocab_resize(VocabularyObject *self, Py_ssize_t size)
+{
+	struct vocab_slot *slots;
+	Py_ssize_t i, j;
+	
+	if ((slots = (struct vocab_slot *)PyMem_Calloc(size, sizeof(struct vocab_slot))) == NULL) {
+		PyErr_NoMemory();
+		return 0;
+	}
+	for (i = 0; self->slots && i <= self->mask; i++) {
+		if (!self->slots[i].id)
+			continue;
+		for (j = self->slots[i].hash & (size - 1); slots[j].id; j = (j + 1) & (size - 1))
+			;
+		slots[j] = self->slots[i];
+	}
+	PyMem_Free(self->slots);
+	self->slots = slots;
+	self->mask = size - 1;
+	return 1;
+}
+
+
+/* Returns the id of `token`, adding it to the vocabulary if needed and `add`
+is set, or -1 with an exception. The comparison of tokens can run Python code
+which modifies the vocabulary, in which case the lookup starts over. */
+
+static Py_ssize_t
+vocab_id(VocabularyObject *self, PyObject *token, int add)
+{
+	struct vocab_slot *slots;
+	Py_ssize_t n = PyList_GET_SIZE(self->tokens), i;
+	Py_hash_t hash;
+	PyObject *other;
+	int eq;
+	
+	if ((hash = PyObject_Hash(token)) == -1)
+		return -1;
+	
+	Lookup:
+	slots = self->slots;
+	for (i = hash & self->mask; slots[i].id; i = (i + 1) & self->mask) {
+		if (slots[i].hash != hash)
+			continue;
+		other = PyList_GET_ITEM(self->tokens, slots[i].id - 1);
+		if (other == token)
+			return slots[i].id - 1;
+		Py_INCREF(other);
+		eq = PyObject_RichCompareBool(other, token, Py_EQ);
+		Py_DECREF(other);
+		if (eq == -1)
+			return -1;
+		if (self->slots != slots || PyList_GET_SIZE(self->tokens) != n)
+			goto Lookup;
+		if (eq)
+			return slots[i].id - 1;
+	}
+	
+	if (!add) {
+		PyErr_SetObject(PyExc_KeyError, token);
+		return -1;
+	}
+	if (n >= (Py_ssize_t)UINT32_MAX) {
+		PyErr_SetString(PyExc_OverflowError, "too many tokens in the vocabulary");
+		return -1;
+	}
+	if (PyList_Append(self->tokens, token) == -1)
+		return -1;
+	slots[i].hash = hash;
+	slots[i].id = (uint32_t)n + 1;
+	
+	// at most two thirds of the slots are used
+	if (3 * (n + 1) > 2 * (self->mask + 1) && !vocab_resize(self, 2 * (self->mask + 1))) {
+		slots[i].id = 0;
+		PyList_SetSlice(self->tokens, n, n + 1, NULL);
+		return -1;
+	}
+	return n;
+}
+
+
+static PyObject *
+vocab_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+	VocabularyObject *self;
+	PyObject *arg = NULL, *itor, *token;
+	static char *keywords[] = {"tokens", NULL};
+	
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O:Vocabulary", keywords, &arg))
+		return NULL;
+	if ((self = (VocabularyObject *)type->tp_alloc(type, 0)) == NULL)
+		return NULL;
+	if ((self->tokens = PyList_New(0)) == NULL || !vocab_resize(self, 8))
+		goto On_Error;
+	if (arg == NULL)
+		return (PyObject *)self;
+	
+	if ((itor = PyObject_GetIter(arg)) == NULL)
+		goto On_Error;
+	while ((token = PyIter_Next(itor)) != NULL) {
+		if (vocab_id(self, token, 1) == -1) {
+			Py_DECREF(token);
+			break;
+		}
+		Py_DECREF(token);
+	}
+	Py_DECREF(itor);
+	if (PyErr_Occurred())
+		goto On_Error;
+	return (PyObject *)self;
+	
+	On_Error:
+		Py_DECREF(self);
+		return NULL;
+}
+
+
+static void
+vocab_dealloc(VocabularyObject *self)
+{
+	PyMem_Free(self->slots);
+	Py_XDECREF(self->tokens);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+
+static Py_ssize_t
+vocab_length(VocabularyObject *self)
+{
+	return PyList_GET_SIZE(self->tokens);
+}
+
+
+static PyObject *
+vocab_item(VocabularyObject *self, Py_ssize_t i)
+{
+	if (i < 0 || i >= PyList_GET_SIZE(self->tokens)) {
+		PyErr_SetString(PyExc_IndexError, "vocabulary index out of range");
+		return NULL;
+	}
+	Py_INCREF(PyList_GET_ITEM(self->tokens, i));
+	return PyList_GET_ITEM(self->tokens, i);
+}
+
+
+static int
+vocab_contains(VocabularyObject *self, PyObject *token)
+{
+	if (vocab_id(self, token, 0) != -1)
+		return 1;
+	if (!PyErr_ExceptionMatches(PyExc_KeyError))
+		return -1;
+	PyErr_Clear();
+	return 0;
+}
+
+
+// Returns a new `array.array` of type `code`, holding the `size` bytes of `items`.
+
+static PyObject *
+new_array(const char *code, const void *items, Py_ssize_t size)
+{
+	static PyObject *array_type = NULL;
+	PyObject *module, *bytes, *rv;
+	
+	if (array_type == NULL) {
+		if ((module = PyImport_ImportModule("array")) == NULL)
+			return NULL;
+		array_type = PyObject_GetAttrString(module, "array");
+		Py_DECREF(module);
+		if (array_type == NULL)
+			return NULL;
+	}
+	if ((bytes = PyBytes_FromStringAndSize((const char *)items, size)) == NULL)
+		return NULL;
+	rv = PyObject_CallFunction(array_type, "sO", code, bytes);
+	Py_DECREF(bytes);
+	return rv;
+}
+
+
+/* Returns a new `array.array` holding `len` items of `width` bytes, of the
+matching type. */
+
+static PyObject *
+make_array(const void *items, int width, Py_ssize_t len)
+{
+	return new_array((width == 1 ? "B" : width == 2 ? "H" : "I"), items, len * width);
+}
+
+
+static PyObject *
+vocab_encode_py(VocabularyObject *self, PyObject *args, PyObject *kwargs)
+{
+	PyObject *arg, *seq, *rv = NULL;
+	PyObject *oadd = NULL;
+	Py_ssize_t len, i, id, n;
+	static char *keywords[] = {"seq", "add", NULL};
+	uint32_t *ids;
+	uint16_t narrow;
+	int add = 1, width;
+	
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O:encode", keywords, &arg, &oadd))
+		return NULL;
+	if (oadd && (add = PyObject_IsTrue(oadd)) == -1)
+		return NULL;
+	if ((seq = PySequence_Fast(arg, "expected a sequence of tokens")) == NULL)
+		return NULL;
+	
+	len = PySequence_Fast_GET_SIZE(seq);
+	if ((ids = (uint32_t *)PyMem_Malloc((len + 1) * sizeof(uint32_t))) == NULL) {
+		PyErr_NoMemory();
+		goto On_Exit;
+	}
+	for (i = 0; i < len; i++) {
+		if ((id = vocab_id(self, PySequence_Fast_GET_ITEM(seq, i), add)) == -1)
+			goto On_Exit;
+		ids[i] = (uint32_t)id;
+	}
+	
+	// the ids are narrowed in place, to the width of the vocabulary
+	n = PyList_GET_SIZE(self->tokens);
+	width = (n <= 0x100 ? 1 : n <= 0x10000 ? 2 : 4);
+	for (i = 0; width == 1 && i < len; i++)
+		((uint8_t *)ids)[i] = (uint8_t)ids[i];
+	for (i = 0; width == 2 && i < len; i++) {
+		narrow = (uint16_t)ids[i];
+		memcpy((char *)ids + 2 * i, &narrow, 2);
+	}
+	rv = make_array(ids, width, len);
+	
+	On_Exit:
+		PyMem_Free(ids);
+		Py_DECREF(seq);
+		return rv;
+}
+
+
+static PyObject *
+vocab_decode_py(VocabularyObject *self, PyObject *arg)
+{
+	PyObject *seq, *rv, *token;
+	Py_ssize_t len, i, id;
+	
+	if ((seq = PySequence_Fast(arg, "expected a sequence of ids")) == NULL)
+		return NULL;
+	len = PySequence_Fast_GET_SIZE(seq);
+	if ((rv = PyList_New(len)) == NULL) {
+		Py_DECREF(seq);
+		return NULL;
+	}
+	for (i = 0; i < len; i++) {
+		id = PyNumber_AsSsize_t(PySequence_Fast_GET_ITEM(seq, i), PyExc_IndexError);
+		if (id == -1 && PyErr_Occurred())
+			goto On_Error;
+		if (id < 0 || id >= PyList_GET_SIZE(self->tokens)) {
+			PyErr_SetString(PyExc_IndexError, "no such id in the vocabulary");
+			goto On_Error;
+		}
+		token = PyList_GET_ITEM(self->tokens, id);
+		Py_INCREF(token);
+		PyList_SET_ITEM(rv, i, token);
+	}
+	Py_DECREF(seq);
+	return rv;
+	
+	On_Error:
+		Py_DECREF(seq);
+		Py_DECREF(rv);
+		return NULL;
+}
+
+
+static PySequenceMethods vocab_as_sequence = {
+	(lenfunc)vocab_length, /* sq_length */
+	0, /* sq_concat */
+	0, /* sq_repeat */
+	(ssizeargfunc)vocab_item, /* sq_item */
+	0, /* sq_slice */
+	0, /* sq_ass_item */
+	0, /* sq_ass_slice */
+	(objobjproc)vocab_contains, /* sq_contains */
+};
+
+
+static PyMethodDef vocab_methods[] = {
+	{"encode", (PyCFunction)vocab_encode_py, METH_VARARGS | METH_KEYWORDS, Vocabulary_encode_doc},
+	{"decode", (PyCFunction)vocab_decode_py, METH_O, Vocabulary_decode_doc},
+	{NULL, NULL, 0, NULL}
+};
+
+
+PyTypeObject Vocabulary_Type = {
+	PyVarObject_HEAD_INIT(&PyType_Type, 0)
+	"distance.Vocabulary", /* tp_name */
+	sizeof(VocabularyObject), /* tp_basicsize */
+	0, /* tp_itemsize */
+	(destructor)vocab_dealloc, /* tp_dealloc */
+	0, /* tp_print */
+	0, /* tp_getattr */
+	0, /* tp_setattr */
+	0, /* tp_reserved */
+	0, /* tp_repr */
+	0, /* tp_as_number */
+	&vocab_as_sequence, /* tp_as_sequence */
+	0, /* tp_as_mapping */
+	0, /* tp_hash */
+	0, /* tp_call */
+	0, /* tp_str */
+	0, /* tp_getattro */
+	0, /* tp_setattro */
+	0, /* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT, /* tp_flags */
+	Vocabulary_doc, /* tp_doc */
+	0, /* tp_traverse */
+	0, /* tp_clear */
+	0, /* tp_richcompare */
+	0, /* tp_weaklistoffset */
+	0, /* tp_iter */
+	0, /* tp_iternext */
+	vocab_methods, /* tp_methods */
+	0, /* tp_members */
+	0, /* tp_getset */
+	0, /* tp_base */
+	0, /* tp_dict */
+	0, /* tp_descr_get */
+	0, /* tp_descr_set */
+	0, /* tp_dictoffset */
+	0, /* tp_init */
+	PyType_GenericAlloc, /* tp_alloc */
+	vocab_new, /* tp_new */
+};
+
+
+// Compiled queries.
+
+static const struct {
+	const char *name;
+	int flags;
+} pattern_metrics[] = {
+	{"levenshtein", DISTANCE_PATTERN_PEQ},
+	{"lcs_length", DISTANCE_PATTERN_PEQ},
+	{"indel_distance", DISTANCE_PATTERN_PEQ},
+	{"qgrams", DISTANCE_PATTERN_QGRAMS},
+};
+
+#define PATTERN_NMETRICS (sizeof(pattern_metrics) / sizeof(pattern_metrics[0]))
+
+
+// Flags of the names in the tuple `metrics`, or -1 with an exception.
+
+static int
+pattern_flags(PyObject *metrics)
+{
+	PyObject *name;
+	Py_ssize_t i;
+	size_t k;
+	int flags = 0;
+	
+	for (i = 0; i < PyTuple_GET_SIZE(metrics); i++) {
+		name = PyTuple_GET_ITEM(metrics, i);
+		for (k = 0; k < PATTERN_NMETRICS; k++) {
+			if (PyUnicode_Check(name) && PyUnicode_CompareWithASCIIString(name, pattern_metrics[k].name) == 0)
+				break;
+		}
+		if (k == PATTERN_NMETRICS) {
+			PyErr_Format(PyExc_ValueError, "unknown metric: %R", name);
+			return -1;
+		}
+		flags |= pattern_metrics[k].flags;
+	}
+	return flags;
+}
+
+
+static PyObject *
+pattern_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+	PatternObject *self;
+	PyObject *arg, *ometrics = Py_None;
+	static char *keywords[] = {"seq", "metrics", "q", NULL};
+	sequence seq;
+	Py_ssize_t len;
+	size_t k;
+	int q = 2, flags, status;
+	char t;
+	
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|Oi:compile_query", keywords,
+		&arg, &ometrics, &q))
+		return NULL;
+	if (q < 1 || q > QGRAMS_MAX_Q) {
+		PyErr_Format(PyExc_ValueError, "expected a value between 1 and %d for `q`", QGRAMS_MAX_Q);
+		return NULL;
+	}
+	if (PATTERN_CHECK(arg)) {
+		PyErr_SetString(PyExc_ValueError, "the query is compiled already");
+		return NULL;
+	}
+	if ((self = (PatternObject *)type->tp_alloc(type, 0)) == NULL)
+		return NULL;
+	
+	if (ometrics == Py_None) {
+		if ((self->metrics = PyTuple_New(PATTERN_NMETRICS)) == NULL)
+			goto On_Error;
+		for (k = 0; k < PATTERN_NMETRICS; k++) {
+			PyObject *name = PyUnicode_FromString(pattern_metrics[k].name);
+			if (name == NULL)
+				goto On_Error;
+			PyTuple_SET_ITEM(self->metrics, k, name);
+		}
+	}
+	else if ((self->metrics = PySequence_Tuple(ometrics)) == NULL)
+		goto On_Error;
+	if ((flags = pattern_flags(self->metrics)) == -1)
+		goto On_Error;
+	self->q = q;
+	
+	if ((t = get_sequence(arg, &seq, &len, '\0')) == '\0')
+		goto On_Error;
+	self->seqtype = t;
+	self->len = len;
+	
+	// the pattern keeps a query which can't be modified
+	if (t == 'a') {
+		release_sequence(&seq);
+		if ((self->seq = PySequence_Tuple(arg)) == NULL)
+			goto On_Error;
+		return (PyObject *)self;
+	}
+	if (t == 'i')
+		self->seq = make_array(seq.items, seq.width, len);
+	else {
+		Py_INCREF(arg);
+		self->seq = arg;
+	}
+	status = distance_pattern_new(seq.items, seq.width, len, flags, q, &self->pat);
+	release_sequence(&seq);
+	if (self->seq == NULL)
+		goto On_Error;
+	if (status != DISTANCE_OK) {
+		set_error(status);
+		goto On_Error;
+	}
+	return (PyObject *)self;
+	
+	On_Error:
+		Py_DECREF(self);
+		return NULL;
+}
+
+
+static void
+pattern_dealloc(PatternObject *self)
+{
+	distance_pattern_free(self->pat);
+	Py_XDECREF(self->seq);
+	Py_XDECREF(self->metrics);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+
+static Py_ssize_t
+pattern_length(PatternObject *self)
+{
+	return self->len;
+}
+
+
+static PyObject *
+pattern_reduce(PatternObject *self)
+{
+	return Py_BuildValue("O(OOi)", Py_TYPE(self), self->seq, self->metrics, self->q);
+}
+
+
+static PyObject *
+pattern_get_seq(PatternObject *self, void *closure)
+{
+	Py_INCREF(self->seq);
+	return self->seq;
+}
+
+
+static PyObject *
+pattern_get_metrics(PatternObject *self, void *closure)
+{
+	Py_INCREF(self->metrics);
+	return self->metrics;
+}
+
+
+static PyObject *
+pattern_get_q(PatternObject *self, void *closure)
+{
+	return PyLong_FromLong(self->q);
+}
+
+
+static PyObject *
+compile_query_py(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	return pattern_new(&Pattern_Type, args, kwargs);
+}
+
+
+static PySequenceMethods pattern_as_sequence = {
+	(lenfunc)pattern_length, /* sq_length */
+};
+
+
+static PyMethodDef pattern_methods[] = {
+	{"__reduce__", (PyCFunction)pattern_reduce, METH_NOARGS, NULL},
+	{NULL, NULL, 0, NULL}
+};
+
+
+static PyGetSetDef pattern_getset[] = {
+	{"seq", (getter)pattern_get_seq, NULL, "the query", NULL},
+	{"metrics", (getter)pattern_get_metrics, NULL, "the metrics the query is compiled for", NULL},
+	{"q", (getter)pattern_get_q, NULL, "the length of the q-grams of the profile", NULL},
+	{NULL, NULL, NULL, NULL, NULL}
+};
+
+
+PyTypeObject Pattern_Type = {
+	PyVarObject_HEAD_INIT(&PyType_Type, 0)
+	"distance.Pattern", /* tp_name */
+	sizeof(PatternObject), /* tp_basicsize */
+	0, /* tp_itemsize */
+	(destructor)pattern_dealloc, /* tp_dealloc */
+	0, /* tp_print */
+	0, /* tp_getattr */
+	0, /* tp_setattr */
+	0, /* tp_reserved */
+	0, /* tp_repr */
+	0, /* tp_as_number */
+	&pattern_as_sequence, /* tp_as_sequence */
+	0, /* tp_as_mapping */
+	0, /* tp_hash */
+	0, /* tp_call */
+	0, /* tp_str */
+	0, /* tp_getattro */
+	0, /* tp_setattro */
+	0, /* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT, /* tp_flags */
+	Pattern_doc, /* tp_doc */
+	0, /* tp_traverse */
+	0, /* tp_clear */
+	0, /* tp_richcompare */
+	0, /* tp_weaklistoffset */
+	0, /* tp_iter */
+	0, /* tp_iternext */
+	pattern_methods, /* tp_methods */
+	0, /* tp_members */
+	pattern_getset, /* tp_getset */
+	0, /* tp_base */
+	0, /* tp_dict */
+	0, /* tp_descr_get */
+	0, /* tp_descr_set */
+	0, /* tp_dictoffset */
+	0, /* tp_init */
+	PyType_GenericAlloc, /* tp_alloc */
+	pattern_new, /* tp_new */
+};
+
+
+// Approximate search (see distance_scan_next).
+
+#define FIND_CHUNK 256
+
+// A new reference to a Pattern of `obj` with match vectors: `obj` itself if
+// it has them, else a new one.
+
+static PyObject *
+scan_pattern(PyObject *obj)
+{
+	if (COMPILED(obj) && (pattern_flags(((PatternObject *)obj)->metrics) & DISTANCE_PATTERN_PEQ)) {
+		Py_INCREF(obj);
+		return obj;
+	}
+	return PyObject_CallFunction((PyObject *)&Pattern_Type, "O(s)", QUERY(obj), "levenshtein");
+}
+
+
+typedef struct {
+	PyObject_HEAD
+	PyObject *pattern;			// a Pattern compiled for levenshtein
+	PyObject *text;
+	sequence seq;
+	Py_ssize_t len;
+	struct distance_scan *scan;
+	int starts;
+	struct distance_match matches[FIND_CHUNK];
+	Py_ssize_t n, pos;			// matches read, and returned
+} FindApproxState;
+
+
+static PyObject *
+find_approx_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+	FindApproxState *state;
+	PyObject *arg1, *arg2, *ostarts = NULL;
+	static char *keywords[] = {"pattern", "text", "max_dist", "starts", NULL};
+	Py_ssize_t max_dist;
+	int starts = 0, rv, status;
+	
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOn|O:find_approx", keywords,
+		&arg1, &arg2, &max_dist, &ostarts))
+		return NULL;
+	if (ostarts && (starts = PyObject_IsTrue(ostarts)) == -1)
+		return NULL;
+	if (max_dist < 0) {
+		PyErr_SetString(PyExc_ValueError, "expected a positive `max_dist`, or 0");
+		return NULL;
+	}
+	if ((state = (FindApproxState *)type->tp_alloc(type, 0)) == NULL)
+		return NULL;
+	state->starts = starts;
+	
+	if ((state->pattern = scan_pattern(arg1)) == NULL)
+		goto On_Error;
+	if (COMPILED(state->pattern) == NULL) {
+		PyErr_SetString(PyExc_ValueError, "expected a string or an array of integers "
+			"(see Vocabulary)");
+		goto On_Error;
+	}
+	
+	if ((rv = pattern_sequence(state->pattern, arg2, &state->seq, &state->len)) != 1) {
+		if (rv == 0)
+			PyErr_SetString(PyExc_ValueError, "expected a text of the same type as the pattern");
+		goto On_Error;
+	}
+	Py_INCREF(arg2);
+	state->text = arg2;
+	if ((status = distance_scan_new(COMPILED(state->pattern), max_dist, starts, &state->scan)) != DISTANCE_OK) {
+		set_error(status);
+		goto On_Error;
+	}
+	return (PyObject *)state;
+	
+	On_Error:
+		Py_DECREF(state);
+		return NULL;
+}
+
+
+static void
+find_approx_dealloc(FindApproxState *state)
+{
+	distance_scan_free(state->scan);
+	if (state->text)
+		release_sequence(&state->seq);
+	Py_XDECREF(state->text);
+	Py_XDECREF(state->pattern);
+	Py_TYPE(state)->tp_free((PyObject *)state);
+}
+
+
+static PyObject *
+find_approx_next(FindApproxState *state)
+{
+	struct distance_match *match;
+	dist_ssize_t n;
+	int status;
+	
+	if (state->pos == state->n) {
+		// the text can't change, as it is immutable or its buffer is held
+		Py_BEGIN_ALLOW_THREADS
+		status = distance_scan_next(state->scan, state->seq.items, state->seq.width, state->len,
+			state->matches, FIND_CHUNK, &n);
+		Py_END_ALLOW_THREADS
+		if (status != DISTANCE_OK)
+			return set_error(status);
+		state->n = n;
+		state->pos = 0;
+		if (n == 0)
+			return NULL;
+	}
+	match = &state->matches[state->pos++];
+	if (state->starts)
+		return Py_BuildValue("(nnn)", match->start, match->end, match->dist);
+	return Py_BuildValue("(nn)", match->end, match->dist);
+}
+
+
+PyTypeObject FindApprox_Type = {
+	PyVarObject_HEAD_INIT(&PyType_Type, 0)
+	"distance.find_approx", /* tp_name */
+	sizeof(FindApproxState), /* tp_basicsize */
+	0, /* tp_itemsize */
+	(destructor)find_approx_dealloc, /* tp_dealloc */
+	0, /* tp_print */
+	0, /* tp_getattr */
+	0, /* tp_setattr */
+	0, /* tp_reserved */
+	0, /* tp_repr */
+	0, /* tp_as_number */
+	0, /* tp_as_sequence */
+	0, /* tp_as_mapping */
+	0, /* tp_hash */
+	0, /* tp_call */
+	0, /* tp_str */
+	0, /* tp_getattro */
+	0, /* tp_setattro */
+	0, /* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT, /* tp_flags */
+	find_approx_doc, /* tp_doc */
+	0, /* tp_traverse */
+	0, /* tp_clear */
+	0, /* tp_richcompare */
+	0, /* tp_weaklistoffset */
+	PyObject_SelfIter, /* tp_iter */
+	(iternextfunc)find_approx_next, /* tp_iternext */
+	0, /* tp_methods */
+	0, /* tp_members */
+	0, /* tp_getset */
+	0, /* tp_base */
+	0, /* tp_dict */
+	0, /* tp_descr_get */
+	0, /* tp_descr_set */
+	0, /* tp_dictoffset */
+	0, /* tp_init */
+	PyType_GenericAlloc, /* tp_alloc */
+	find_approx_new, /* tp_new */
+};
+
+
+// Approximate grep (see distance_grep).
+
+/* The text is cut into chunks of `chunk_size` bytes, each holding the lines
+which start in it. As for the iterators, the chunks are searched by batches:
+while the hits of a batch are consumed, the next one is searched by the pool
+of workers, without holding the GIL. With a single worker, the batches hold
+one chunk, which is searched in the calling thread. */
+
+struct grep_chunk {
+	Py_ssize_t from, to;
+	struct distance_line_hit *hits;
+	dist_ssize_t nhits;
+	dist_ssize_t nlines;
+	int status;
+};
+
+struct grep_batch {
+	struct pool_job job;
+	struct grep_state *state;
+	struct grep_chunk *chunks;
+	Py_ssize_t size;		// number of chunks
+	Py_ssize_t pos;			// chunk being consumed
+	Py_ssize_t hit;			// next hit of that chunk
+	int active;				// filled, and not consumed yet
+	int ready;				// searched
+};
+
+typedef struct grep_state {
+	PyObject_HEAD
+	PyObject *source;		// object holding the text, NULL for a file
+	Py_buffer view;
+	struct file_map file;
+	const char *text;
+	Py_ssize_t len;
+	PyObject *patterns;		// tuple of Patterns compiled for levenshtein
+	const struct distance_pattern **pats;
+	int mode;
+	Py_ssize_t max_dist;
+	Py_ssize_t chunk_size;
+	Py_ssize_t next;		// offset of the next chunk to search
+	Py_ssize_t lineno;		// number of the first line of the chunk being consumed
+	int failed;
+	struct pool *pool;
+	struct grep_batch batches[2];
+	int current;
+} GrepState;
+
+
+static void
+grep_run(void *arg, dist_ssize_t i)
+{
+	struct grep_batch *batch = (struct grep_batch *)arg;
+	struct grep_chunk *chunk = &batch->chunks[i];
+	GrepState *state = batch->state;
+
+	chunk->status = distance_grep(state->pats, PyTuple_GET_SIZE(state->patterns), state->mode,
+		state->max_dist, state->text, state->len, chunk->from, chunk->to,
+		&chunk->hits, &chunk->nhits, &chunk->nlines);
+}
+
+
+// Assigns the next chunks of the text to a batch, and has them searched.
+
+static void
+grep_batch_fill(GrepState *state, struct grep_batch *batch)
+{
+	Py_ssize_t i, cap = (state->pool ? 4 * state->pool->nthreads : 1);
+	struct grep_chunk *chunk;
+
+	for (i = 0; i < cap && state->next < state->len; i++) {
+		chunk = &batch->chunks[i];
+		chunk->from = state->next;
+		chunk->to = (state->len - state->next > state->chunk_size ?
+			state->next + state->chunk_size : state->len);
+		chunk->hits = NULL;
+		chunk->nhits = chunk->nlines = 0;
+		state->next = chunk->to;
+	}
+	batch->size = i;
+	batch->pos = batch->hit = 0;
+	batch->active = 1;
+	batch->ready = 0;
+	if (state->pool) {
+		batch->job.run = grep_run;
+		batch->job.arg = batch;
+		batch->job.size = batch->size;
+		batch->job.order = NULL;
+		pool_submit(state->pool, &batch->job);
+		return;
+	}
+	Py_BEGIN_ALLOW_THREADS
+	for (i = 0; i < batch->size; i++)
+		grep_run(batch, i);
+	Py_END_ALLOW_THREADS
+	batch->ready = 1;
+}
+
+
+// Waits for the search of a batch, if needed, and frees its hits.
+
+static void
+grep_batch_release(GrepState *state, struct grep_batch *batch)
+{
+	Py_ssize_t i;
+
+	if (!batch->active)
+		return;
+	if (!batch->ready) {
+		Py_BEGIN_ALLOW_THREADS
+		pool_wait(state->pool, &batch->job, batch->size);
+		Py_END_ALLOW_THREADS
+	}
+	for (i = 0; i < batch->size; i++)
+		free(batch->chunks[i].hits);
+	batch->size = 0;
+	batch->active = 0;
+}
+
+
+// Parses `patterns`, a byte string, a Pattern or a sequence of them.
+
+static int
+grep_patterns(GrepState *state, PyObject *opatterns)
+{
+	PyObject *seq, *pattern;
+	Py_ssize_t n, i;
+
+	if (PyBytes_Check(opatterns) || PATTERN_CHECK(opatterns))
+		seq = PyTuple_Pack(1, opatterns);
+	else
+		seq = PySequence_Fast(opatterns, "expected a byte string or a sequence of byte strings "
+			"as patterns");
+	if (seq == NULL)
+		return 0;
+	n = PySequence_Fast_GET_SIZE(seq);
+	if ((state->patterns = PyTuple_New(n)) == NULL
+		|| (state->pats = (const struct distance_pattern **)malloc((n + 1) * sizeof(void *))) == NULL) {
+		Py_DECREF(seq);
+		if (state->patterns)
+			PyErr_NoMemory();
+		return 0;
+	}
+	for (i = 0; i < n; i++) {
+		pattern = PySequence_Fast_GET_ITEM(seq, i);
+		if (!PyBytes_Check(QUERY(pattern))) {
+			PyErr_SetString(PyExc_ValueError, "expected byte strings as patterns");
+			Py_DECREF(seq);
+			return 0;
+		}
+		if ((pattern = scan_pattern(pattern)) == NULL) {
+			Py_DECREF(seq);
+			return 0;
+		}
+		PyTuple_SET_ITEM(state->patterns, i, pattern);
+		state->pats[i] = COMPILED(pattern);
+	}
+	Py_DECREF(seq);
+	return 1;
+}
+
+
+// Maps the file `source`, or reads the buffer of `source`.
+
+static int
+grep_source(GrepState *state, PyObject *source)
+{
+	PyObject *opath = NULL;
+	const char *path;
+	int status;
+
+#if PY_MAJOR_VERSION >= 3
+	if (PyObject_CheckBuffer(source)) {
+#else
+	if (!PyUnicode_Check(source)) {
+#endif
+		if (PyObject_GetBuffer(source, &state->view, PyBUF_SIMPLE) == -1)
+			return 0;
+		Py_INCREF(source);
+		state->source = source;
+		state->text = (const char *)state->view.buf;
+		state->len = state->view.len;
+		return 1;
+	}
+
+#if PY_MAJOR_VERSION >= 3
+	if (!PyUnicode_FSConverter(source, &opath))
+		return 0;
+#else
+	if ((opath = PyUnicode_AsEncodedString(source, Py_FileSystemDefaultEncoding, NULL)) == NULL)
+		return 0;
+#endif
+	path = PyBytes_AS_STRING(opath);
+	Py_BEGIN_ALLOW_THREADS
+	if ((status = file_map(&state->file, path)) == DISTANCE_OK)
+		file_sequential(&state->file);
+	Py_END_ALLOW_THREADS
+	if (status == DISTANCE_EIO)
+		PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+	else if (status != DISTANCE_OK)
+		set_error(status);
+	Py_DECREF(opath);
+	state->text = (const char *)state->file.data;
+	state->len = state->file.size;
+	return status == DISTANCE_OK;
+}
+
+
+static PyObject *
+grep_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+	GrepState *state;
+	PyObject *source, *opatterns;
+	static char *keywords[] = {"source", "patterns", "max_dist", "mode", "workers",
+		"chunk_size", NULL};
+	const char *mode = "line";
+	Py_ssize_t max_dist, chunk_size = 1 << 20;
+	int workers = 0, i, status;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOn|sin:grep", keywords,
+		&source, &opatterns, &max_dist, &mode, &workers, &chunk_size))
+		return NULL;
+	if (max_dist < 0) {
+		PyErr_SetString(PyExc_ValueError, "expected a positive `max_dist`, or 0");
+		return NULL;
+	}
+	if (strcmp(mode, "line") != 0 && strcmp(mode, "substring") != 0) {
+		PyErr_SetString(PyExc_ValueError, "expected one of line, substring for `mode`");
+		return NULL;
+	}
+	if (workers < 0) {
+		PyErr_SetString(PyExc_ValueError, "expected a positive number of workers, or 0");
+		return NULL;
+	}
+	if (chunk_size < 1) {
+		PyErr_SetString(PyExc_ValueError, "expected a positive `chunk_size`");
+		return NULL;
+	}
+	if ((state = (GrepState *)type->tp_alloc(type, 0)) == NULL)
+		return NULL;
+	state->mode = (mode[0] == 'l' ? DISTANCE_GREP_LINE : DISTANCE_GREP_SUBSTRING);
+	state->max_dist = max_dist;
+	state->chunk_size = chunk_size;
+	if (!grep_patterns(state, opatterns) || !grep_source(state, source))
+		goto On_Error;
+
+	if (workers == 0)
+		workers = pool_cpu_count();
+	// no need for more threads than chunks
+	if (workers > (state->len + chunk_size - 1) / chunk_size)
+		workers = (int)((state->len + chunk_size - 1) / chunk_size);
+	if (workers > 1 && (status = pool_new(&state->pool, workers)) != DISTANCE_OK) {
+		set_error(status);
+		goto On_Error;
+	}
+	for (i = 0; i < 2; i++) {
+		state->batches[i].state = state;
+		state->batches[i].chunks = (struct grep_chunk *)malloc((state->pool ? 4 * workers : 1)
+			* sizeof(struct grep_chunk));
+		if (state->batches[i].chunks == NULL) {
+			PyErr_NoMemory();
+			goto On_Error;
+		}
+	}
+	return (PyObject *)state;
+
+	On_Error:
+		Py_DECREF(state);
+		return NULL;
+}
+
+
+static void
+grep_dealloc(GrepState *state)
+{
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		grep_batch_release(state, &state->batches[i]);
+		free(state->batches[i].chunks);
+	}
+	if (state->pool)
+		pool_free(state->pool);
+	if (state->source) {
+		PyBuffer_Release(&state->view);
+		Py_DECREF(state->source);
+	}
+	else
+		file_unmap(&state->file);
+	free(state->pats);
+	Py_XDECREF(state->patterns);
+	Py_TYPE(state)->tp_free((PyObject *)state);
+}
+
+
+static PyObject *
+grep_next(GrepState *state)
+{
+	struct grep_batch *batch, *other;
+	struct grep_chunk *chunk;
+	struct distance_line_hit *hit;
+
+	if (state->failed)
+		return NULL;
+	for (;;) {
+		batch = &state->batches[state->current];
+		other = &state->batches[!state->current];
+		if (!batch->active) {
+			if (state->next >= state->len)
+				return NULL;
+			grep_batch_fill(state, batch);
+		}
+		// searched while the current batch is consumed
+		if (state->pool && !other->active && state->next < state->len)
+			grep_batch_fill(state, other);
+		if (!batch->ready) {
+			Py_BEGIN_ALLOW_THREADS
+			pool_wait(state->pool, &batch->job, batch->size);
+			Py_END_ALLOW_THREADS
+			batch->ready = 1;
+		}
+
+		while (batch->pos < batch->size) {
+			chunk = &batch->chunks[batch->pos];
+			if (chunk->status != DISTANCE_OK) {
+				state->failed = 1;
+				return set_error(chunk->status);
+			}
+			if (batch->hit < chunk->nhits) {
+				hit = &chunk->hits[batch->hit++];
+				return Py_BuildValue("(nnnN)", state->lineno + hit->line, hit->index, hit->dist,
+					PyBytes_FromStringAndSize(state->text + hit->start, hit->end - hit->start));
+			}
+			state->lineno += chunk->nlines;
+			batch->pos++;
+			batch->hit = 0;
+		}
+		grep_batch_release(state, batch);
+		state->current = !state->current;
+	}
+}
+
+
+PyTypeObject Grep_Type = {
+	PyVarObject_HEAD_INIT(&PyType_Type, 0)
+	"distance.grep", /* tp_name */
+	sizeof(GrepState), /* tp_basicsize */
+	0, /* tp_itemsize */
+	(destructor)grep_dealloc, /* tp_dealloc */
+	0, /* tp_print */
+	0, /* tp_getattr */
+	0, /* tp_setattr */
+	0, /* tp_reserved */
+	0, /* tp_repr */
+	0, /* tp_as_number */
+	0, /* tp_as_sequence */
+	0, /* tp_as_mapping */
+	0, /* tp_hash */
+	0, /* tp_call */
+	0, /* tp_str */
+	0, /* tp_getattro */
+	0, /* tp_setattro */
+	0, /* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT, /* tp_flags */
+	grep_doc, /* tp_doc */
+	0, /* tp_traverse */
+	0, /* tp_clear */
+	0, /* tp_richcompare */
+	0, /* tp_weaklistoffset */
+	PyObject_SelfIter, /* tp_iter */
+	(iternextfunc)grep_next, /* tp_iternext */
+	0, /* tp_methods */
+	0, /* tp_members */
+	0, /* tp_getset */
+	0, /* tp_base */
+	0, /* tp_dict */
+	0, /* tp_descr_get */
+	0, /* tp_descr_set */
+	0, /* tp_dictoffset */
+	0, /* tp_init */
+	PyType_GenericAlloc, /* tp_alloc */
+	grep_new, /* tp_new */
+};
+
+
+// Q-gram profiles (see qgrams.c).
+
+typedef struct {
+	PyObject_HEAD
+	char seqtype;			// 'u', 'b' or 'i'
+	struct distance_profile *profile;
+} QGramProfileObject;
+
+extern PyTypeObject QGramProfile_Type;
+
+#define PROFILE_CHECK(obj) PyObject_TypeCheck((obj), &QGramProfile_Type)
+
+#define PROFILE_DEFAULT_Q 3
+
+
+// Reads `obj`, which must be a string or an array of integers.
+
+static char
+profile_sequence(PyObject *obj, sequence *seq, Py_ssize_t *len)
+{
+	char t;
+	
+	if ((t = get_sequence(obj, seq, len, '\0')) == '\0')
+		return '\0';
+	if (t == 'a') {
+		release_sequence(seq);
+		PyErr_SetString(PyExc_ValueError, "expected a string or an array of integers "
+			"(see Vocabulary)");
+		return '\0';
+	}
+	return t;
+}
+
+
+// Converts the `q` argument, None giving 0.
+
+static int
+get_q(PyObject *oq, int *q)
+{
+	long value;
+	
+	*q = 0;
+	if (oq == NULL || oq == Py_None)
+		return 1;
+	if ((value = PyLong_AsLong(oq)) == -1 && PyErr_Occurred())
+		return 0;
+	if (value < 1 || value > INT_MAX) {
+		PyErr_SetString(PyExc_ValueError, "expected a positive `q`");
+		return 0;
+	}
+	*q = (int)value;
+	return 1;
+}
+
+
+static PyObject *
+profile_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+	QGramProfileObject *self;
+	PyObject *arg, *oq = NULL;
+	static char *keywords[] = {"seq", "q", NULL};
+	sequence seq;
+	Py_ssize_t len;
+	int q, status;
+	
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O:QGramProfile", keywords, &arg, &oq))
+		return NULL;
+	if (!get_q(oq, &q))
+		return NULL;
+	if ((self = (QGramProfileObject *)type->tp_alloc(type, 0)) == NULL)
+		return NULL;
+	if ((self->seqtype = profile_sequence(arg, &seq, &len)) == '\0') {
+		Py_DECREF(self);
+		return NULL;
+	}
+	status = distance_profile_new(seq.items, seq.width, len, (q ? q : PROFILE_DEFAULT_Q),
+		&self->profile);
+	release_sequence(&seq);
+	if (status != DISTANCE_OK) {
+		Py_DECREF(self);
+		return set_error(status);
+	}
+	return (PyObject *)self;
+}
+
+
+static void
+profile_dealloc(QGramProfileObject *self)
+{
+	distance_profile_free(self->profile);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+
+static Py_ssize_t
+profile_length(QGramProfileObject *self)
+{
+	return distance_profile_size(self->profile, NULL);
+}
+
+
+static PyObject *
+profile_get_q(QGramProfileObject *self, void *closure)
+{
+	int q;
+	
+	distance_profile_size(self->profile, &q);
+	return PyLong_FromLong(q);
+}
+
+
+/* Stores the profiles of `arg1` and `arg2` in `p`. The arguments which are not
+profiles already are read with `q`, or, if it is 0, with the `q` of the other
+argument if it is a profile; their profiles are stored in `own`, to be freed
+by the caller. */
+
+static int
+get_profiles(PyObject *arg1, PyObject *arg2, int q, struct distance_profile **p,
+	struct distance_profile **own)
+{
+	PyObject *arg[2] = {arg1, arg2};
+	char types[2];
+	sequence seq;
+	Py_ssize_t len;
+	int i, q1, q2, status;
+	
+	own[0] = own[1] = NULL;
+	if (q == 0) {
+		q = PROFILE_DEFAULT_Q;
+		for (i = 1; i >= 0; i--) {
+			if (PROFILE_CHECK(arg[i]))
+				distance_profile_size(((QGramProfileObject *)arg[i])->profile, &q);
+		}
+	}
+	for (i = 0; i < 2; i++) {
+		if (PROFILE_CHECK(arg[i])) {
+			p[i] = ((QGramProfileObject *)arg[i])->profile;
+			types[i] = ((QGramProfileObject *)arg[i])->seqtype;
+			continue;
+		}
+		if ((types[i] = profile_sequence(arg[i], &seq, &len)) == '\0')
+			goto On_Error;
+		status = distance_profile_new(seq.items, seq.width, len, q, &own[i]);
+		release_sequence(&seq);
+		if (status != DISTANCE_OK) {
+			set_error(status);
+			goto On_Error;
+		}
+		p[i] = own[i];
+	}
+	
+	distance_profile_size(p[0], &q1);
+	distance_profile_size(p[1], &q2);
+	if (types[0] != types[1]) {
+		PyErr_SetString(PyExc_ValueError, "expected two sequences of the same type");
+		goto On_Error;
+	}
+	if (q1 != q2) {
+		PyErr_SetString(PyExc_ValueError, "expected profiles with the same `q`");
+		goto On_Error;
+	}
+	return 1;
+	
+	On_Error:
+		distance_profile_free(own[0]);
+		distance_profile_free(own[1]);
+		return 0;
+}
+
+
+static PyObject *
+qgram_distance_py(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	PyObject *arg1, *arg2, *oq = NULL;
+	static char *keywords[] = {"seq1", "seq2", "q", NULL};
+	struct distance_profile *p[2], *own[2];
+	dist_ssize_t dist;
+	int q;
+	
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|O:qgram_distance", keywords,
+		&arg1, &arg2, &oq))
+		return NULL;
+	if (!get_q(oq, &q) || !get_profiles(arg1, arg2, q, p, own))
+		return NULL;
+	distance_qgram_distance(p[0], p[1], &dist);
+	distance_profile_free(own[0]);
+	distance_profile_free(own[1]);
+	return PyLong_FromSsize_t(dist);
+}
+
+
+static PyObject *
+cosine_py(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	PyObject *arg1, *arg2, *oq = NULL;
+	static char *keywords[] = {"seq1", "seq2", "q", NULL};
+	struct distance_profile *p[2], *own[2];
+	double dist;
+	int q;
+	
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|O:cosine", keywords,
+		&arg1, &arg2, &oq))
+		return NULL;
+	if (!get_q(oq, &q) || !get_profiles(arg1, arg2, q, p, own))
+		return NULL;
+	distance_cosine(p[0], p[1], &dist);
+	distance_profile_free(own[0]);
+	distance_profile_free(own[1]);
+	return PyFloat_FromDouble(dist);
+}
+
+
+static PyObject *
+overlap_py(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	PyObject *arg1, *arg2, *oq = NULL;
+	static char *keywords[] = {"seq1", "seq2", "q", NULL};
+	struct distance_profile *p[2], *own[2];
+	double dist;
+	int q;
+	
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|O:overlap", keywords,
+		&arg1, &arg2, &oq))
+		return NULL;
+	if (!get_q(oq, &q) || !get_profiles(arg1, arg2, q, p, own))
+		return NULL;
+	distance_overlap(p[0], p[1], &dist);
+	distance_profile_free(own[0]);
+	distance_profile_free(own[1]);
+	return PyFloat_FromDouble(dist);
+}
+
+
+static PySequenceMethods profile_as_sequence = {
+	(lenfunc)profile_length, /* sq_length */
+};
+
+
+static PyGetSetDef profile_getset[] = {
+	{"q", (getter)profile_get_q, NULL, "the length of the q-grams", NULL},
+	{NULL, NULL, NULL, NULL, NULL}
+};
+
+
+PyTypeObject QGramProfile_Type = {
+	PyVarObject_HEAD_INIT(&PyType_Type, 0)
+	"distance.QGramProfile", /* tp_name */
+	sizeof(QGramProfileObject), /* tp_basicsize */
+	0, /* tp_itemsize */
+	(destructor)profile_dealloc, /* tp_dealloc */
+	0, /* tp_print */
+	0, /* tp_getattr */
+	0, /* tp_setattr */
+	0, /* tp_reserved */
+	0, /* tp_repr */
+	0, /* tp_as_number */
+	&profile_as_sequence, /* tp_as_sequence */
+	0, /* tp_as_mapping */
+	0, /* tp_hash */
+	0, /* tp_call */
+	0, /* tp_str */
+	0, /* tp_getattro */
+	0, /* tp_setattro */
+	0, /* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT, /* tp_flags */
+	QGramProfile_doc, /* tp_doc */
+	0, /* tp_traverse */
+	0, /* tp_clear */
+	0, /* tp_richcompare */
+	0, /* tp_weaklistoffset */
+	0, /* tp_iter */
+	0, /* tp_iternext */
+	0, /* tp_methods */
+	0, /* tp_members */
+	profile_getset, /* tp_getset */
+	0, /* tp_base */
+	0, /* tp_dict */
+	0, /* tp_descr_get */
+	0, /* tp_descr_set */
+	0, /* tp_dictoffset */
+	0, /* tp_init */
+	PyType_GenericAlloc, /* tp_alloc */
+	profile_new, /* tp_new */
+};
+
+
+// Similarity joins (see setjoin.c).
+
+/* The sets of a collection, as token ids, one set after the other (see
+distance_jaccard_join). */
+
+struct join_sets {
+	uint32_t *tokens;
+	dist_ssize_t *offsets;
+	Py_ssize_t nsets, len, alloc;
+};
+
+
+static int
+join_reserve(struct join_sets *js, Py_ssize_t n)
+{
+	uint32_t *tmp;
+	
+	if (js->tokens != NULL && js->len + n <= js->alloc)
+		return 1;
+	js->alloc = (js->len + n > 2 * js->alloc ? js->len + n : 2 * js->alloc);
+	if ((tmp = (uint32_t *)PyMem_Realloc(js->tokens, (js->alloc + 1) * sizeof(uint32_t))) == NULL) {
+		PyErr_NoMemory();
+		return 0;
+	}
+	js->tokens = tmp;
+	return 1;
+}
+
+
+static void
+join_release(struct join_sets *js)
+{
+	PyMem_Free(js->tokens);
+	PyMem_Free(js->offsets);
+	js->tokens = NULL;
+	js->offsets = NULL;
+	js->len = js->alloc = 0;
+}
+
+
+/* Arrays of integers, e.g. sets encoded with a `Vocabulary`, are taken as
+token ids as is. Returns 0, without error, if one of the sets isn't such an
+array, and stores the highest id in `max_id`. */
+
+static int
+join_ints(PyObject *seq, struct join_sets *js, uint32_t *max_id)
+{
+	sequence set;
+	Py_ssize_t i, k, len;
+	uint32_t id;
+	
+	for (i = 0; i < js->nsets; i++) {
+		js->offsets[i] = js->len;
+		if (!get_ints(PySequence_Fast_GET_ITEM(seq, i), &set, &len))
+			return 0;
+		if (!join_reserve(js, len)) {
+			PyBuffer_Release(&set.view);
+			return -1;
+		}
+		for (k = 0; k < len; k++) {
+			id = (set.width == 1 ? ((uint8_t *)set.items)[k] : set.width == 2
+				? ((uint16_t *)set.items)[k] : ((uint32_t *)set.items)[k]);
+			js->tokens[js->len++] = id;
+			if (id > *max_id)
+				*max_id = id;
+		}
+		PyBuffer_Release(&set.view);
+	}
+	js->offsets[js->nsets] = js->len;
+	return 1;
+}
+
+
+// Other sets are iterated, and their tokens added to `vocab`.
+
+static int
+join_tokens(PyObject *seq, struct join_sets *js, VocabularyObject *vocab)
+{
+	PyObject *itor, *token;
+	Py_ssize_t i, id;
+	
+	js->len = 0;
+	for (i = 0; i < js->nsets; i++) {
+		js->offsets[i] = js->len;
+		if ((itor = PyObject_GetIter(PySequence_Fast_GET_ITEM(seq, i))) == NULL)
+			return 0;
+		while ((token = PyIter_Next(itor)) != NULL) {
+			id = vocab_id(vocab, token, 1);
+			Py_DECREF(token);
+			if (id == -1 || !join_reserve(js, 1))
+				break;
+			js->tokens[js->len++] = (uint32_t)id;
+		}
+		Py_DECREF(itor);
+		if (PyErr_Occurred())
+			return 0;
+	}
+	js->offsets[js->nsets] = js->len;
+	return 1;
+}
+
+
+// The pairs are returned as three arrays: the indexes of the sets, and their
+// distances.
+
+static PyObject *
+join_result(struct distance_join_pair *pairs, Py_ssize_t npairs)
+{
+	int64_t *left, *right;
+	double *dists;
+	PyObject *rv = NULL;
+	Py_ssize_t k;
+	
+	left = (int64_t *)PyMem_Malloc((npairs + 1) * sizeof(int64_t));
+	right = (int64_t *)PyMem_Malloc((npairs + 1) * sizeof(int64_t));
+	dists = (double *)PyMem_Malloc((npairs + 1) * sizeof(double));
+	if (left == NULL || right == NULL || dists == NULL) {
+		PyErr_NoMemory();
+		goto On_Exit;
+	}
+	for (k = 0; k < npairs; k++) {
+		left[k] = pairs[k].i;
+		right[k] = pairs[k].j;
+		dists[k] = pairs[k].dist;
+	}
+	rv = Py_BuildValue("(NNN)", new_array("q", left, npairs * sizeof(int64_t)),
+		new_array("q", right, npairs * sizeof(int64_t)),
+		new_array("d", dists, npairs * sizeof(double)));
+	
+	On_Exit:
+		PyMem_Free(left);
+		PyMem_Free(right);
+		PyMem_Free(dists);
+		return rv;
+}
+
+
+static PyObject *
+jaccard_join_py(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	PyObject *arg1, *arg2 = Py_None, *seqs[2] = {NULL, NULL}, *rv = NULL;
+	static char *keywords[] = {"sets", "threshold", "others", "workers", NULL};
+	double threshold;
+	int workers = 1, n, k, ints = 1, status;
+	
+	struct join_sets js[2];
+	VocabularyObject *vocab = NULL;
+	PyObject *empty;
+	uint32_t max_id = 0;
+	Py_ssize_t ntokens;
+	struct distance_join_pair *pairs;
+	dist_ssize_t npairs;
+	
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Od|Oi:jaccard_join", keywords,
+		&arg1, &threshold, &arg2, &workers))
+		return NULL;
+	if (!(threshold >= 0 && threshold < 1)) {
+		PyErr_SetString(PyExc_ValueError, "expected a threshold between 0 and 1, 1 excluded");
+		return NULL;
+	}
+	if ((workers = get_workers(workers)) == -1)
+		return NULL;
+	
+	memset(js, 0, sizeof(js));
+	n = (arg2 == Py_None ? 1 : 2);
+	for (k = 0; k < n; k++) {
+		if ((seqs[k] = PySequence_Fast(k ? arg2 : arg1, "expected a sequence of sets")) == NULL)
+			goto On_Exit;
+		js[k].nsets = PySequence_Fast_GET_SIZE(seqs[k]);
+		if ((js[k].offsets = (dist_ssize_t *)PyMem_Malloc((js[k].nsets + 1) * sizeof(dist_ssize_t))) == NULL) {
+			PyErr_NoMemory();
+			goto On_Exit;
+		}
+		if (!join_reserve(&js[k], 0))
+			goto On_Exit;
+	}
+	
+	/* the ids of arrays are used as is unless they are too sparse, the
+	postings of the join being indexed by id */
+	for (k = 0; k < n && ints == 1; k++)
+		ints = join_ints(seqs[k], &js[k], &max_id);
+	if (ints == -1)
+		goto On_Exit;
+	ntokens = (Py_ssize_t)max_id + 1;
+	if (ints == 0 || ntokens > 2 * (js[0].len + js[1].len) + 0x10000) {
+		if ((empty = PyTuple_New(0)) == NULL)
+			goto On_Exit;
+		vocab = (VocabularyObject *)vocab_new(&Vocabulary_Type, empty, NULL);
+		Py_DECREF(empty);
+		if (vocab == NULL)
+			goto On_Exit;
+		for (k = 0; k < n; k++) {
+			if (!join_tokens(seqs[k], &js[k], vocab))
+				goto On_Exit;
+		}
+		ntokens = PyList_GET_SIZE(vocab->tokens);
+	}
+	
+	Py_BEGIN_ALLOW_THREADS
+	status = distance_jaccard_join(js[0].tokens, js[0].offsets, js[0].nsets,
+		(n == 2 ? js[1].tokens : NULL), js[1].offsets, js[1].nsets, ntokens, threshold,
+		workers, &pairs, &npairs);
+	Py_END_ALLOW_THREADS
+	if (status != DISTANCE_OK) {
+		set_error(status);
+		goto On_Exit;
+	}
+	rv = join_result(pairs, npairs);
+	distance_free(pairs);
+	
+	On_Exit:
+		for (k = 0; k < 2; k++) {
+			join_release(&js[k]);
+			Py_XDECREF(seqs[k]);
+		}
+		Py_XDECREF(vocab);
+		return rv;
+}
+
+
+// Set indexes (see setindex.c).
+
+typedef struct {
+	PyObject_HEAD
+	struct distance_set_index *idx;
+	VocabularyObject *vocab;	// ids of the tokens of the sets
+	int searches;				// searches running without the GIL
+} SetIndexObject;
+
+
+/* Ids of the tokens of a set. Tokens are added to the vocabulary if `unknown`
+is NULL; otherwise, those which aren't in it are added to `unknown`, a set,
+instead. */
+
+static int
+set_index_ids(SetIndexObject *self, PyObject *obj, PyObject *unknown,
+	uint32_t **ids, Py_ssize_t *len)
+{
+	PyObject *itor, *token;
+	Py_ssize_t id, cap = 16;
+	uint32_t *tmp;
+	int added;
+	
+	if ((itor = PyObject_GetIter(QUERY(obj))) == NULL)
+		return 0;
+	if ((*ids = (uint32_t *)PyMem_Malloc(cap * sizeof(uint32_t))) == NULL) {
+		Py_DECREF(itor);
+		PyErr_NoMemory();
+		return 0;
+	}
+	*len = 0;
+	while ((token = PyIter_Next(itor)) != NULL) {
+		id = vocab_id(self->vocab, token, unknown == NULL);
+		if (id == -1 && unknown != NULL && PyErr_ExceptionMatches(PyExc_KeyError)) {
+			PyErr_Clear();
+			added = PySet_Add(unknown, token);
+			Py_DECREF(token);
+			if (added == -1)
+				break;
+			continue;
+		}
+		Py_DECREF(token);
+		if (id == -1)
+			break;
+		if (*len == cap) {
+			if ((tmp = (uint32_t *)PyMem_Realloc(*ids, 2 * cap * sizeof(uint32_t))) == NULL) {
+				PyErr_NoMemory();
+				break;
+			}
+			*ids = tmp;
+			cap *= 2;
+		}
+		(*ids)[(*len)++] = (uint32_t)id;
+	}
+	Py_DECREF(itor);
+	if (PyErr_Occurred()) {
+		PyMem_Free(*ids);
+		return 0;
+	}
+	return 1;
+}
+
+
+static PyObject *
+set_index_add_py(SetIndexObject *self, PyObject *obj)
+{
+	uint32_t *ids;
+	Py_ssize_t len;
+	int status;
+	
+	if (self->searches) {
+		PyErr_SetString(PyExc_ValueError, "can't add to a set index while it is searched");
+		return NULL;
+	}
+	if (!set_index_ids(self, obj, NULL, &ids, &len))
+		return NULL;
+	status = distance_set_index_add(self->idx, ids, len);
+	PyMem_Free(ids);
+	if (status != DISTANCE_OK)
+		return set_error(status);
+	Py_RETURN_NONE;
+}
+
+
+static PyObject *
+set_index_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+	SetIndexObject *self;
+	PyObject *arg = NULL, *itor, *obj, *rv, *empty;
+	static char *keywords[] = {"sets", NULL};
+	int status;
+	
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O:SetIndex", keywords, &arg))
+		return NULL;
+	if ((self = (SetIndexObject *)type->tp_alloc(type, 0)) == NULL)
+		return NULL;
+	if ((status = distance_set_index_new(&self->idx)) != DISTANCE_OK) {
+		set_error(status);
+		goto On_Error;
+	}
+	if ((empty = PyTuple_New(0)) == NULL)
+		goto On_Error;
+	self->vocab = (VocabularyObject *)vocab_new(&Vocabulary_Type, empty, NULL);
+	Py_DECREF(empty);
+	if (self->vocab == NULL)
+		goto On_Error;
+	if (arg == NULL)
+		return (PyObject *)self;
+	
+	if ((itor = PyObject_GetIter(arg)) == NULL)
+		goto On_Error;
+	while ((obj = PyIter_Next(itor)) != NULL) {
+		rv = set_index_add_py(self, obj);
+		Py_DECREF(obj);
+		if (rv == NULL)
+			break;
+		Py_DECREF(rv);
+	}
+	Py_DECREF(itor);
+	if (PyErr_Occurred())
+		goto On_Error;
+	return (PyObject *)self;
+	
+	On_Error:
+		Py_DECREF(self);
+		return NULL;
+}
+
+
+static void
+set_index_dealloc(SetIndexObject *self)
+{
+	distance_set_index_free(self->idx);
+	Py_XDECREF(self->vocab);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+
+static Py_ssize_t
+set_index_length(SetIndexObject *self)
+{
+	return distance_set_index_size(self->idx);
+}
+
+
+// Names of the metrics of `topk`, in the order of `enum distance_set_metric`.
+
+static const char *set_metrics[] = {"jaccard", "sorensen"};
+
+
+static PyObject *
+set_index_topk_py(SetIndexObject *self, PyObject *args, PyObject *kwargs)
+{
+	PyObject *arg, *unknown, *rv = NULL, *hit;
+	const char *metric_name = "jaccard";
+	Py_ssize_t k, len, nhits = 0, i;
+	double min_sim = 0.0;
+	static char *keywords[] = {"query", "k", "metric", "min_sim", NULL};
+	struct distance_set_hit *hits = NULL;
+	uint32_t *ids;
+	int metric, status;
+	
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "On|sd:topk", keywords,
+		&arg, &k, &metric_name, &min_sim))
+		return NULL;
+	for (metric = 0; metric < 2 && strcmp(metric_name, set_metrics[metric]) != 0; metric++)
+		;
+	if (metric == 2) {
+		PyErr_SetString(PyExc_ValueError, "expected one of jaccard, sorensen for `metric`");
+		return NULL;
+	}
+	if (k < 0) {
+		PyErr_SetString(PyExc_ValueError, "expected a positive `k`, or 0");
+		return NULL;
+	}
+	if (!(min_sim >= 0 && min_sim <= 1)) {
+		PyErr_SetString(PyExc_ValueError, "expected a value between 0 and 1 for `min_sim`");
+		return NULL;
+	}
+	if ((unknown = PySet_New(NULL)) == NULL)
+		return NULL;
+	if (!set_index_ids(self, arg, unknown, &ids, &len)) {
+		Py_DECREF(unknown);
+		return NULL;
+	}
+	
+	self->searches++;
+	Py_BEGIN_ALLOW_THREADS
+	status = distance_set_index_topk(self->idx, ids, len, PySet_GET_SIZE(unknown), metric, k,
+		min_sim, &hits, &nhits);
+	Py_END_ALLOW_THREADS
+	self->searches--;
+	PyMem_Free(ids);
+	Py_DECREF(unknown);
+	if (status != DISTANCE_OK)
+		return set_error(status);
+	
+	if ((rv = PyList_New(nhits)) == NULL)
+		goto On_Error;
+	for (i = 0; i < nhits; i++) {
+		if ((hit = Py_BuildValue("(dn)", hits[i].dist, hits[i].index)) == NULL)
+			goto On_Error;
+		PyList_SET_ITEM(rv, i, hit);
+	}
+	distance_free(hits);
+	return rv;
+	
+	On_Error:
+		Py_XDECREF(rv);
+		distance_free(hits);
+		return NULL;
+}
+
+
+static PySequenceMethods set_index_as_sequence = {
+	(lenfunc)set_index_length, /* sq_length */
+};
+
+
+static PyMethodDef set_index_methods[] = {
+	{"add", (PyCFunction)set_index_add_py, METH_O, SetIndex_add_doc},
+	{"topk", (PyCFunction)set_index_topk_py, METH_VARARGS | METH_KEYWORDS, SetIndex_topk_doc},
+	{NULL, NULL, 0, NULL}
+};
+
+
+PyTypeObject SetIndex_Type = {
+	PyVarObject_HEAD_INIT(&PyType_Type, 0)
+	"distance.SetIndex", /* tp_name */
+	sizeof(SetIndexObject), /* tp_basicsize */
+	0, /* tp_itemsize */
+	(destructor)set_index_dealloc, /* tp_dealloc */
+	0, /* tp_print */
+	0, /* tp_getattr */
+	0, /* tp_setattr */
+	0, /* tp_reserved */
+	0, /* tp_repr */
+	0, /* tp_as_number */
+	&set_index_as_sequence, /* tp_as_sequence */
+	0, /* tp_as_mapping */
+	0, /* tp_hash */
+	0, /* tp_call */
+	0, /* tp_str */
+	0, /* tp_getattro */
+	0, /* tp_setattro */
+	0, /* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT, /* tp_flags */
+	SetIndex_doc, /* tp_doc */
+	0, /* tp_traverse */
+	0, /* tp_clear */
+	0, /* tp_richcompare */
+	0, /* tp_weaklistoffset */
+	0, /* tp_iter */
+	0, /* tp_iternext */
+	set_index_methods, /* tp_methods */
+	0, /* tp_members */
+	0, /* tp_getset */
+	0, /* tp_base */
+	0, /* tp_dict */
+	0, /* tp_descr_get */
+	0, /* tp_descr_set */
+	0, /* tp_dictoffset */
+	0, /* tp_init */
+	PyType_GenericAlloc, /* tp_alloc */
+	set_index_new, /* tp_new */
+};
+
+
+// Packed nucleotide sequences (see dna.c).
+
+static PyObject *
+dna_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+	PackedDNAObject *self;
+	PyObject *arg;
+	static char *keywords[] = {"seq", NULL};
+	
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O:PackedDNA", keywords, &arg))
+		return NULL;
+	// packed sequences can't change
+	if (Py_TYPE(arg) == type) {
+		Py_INCREF(arg);
+		return arg;
+	}
+	if ((self = (PackedDNAObject *)type->tp_alloc(type, 0)) == NULL)
+		return NULL;
+	if (!dna_pack_object(arg, &self->dna)) {
+		Py_DECREF(self);
+		return NULL;
+	}
+	return (PyObject *)self;
+}
+
+
+static void
+dna_dealloc(PackedDNAObject *self)
+{
+	distance_dna_release(&self->dna);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+
+static Py_ssize_t
+dna_length(PackedDNAObject *self)
+{
+	return self->dna.len;
+}
+
+
+static PyObject *
+dna_str(PackedDNAObject *self)
+{
+	PyObject *rv;
+	uint8_t *bases;
+	
+	if ((bases = (uint8_t *)PyMem_Malloc(self->dna.len + 1)) == NULL)
+		return PyErr_NoMemory();
+	distance_dna_unpack(&self->dna, bases);
+	rv = PyUnicode_FromKindAndData(PyUnicode_1BYTE_KIND, bases, self->dna.len);
+	PyMem_Free(bases);
+	return rv;
+}
+
+
+static PyObject *
+dna_repr(PackedDNAObject *self)
+{
+	PyObject *str, *rv;
+	
+	if ((str = dna_str(self)) == NULL)
+		return NULL;
+	rv = PyUnicode_FromFormat("PackedDNA(%R)", str);
+	Py_DECREF(str);
+	return rv;
+}
+
+
+static PyObject *
+dna_reduce(PackedDNAObject *self)
+{
+	PyObject *str, *rv;
+	
+	if ((str = dna_str(self)) == NULL)
+		return NULL;
+	rv = Py_BuildValue("O(O)", Py_TYPE(self), str);
+	Py_DECREF(str);
+	return rv;
+}
+
+
+static PySequenceMethods dna_as_sequence = {
+	(lenfunc)dna_length, /* sq_length */
+};
+
+
+static PyMethodDef dna_methods[] = {
+	{"__reduce__", (PyCFunction)dna_reduce, METH_NOARGS, NULL},
+	{NULL, NULL, 0, NULL}
+};
+
+
+PyTypeObject PackedDNA_Type = {
+	PyVarObject_HEAD_INIT(&PyType_Type, 0)
+	"distance.PackedDNA", /* tp_name */
+	sizeof(PackedDNAObject), /* tp_basicsize */
+	0, /* tp_itemsize */
+	(destructor)dna_dealloc, /* tp_dealloc */
+	0, /* tp_print */
+	0, /* tp_getattr */
+	0, /* tp_setattr */
+	0, /* tp_reserved */
+	(reprfunc)dna_repr, /* tp_repr */
+	0, /* tp_as_number */
+	&dna_as_sequence, /* tp_as_sequence */
+	0, /* tp_as_mapping */
+	0, /* tp_hash */
+	0, /* tp_call */
+	(reprfunc)dna_str, /* tp_str */
+	0, /* tp_getattro */
+	0, /* tp_setattro */
+	0, /* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT, /* tp_flags */
+	PackedDNA_doc, /* tp_doc */
+	0, /* tp_traverse */
+	0, /* tp_clear */
+	0, /* tp_richcompare */
+	0, /* tp_weaklistoffset */
+	0, /* tp_iter */
+	0, /* tp_iternext */
+	dna_methods, /* tp_methods */
+	0, /* tp_members */
+	0, /* tp_getset */
+	0, /* tp_base */
+	0, /* tp_dict */
+	0, /* tp_descr_get */
+	0, /* tp_descr_set */
+	0, /* tp_dictoffset */
+	0, /* tp_init */
+	PyType_GenericAlloc, /* tp_alloc */
+	dna_new, /* tp_new */
+};
+
+
+// Barcode sets (see distance_barcodes_assign).
+
+typedef struct {
+	PyObject_HEAD
+	struct distance_barcodes *bs;
+} BarcodeSetObject;
+
+
+/* Packs the sequences of `seqs`, which is a list or a tuple. The PackedDNA
+are read in place, and the strings packed; `owned` flags the latter, which
+`release_dna` releases. */
+
+static int
+get_dna_list(PyObject *seqs, struct distance_dna **dna, char **owned)
+{
+	PyObject *obj;
+	Py_ssize_t i, n = PySequence_Fast_GET_SIZE(seqs);
+	
+	*dna = (struct distance_dna *)PyMem_Malloc((n ? n : 1) * sizeof(struct distance_dna));
+	*owned = (char *)PyMem_Malloc(n ? n : 1);
+	if (*dna == NULL || *owned == NULL) {
+		PyMem_Free(*dna);
+		PyMem_Free(*owned);
+		PyErr_NoMemory();
+		return 0;
+	}
+	for (i = 0; i < n; i++) {
+		obj = PySequence_Fast_GET_ITEM(seqs, i);
+		if (((*owned)[i] = !DNA_CHECK(obj)) == 0)
+			(*dna)[i] = ((PackedDNAObject *)obj)->dna;
+		else if (!dna_pack_object(obj, &(*dna)[i])) {
+			n = i;
+			for (i = 0; i < n; i++) {
+				if ((*owned)[i])
+					distance_dna_release(&(*dna)[i]);
+			}
+			PyMem_Free(*dna);
+			PyMem_Free(*owned);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+
+static void
+release_dna(struct distance_dna *dna, char *owned, Py_ssize_t n)
+{
+	Py_ssize_t i;
+	
+	for (i = 0; i < n; i++) {
+		if (owned[i])
+			distance_dna_release(&dna[i]);
+	}
+	PyMem_Free(dna);
+	PyMem_Free(owned);
+}
+
+
+static PyObject *
+barcodes_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+	BarcodeSetObject *self;
+	PyObject *arg, *seqs;
+	struct distance_dna *dna;
+	static char *keywords[] = {"barcodes", NULL};
+	char *owned;
+	int status;
+	
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O:BarcodeSet", keywords, &arg))
+		return NULL;
+	if ((seqs = PySequence_Fast(arg, "expected a sequence of barcodes")) == NULL)
+		return NULL;
+	if (!get_dna_list(seqs, &dna, &owned)) {
+		Py_DECREF(seqs);
+		return NULL;
+	}
+	if ((self = (BarcodeSetObject *)type->tp_alloc(type, 0)) != NULL) {
+		status = distance_barcodes_new(dna, PySequence_Fast_GET_SIZE(seqs), &self->bs);
+		if (status != DISTANCE_OK) {
+			Py_DECREF(self);
+			self = (BarcodeSetObject *)set_error(status);
+		}
+	}
+	release_dna(dna, owned, PySequence_Fast_GET_SIZE(seqs));
+	Py_DECREF(seqs);
+	return (PyObject *)self;
+}
+
+
+static void
+barcodes_dealloc(BarcodeSetObject *self)
+{
+	distance_barcodes_free(self->bs);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+
+static Py_ssize_t
+barcodes_length(BarcodeSetObject *self)
+{
+	return distance_barcodes_size(self->bs);
+}
+
+
+static PyObject *
+barcodes_assign_py(BarcodeSetObject *self, PyObject *args, PyObject *kwargs)
+{
+	PyObject *arg, *seqs, *oindex = NULL, *odist = NULL, *rv = NULL;
+	const char *metric_name = "hamming";
+	Py_ssize_t max_dist = 1, nreads, *index = NULL, *dist = NULL;
+	static char *keywords[] = {"reads", "max_dist", "metric", "workers", NULL};
+	struct distance_dna *reads;
+	char *owned;
+	int metric, workers = 1, status;
+	
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|nsi:assign", keywords,
+		&arg, &max_dist, &metric_name, &workers))
+		return NULL;
+	if (strcmp(metric_name, "hamming") == 0)
+		metric = DISTANCE_METRIC_HAMMING;
+	else if (strcmp(metric_name, "levenshtein") == 0)
+		metric = DISTANCE_METRIC_LEVENSHTEIN;
+	else {
+		PyErr_SetString(PyExc_ValueError, "expected one of hamming, levenshtein for `metric`");
+		return NULL;
+	}
+	if ((workers = get_workers(workers)) == -1)
+		return NULL;
+	if ((seqs = PySequence_Fast(arg, "expected a sequence of reads")) == NULL)
+		return NULL;
+	if (!get_dna_list(seqs, &reads, &owned)) {
+		Py_DECREF(seqs);
+		return NULL;
+	}
+	nreads = PySequence_Fast_GET_SIZE(seqs);
+	index = (Py_ssize_t *)PyMem_Malloc((nreads ? nreads : 1) * sizeof(Py_ssize_t));
+	dist = (Py_ssize_t *)PyMem_Malloc((nreads ? nreads : 1) * sizeof(Py_ssize_t));
+	if (index == NULL || dist == NULL) {
+		PyErr_NoMemory();
+		goto Done;
+	}
+	
+	// the PackedDNA read in place are kept alive by `seqs`
+	Py_BEGIN_ALLOW_THREADS
+	status = distance_barcodes_assign(self->bs, reads, nreads, metric, max_dist, workers,
+		index, dist);
+	Py_END_ALLOW_THREADS
+	if (status != DISTANCE_OK) {
+		set_error(status);
+		goto Done;
+	}
+	if ((oindex = new_array("q", index, nreads * sizeof(Py_ssize_t))) != NULL
+		&& (odist = new_array("q", dist, nreads * sizeof(Py_ssize_t))) != NULL)
+		rv = PyTuple_Pack(2, oindex, odist);
+	Py_XDECREF(oindex);
+	Py_XDECREF(odist);
+	
+	Done:
+		release_dna(reads, owned, nreads);
+		Py_DECREF(seqs);
+		PyMem_Free(index);
+		PyMem_Free(dist);
+		return rv;
+}
+
+
+static PySequenceMethods barcodes_as_sequence = {
+	(lenfunc)barcodes_length, /* sq_length */
+};
+
+
+static PyMethodDef barcodes_methods[] = {
+	{"assign", (PyCFunction)barcodes_assign_py, METH_VARARGS | METH_KEYWORDS, BarcodeSet_assign_doc},
+	{NULL, NULL, 0, NULL}
+};
+
+
+PyTypeObject BarcodeSet_Type = {
+	PyVarObject_HEAD_INIT(&PyType_Type, 0)
+	"distance.BarcodeSet", /* tp_name */
+	sizeof(BarcodeSetObject), /* tp_basicsize */
+	0, /* tp_itemsize */
+	(destructor)barcodes_dealloc, /* tp_dealloc */
+	0, /* tp_print */
+	0, /* tp_getattr */
+	0, /* tp_setattr */
+	0, /* tp_reserved */
+	0, /* tp_repr */
+	0, /* tp_as_number */
+	&barcodes_as_sequence, /* tp_as_sequence */
+	0, /* tp_as_mapping */
+	0, /* tp_hash */
+	0, /* tp_call */
+	0, /* tp_str */
+	0, /* tp_getattro */
+	0, /* tp_setattro */
+	0, /* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT, /* tp_flags */
+	BarcodeSet_doc, /* tp_doc */
+	0, /* tp_traverse */
+	0, /* tp_clear */
+	0, /* tp_richcompare */
+	0, /* tp_weaklistoffset */
+	0, /* tp_iter */
+	0, /* tp_iternext */
+	barcodes_methods, /* tp_methods */
+	0, /* tp_members */
+	0, /* tp_getset */
+	0, /* tp_base */
+	0, /* tp_dict */
+	0, /* tp_descr_get */
+	0, /* tp_descr_set */
+	0, /* tp_dictoffset */
+	0, /* tp_init */
+	PyType_GenericAlloc, /* tp_alloc */
+	barcodes_new, /* tp_new */
+};
+
+
+// DAWGs (see dawg.c).
+
+typedef struct {
+	PyObject_HEAD
+	struct distance_dawg *dawg;
+	uint32_t *word;			// room for the longest word
+	int searches;			// searches running without the GIL
+} DawgObject;
+
+
+static PyObject *
+dawg_closed(void)
+{
+	PyErr_SetString(PyExc_ValueError, "operation on a closed dawg");
+	return NULL;
+}
+
+
+static PyObject *
+dawg_word(DawgObject *self, Py_ssize_t rank)
+{
+	dist_ssize_t len;
+	int status;
+#if PY_VERSION_HEX < 0x03030000
+	int byteorder = -1;
+#endif
+	
+	if ((status = distance_dawg_word(self->dawg, rank, self->word, &len)) != DISTANCE_OK)
+		return set_error(status);
+#if PY_VERSION_HEX >= 0x03030000
+	return PyUnicode_FromKindAndData(PyUnicode_4BYTE_KIND, self->word, len);
+#else
+	return PyUnicode_DecodeUTF32((const char *)self->word, 4 * len, NULL, &byteorder);
+#endif
+}
+
+
+static PyObject *
+dawg_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+	DawgObject *self;
+	struct distance_dawg *dawg = NULL;
+	static char *keywords[] = {"path", NULL};
+	const char *path;
+	int status;
+#if PY_MAJOR_VERSION >= 3
+	PyObject *opath;
+	
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O&:Dawg", keywords,
+		PyUnicode_FSConverter, &opath))
+		return NULL;
+	path = PyBytes_AS_STRING(opath);
+#else
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s:Dawg", keywords, &path))
+		return NULL;
+#endif
+	
+	Py_BEGIN_ALLOW_THREADS
+	status = distance_dawg_open(path, &dawg);
+	Py_END_ALLOW_THREADS
+	if (status == DISTANCE_EIO)
+		PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+	else if (status != DISTANCE_OK)
+		set_error(status);
+#if PY_MAJOR_VERSION >= 3
+	Py_DECREF(opath);
+#endif
+	if (status != DISTANCE_OK)
+		return NULL;
+	
+	if ((self = (DawgObject *)type->tp_alloc(type, 0)) == NULL) {
+		distance_dawg_close(dawg);
+		return NULL;
+	}
+	self->dawg = dawg;
+	self->word = (uint32_t *)PyMem_Malloc((distance_dawg_max_len(dawg) + 1) * sizeof(uint32_t));
+	if (self->word == NULL) {
+		Py_DECREF(self);
+		return PyErr_NoMemory();
+	}
+	return (PyObject *)self;
+}
+
+
+static void
+dawg_dealloc(DawgObject *self)
+{
+	distance_dawg_close(self->dawg);
+	PyMem_Free(self->word);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+
+static PyObject *
+dawg_open_py(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+	return dawg_new(type, args, kwargs);
+}
+
+
+static PyObject *
+dawg_close_py(DawgObject *self)
+{
+	if (self->searches) {
+		PyErr_SetString(PyExc_ValueError, "can't close a dawg while it is searched");
+		return NULL;
+	}
+	distance_dawg_close(self->dawg);
+	self->dawg = NULL;
+	Py_RETURN_NONE;
+}
+
+
+static PyObject *
+dawg_enter_py(DawgObject *self)
 {
-	// we got two references for tuples and lists, one for the original python object,
-	// and one returned by `PySequence_fast`
-	if (state->seqtype == 'a')
-		Py_XDECREF(state->seq1.a);
-	Py_XDECREF(state->object);
-	Py_XDECREF(state->itor);
-	Py_TYPE(state)->tp_free(state);
+	if (self->dawg == NULL)
+		return dawg_closed();
+	Py_INCREF(self);
+	return (PyObject *)self;
 }
 
 
 static PyObject *
-ifastcomp_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+dawg_exit_py(DawgObject *self, PyObject *args)
 {
-	PyObject *arg1, *arg2, *itor;
-	int transpositions = 0;
-	static char *keywords[] = {"seq1", "seqs", "transpositions", NULL};
-	
-	char seqtype;
-	sequence seq1;
-	Py_ssize_t len1;
-	
-	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|O:ifast_comp",
-		keywords, &arg1, &arg2, &transpositions))
-		return NULL;
-	if (otr && (transpositions = PyObject_IsTrue(otr)) == -1)
-		return NULL;
-	
-	if ((seqtype = get_sequence(arg1, &seq1, &len1, '\0')) == '\0')
-		return NULL;
-	
-	if ((itor = PyObject_GetIter(arg2)) == NULL) {
-		PyErr_SetString(PyExc_ValueError, "expected an iterable as second argument");
-		return NULL;
+	return dawg_close_py(self);
+}
+
+
+static Py_ssize_t
+dawg_length(DawgObject *self)
+{
+	if (self->dawg == NULL) {
+		dawg_closed();
+		return -1;
 	}
+	return distance_dawg_size(self->dawg);
+}
 
-	ItorState *state = (ItorState *)type->tp_alloc(type, 0);
-	if (state == NULL) {
-		Py_DECREF(itor);
+
+static PyObject *
+dawg_item(DawgObject *self, Py_ssize_t i)
+{
+	if (self->dawg == NULL)
+		return dawg_closed();
+	if (i < 0 || i >= distance_dawg_size(self->dawg)) {
+		PyErr_SetString(PyExc_IndexError, "dawg index out of range");
 		return NULL;
 	}
+	return dawg_word(self, i);
+}
 
-	Py_INCREF(arg1);
 
-	state->itor = itor;
-	state->seqtype = seqtype;
-	state->seq1 = seq1;
-	state->object = arg1;
-	state->len1 = len1;
-	state->transpos = transpositions;
+// Number of the word `obj` in `*rank`, -1 if it isn't in the dawg.
+
+static int
+dawg_find(DawgObject *self, PyObject *obj, Py_ssize_t *rank)
+{
+	sequence seq;
+	Py_ssize_t len;
+	int status;
 	
-	return (PyObject *)state;
+	if (self->dawg == NULL) {
+		dawg_closed();
+		return 0;
+	}
+	if (!get_unicode(obj, &seq, &len))
+		return 0;
+	if ((status = distance_dawg_find(self->dawg, seq.items, seq.width, len, rank)) != DISTANCE_OK) {
+		set_error(status);
+		return 0;
+	}
+	return 1;
 }
 
 
-static PyObject *
-ilevenshtein_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+static int
+dawg_contains(DawgObject *self, PyObject *obj)
 {
-	PyObject *arg1, *arg2, *itor;
-	Py_ssize_t max_dist = -1;
-	static char *keywords[] = {"seq1", "seqs", "max_dist", NULL};
+	Py_ssize_t rank;
 	
-	char seqtype;
-	sequence seq1;
-	Py_ssize_t len1;
+	if (!PyUnicode_Check(obj))
+		return 0;
+	if (!dawg_find(self, obj, &rank))
+		return -1;
+	return rank >= 0;
+}
 
-	if (!PyArg_ParseTupleAndKeywords(args, kwargs,
-		"OO|n:ilevenshtein", keywords, &arg1, &arg2, &max_dist))
-		return NULL;
 
-	if ((seqtype = get_sequence(arg1, &seq1, &len1, '\0')) == '\0')
-		return NULL;
+static PyObject *
+dawg_get_py(DawgObject *self, PyObject *args, PyObject *kwargs)
+{
+	PyObject *word, *dflt = Py_None;
+	static char *keywords[] = {"word", "default", NULL};
+	const int64_t *values;
+	Py_ssize_t rank;
 	
-	if ((itor = PyObject_GetIter(arg2)) == NULL) {
-		PyErr_SetString(PyExc_ValueError, "expected an iterable as second argument");
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O:get", keywords, &word, &dflt))
+		return NULL;
+	if (!PyUnicode_Check(word)) {
+		PyErr_SetString(PyExc_ValueError, "expected a unicode string");
 		return NULL;
 	}
-
-	ItorState *state = (ItorState *)type->tp_alloc(type, 0);
-	if (state == NULL) {
-		Py_DECREF(itor);
+	if (!dawg_find(self, word, &rank))
 		return NULL;
+	if (rank < 0) {
+		Py_INCREF(dflt);
+		return dflt;
 	}
-
-	Py_INCREF(arg1);
-
-	state->itor = itor;
-	state->seqtype = seqtype;
-	state->seq1 = seq1;
-	state->object = arg1;
-	state->len1 = len1;
-	state->max_dist = max_dist;
-	  
-	return (PyObject *)state;
+	if ((values = distance_dawg_values(self->dawg)) == NULL)
+		return PyLong_FromSsize_t(rank);
+	return PyLong_FromLongLong(values[rank]);
 }
 
 
 static PyObject *
-ilevenshtein_next(ItorState *state)
+dawg_search(DawgObject *self, PyObject *args, PyObject *kwargs, int prefix)
 {
-	PyObject *arg2;
-	sequence seq1, seq2;
-	Py_ssize_t len2;
+	PyObject *arg1, *rv = NULL, *word, *hit;
+	Py_ssize_t max_dist = -1, len1, nhits = 0, i;
+	static char *keywords[] = {"query", "max_dist", NULL};
+	struct distance_hit *hits = NULL;
+	const int64_t *values;
+	sequence seq1;
+	int status;
 	
-	Py_ssize_t dist = -1;
-	PyObject *rv;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs,
+		prefix ? "O|n:prefix_search" : "O|n:search", keywords, &arg1, &max_dist))
+		return NULL;
+	if (self->dawg == NULL)
+		return dawg_closed();
+	arg1 = QUERY(arg1);
+	if (!PyUnicode_Check(arg1)) {
+		PyErr_SetString(PyExc_ValueError, "expected a unicode string as query");
+		return NULL;
+	}
+	if (!get_unicode(arg1, &seq1, &len1))
+		return NULL;
 	
-	seq1 = state->seq1;
-
-	while ((arg2 = PyIter_Next(state->itor)) != NULL) {
+	self->searches++;
+	Py_BEGIN_ALLOW_THREADS
+	status = distance_dawg_search(self->dawg, seq1.items, seq1.width, len1, max_dist,
+		prefix, &hits, &nhits);
+	Py_END_ALLOW_THREADS
+	self->searches--;
+	if (status != DISTANCE_OK)
+		return set_error(status);
 	
-		if (get_sequence(arg2, &seq2, &len2, state->seqtype) == '\0') {
-			Py_DECREF(arg2);
-			return NULL;
-		}
-		switch(state->seqtype) {
-			case 'u':
-				dist = ulevenshtein(seq1.u, seq2.u, state->len1, len2, state->max_dist);
-				break;
-			case 'b':
-				dist = blevenshtein(seq1.b, seq2.b, state->len1, len2, state->max_dist);
-				break;
-			default:
-				dist = alevenshtein(seq1.a, seq2.a, state->len1, len2, state->max_dist);
-				Py_DECREF(seq2.a);
-		}
-		if (dist < -1) {
-			Py_DECREF(arg2);
-			if (dist == -2)
-				return PyErr_NoMemory(); // memory allocation failed
-			return NULL; // comparison failed
-		}
-		if (dist != -1) {
-			rv = Py_BuildValue("(nO)", dist, arg2);
-			Py_DECREF(arg2);
-			return rv;
-		}
-		Py_DECREF(arg2);
+	values = distance_dawg_values(self->dawg);
+	if ((rv = PyList_New(nhits)) == NULL)
+		goto On_Error;
+	for (i = 0; i < nhits; i++) {
+		if ((word = dawg_word(self, hits[i].index)) == NULL)
+			goto On_Error;
+		if (values)
+			hit = Py_BuildValue("(nNL)", hits[i].dist, word, (PY_LONG_LONG)values[hits[i].index]);
+		else
+			hit = Py_BuildValue("(nN)", hits[i].dist, word);
+		if (hit == NULL)
+			goto On_Error;
+		PyList_SET_ITEM(rv, i, hit);
 	}
+	distance_free(hits);
+	return rv;
 	
-	return NULL;
+	On_Error:
+		Py_XDECREF(rv);
+		distance_free(hits);
+		return NULL;
 }
 
 
 static PyObject *
-ifastcomp_next(ItorState *state)
+dawg_search_py(DawgObject *self, PyObject *args, PyObject *kwargs)
 {
-	PyObject *arg2;
-	sequence seq1, seq2;
-	Py_ssize_t len2;
-	
-	short dist = -1;
-	PyObject *rv;
-	
-	seq1 = state->seq1;
-	
-	while ((arg2 = PyIter_Next(state->itor)) != NULL) {
-	
-		if (get_sequence(arg2, &seq2, &len2, state->seqtype) == '\0') {
-			Py_DECREF(arg2);
-			return NULL;
-		}
-		switch(state->seqtype) {
-			case 'u':
-				dist = ufastcomp(seq1.u, seq2.u, state->len1, len2, state->transpos);
-				break;
-			case 'b':
-				dist = bfastcomp(seq1.b, seq2.b, state->len1, len2, state->transpos);
-				break;
-			default:
-				dist = afastcomp(seq1.a, seq2.a, state->len1, len2, state->transpos);
-				Py_DECREF(seq2.a);
-		}
-		if (dist == -2) {	// comparison failed
-			Py_DECREF(arg2);
-			return NULL;
-		}
-		if (dist != -1) {
-			rv = Py_BuildValue("(hO)", dist, arg2);
-			Py_DECREF(arg2);
-			return rv;
-		}
-		Py_DECREF(arg2);
-	}
-	
-	return NULL;
+	return dawg_search(self, args, kwargs, 0);
 }
 
 
-PyTypeObject IFastComp_Type = {
-	PyVarObject_HEAD_INIT(&PyType_Type, 0)
-	"distance.ifast_comp", /* tp_name */
-	sizeof(ItorState), /* tp_basicsize */
-	0, /* tp_itemsize */
-	(destructor)itor_dealloc, /* tp_dealloc */
-	0, /* tp_print */
-	0, /* tp_getattr */
-	0, /* tp_setattr */
-	0, /* tp_reserved */
-	0, /* tp_repr */
-	0, /* tp_as_number */
-	0, /* tp_as_sequence */
-	0, /* tp_as_mapping */
-	0, /* tp_hash */
-	0, /* tp_call */
-	0, /* tp_str */
-	0, /* tp_getattro */
-	0, /* tp_setattro */
-	0, /* tp_as_buffer */
-	Py_TPFLAGS_DEFAULT, /* tp_flags */
-	ifast_comp_doc, /* tp_doc */
-	0, /* tp_traverse */
-	0, /* tp_clear */
-	0, /* tp_richcompare */
-	0, /* tp_weaklistoffset */
-	PyObject_SelfIter, /* tp_iter */
-	(iternextfunc)ifastcomp_next, /* tp_iternext */
-	0, /* tp_methods */
-	0, /* tp_members */
-	0, /* tp_getset */
-	0, /* tp_base */
-	0, /* tp_dict */
-	0, /* tp_descr_get */
-	0, /* tp_descr_set */
-	0, /* tp_dictoffset */
-	0, /* tp_init */
-	PyType_GenericAlloc, /* tp_alloc */
-	ifastcomp_new, /* tp_new */
+static PyObject *
+dawg_prefix_search_py(DawgObject *self, PyObject *args, PyObject *kwargs)
+{
+	return dawg_search(self, args, kwargs, 1);
+}
+
+
+static PySequenceMethods dawg_as_sequence = {
+	(lenfunc)dawg_length, /* sq_length */
+	0, /* sq_concat */
+	0, /* sq_repeat */
+	(ssizeargfunc)dawg_item, /* sq_item */
+	0, /* sq_slice */
+	0, /* sq_ass_item */
+	0, /* sq_ass_slice */
+	(objobjproc)dawg_contains, /* sq_contains */
 };
 
 
-PyTypeObject ILevenshtein_Type = {
+static PyMethodDef dawg_methods[] = {
+	{"open", (PyCFunction)dawg_open_py, METH_VARARGS | METH_KEYWORDS | METH_CLASS, Dawg_open_doc},
+	{"get", (PyCFunction)dawg_get_py, METH_VARARGS | METH_KEYWORDS, Dawg_get_doc},
+	{"search", (PyCFunction)dawg_search_py, METH_VARARGS | METH_KEYWORDS, Dawg_search_doc},
+	{"prefix_search", (PyCFunction)dawg_prefix_search_py, METH_VARARGS | METH_KEYWORDS, Dawg_prefix_search_doc},
+	{"close", (PyCFunction)dawg_close_py, METH_NOARGS, Dawg_close_doc},
+	{"__enter__", (PyCFunction)dawg_enter_py, METH_NOARGS, NULL},
+	{"__exit__", (PyCFunction)dawg_exit_py, METH_VARARGS, NULL},
+	{NULL, NULL, 0, NULL}
+};
+
+
+PyTypeObject Dawg_Type = {
 	PyVarObject_HEAD_INIT(&PyType_Type, 0)
-	"distance.ilevenshtein", /* tp_name */
-	sizeof(ItorState), /* tp_basicsize */
+	"distance.Dawg", /* tp_name */
+	sizeof(DawgObject), /* tp_basicsize */
 	0, /* tp_itemsize */
-	(destructor)itor_dealloc, /* tp_dealloc */
+	(destructor)dawg_dealloc, /* tp_dealloc */
 	0, /* tp_print */
 	0, /* tp_getattr */
 	0, /* tp_setattr */
 	0, /* tp_reserved */
 	0, /* tp_repr */
 	0, /* tp_as_number */
-	0, /* tp_as_sequence */
+	&dawg_as_sequence, /* tp_as_sequence */
 	0, /* tp_as_mapping */
 	0, /* tp_hash */
 	0, /* tp_call */
@@ -708,14 +5680,14 @@ PyTypeObject ILevenshtein_Type = {
 	0, /* tp_setattro */
 	0, /* tp_as_buffer */
 	Py_TPFLAGS_DEFAULT, /* tp_flags */
-	ilevenshtein_doc, /* tp_doc */
+	Dawg_doc, /* tp_doc */
 	0, /* tp_traverse */
 	0, /* tp_clear */
 	0, /* tp_richcompare */
 	0, /* tp_weaklistoffset */
-	PyObject_SelfIter, /* tp_iter */
-	(iternextfunc)ilevenshtein_next, /* tp_iternext */
-	0, /* tp_methods */
+	0, /* tp_iter */
+	0, /* tp_iternext */
+	dawg_methods, /* tp_methods */
 	0, /* tp_members */
 	0, /* tp_getset */
 	0, /* tp_base */
@@ -725,16 +5697,170 @@ PyTypeObject ILevenshtein_Type = {
 	0, /* tp_dictoffset */
 	0, /* tp_init */
 	PyType_GenericAlloc, /* tp_alloc */
-	ilevenshtein_new, /* tp_new */
+	dawg_new, /* tp_new */
 };
 
 
+// Instrumentation (see stats.h).
+
+static const char *stats_kernels[] = {"hamming", "levenshtein", "nlevenshtein",
+	"fast_comp", "lcsubstrings", "jaro", "lcs"};
+static const char *stats_types[] = {"u8", "u16", "u32", "seq"};
+static const char *stats_algos[] = {"dp", "bitpar", "diag", "tiled"};
+
+
+static int
+stats_set(PyObject *dict, const char *key, PyObject *value)
+{
+	int rv;
+
+	if (value == NULL)
+		return -1;
+	rv = PyDict_SetItemString(dict, key, value);
+	Py_DECREF(value);
+	return rv;
+}
+
+
+static PyObject *
+stats_kernel(const struct distance_kernel_stats *ks)
+{
+	PyObject *dict, *paths, *latency, *key, *value;
+	char name[48];
+	int i, t, a, k;
+
+	if ((dict = PyDict_New()) == NULL)
+		return NULL;
+	if (stats_set(dict, "calls", PyLong_FromUnsignedLongLong(ks->calls)) == -1
+		|| stats_set(dict, "cells", PyLong_FromUnsignedLongLong(ks->cells)) == -1
+		|| stats_set(dict, "early_exits", Py_BuildValue("{sKsK}", "length",
+			(unsigned long long)ks->exits_length, "bound", (unsigned long long)ks->exits_bound)) == -1
+		|| stats_set(dict, "bytes_allocated", PyLong_FromUnsignedLongLong(ks->bytes)) == -1
+		|| stats_set(dict, "paths", (paths = PyDict_New())) == -1
+		|| stats_set(dict, "latency_ns", (latency = PyDict_New())) == -1)
+		goto On_Error;
+
+	for (i = 0; i < DISTANCE_ISA_NLEVELS; i++) {
+		for (t = 0; t < DISTANCE_STATS_NTYPES; t++) {
+			for (a = 0; a < DISTANCE_STATS_NALGOS; a++) {
+				if (!ks->paths[i][t][a])
+					continue;
+				sprintf(name, "%s/%s/%s", stats_types[t], stats_algos[a], distance_isa_name(i));
+				if (stats_set(paths, name, PyLong_FromUnsignedLongLong(ks->paths[i][t][a])) == -1)
+					goto On_Error;
+			}
+		}
+	}
+	for (k = 0; k < DISTANCE_STATS_NBUCKETS; k++) {
+		if (!ks->latency[k])
+			continue;
+		key = PyLong_FromUnsignedLongLong((unsigned long long)1 << k);
+		value = PyLong_FromUnsignedLongLong(ks->latency[k]);
+		if (key == NULL || value == NULL || PyDict_SetItem(latency, key, value) == -1) {
+			Py_XDECREF(key);
+			Py_XDECREF(value);
+			goto On_Error;
+		}
+		Py_DECREF(key);
+		Py_DECREF(value);
+	}
+	return dict;
+
+	On_Error:
+		Py_DECREF(dict);
+		return NULL;
+}
+
+
+static PyObject *
+stats_py(PyObject *self)
+{
+	struct distance_stats stats;
+	PyObject *dict;
+	int k;
+
+	if ((dict = PyDict_New()) == NULL)
+		return NULL;
+	if (!distance_stats_enabled())
+		return dict;
+
+	distance_stats_read(&stats);
+	for (k = 0; k < DISTANCE_STATS_NKERNELS; k++) {
+		if (!stats.kernels[k].calls)
+			continue;
+		if (stats_set(dict, stats_kernels[k], stats_kernel(&stats.kernels[k])) == -1) {
+			Py_DECREF(dict);
+			return NULL;
+		}
+	}
+	return dict;
+}
+
+
+static PyObject *
+reset_stats_py(PyObject *self)
+{
+	distance_stats_reset();
+	Py_RETURN_NONE;
+}
+
+
+// Names of the DISTANCE_CPU_* flags, from the lowest bit.
+
+static const char *cpu_feature_names[] = {"popcnt", "sse4.2", "avx2", "bmi2", "avx512f"};
+
+
+static PyObject *
+cpu_features_py(PyObject *self)
+{
+	PyObject *supported, *features, *name;
+	unsigned flags = distance_cpu_features();
+	int i;
+	
+	if ((supported = PyList_New(distance_isa_max() + 1)) == NULL)
+		return NULL;
+	for (i = 0; i <= distance_isa_max(); i++) {
+		if ((name = PyUnicode_FromString(distance_isa_name(i))) == NULL) {
+			Py_DECREF(supported);
+			return NULL;
+		}
+		PyList_SET_ITEM(supported, i, name);
+	}
+	if ((features = PyDict_New()) == NULL) {
+		Py_DECREF(supported);
+		return NULL;
+	}
+	for (i = 0; i < (int)(sizeof(cpu_feature_names) / sizeof(cpu_feature_names[0])); i++) {
+		if (PyDict_SetItemString(features, cpu_feature_names[i],
+			(flags & (1u << i) ? Py_True : Py_False)) == -1) {
+			Py_DECREF(supported);
+			Py_DECREF(features);
+			return NULL;
+		}
+	}
+	return Py_BuildValue("{sssNsN}", "isa", distance_isa_name(distance_isa()),
+		"supported", supported, "features", features);
+}
+
+
 static PyMethodDef CDistanceMethods[] = {
 	{"hamming", (PyCFunction)hamming_py, METH_VARARGS | METH_KEYWORDS, hamming_doc},
 	{"levenshtein", (PyCFunction)levenshtein_py, METH_VARARGS | METH_KEYWORDS, levenshtein_doc},
 	{"nlevenshtein", (PyCFunction)nlevenshtein_py, METH_VARARGS | METH_KEYWORDS, nlevenshtein_doc},
 	{"lcsubstrings", (PyCFunction)lcsubstrings_py, METH_VARARGS | METH_KEYWORDS, lcsubstrings_doc},
 	{"fast_comp", (PyCFunction)fastcomp_py, METH_VARARGS | METH_KEYWORDS, fast_comp_doc},
+	{"jaro", (PyCFunction)jaro_py, METH_VARARGS | METH_KEYWORDS, jaro_doc},
+	{"jaro_winkler", (PyCFunction)jaro_winkler_py, METH_VARARGS | METH_KEYWORDS, jaro_winkler_doc},
+	{"lcs_length", (PyCFunction)lcs_length_py, METH_VARARGS | METH_KEYWORDS, lcs_length_doc},
+	{"indel_distance", (PyCFunction)indel_distance_py, METH_VARARGS | METH_KEYWORDS, indel_distance_doc},
+	{"compile_query", (PyCFunction)compile_query_py, METH_VARARGS | METH_KEYWORDS, compile_query_doc},
+	{"qgram_distance", (PyCFunction)qgram_distance_py, METH_VARARGS | METH_KEYWORDS, qgram_distance_doc},
+	{"cosine", (PyCFunction)cosine_py, METH_VARARGS | METH_KEYWORDS, cosine_doc},
+	{"overlap", (PyCFunction)overlap_py, METH_VARARGS | METH_KEYWORDS, overlap_doc},
+	{"jaccard_join", (PyCFunction)jaccard_join_py, METH_VARARGS | METH_KEYWORDS, jaccard_join_doc},
+	{"stats", (PyCFunction)stats_py, METH_NOARGS, stats_doc},
+	{"reset_stats", (PyCFunction)reset_stats_py, METH_NOARGS, reset_stats_doc},
+	{"cpu_features", (PyCFunction)cpu_features_py, METH_NOARGS, cpu_features_doc},
 	{NULL, NULL, 0, NULL}
 };
 
@@ -752,6 +5878,7 @@ PyMODINIT_FUNC initcdistance(void)
 #endif
 {
 	PyObject *module;
+	const char *isa = getenv("DISTANCE_ISA");
 
 #if PY_MAJOR_VERSION >= 3
 	if ((module = PyModule_Create(&cdistancemodule)) == NULL)
@@ -761,7 +5888,25 @@ PyMODINIT_FUNC initcdistance(void)
 		return;
 #endif
 
-	if (PyType_Ready(&IFastComp_Type) != 0 || PyType_Ready(&ILevenshtein_Type) != 0)
+	// the level was selected when the module was loaded (see cpu.c)
+	if (isa && strcmp(isa, distance_isa_name(distance_isa())) != 0
+		&& PyErr_WarnEx(PyExc_RuntimeWarning, "DISTANCE_ISA doesn't name an instruction set "
+			"level supported here, and is ignored", 1) == -1)
+#if PY_MAJOR_VERSION >= 3
+		return NULL;
+#else
+		return;
+#endif
+
+	if (PyType_Ready(&IFastComp_Type) != 0 || PyType_Ready(&ILevenshtein_Type) != 0
+		|| PyType_Ready(&IJaro_Type) != 0 || PyType_Ready(&IJaroWinkler_Type) != 0
+		|| PyType_Ready(&Lexicon_Type) != 0 || PyType_Ready(&CandidateSet_Type) != 0
+		|| PyType_Ready(&Trie_Type) != 0 || PyType_Ready(&IIndel_Type) != 0
+		|| PyType_Ready(&CommonSubstrings_Type) != 0 || PyType_Ready(&Vocabulary_Type) != 0
+		|| PyType_Ready(&Pattern_Type) != 0 || PyType_Ready(&QGramProfile_Type) != 0
+		|| PyType_Ready(&FindApprox_Type) != 0 || PyType_Ready(&Grep_Type) != 0
+		|| PyType_Ready(&SetIndex_Type) != 0 || PyType_Ready(&PackedDNA_Type) != 0
+		|| PyType_Ready(&BarcodeSet_Type) != 0 || PyType_Ready(&Dawg_Type) != 0)
 #if PY_MAJOR_VERSION >= 3
 		return NULL;
 #else
@@ -770,9 +5915,41 @@ PyMODINIT_FUNC initcdistance(void)
 	
 	Py_INCREF((PyObject *)&IFastComp_Type);
 	Py_INCREF((PyObject *)&ILevenshtein_Type);
+	Py_INCREF((PyObject *)&IJaro_Type);
+	Py_INCREF((PyObject *)&IJaroWinkler_Type);
+	Py_INCREF((PyObject *)&Lexicon_Type);
+	Py_INCREF((PyObject *)&CandidateSet_Type);
+	Py_INCREF((PyObject *)&Trie_Type);
+	Py_INCREF((PyObject *)&IIndel_Type);
+	Py_INCREF((PyObject *)&CommonSubstrings_Type);
+	Py_INCREF((PyObject *)&Vocabulary_Type);
+	Py_INCREF((PyObject *)&Pattern_Type);
+	Py_INCREF((PyObject *)&QGramProfile_Type);
+	Py_INCREF((PyObject *)&FindApprox_Type);
+	Py_INCREF((PyObject *)&Grep_Type);
+	Py_INCREF((PyObject *)&SetIndex_Type);
+	Py_INCREF((PyObject *)&PackedDNA_Type);
+	Py_INCREF((PyObject *)&BarcodeSet_Type);
+	Py_INCREF((PyObject *)&Dawg_Type);
 	
 	PyModule_AddObject(module, "ifast_comp", (PyObject *)&IFastComp_Type);
 	PyModule_AddObject(module, "ilevenshtein", (PyObject *)&ILevenshtein_Type);
+	PyModule_AddObject(module, "ijaro", (PyObject *)&IJaro_Type);
+	PyModule_AddObject(module, "ijaro_winkler", (PyObject *)&IJaroWinkler_Type);
+	PyModule_AddObject(module, "Lexicon", (PyObject *)&Lexicon_Type);
+	PyModule_AddObject(module, "CandidateSet", (PyObject *)&CandidateSet_Type);
+	PyModule_AddObject(module, "Trie", (PyObject *)&Trie_Type);
+	PyModule_AddObject(module, "iindel_distance", (PyObject *)&IIndel_Type);
+	PyModule_AddObject(module, "common_substrings", (PyObject *)&CommonSubstrings_Type);
+	PyModule_AddObject(module, "Vocabulary", (PyObject *)&Vocabulary_Type);
+	PyModule_AddObject(module, "Pattern", (PyObject *)&Pattern_Type);
+	PyModule_AddObject(module, "QGramProfile", (PyObject *)&QGramProfile_Type);
+	PyModule_AddObject(module, "find_approx", (PyObject *)&FindApprox_Type);
+	PyModule_AddObject(module, "grep", (PyObject *)&Grep_Type);
+	PyModule_AddObject(module, "SetIndex", (PyObject *)&SetIndex_Type);
+	PyModule_AddObject(module, "PackedDNA", (PyObject *)&PackedDNA_Type);
+	PyModule_AddObject(module, "BarcodeSet", (PyObject *)&BarcodeSet_Type);
+	PyModule_AddObject(module, "Dawg", (PyObject *)&Dawg_Type);
 
 #if PY_MAJOR_VERSION >= 3
 	return module;
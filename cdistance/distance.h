@@ -2,14 +2,8 @@
 #define DISTANCE_H
 
 #include "Python.h"
-#include "utarray.h"
-
-// Debugging. This kills the interpreter if an assertion fails.
-
-#ifdef DISTANCE_DEBUG
-	#undef NDEBUG
-	#include <assert.h>
-#endif
+#include "libdistance.h"
+#include "core.h"
 
 // Compatibility Python 2 && 3
 
@@ -20,38 +14,46 @@
 	#define PyUnicode_GET_LENGTH PyUnicode_GET_SIZE
 #endif
 
-// Aliases for each sequence type
-
-typedef Py_UNICODE unicode;
-
-typedef char byte;
-
-typedef PyObject array;
-
-typedef union {
-	unicode *u;
-	byte    *b;
-	array   *a;
+/* A sequence, as passed to the kernels. Unicode and byte strings are buffers
+of 8, 16 or 32 bits items, handled by libdistance; unicode strings are read in
+their compact (PEP 393) representation when available, and so are arrays of
+unsigned integers, read through the buffer protocol. Other sequences are
+turned into lists or tuples with `PySequence_Fast`, and their items compared
+with the Python API. */
+
+typedef struct {
+	int width;				// size of the items in bytes, 0 for Python sequences
+	void *items;			// for strings
+	PyObject *a;			// for Python sequences
+	void *copy;				// items widened to the width of another string, or NULL
+	Py_buffer view;			// for arrays, `view.obj` is NULL otherwise
 } sequence;
 
 
-// Used in distance.c and some other files
-
-#define SWAP(type, a, b)								\
-do {															\
-	type a##_tmp = a;										\
-	a = b;													\
-	b = a##_tmp;											\
+/* Calls the kernel `name` for the width of the sequences `seq1` and `seq2`,
+which must be the same; the arguments following the sequences are passed as
+is, e.g.
+
+	DISPATCH(status, levenshtein, seq1, seq2, len1, len2, max_dist, &dist);
+
+Python sequences are handled by the kernels instantiated in the extension
+module, `name_seq`. */
+
+#define DISPATCH(status, name, seq1, seq2, ...)											\
+do {																					\
+	switch ((seq1).width) {																\
+		case 1:																			\
+			status = distance_##name##_u8((seq1).items, (seq2).items, __VA_ARGS__);		\
+			break;																		\
+		case 2:																			\
+			status = distance_##name##_u16((seq1).items, (seq2).items, __VA_ARGS__);	\
+			break;																		\
+		case 4:																			\
+			status = distance_##name##_u32((seq1).items, (seq2).items, __VA_ARGS__);	\
+			break;																		\
+		default:																		\
+			STAT_TIMED(name, status, name##_seq((seq1).a, (seq2).a, __VA_ARGS__));		\
+	}																					\
 } while (0)
 
-
-// Used in lcsubstrings.c and distance.c for dynamic array
-
-struct pair_t {
-	Py_ssize_t i;
-	Py_ssize_t j;
-};
-
-UT_icd pair_icd = {sizeof(struct pair_t), NULL, NULL, NULL};
-
 #endif
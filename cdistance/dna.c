@@ -0,0 +1,687 @@
+#define DISTANCE_BUILD
+#include "core.h"
+#include "pool.h"
+
+/* Nucleotide sequences packed in 2 bits per base. The bases are stored by
+blocks of 64, as two words: the low bits of their codes (A = 0, C = 1, G = 2,
+T = 3), then their high bits, base `i` of a block being bit `i` of each word;
+N is stored as A, and flagged in a third word, only allocated for the
+sequences which have some N. The bits past the end of a sequence are 0.
+
+With this layout, the positions at which two blocks differ are the OR of the
+XOR of their words, and their number is a popcount; the match vectors of the
+bit-parallel Levenshtein kernel are computed for a whole block with a few
+word operations, rather than base by base through a table. */
+
+#define BLOCKS(len) (((len) + 63) / 64)
+
+static const uint8_t dna_bases[5] = {'A', 'C', 'G', 'T', 'N'};
+
+
+// Code of an item, 4 for N, and 5 for the items which aren't bases.
+
+static int
+dna_code(uint32_t item)
+{
+	switch (item) {
+		case 'A': case 'a':
+			return 0;
+		case 'C': case 'c':
+			return 1;
+		case 'G': case 'g':
+			return 2;
+		case 'T': case 't':
+			return 3;
+		case 'N': case 'n':
+			return 4;
+	}
+	return 5;
+}
+
+
+DISTANCE_API int
+distance_dna_pack(const void *items, int width, dist_ssize_t len, struct distance_dna *dna,
+	dist_ssize_t *bad)
+{
+	dist_ssize_t i, nblocks = BLOCKS(len);
+	uint32_t item;
+	uint64_t bit;
+	int code;
+
+	if (len < 0 || (width != 1 && width != 2 && width != 4))
+		return DISTANCE_EINVAL;
+	dna->len = len;
+	dna->n = NULL;
+	// an empty sequence has a block too, so that `bits` is never NULL
+	if ((dna->bits = (uint64_t *)calloc(2 * (nblocks ? nblocks : 1), sizeof(uint64_t))) == NULL)
+		return DISTANCE_ENOMEM;
+
+	for (i = 0; i < len; i++) {
+		switch (width) {
+			case 1:
+				item = ((const uint8_t *)items)[i];
+				break;
+			case 2:
+				item = ((const uint16_t *)items)[i];
+				break;
+			default:
+				item = ((const uint32_t *)items)[i];
+		}
+		code = dna_code(item);
+		bit = (uint64_t)1 << (i & 63);
+		if (code == 5) {
+			distance_dna_release(dna);
+			*bad = i;
+			return DISTANCE_EINVAL;
+		}
+		if (code == 4) {
+			if (dna->n == NULL && (dna->n = (uint64_t *)calloc(nblocks, sizeof(uint64_t))) == NULL) {
+				distance_dna_release(dna);
+				return DISTANCE_ENOMEM;
+			}
+			dna->n[i / 64] |= bit;
+			continue;
+		}
+		if (code & 1)
+			dna->bits[2 * (i / 64)] |= bit;
+		if (code & 2)
+			dna->bits[2 * (i / 64) + 1] |= bit;
+	}
+	return DISTANCE_OK;
+}
+
+
+DISTANCE_API int
+distance_dna_copy(const struct distance_dna *dna, struct distance_dna *copy)
+{
+	dist_ssize_t nblocks = BLOCKS(dna->len);
+
+	copy->len = dna->len;
+	copy->n = NULL;
+	if ((copy->bits = (uint64_t *)malloc(2 * (nblocks ? nblocks : 1) * sizeof(uint64_t))) == NULL)
+		return DISTANCE_ENOMEM;
+	memcpy(copy->bits, dna->bits, 2 * (nblocks ? nblocks : 1) * sizeof(uint64_t));
+	if (dna->n) {
+		if ((copy->n = (uint64_t *)malloc(nblocks * sizeof(uint64_t))) == NULL) {
+			distance_dna_release(copy);
+			return DISTANCE_ENOMEM;
+		}
+		memcpy(copy->n, dna->n, nblocks * sizeof(uint64_t));
+	}
+	return DISTANCE_OK;
+}
+
+
+DISTANCE_API void
+distance_dna_release(struct distance_dna *dna)
+{
+	free(dna->bits);
+	free(dna->n);
+	dna->bits = dna->n = NULL;
+	dna->len = 0;
+}
+
+
+// Code of the base `i`, 4 for N.
+
+static int
+dna_base(const struct distance_dna *dna, dist_ssize_t i)
+{
+	const uint64_t *block = dna->bits + 2 * (i / 64);
+	int shift = (int)(i & 63);
+
+	if (dna->n && (dna->n[i / 64] >> shift) & 1)
+		return 4;
+	return (int)((block[0] >> shift) & 1) | (int)(((block[1] >> shift) & 1) << 1);
+}
+
+
+DISTANCE_API void
+distance_dna_unpack(const struct distance_dna *dna, uint8_t *bases)
+{
+	dist_ssize_t i;
+
+	for (i = 0; i < dna->len; i++)
+		bases[i] = dna_bases[dna_base(dna, i)];
+}
+
+
+/* Number of differing bases of two sequences of the same length. The kernel is
+compiled a second time for POPCNT with GCC on x86, and the instruction set
+level in use (see cpu.c) selects one of them. */
+
+#define DEFINE_MISMATCHES(name)												\
+static dist_ssize_t															\
+name(const struct distance_dna *dna1, const struct distance_dna *dna2)		\
+{																			\
+	const uint64_t *b1 = dna1->bits, *b2 = dna2->bits;						\
+	dist_ssize_t k, nblocks = BLOCKS(dna1->len), dist = 0;					\
+	uint64_t diff;															\
+																			\
+	for (k = 0; k < nblocks; k++) {											\
+		diff = (b1[2 * k] ^ b2[2 * k]) | (b1[2 * k + 1] ^ b2[2 * k + 1]);	\
+		if (dna1->n || dna2->n)												\
+			diff |= (dna1->n ? dna1->n[k] : 0) ^ (dna2->n ? dna2->n[k] : 0);	\
+		dist += POPCOUNT64(diff);											\
+	}																		\
+	return dist;															\
+}
+
+DEFINE_MISMATCHES(mismatches)
+
+#ifdef DISTANCE_MULTIVERSION
+
+#pragma GCC push_options
+#pragma GCC target("popcnt")
+DEFINE_MISMATCHES(mismatches_popcnt)
+#pragma GCC pop_options
+
+#define MISMATCHES(dna1, dna2)													\
+	(cpu_level >= DISTANCE_ISA_SSE42 ? mismatches_popcnt(dna1, dna2) : mismatches(dna1, dna2))
+
+#else
+
+#define MISMATCHES mismatches
+
+#endif
+
+
+DISTANCE_API int
+distance_dna_hamming(const struct distance_dna *dna1, const struct distance_dna *dna2,
+	dist_ssize_t *dist)
+{
+	if (dna1->len != dna2->len)
+		return DISTANCE_EINVAL;
+	*dist = MISMATCHES(dna1, dna2);
+	return DISTANCE_OK;
+}
+
+
+/* Match vectors of the block `k` of `dna`, indexed by the code of the bases:
+the bits of the positions at which each base occurs. */
+
+static void
+dna_peq(const struct distance_dna *dna, dist_ssize_t k, uint64_t *peq)
+{
+	uint64_t lo = dna->bits[2 * k], hi = dna->bits[2 * k + 1];
+	uint64_t n = (dna->n ? dna->n[k] : 0), valid = ~(uint64_t)0;
+
+	if (k == BLOCKS(dna->len) - 1 && dna->len % 64)
+		valid = ((uint64_t)1 << (dna->len % 64)) - 1;
+	peq[0] = ~(lo | hi | n) & valid;
+	peq[1] = lo & ~hi;
+	peq[2] = hi & ~lo;
+	peq[3] = lo & hi;
+	peq[4] = n;
+}
+
+
+/* Bit-parallel algorithm of Myers, in the form given by Hyyrö for sequences
+of any length: `dna2`, the shorter sequence, is cut into blocks of 64 bases,
+and the horizontal difference at the bottom of each block is carried into the
+next one. The bases of `dna1` are read from its words, a block at a time.
+`work` holds 7 words per block of `dna2`. Returns the distance, or -1 if it is
+higher than `max_dist`. */
+
+static dist_ssize_t
+dna_levenshtein(const struct distance_dna *dna1, const struct distance_dna *dna2,
+	dist_ssize_t max_dist, uint64_t *work)
+{
+	dist_ssize_t i, k, nblocks = BLOCKS(dna2->len), len1 = dna1->len;
+	dist_ssize_t dist = dna2->len;
+	uint64_t *peq = work, *pvs = work + 5 * nblocks, *mvs = pvs + nblocks;
+	uint64_t pv = ~(uint64_t)0, mv = 0, ph, mh, xv, xh, eq, high, neg, pos;
+	uint64_t lo = 0, hi = 0, n = 0;
+	uint64_t last = (uint64_t)1 << ((dna2->len - 1) & 63);
+	int hin, base;
+
+	for (k = 0; k < nblocks; k++) {
+		dna_peq(dna2, k, peq + 5 * k);
+		pvs[k] = ~(uint64_t)0;
+		mvs[k] = 0;
+	}
+
+	for (i = 0; i < len1; i++) {
+		if ((i & 63) == 0) {
+			lo = dna1->bits[2 * (i / 64)];
+			hi = dna1->bits[2 * (i / 64) + 1];
+			n = (dna1->n ? dna1->n[i / 64] : 0);
+		}
+		// N is stored as A, with a code of 0
+		base = (int)(lo & 1) | (int)((hi & 1) << 1) | (int)((n & 1) << 2);
+		lo >>= 1;
+		hi >>= 1;
+		n >>= 1;
+
+		if (nblocks == 1) {
+			eq = peq[base];
+			xv = eq | mv;
+			xh = (((eq & pv) + pv) ^ pv) | eq;
+			ph = mv | ~(xh | pv);
+			mh = pv & xh;
+			dist += (ph & last ? 1 : 0) - (mh & last ? 1 : 0);
+			// the first row is 0, 1, 2..., so its horizontal differences are +1
+			ph = (ph << 1) | 1;
+			mh <<= 1;
+			pv = mh | ~(xv | ph);
+			mv = ph & xv;
+		}
+		else {
+			hin = 1;
+			for (k = 0; k < nblocks; k++) {
+				eq = peq[5 * k + base];
+				pv = pvs[k];
+				mv = mvs[k];
+				high = (k == nblocks - 1 ? last : (uint64_t)1 << 63);
+				neg = (hin < 0);
+				pos = (hin > 0);
+				xv = eq | mv;
+				eq |= neg;
+				xh = (((eq & pv) + pv) ^ pv) | eq;
+				ph = mv | ~(xh | pv);
+				mh = pv & xh;
+				hin = (ph & high ? 1 : 0) - (mh & high ? 1 : 0);
+				ph = (ph << 1) | pos;
+				mh = (mh << 1) | neg;
+				pvs[k] = mh | ~(xv | ph);
+				mvs[k] = ph & xv;
+			}
+			dist += hin;
+		}
+		// the last cell decreases by at most 1 for each remaining base
+		if (max_dist >= 0 && dist - (len1 - i - 1) > max_dist)
+			return -1;
+	}
+
+	if (max_dist >= 0 && dist > max_dist)
+		return -1;
+	return dist;
+}
+
+
+/* Distance of two sequences, `work` holding 7 words per block of the shorter
+one, if it isn't empty. */
+
+static dist_ssize_t
+dna_compare(const struct distance_dna *dna1, const struct distance_dna *dna2,
+	dist_ssize_t max_dist, uint64_t *work)
+{
+	dist_ssize_t dist;
+
+	if (dna1->len < dna2->len)
+		SWAP(const struct distance_dna *, dna1, dna2);
+	if (max_dist >= 0 && dna1->len - dna2->len > max_dist)
+		return -1;
+	if (dna2->len == 0)
+		dist = dna1->len;
+	else
+		return dna_levenshtein(dna1, dna2, max_dist, work);
+	return (max_dist >= 0 && dist > max_dist ? -1 : dist);
+}
+
+
+DISTANCE_API int
+distance_dna_levenshtein(const struct distance_dna *dna1, const struct distance_dna *dna2,
+	dist_ssize_t max_dist, dist_ssize_t *dist)
+{
+	uint64_t local[7], *work = local;
+	dist_ssize_t len = (dna1->len < dna2->len ? dna1->len : dna2->len);
+
+	if (len > 64 && (work = (uint64_t *)malloc(7 * BLOCKS(len) * sizeof(uint64_t))) == NULL)
+		return DISTANCE_ENOMEM;
+	*dist = dna_compare(dna1, dna2, max_dist, work);
+	if (work != local)
+		free(work);
+	return DISTANCE_OK;
+}
+
+
+/* Barcode sets. When all the barcodes have 32 bases or less, and no N, they
+are also stored in a hash table, keyed by their length and by their two
+words, which then fit in a single one. A read of 32 bases or less is then
+looked up as it is, and, if it isn't a barcode, each sequence at distance 1
+of it is looked up in turn: they are derived from the read by a few bit
+operations, substituting, deleting or inserting a base, and there are about
+8 per base for Levenshtein, 3 for Hamming, far fewer than the barcodes of a
+large whitelist. The barcodes are compared with the read one by one only if
+there is none at distance 0 or 1, and `max_dist` is higher. */
+
+struct barcode_slot {
+	uint64_t key;
+	dist_ssize_t len;
+	dist_ssize_t index;				// of the first barcode, -1 for free slots
+	dist_ssize_t count;				// of the barcodes of this key
+};
+
+struct distance_barcodes {
+	struct distance_dna *codes;
+	dist_ssize_t ncodes;
+	dist_ssize_t max_len;
+	struct barcode_slot *table;		// NULL if some barcode can't be keyed
+	size_t mask;
+};
+
+
+#define LOW_BITS(n) ((n) >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << (n)) - 1)
+
+static struct barcode_slot *
+barcode_slot(const struct distance_barcodes *bs, uint64_t key, dist_ssize_t len)
+{
+	uint64_t x = (key ^ ((uint64_t)len << 58)) * 0x9e3779b97f4a7c15ull;
+	size_t h = (size_t)(x ^ (x >> 32)) & bs->mask;
+
+	while (bs->table[h].index >= 0 && (bs->table[h].key != key || bs->table[h].len != len))
+		h = (h + 1) & bs->mask;
+	return &bs->table[h];
+}
+
+
+static uint64_t
+barcode_key(const struct distance_dna *dna)
+{
+	return dna->bits[0] | (dna->bits[1] << 32);
+}
+
+
+static int
+barcodes_index(struct distance_barcodes *bs)
+{
+	struct barcode_slot *slot;
+	size_t size = 16;
+	dist_ssize_t i;
+
+	for (i = 0; i < bs->ncodes; i++) {
+		if (bs->codes[i].len > 32 || bs->codes[i].n)
+			return DISTANCE_OK;
+	}
+	while (size < 2 * (size_t)bs->ncodes)
+		size *= 2;
+	if ((bs->table = (struct barcode_slot *)malloc(size * sizeof(struct barcode_slot))) == NULL)
+		return DISTANCE_ENOMEM;
+	bs->mask = size - 1;
+	for (i = 0; i < (dist_ssize_t)size; i++)
+		bs->table[i].index = -1;
+
+	for (i = 0; i < bs->ncodes; i++) {
+		slot = barcode_slot(bs, barcode_key(&bs->codes[i]), bs->codes[i].len);
+		if (slot->index < 0) {
+			slot->key = barcode_key(&bs->codes[i]);
+			slot->len = bs->codes[i].len;
+			slot->index = i;
+			slot->count = 0;
+		}
+		slot->count++;
+	}
+	return DISTANCE_OK;
+}
+
+
+DISTANCE_API int
+distance_barcodes_new(const struct distance_dna *barcodes, dist_ssize_t count,
+	struct distance_barcodes **bs)
+{
+	struct distance_barcodes *b;
+	dist_ssize_t i;
+	int status;
+
+	if (count < 0)
+		return DISTANCE_EINVAL;
+	if ((b = (struct distance_barcodes *)calloc(1, sizeof(struct distance_barcodes))) == NULL)
+		return DISTANCE_ENOMEM;
+	if ((b->codes = (struct distance_dna *)calloc(count ? count : 1, sizeof(struct distance_dna))) == NULL) {
+		free(b);
+		return DISTANCE_ENOMEM;
+	}
+	for (i = 0; i < count; i++) {
+		if ((status = distance_dna_copy(&barcodes[i], &b->codes[i])) != DISTANCE_OK) {
+			distance_barcodes_free(b);
+			return status;
+		}
+		b->ncodes++;
+		if (barcodes[i].len > b->max_len)
+			b->max_len = barcodes[i].len;
+	}
+	if ((status = barcodes_index(b)) != DISTANCE_OK) {
+		distance_barcodes_free(b);
+		return status;
+	}
+	*bs = b;
+	return DISTANCE_OK;
+}
+
+
+DISTANCE_API void
+distance_barcodes_free(struct distance_barcodes *bs)
+{
+	dist_ssize_t i;
+
+	if (bs == NULL)
+		return;
+	for (i = 0; i < bs->ncodes; i++)
+		distance_dna_release(&bs->codes[i]);
+	free(bs->codes);
+	free(bs->table);
+	free(bs);
+}
+
+
+DISTANCE_API dist_ssize_t
+distance_barcodes_size(const struct distance_barcodes *bs)
+{
+	return bs->ncodes;
+}
+
+
+// Barcode of a read so far: its index, -1 if there is none, -2 if there are
+// several at its distance.
+
+struct barcode_match {
+	dist_ssize_t index;
+	dist_ssize_t dist;
+};
+
+
+static void
+match_add(struct barcode_match *m, const struct barcode_slot *slot, dist_ssize_t dist)
+{
+	if (slot->index < 0)
+		return;
+	if (m->index == -1) {
+		m->index = (slot->count > 1 ? -2 : slot->index);
+		m->dist = dist;
+	}
+	else if (m->index != slot->index)
+		m->index = -2;
+}
+
+
+// Inserts a bit `b` before the bit `pos` of `w`.
+
+#define INSERT_BIT(w, pos, b) \
+	(((w) & LOW_BITS(pos)) | (((w) & ~LOW_BITS(pos)) << 1) | ((uint64_t)(b) << (pos)))
+
+// Deletes the bit `pos` of `w`.
+
+#define DELETE_BIT(w, pos) (((w) & LOW_BITS(pos)) | (((w) >> 1) & ~LOW_BITS(pos)))
+
+
+/* Looks the read and the sequences at distance 1 of it up in the table. Only
+the substitutions, deletions and insertions which could lead to a barcode
+are tried: a barcode has no N, so if the read has one, it has to be
+substituted or deleted, and if the read has more, no barcode is at distance 1
+of it. */
+
+static void
+barcodes_lookup(const struct distance_barcodes *bs, const struct distance_dna *read,
+	int metric, dist_ssize_t max_dist, struct barcode_match *m)
+{
+	const dist_ssize_t len = read->len;
+	uint64_t lo = read->bits[0], hi = read->bits[1], n = (read->n ? read->n[0] : 0);
+	dist_ssize_t pos;
+	int c, cur, levenshtein = (metric == DISTANCE_METRIC_LEVENSHTEIN);
+
+	if (!n) {
+		match_add(m, barcode_slot(bs, lo | (hi << 32), len), 0);
+		if (m->index != -1)
+			return;
+	}
+	if (max_dist == 0 || POPCOUNT64(n) > 1)
+		return;
+
+	for (pos = 0; pos < len; pos++) {
+		if (n && !((n >> pos) & 1))
+			continue;
+		cur = (n ? 4 : (int)((lo >> pos) & 1) | (int)(((hi >> pos) & 1) << 1));
+		for (c = 0; c < 4; c++) {
+			if (c == cur)
+				continue;
+			match_add(m, barcode_slot(bs,
+				((lo & ~((uint64_t)1 << pos)) | ((uint64_t)(c & 1) << pos))
+				| (((hi & ~((uint64_t)1 << pos)) | ((uint64_t)(c >> 1) << pos)) << 32), len), 1);
+		}
+		if (levenshtein)
+			match_add(m, barcode_slot(bs, DELETE_BIT(lo, pos) | (DELETE_BIT(hi, pos) << 32),
+				len - 1), 1);
+	}
+	if (levenshtein && !n && len < 32) {
+		for (pos = 0; pos <= len; pos++) {
+			for (c = 0; c < 4; c++)
+				match_add(m, barcode_slot(bs, INSERT_BIT(lo, pos, c & 1)
+					| (INSERT_BIT(hi, pos, c >> 1) << 32), len + 1), 1);
+		}
+	}
+}
+
+
+// Compares the read with each barcode, keeping the closest ones.
+
+static void
+barcodes_scan(const struct distance_barcodes *bs, const struct distance_dna *read,
+	int metric, dist_ssize_t max_dist, uint64_t *work, struct barcode_match *m)
+{
+	const struct distance_dna *code;
+	dist_ssize_t i, dist, bound;
+
+	for (i = 0; i < bs->ncodes; i++) {
+		code = &bs->codes[i];
+		bound = (m->index != -1 ? m->dist : max_dist);
+		if (metric == DISTANCE_METRIC_HAMMING) {
+			if (code->len != read->len)
+				continue;
+			dist = MISMATCHES(read, code);
+			if (bound >= 0 && dist > bound)
+				continue;
+		}
+		else if ((dist = dna_compare(read, code, bound, work)) < 0)
+			continue;
+		if (m->index == -1 || dist < m->dist) {
+			m->index = i;
+			m->dist = dist;
+		}
+		else
+			m->index = -2;
+	}
+}
+
+
+struct assign_job {
+	const struct distance_barcodes *bs;
+	const struct distance_dna *reads;
+	dist_ssize_t nreads;
+	int metric;
+	dist_ssize_t max_dist;
+	dist_ssize_t *index;
+	dist_ssize_t *dist;
+	int *status;					// of each chunk
+};
+
+#define ASSIGN_CHUNK 4096
+
+
+static void
+assign_chunk(void *arg, dist_ssize_t chunk)
+{
+	struct assign_job *job = (struct assign_job *)arg;
+	const struct distance_barcodes *bs = job->bs;
+	const struct distance_dna *read;
+	struct barcode_match m;
+	dist_ssize_t i, end = (chunk + 1) * ASSIGN_CHUNK, max_len = 0;
+	uint64_t local[7], *work = local;
+
+	if (end > job->nreads)
+		end = job->nreads;
+	// the longest sequence the Levenshtein kernel can get as the shorter one
+	if (job->metric == DISTANCE_METRIC_LEVENSHTEIN) {
+		for (i = chunk * ASSIGN_CHUNK; i < end; i++) {
+			if (job->reads[i].len > max_len)
+				max_len = job->reads[i].len;
+		}
+		if (bs->max_len < max_len)
+			max_len = bs->max_len;
+	}
+	if (max_len > 64 && (work = (uint64_t *)malloc(7 * BLOCKS(max_len) * sizeof(uint64_t))) == NULL) {
+		job->status[chunk] = DISTANCE_ENOMEM;
+		return;
+	}
+
+	for (i = chunk * ASSIGN_CHUNK; i < end; i++) {
+		read = &job->reads[i];
+		m.index = -1;
+		m.dist = -1;
+		if (bs->table && read->len <= 32) {
+			barcodes_lookup(bs, read, job->metric, job->max_dist, &m);
+			if (m.index == -1 && (job->max_dist < 0 || job->max_dist > 1))
+				barcodes_scan(bs, read, job->metric, job->max_dist, work, &m);
+		}
+		else
+			barcodes_scan(bs, read, job->metric, job->max_dist, work, &m);
+		job->index[i] = m.index;
+		job->dist[i] = m.dist;
+	}
+	if (work != local)
+		free(work);
+	job->status[chunk] = DISTANCE_OK;
+}
+
+
+DISTANCE_API int
+distance_barcodes_assign(const struct distance_barcodes *bs, const struct distance_dna *reads,
+	dist_ssize_t nreads, int metric, dist_ssize_t max_dist, int nthreads,
+	dist_ssize_t *index, dist_ssize_t *dist)
+{
+	struct assign_job job = {bs, reads, nreads, metric, max_dist, index, dist, NULL};
+	struct pool_job pjob;
+	struct pool *pool;
+	dist_ssize_t k, nchunks = (nreads + ASSIGN_CHUNK - 1) / ASSIGN_CHUNK;
+	int status = DISTANCE_OK;
+
+	if (nreads < 0 || (metric != DISTANCE_METRIC_LEVENSHTEIN && metric != DISTANCE_METRIC_HAMMING))
+		return DISTANCE_EINVAL;
+	if ((job.status = (int *)malloc((nchunks ? nchunks : 1) * sizeof(int))) == NULL)
+		return DISTANCE_ENOMEM;
+
+	if (nthreads <= 1 || nchunks <= 1) {
+		for (k = 0; k < nchunks; k++)
+			assign_chunk(&job, k);
+	}
+	else {
+		if ((status = pool_new(&pool, nthreads < nchunks ? nthreads : (int)nchunks)) != DISTANCE_OK) {
+			free(job.status);
+			return status;
+		}
+		pjob.run = assign_chunk;
+		pjob.arg = &job;
+		pjob.size = nchunks;
+		pjob.order = NULL;
+		pool_submit(pool, &pjob);
+		pool_wait(pool, &pjob, pjob.size);
+		pool_free(pool);
+	}
+
+	for (k = 0; k < nchunks; k++) {
+		if (job.status[k] != DISTANCE_OK)
+			status = job.status[k];
+	}
+	free(job.status);
+	return status;
+}
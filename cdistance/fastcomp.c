@@ -1,19 +1,22 @@
-#include "distance.h"
+#include "core.h"
 
 
-static short
-fastcomp(unicode *seq1, unicode *seq2, Py_ssize_t len1, Py_ssize_t len2, int transpositions)
+/* Stores the distance in `dist`, or -1 if it is higher than 2. */
+
+static int
+fastcomp(unicode *seq1, unicode *seq2, dist_ssize_t len1, dist_ssize_t len2,
+         int transpositions, int *dist)
 {
 	char *models[3];
 	short m, cnt, res = 3;
-	Py_ssize_t i, j, c, ldiff;
+	dist_ssize_t i, j, c, ldiff;
 #ifdef SEQUENCE_COMP
 	int comp;
 #endif
 	
 	if (len1 < len2) {
-		SWAP(unicode *,  seq1, seq2);
-		SWAP(Py_ssize_t, len1, len2);
+		SWAP(unicode *,    seq1, seq2);
+		SWAP(dist_ssize_t, len1, len2);
 	}
 	
 	ldiff = len1 - len2;
@@ -34,8 +37,11 @@ fastcomp(unicode *seq1, unicode *seq2, Py_ssize_t len1, Py_ssize_t len2, int tra
 			m = 0;
 			break;
 		default:
-			return -1;
+			STAT_ADD(FASTCOMP, exits_length, 1);
+			*dist = -1;
+			return DISTANCE_OK;
 	}
+	STAT_PATH(FASTCOMP, KERNEL_TYPE, DISTANCE_STATS_DP);
 
 	for (; m >= 0; m--) {
 	
@@ -43,10 +49,11 @@ fastcomp(unicode *seq1, unicode *seq2, Py_ssize_t len1, Py_ssize_t len2, int tra
 		
 		while (i < len1 && j < len2)
 		{
+			STAT_ADD(FASTCOMP, cells, 1);
 #ifdef SEQUENCE_COMP
 			comp = SEQUENCE_COMP(seq1, i, seq2, j);
 			if (comp == -1)
-				return -2;
+				return DISTANCE_ECOMPARE;
 			if (!comp) {
 #else
 			if (seq1[i] != seq2[j]) {
@@ -68,11 +75,11 @@ fastcomp(unicode *seq1, unicode *seq2, Py_ssize_t len1, Py_ssize_t len2, int tra
 				if (transpositions && ldiff != 2 && i < (len1 - 1) && j < (len2 - 1)) {
 					comp = SEQUENCE_COMP(seq1, i + 1, seq2, j);
 					if (comp == -1)
-						return -2;
+						return DISTANCE_ECOMPARE;
 					else if (comp) {
 						comp = SEQUENCE_COMP(seq1, i, seq2, j + 1);
 						if (comp == -1)
-							return -2;
+							return DISTANCE_ECOMPARE;
 						else if (comp) {
 							i = i + 2;
 							j = j + 2;
@@ -132,5 +139,6 @@ fastcomp(unicode *seq1, unicode *seq2, Py_ssize_t len1, Py_ssize_t len2, int tra
 	if (res == 3)
 		res = -1;
 		
-	return res;
+	*dist = res;
+	return DISTANCE_OK;
 }
@@ -0,0 +1,167 @@
+#define DISTANCE_BUILD
+#include "core.h"
+
+/* Case folding of the items of a sequence, read as code points. The simple
+folding maps each code point to a single one, so that a folded sequence has
+the length of the original one, and positions in one are valid in the other.
+Code points of the BMP are looked up in a two-level table of differences,
+those of the astral planes in a short array of ranges; see gen_casefold.py. */
+
+struct fold_range {
+	uint32_t first, last;
+	int32_t delta;
+};
+
+#include "casefold.h"
+
+#define FOLD_NRANGES (sizeof(fold_ranges) / sizeof(fold_ranges[0]))
+
+
+DISTANCE_API uint32_t
+distance_fold_char(uint32_t c, int fold)
+{
+	size_t lo = 0, hi = FOLD_NRANGES, mid;
+
+	if (fold == DISTANCE_FOLD_ASCII)
+		return (c - 'A' < 26u ? c + ('a' - 'A') : c);
+	if (fold != DISTANCE_FOLD_SIMPLE)
+		return c;
+	if (c < 0x10000)
+		return (c + fold_blocks[fold_index[c >> 8]][c & 0xFF]) & 0xFFFF;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (c > fold_ranges[mid].last)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < FOLD_NRANGES && c >= fold_ranges[lo].first)
+		return c + fold_ranges[lo].delta;
+	return c;
+}
+
+
+#define FOLD_ITEMS(sfx, T)																	\
+static dist_ssize_t																			\
+fold_first_##sfx(const T *items, dist_ssize_t len, int fold)								\
+{																							\
+	dist_ssize_t i;																			\
+	for (i = 0; i < len; i++) {																\
+		if (distance_fold_char(items[i], fold) != items[i])									\
+			return i;																		\
+	}																						\
+	return len;																				\
+}
+
+FOLD_ITEMS(u8, uint8_t)
+FOLD_ITEMS(u16, uint16_t)
+FOLD_ITEMS(u32, uint32_t)
+
+
+static uint32_t
+fold_item(const void *items, int width, dist_ssize_t i)
+{
+	switch (width) {
+		case 1:
+			return ((const uint8_t *)items)[i];
+		case 2:
+			return ((const uint16_t *)items)[i];
+	}
+	return ((const uint32_t *)items)[i];
+}
+
+
+/* Checks the arguments, and stores in `first` the position of the first item
+which changes, `len` if none, and in `to` the width of the folded items. */
+
+static int
+fold_prepare(const void *items, int width, dist_ssize_t len, int fold, dist_ssize_t *first,
+	int *to)
+{
+	if (len < 0 || (width != 1 && width != 2 && width != 4)
+		|| fold < DISTANCE_FOLD_NONE || fold > DISTANCE_FOLD_SIMPLE)
+		return DISTANCE_EINVAL;
+	switch (width) {
+		case 1:
+			*first = fold_first_u8((const uint8_t *)items, len, fold);
+			break;
+		case 2:
+			*first = fold_first_u16((const uint16_t *)items, len, fold);
+			break;
+		default:
+			*first = fold_first_u32((const uint32_t *)items, len, fold);
+	}
+	*to = width;
+	// MICRO SIGN, the only code point below 256 folded above it
+	if (width == 1 && fold == DISTANCE_FOLD_SIMPLE && *first < len
+		&& memchr((const uint8_t *)items + *first, 0xB5, len - *first))
+		*to = 2;
+	return DISTANCE_OK;
+}
+
+
+static void
+fold_copy(const void *items, int width, dist_ssize_t len, int fold, dist_ssize_t first,
+	void *dst, int to)
+{
+	dist_ssize_t i;
+	uint32_t c;
+
+	for (i = 0; i < len; i++) {
+		c = fold_item(items, width, i);
+		if (i >= first)
+			c = distance_fold_char(c, fold);
+		switch (to) {
+			case 1:
+				((uint8_t *)dst)[i] = (uint8_t)c;
+				break;
+			case 2:
+				((uint16_t *)dst)[i] = (uint16_t)c;
+				break;
+			default:
+				((uint32_t *)dst)[i] = c;
+		}
+	}
+}
+
+
+DISTANCE_API int
+distance_fold(const void *items, int width, dist_ssize_t len, int fold, void **folded,
+	int *folded_width)
+{
+	dist_ssize_t first;
+	void *dst;
+	int to, status;
+
+	*folded = NULL;
+	*folded_width = width;
+	if ((status = fold_prepare(items, width, len, fold, &first, &to)) != DISTANCE_OK)
+		return status;
+	// nothing is allocated for the sequences which are folded already
+	if (first == len)
+		return DISTANCE_OK;
+	if ((dst = malloc((len + 1) * to)) == NULL)
+		return DISTANCE_ENOMEM;
+	fold_copy(items, width, len, fold, first, dst, to);
+	*folded = dst;
+	*folded_width = to;
+	return DISTANCE_OK;
+}
+
+
+DISTANCE_API int
+distance_fold_into(const void *items, int width, dist_ssize_t len, int fold, void *buffer,
+	int *folded_width)
+{
+	dist_ssize_t first;
+	int to, status;
+
+	*folded_width = 0;
+	if ((status = fold_prepare(items, width, len, fold, &first, &to)) != DISTANCE_OK)
+		return status;
+	if (first == len)
+		return DISTANCE_OK;
+	fold_copy(items, width, len, fold, first, buffer, to);
+	*folded_width = to;
+	return DISTANCE_OK;
+}
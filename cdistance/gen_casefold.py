@@ -0,0 +1,68 @@
+# -*- coding: utf-8 -*-
+# Writes casefold.h, the tables of the simple case folding of fold.c, from the
+# Unicode database of the running Python (3.3 or later):
+#
+#	python3 cdistance/gen_casefold.py > cdistance/casefold.h
+#
+# The simple folding maps a code point to a single one. It is the full folding
+# of str.casefold() where that gives a single code point, and the lowercase
+# form otherwise, e.g. for U+1E9E, which full folding turns into "ss".
+
+import sys, unicodedata
+
+
+def simple_fold(c):
+	for f in (c.casefold(), c.lower()):
+		if len(f) == 1:
+			return f
+	return c
+
+
+def main():
+	folds = {}
+	for cp in range(sys.maxunicode + 1):
+		if 0xD800 <= cp < 0xE000:
+			continue
+		f = ord(simple_fold(chr(cp)))
+		if f != cp:
+			assert (cp < 0x10000) == (f < 0x10000)
+			folds[cp] = f
+
+	# BMP: blocks of 256 differences, modulo 2 ** 16, shared when equal
+	blocks, index = [[0] * 256], []
+	for hi in range(256):
+		block = [(folds.get(hi << 8 | lo, hi << 8 | lo) - (hi << 8 | lo)) & 0xFFFF for lo in range(256)]
+		if block not in blocks:
+			blocks.append(block)
+		index.append(blocks.index(block))
+
+	# astral planes: runs of consecutive code points with the same difference
+	ranges = []
+	for cp in sorted(c for c in folds if c >= 0x10000):
+		delta = folds[cp] - cp
+		if ranges and ranges[-1][1] == cp - 1 and ranges[-1][2] == delta:
+			ranges[-1][1] = cp
+		else:
+			ranges.append([cp, cp, delta])
+
+	out = sys.stdout
+	out.write("/* Generated by gen_casefold.py from Unicode %s; do not edit. */\n\n" % unicodedata.unidata_version)
+	out.write("static const uint8_t fold_index[256] = {\n")
+	for i in range(0, 256, 16):
+		out.write("\t" + ", ".join("%d" % x for x in index[i:i + 16]) + ",\n")
+	out.write("};\n\n")
+	out.write("static const uint16_t fold_blocks[%d][256] = {\n" % len(blocks))
+	for block in blocks:
+		out.write("\t{\n")
+		for i in range(0, 256, 8):
+			out.write("\t\t" + ", ".join("0x%04x" % x for x in block[i:i + 8]) + ",\n")
+		out.write("\t},\n")
+	out.write("};\n\n")
+	out.write("static const struct fold_range fold_ranges[%d] = {\n" % len(ranges))
+	for first, last, delta in ranges:
+		out.write("\t{0x%05x, 0x%05x, %d},\n" % (first, last, delta))
+	out.write("};\n")
+
+
+if __name__ == "__main__":
+	main()
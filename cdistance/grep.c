@@ -0,0 +1,82 @@
+#define DISTANCE_BUILD
+#include "core.h"
+
+/* The lines of a text are searched independently of each other, so that a
+text can be cut into chunks at any position, each chunk holding the lines
+which start in it; the lines are found with memchr, which is much faster than
+the comparisons. */
+
+
+static int
+line_hits_append(struct distance_line_hit **hits, dist_ssize_t *nhits, dist_ssize_t *cap,
+	const struct distance_line_hit *hit)
+{
+	struct distance_line_hit *tmp;
+
+	if (*nhits == *cap) {
+		*cap = (*cap ? 2 * *cap : 64);
+		if ((tmp = (struct distance_line_hit *)realloc(*hits, *cap * sizeof(struct distance_line_hit))) == NULL)
+			return DISTANCE_ENOMEM;
+		*hits = tmp;
+	}
+	(*hits)[(*nhits)++] = *hit;
+	return DISTANCE_OK;
+}
+
+
+DISTANCE_API int
+distance_grep(const struct distance_pattern *const *patterns, dist_ssize_t npatterns, int mode,
+	dist_ssize_t max_dist, const void *text, dist_ssize_t len, dist_ssize_t from, dist_ssize_t to,
+	struct distance_line_hit **hits, dist_ssize_t *nhits, dist_ssize_t *nlines)
+{
+	const char *data = (const char *)text, *nl;
+	struct distance_line_hit hit;
+	dist_ssize_t cap = 0, qlen;
+	int status = DISTANCE_OK, width;
+
+	if (npatterns < 0 || max_dist < 0 || len < 0 || from < 0 || from > to
+		|| (mode != DISTANCE_GREP_LINE && mode != DISTANCE_GREP_SUBSTRING))
+		return DISTANCE_EINVAL;
+	*hits = NULL;
+	*nhits = *nlines = 0;
+	if (to > len)
+		to = len;
+
+	// the first line which starts at `from` or after it
+	if (from > 0 && from < to) {
+		if ((nl = (const char *)memchr(data + from - 1, '\n', to - from + 1)) == NULL)
+			return DISTANCE_OK;
+		from = nl - data + 1;
+	}
+
+	for (hit.line = 0, hit.start = from; hit.start < to; hit.line++) {
+		nl = (const char *)memchr(data + hit.start, '\n', len - hit.start);
+		hit.end = (nl ? nl - data : len);
+		for (hit.index = 0; hit.index < npatterns; hit.index++) {
+			if (mode == DISTANCE_GREP_LINE)
+				status = distance_pattern_levenshtein(patterns[hit.index], data + hit.start, 1,
+					hit.end - hit.start, max_dist, &hit.dist);
+			else {
+				distance_pattern_query(patterns[hit.index], &width, &qlen);
+				// no substring can be close enough
+				if (qlen - (hit.end - hit.start) > max_dist)
+					continue;
+				status = distance_pattern_search(patterns[hit.index], data + hit.start, 1,
+					hit.end - hit.start, max_dist, &hit.dist);
+			}
+			if (status != DISTANCE_OK)
+				goto On_Error;
+			if (hit.dist != -1 && (status = line_hits_append(hits, nhits, &cap, &hit)) != DISTANCE_OK)
+				goto On_Error;
+		}
+		hit.start = hit.end + 1;
+	}
+	*nlines = hit.line;
+	return DISTANCE_OK;
+
+	On_Error:
+		free(*hits);
+		*hits = NULL;
+		*nhits = 0;
+		return status;
+}
@@ -1,24 +1,28 @@
-#include "distance.h"
+#include "core.h"
 
-static Py_ssize_t
-hamming(unicode *seq1, unicode *seq2, Py_ssize_t len)
+static int
+hamming(unicode *seq1, unicode *seq2, dist_ssize_t len, dist_ssize_t *dist)
 {
-	Py_ssize_t i, dist = 0;
+	dist_ssize_t i, d = 0;
 #ifdef SEQUENCE_COMP
 	int comp;
 #endif
 	
+	STAT_PATH(HAMMING, KERNEL_TYPE, DISTANCE_STATS_DP);
+	STAT_ADD(HAMMING, cells, len);
+
 	for (i = 0; i < len; i++) {
 #ifdef SEQUENCE_COMP
 		comp = SEQUENCE_COMP(seq1, i, seq2, i);
 		if (comp == -1)
-			return -1;
+			return DISTANCE_ECOMPARE;
 		if (!comp)
 #else
 		if (seq1[i] != seq2[i])
 #endif
-			dist++;
+			d++;
 	}
 
-	return dist;
+	*dist = d;
+	return DISTANCE_OK;
 }
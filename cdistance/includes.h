@@ -1,5 +1,5 @@
 #define hamming_doc \
-"hamming(seq1, seq2, normalized=False)\n\
+"hamming(seq1, seq2, normalized=False, fold=\"none\")\n\
 \n\
 Compute the Hamming distance between the two sequences `seq1` and `seq2`.\n\
 The Hamming distance is the number of differing items in two ordered\n\
@@ -12,7 +12,10 @@ otherwise, it will be a float between 0 and 1 included, where 0 means\n\
 equal, and 1 totally different. Normalized hamming distance is computed as:\n\
 \n\
     0.0                         if len(seq1) == 0\n\
-    hamming_dist / len(seq1)    otherwise"
+    hamming_dist / len(seq1)    otherwise\n\
+\n\
+`fold` has the same sense as in `levenshtein`. Nucleotide sequences\n\
+can be compared as `PackedDNA`."
 
 
 #define jaccard_doc \
@@ -34,7 +37,7 @@ The return value is a float between 0 and 1, where 0 means equal, and 1 totally
 
 
 #define lcsubstrings_doc \
-"lcsubstrings(seq1, seq2, positions=False)\n\
+"lcsubstrings(seq1, seq2, positions=False, fold=\"none\", workers=1)\n\
 \n\
 Find the longest common substring(s) in the sequences `seq1` and `seq2`.\n\
 \n\
@@ -50,11 +53,19 @@ Example:\n\
     >>> lcsubstrings(\"sedentar\", \"dentist\")\n\
     {'dent'}\n\
     >>> lcsubstrings(\"sedentar\", \"dentist\", positions=True)\n\
-    (4, [(2, 0)])"
+    (4, [(2, 0)])\n\
+\n\
+`fold` has the same sense as in `levenshtein`; the substrings are then\n\
+returned as they are in the shortest sequence, or in `seq2` if both have\n\
+the same length.\n\
+\n\
+`workers` has the same sense as in `levenshtein`: with the C extension,\n\
+long strings are compared by several threads, and the result is the same,\n\
+positions included."
 
 
 #define ilevenshtein_doc \
-"ilevenshtein(seq1, seqs, max_dist=-1)\n\
+"ilevenshtein(seq1, seqs, max_dist=-1, workers=1, ordered=True, chunk_size=1024, out=None, dense=False, fold=\"none\")\n\
 \n\
 Compute the Levenshtein distance between the sequence `seq1` and the series\n\
 of      sequences `seqs`.\n\
@@ -68,11 +79,49 @@ The return value is a series of pairs (distance, sequence).\n\
 \n\
 The sequence objects in `seqs` are expected to be of the same kind than\n\
 the reference sequence in the C implementation; the same holds true for\n\
-`ifast_comp`."
+`ifast_comp`.\n\
+\n\
+In the C implementation, the distances can be computed by a pool of\n\
+threads, without holding the GIL:\n\
+\n\
+    `workers`: number of threads; 0 means one per CPU, and 1 (the default)\n\
+    computes the distances in the calling thread\n\
+    `ordered`: if false, the results are returned as soon as they are\n\
+    computed, rather than in the order of `seqs`\n\
+    `chunk_size`: number of sequences handed to the threads at once; at most\n\
+    twice as many sequences are read ahead of the consumer\n\
+\n\
+Only strings are processed in parallel; other sequences are compared in\n\
+the calling thread whatever the value of `workers`. These parameters are\n\
+accepted but ignored in the pure Python implementation; the same holds\n\
+true for `ifast_comp`.\n\
+\n\
+Creating a pair for each result can be avoided by passing two arrays of\n\
+signed integers of the same length, e.g. `array.array(\"q\")` or numpy\n\
+arrays, as `out`:\n\
+\n\
+    `out`: a pair (indices, distances); the positions of the results in\n\
+    `seqs` and their distances are written to the start of these arrays,\n\
+    and the iterator returns the number of results written each time they\n\
+    are full, and once more for the last results; an error met once\n\
+    some results were written is raised by the next iteration\n\
+    `dense`: if true, a result is returned for every sequence of `seqs`,\n\
+    with a distance of -1 for those beyond `max_dist`\n\
+\n\
+    >>> indices, dists = array(\"q\", [0] * 2), array(\"q\", [0] * 2)\n\
+    >>> for n in ilevenshtein(\"foo\", [\"fo\", \"bar\", \"foob\"], 1, out=(indices, dists)):\n\
+    ...     print(list(indices[:n]), list(dists[:n]))\n\
+    [0, 2] [1, 1]\n\
+\n\
+The arrays are locked until the iterator is destroyed. With several\n\
+workers and `ordered` false, the indices are not in increasing order.\n\
+\n\
+`fold` has the same sense as in `levenshtein`; the sequences of `seqs` are\n\
+returned as they are. The same holds true for the other iterators."
 
 
 #define ifast_comp_doc \
-"ifast_comp(seq1, seqs, transpositions=False)\n\
+"ifast_comp(seq1, seqs, transpositions=False, workers=1, ordered=True, chunk_size=1024, out=None, dense=False, fold=\"none\")\n\
 \n\
 Return an iterator over all the sequences in `seqs` which distance from\n\
 `seq1` is lower or equal to 2. The sequences which distance from the\n\
@@ -81,6 +130,8 @@ reference sequence is higher than that are dropped.\n\
     `seq1`: the reference sequence.\n\
     `seqs`: a series of sequences (can be a generator)\n\
     `transpositions` has the same sense than in `fast_comp`.\n\
+    `workers`, `ordered`, `chunk_size`, `out` and `dense` have the same\n\
+    sense than in `ilevenshtein`.\n\
 \n\
 The return value is a series of pairs (distance, sequence).\n\
 \n\
@@ -93,7 +144,7 @@ significant order:\n\
 
 
 #define fast_comp_doc \
-"fast_comp(seq1, seq2, transpositions=False)\n\
+"fast_comp(seq1, seq2, transpositions=False, fold=\"none\")\n\
 \n\
 Compute the distance between the two sequences `seq1` and `seq2` up to a\n\
 maximum of 2 included, and return it. If the edit distance between the two\n\
@@ -111,11 +162,13 @@ This is faster than `levenshtein` by an order of magnitude, but on the\n\
 other hand is of limited use.\n\
 \n\
 The algorithm comes from `http://writingarchives.sakura.ne.jp/fastcomp`.\n\
-I've added transpositions support to the original code."
+I've added transpositions support to the original code.\n\
+\n\
+`fold` has the same sense as in `levenshtein`."
 
 
 #define levenshtein_doc \
-"levenshtein(seq1, seq2, max_dist=-1, normalized=False)\n\
+"levenshtein(seq1, seq2, normalized=False, max_dist=-1, fold=\"none\", workers=1)\n\
 \n\
 Compute the absolute Levenshtein distance between the two sequences\n\
 `seq1` and `seq2`.\n\
@@ -144,11 +197,36 @@ given threshold.\n\
 \n\
 The `normalized` parameter is here for backward compatibility; providing\n\
 it will result in a call to `nlevenshtein`, which should be used directly\n\
-instead. "
+instead. \n\
+\n\
+Strings can be compared regardless of their case with `fold`:\n\
+\n\
+    \"none\": the items are compared as they are (the default)\n\
+    \"ascii\": the ASCII letters are lowercased\n\
+    \"simple\": the simple case folding of Unicode, which maps every\n\
+    character to a single one, e.g. \"Σ\" and \"ς\" to \"σ\", but leaves \"ß\"\n\
+    as it is\n\
+\n\
+    >>> levenshtein(\"Straße\", \"STRASSE\", fold=\"simple\")\n\
+    2\n\
+\n\
+Byte strings are only folded as ASCII, as their encoding is unknown; other\n\
+sequences can't be folded. The strings are folded before being compared,\n\
+into a copy which is only made if some character changes.\n\
+\n\
+In the C implementation, two long strings can be compared by several\n\
+threads, without holding the GIL, with `workers`: the number of threads,\n\
+0 meaning one per CPU. The matrix of the computation is then cut into\n\
+tiles, which are computed along its anti-diagonals. Strings of less than\n\
+a few thousand characters are compared in the calling thread, as are\n\
+near-identical strings. This parameter is accepted but ignored in the pure\n\
+Python implementation.\n\
+\n\
+Nucleotide sequences can be compared as `PackedDNA`."
 
 
 #define nlevenshtein_doc \
-"nlevenshtein(seq1, seq2, method=1)\n\
+"nlevenshtein(seq1, seq2, method=1, fold=\"none\")\n\
 \n\
 Compute the normalized Levenshtein distance between `seq1` and `seq2`.\n\
 \n\
@@ -174,101 +252,758 @@ better than the first one for parallelisms of symbols between the sequences.\n\
 For the rationale behind the use of the second method, see:\n\
 Heeringa, \"Measuring Dialect Pronunciation Differences using Levenshtein\n\
 Distance\", 2004, p. 130 sq, which is available online at:\n\
-http://www.let.rug.nl/~heeringa/dialectology/thesis/thesis.pdf"
-
-
-
-
-
-#define SEQUENCE_COMPARE(s1, i1, s2, i2) \
-(PyObject_RichCompareBool( \
-	PySequence_Fast_GET_ITEM((s1), (i1)), \
-	PySequence_Fast_GET_ITEM((s2), (i2)), \
-	Py_EQ) \
-)
-
-#define unicode unicode
-#define hamming uhamming
-#include "hamming.c"
-#undef unicode
-#undef hamming
-
-#define unicode byte
-#define hamming bhamming
-#include "hamming.c"
-#undef unicode
-#undef hamming
-
-#define SEQUENCE_COMP SEQUENCE_COMPARE
-#define unicode array
-#define hamming ahamming
-#include "hamming.c"
-#undef unicode
-#undef hamming
-#undef SEQUENCE_COMP
-
-#define unicode unicode
-#define levenshtein ulevenshtein
-#define nlevenshtein unlevenshtein
-#include "levenshtein.c"
-#undef unicode
-#undef levenshtein
-#undef nlevenshtein
-
-#define unicode byte
-#define levenshtein blevenshtein
-#define nlevenshtein bnlevenshtein
-#include "levenshtein.c"
-#undef unicode
-#undef levenshtein
-#undef nlevenshtein
-
-#define SEQUENCE_COMP SEQUENCE_COMPARE
-#define unicode array
-#define levenshtein alevenshtein
-#define nlevenshtein anlevenshtein
-#include "levenshtein.c"
-#undef unicode
-#undef levenshtein
-#undef nlevenshtein
-#undef SEQUENCE_COMP
-
-#define unicode unicode
-#define lcsubstrings ulcsubstrings
-#include "lcsubstrings.c"
-#undef unicode
-#undef lcsubstrings
-
-#define unicode byte
-#define lcsubstrings blcsubstrings
-#include "lcsubstrings.c"
-#undef unicode
-#undef lcsubstrings
-
-#define SEQUENCE_COMP SEQUENCE_COMPARE
-#define unicode array
-#define lcsubstrings alcsubstrings
-#include "lcsubstrings.c"
-#undef unicode
-#undef lcsubstrings
-#undef SEQUENCE_COMP
-
-#define unicode unicode
-#define fastcomp ufastcomp
-#include "fastcomp.c"
-#undef unicode
-#undef fastcomp
-
-#define unicode byte
-#define fastcomp bfastcomp
-#include "fastcomp.c"
-#undef unicode
-#undef fastcomp
-
-#define SEQUENCE_COMP SEQUENCE_COMPARE
-#define unicode array
-#define fastcomp afastcomp
-#include "fastcomp.c"
-#undef unicode
-#undef fastcomp
-#undef SEQUENCE_COMP
+http://www.let.rug.nl/~heeringa/dialectology/thesis/thesis.pdf\n\
+\n\
+`fold` has the same sense as in `levenshtein`."
+
+
+#define jaro_doc \
+"jaro(seq1, seq2, min_score=None, fold=\"none\")\n\
+\n\
+Compute the Jaro similarity between the two sequences `seq1` and `seq2`.\n\
+\n\
+Two items are said to match if they are equal and not farther than\n\
+`max(len(seq1), len(seq2)) // 2 - 1` positions apart. With `m` the number of\n\
+matching items and `t` half the number of matching items which are not in\n\
+the same order in both sequences, the similarity is computed as:\n\
+\n\
+    1.0                                                if len(seq1) == len(seq2) == 0\n\
+    0.0                                                if m == 0\n\
+    (m / len(seq1) + m / len(seq2) + (m - t) / m) / 3  otherwise\n\
+\n\
+The return value is a float between 0 and 1, where 1 means equal, and 0\n\
+totally different. For example:\n\
+\n\
+    >>> jaro(\"martha\", \"marhta\")\n\
+    0.9444444444444445\n\
+\n\
+If `min_score` is provided, the computation stops as soon as it is clear\n\
+that the similarity will be lower than this value, and -1.0 is returned.\n\
+\n\
+`fold` has the same sense as in `levenshtein`."
+
+
+#define jaro_winkler_doc \
+"jaro_winkler(seq1, seq2, prefix_weight=0.1, min_score=None, fold=\"none\")\n\
+\n\
+Compute the Jaro-Winkler similarity between the two sequences `seq1` and\n\
+`seq2`.\n\
+\n\
+This is the Jaro similarity (see `jaro`), raised for sequences which have a\n\
+common prefix. With `l` the length of this prefix, up to a maximum of 4, the\n\
+similarity is computed as:\n\
+\n\
+    jaro + l * prefix_weight * (1 - jaro)\n\
+\n\
+`prefix_weight` should be between 0 and 0.25 included, so that the return\n\
+value is a float between 0 and 1, where 1 means equal, and 0 totally\n\
+different. For example:\n\
+\n\
+    >>> jaro_winkler(\"martha\", \"marhta\")\n\
+    0.9611111111111111\n\
+\n\
+If `min_score` is provided, the computation stops as soon as it is clear\n\
+that the similarity will be lower than this value, and -1.0 is returned.\n\
+\n\
+`fold` has the same sense as in `levenshtein`."
+
+
+#define ijaro_doc \
+"ijaro(seq1, seqs, min_score=None, fold=\"none\")\n\
+\n\
+Compute the Jaro similarity between the sequence `seq1` and the series\n\
+of sequences `seqs`.\n\
+\n\
+    `seq1`: the reference sequence\n\
+    `seqs`: a series of sequences (can be a generator)\n\
+    `min_score`: if provided, only the sequences which similarity with the\n\
+    reference sequence is higher or equal to this value will be returned.\n\
+\n\
+The return value is a series of pairs (similarity, sequence)."
+
+
+#define ijaro_winkler_doc \
+"ijaro_winkler(seq1, seqs, prefix_weight=0.1, min_score=None, fold=\"none\")\n\
+\n\
+Compute the Jaro-Winkler similarity between the sequence `seq1` and the\n\
+series of sequences `seqs`.\n\
+\n\
+    `seq1`: the reference sequence\n\
+    `seqs`: a series of sequences (can be a generator)\n\
+    `prefix_weight` has the same sense than in `jaro_winkler`.\n\
+    `min_score`: if provided, only the sequences which similarity with the\n\
+    reference sequence is higher or equal to this value will be returned.\n\
+\n\
+The return value is a series of pairs (similarity, sequence)."
+
+
+#define stats_doc \
+"stats()\n\
+\n\
+Return the counters collected by the C kernels since the module was\n\
+loaded, or since the last call to `reset_stats`.\n\
+\n\
+The return value is a dictionary mapping the name of each kernel\n\
+(\"levenshtein\", \"fast_comp\", \"jaro\"...) to a dictionary with the keys:\n\
+\n\
+    `calls`: number of calls\n\
+    `cells`: number of dynamic programming cells (or items) evaluated\n\
+    `early_exits`: number of calls which stopped early, by reason:\n\
+    \"length\" when the lengths alone exceed the limit, \"bound\" when the\n\
+    limit is exceeded during the computation\n\
+    `bytes_allocated`: total size of the memory allocated\n\
+    `paths`: number of calls per item type, algorithm and instruction set\n\
+    level the kernel was compiled for (see `cpu_features`), e.g.\n\
+    \"u8/bitpar/avx2\"\n\
+    `latency_ns`: durations of a sample of the calls (one in 64), as a\n\
+    dictionary mapping upper bounds in nanoseconds to numbers of calls\n\
+\n\
+Kernels which were never called are omitted. Counters are kept per thread,\n\
+and summed when this function is called.\n\
+\n\
+The counters are only collected if the C extension was built with\n\
+`--with-stats`; otherwise, and with the pure Python implementation, an\n\
+empty dictionary is returned."
+
+
+#define reset_stats_doc \
+"reset_stats()\n\
+\n\
+Reset the counters returned by `stats` to zero."
+
+
+#define write_lexicon_doc \
+"write_lexicon(path, words)\n\
+\n\
+Write the strings `words` to a lexicon file, to be opened with\n\
+`Lexicon.open`.\n\
+\n\
+The words are stored sorted by length, the words of the same length\n\
+keeping their relative order. Each character is stored on 1, 2 or 4 bytes,\n\
+depending on the widest character of the whole lexicon."
+
+
+#define Lexicon_doc \
+"Lexicon(path)\n\
+\n\
+A read-only list of strings, stored in a file written by `write_lexicon`.\n\
+\n\
+The file is memory-mapped rather than read: opening a lexicon is fast\n\
+whatever its size, and processes opening the same file share its memory.\n\
+In the C implementation, the words are compared without creating Python\n\
+objects for them.\n\
+\n\
+Lexicons support `len()`, indexing, and can be used as context managers,\n\
+which close them on exit."
+
+
+#define Lexicon_open_doc \
+"open(path)\n\
+\n\
+Open the lexicon stored in the file `path`."
+
+
+#define Lexicon_close_doc \
+"close()\n\
+\n\
+Unmap the file. The lexicon can't be used anymore afterwards."
+
+
+#define Lexicon_scan_doc \
+"scan(query, metric=\"levenshtein\", max_dist=-1)\n\
+\n\
+Compare the string `query` with the words of the lexicon, and return\n\
+the list of pairs (distance, word) for the words which distance is lower\n\
+or equal to `max_dist`, or for all the words if `max_dist` is negative.\n\
+\n\
+    `metric`: \"levenshtein\", \"hamming\" (only the words of the same length\n\
+    as the query are compared) or \"fast_comp\" (only the words at distance\n\
+    2 or less are returned)\n\
+\n\
+The pairs are returned in the order of the lexicon, i.e. by increasing\n\
+length of the words. Only the words which length is compatible with\n\
+`max_dist` are compared."
+
+
+#define CandidateSet_doc \
+"CandidateSet(seqs, q=2)\n\
+\n\
+A set of strings to be searched for the ones close to a query, as with\n\
+`ilevenshtein`, but without comparing all of them.\n\
+\n\
+    `seqs`: the strings, either unicode or byte strings\n\
+    `q`: length of the q-grams, between 1 and 8\n\
+\n\
+The strings are grouped by length, and the profile of their q-grams\n\
+(substrings of length `q`) is computed once. When searching with a bound,\n\
+only the strings which length is compatible with it are looked at, and\n\
+those which don't share enough q-grams with the query are rejected before\n\
+computing their distance: strings at distance `k` share at least\n\
+`max(len1, len2) - q + 1 - k * q` q-grams.\n\
+\n\
+Candidate sets support `len()` and indexing."
+
+
+#define CandidateSet_add_doc \
+"add(seq)\n\
+\n\
+Add the string `seq` to the set."
+
+
+#define CandidateSet_search_doc \
+"search(query, max_dist=-1, metric=\"levenshtein\")\n\
+\n\
+Return the list of pairs (distance, string) for the strings of the set\n\
+which distance from `query` is lower or equal to `max_dist`, or for all\n\
+the strings if `max_dist` is negative.\n\
+\n\
+    `metric`: \"levenshtein\", \"hamming\" or \"fast_comp\", as in\n\
+    `Lexicon.scan`\n\
+\n\
+The pairs are returned in the order in which the strings were added."
+
+
+#define Trie_doc \
+"Trie(seqs)\n\
+\n\
+A set of strings stored as a prefix tree, to be searched for the ones\n\
+close to a query with the Levenshtein distance.\n\
+\n\
+    `seqs`: the strings, either unicode or byte strings\n\
+\n\
+The search walks the tree keeping a row of the Levenshtein matrix for each\n\
+depth: the prefixes shared by several strings are compared with the query\n\
+only once, and the subtrees in which no string can be close enough to the\n\
+query are skipped. This makes looking up a word in a large vocabulary\n\
+cheaper than comparing it with each word, as `ilevenshtein` does.\n\
+\n\
+A string present several times is only returned once. Tries support\n\
+`len()` and indexing, which give the strings as they were passed."
+
+
+#define Trie_search_doc \
+"search(query, max_dist=-1)\n\
+\n\
+Return the list of pairs (distance, string) for the strings of the trie\n\
+which Levenshtein distance from `query` is lower or equal to `max_dist`,\n\
+or for all the strings if `max_dist` is negative.\n\
+\n\
+The pairs are returned in the lexicographic order of the strings."
+
+
+#define lcs_length_doc \
+"lcs_length(seq1, seq2, fold=\"none\")\n\
+\n\
+Compute the length of the longest common subsequence of the two\n\
+sequences `seq1` and `seq2`, i.e. the highest number of items which appear\n\
+in both sequences in the same order, not necessarily contiguously. For\n\
+example:\n\
+\n\
+    >>> lcs_length(\"abcd\", \"acbd\")\n\
+    3\n\
+\n\
+The items of the sequences are expected to be hashable.\n\
+\n\
+In the C implementation, strings are compared with the bit-parallel\n\
+algorithm of Allison and Dix, on as many 64 bits words as needed to hold\n\
+the shortest sequence.\n\
+\n\
+`fold` has the same sense as in `levenshtein`."
+
+
+#define indel_distance_doc \
+"indel_distance(seq1, seq2, normalized=False, max_dist=-1, fold=\"none\")\n\
+\n\
+Compute the indel distance between the two sequences `seq1` and `seq2`,\n\
+i.e. the number of insertions and deletions necessary for transforming one\n\
+sequence into the other. It is related to the longest common subsequence\n\
+by:\n\
+\n\
+    indel_distance = len(seq1) + len(seq2) - 2 * lcs_length\n\
+\n\
+If `normalized` evaluates to `True`, the distance is divided by the sum of\n\
+the lengths of the sequences, and is a float between 0 (equal) and 1 (no\n\
+item in common); it is 0.0 if both sequences are empty.\n\
+\n\
+`max_dist` has the same sense as in `levenshtein`, and is ignored when the\n\
+distance is normalized.\n\
+\n\
+`fold` has the same sense as in `levenshtein`."
+
+
+#define iindel_distance_doc \
+"iindel_distance(seq1, seqs, max_dist=-1, workers=1, ordered=True, chunk_size=1024, out=None, dense=False, fold=\"none\")\n\
+\n\
+Compute the indel distance between the sequence `seq1` and the series\n\
+of sequences `seqs`.\n\
+\n\
+    `seq1`: the reference sequence\n\
+    `seqs`: a series of sequences (can be a generator)\n\
+    `max_dist`: if provided and >= 0, only the sequences which distance from\n\
+    the reference sequence is lower or equal to this value will be returned.\n\
+    `workers`, `ordered`, `chunk_size`, `out` and `dense` have the same\n\
+    sense than in `ilevenshtein`.\n\
+\n\
+The return value is a series of pairs (distance, sequence)."
+
+
+#define common_substrings_doc \
+"common_substrings(seq1, seq2, min_len=1, fold=\"none\")\n\
+\n\
+Return an iterator over the maximal common substrings of the sequences\n\
+`seq1` and `seq2` which are at least `min_len` items long, as triples\n\
+(start pos in seq1, start pos in seq2, length). A common substring is\n\
+maximal if it can't be extended on either side.\n\
+\n\
+Unlike `lcsubstrings`, all the common substrings are returned, not only the\n\
+longest ones, and they are computed as they are consumed rather than\n\
+stored: memory use doesn't depend on their number. They are returned\n\
+diagonal by diagonal, i.e. by increasing `pos in seq2 - pos in seq1`, then\n\
+by increasing position.\n\
+\n\
+    >>> list(common_substrings(\"sedentar\", \"dentist\", min_len=2))\n\
+    [(2, 0, 4)]\n\
+\n\
+Only one item out of `min_len` needs to be compared until a match is\n\
+found, so that a high `min_len` makes the search faster.\n\
+\n\
+`fold` has the same sense as in `levenshtein`."
+
+
+#define Vocabulary_doc \
+"Vocabulary(tokens=())\n\
+\n\
+A mapping of hashable tokens to dense integer ids, to encode sequences\n\
+of tokens, e.g. tokenized sentences, into arrays of integers.\n\
+\n\
+    `tokens`: tokens to give the first ids to, in order\n\
+\n\
+Lists and tuples are compared item by item with the Python API, hashing\n\
+and comparing the same tokens again on every call. Arrays of unsigned\n\
+integers are compared like strings instead, without touching Python\n\
+objects, so that encoding a corpus once makes every later comparison much\n\
+cheaper. The distance functions and the iterators accept the encoded\n\
+arrays; two sequences must be encoded with the same vocabulary to be\n\
+compared.\n\
+\n\
+Vocabularies support `len()`, `in` and indexing, which gives the token of\n\
+an id."
+
+
+#define Vocabulary_encode_doc \
+"encode(seq, add=True)\n\
+\n\
+Return the ids of the tokens of `seq` as an array of unsigned integers.\n\
+The tokens not in the vocabulary yet are given new ids, unless `add` is\n\
+false, in which case a `KeyError` is raised for them.\n\
+\n\
+The array is of type \"B\", \"H\" or \"I\", the smallest that can hold the ids\n\
+of all the tokens of the vocabulary."
+
+
+#define Vocabulary_decode_doc \
+"decode(ids)\n\
+\n\
+Return the list of the tokens which ids are in `ids`."
+
+
+#define Pattern_doc \
+"Pattern(seq, metrics=None, q=2)\n\
+\n\
+A query compiled for being compared with many sequences, as returned by\n\
+`compile_query`.\n\
+\n\
+    `seq`: the query\n\
+    `metrics`: names of the metrics to prepare the query for, among\n\
+    \"levenshtein\", \"lcs_length\", \"indel_distance\" and \"qgrams\"; all of them\n\
+    by default\n\
+    `q`: length of the q-grams of the profile, between 1 and 8\n\
+\n\
+The functions of the module which compare two sequences, the iterators,\n\
+and the searches of lexicons, candidate sets and tries accept a pattern in\n\
+place of their first sequence. In the C implementation, the match vectors\n\
+of the bit-parallel kernels of `levenshtein` (for queries of at most 64\n\
+items), `lcs_length` and `indel_distance` are then computed once rather\n\
+than for each comparison, and `CandidateSet.search` reuses the q-gram\n\
+profile of the query if it was built with the `q` of the set. These only\n\
+apply to strings compared with strings of the same type, and to arrays of\n\
+integers (see `Vocabulary`); other sequences are compared as usual.\n\
+\n\
+Patterns can be pickled, e.g. for being sent to other processes. Lists\n\
+are stored as tuples, and arrays are copied, so that the query can't\n\
+change after it is compiled."
+
+
+#define compile_query_doc \
+"compile_query(seq, metrics=None, q=2)\n\
+\n\
+Return a `Pattern` for comparing `seq` with many sequences, with the\n\
+structures the metrics in `metrics` need computed once.\n\
+\n\
+    >>> query = compile_query(\"kitten\", metrics=[\"levenshtein\"])\n\
+    >>> [levenshtein(query, word) for word in (\"sitting\", \"mitten\")]\n\
+    [3, 1]\n\
+\n\
+See `Pattern` for the parameters."
+
+
+#define QGramProfile_doc \
+"QGramProfile(seq, q=None)\n\
+\n\
+The profile of the q-grams (substrings of `q` items) of a sequence, for\n\
+being compared with `qgram_distance`, `cosine` and `overlap` without\n\
+extracting its q-grams again.\n\
+\n\
+    `seq`: a string, or an array of integers (see `Vocabulary`)\n\
+    `q`: length of the q-grams, 3 by default\n\
+\n\
+Profiles support `len()`, which is the number of q-grams of the sequence,\n\
+`len(seq) - q + 1`.\n\
+\n\
+In the C implementation, a profile is the sorted array of the hashes of\n\
+the distinct q-grams, with their counts, and is compared with another one\n\
+by merging them. The hashes have 64 bits, which makes collisions\n\
+negligible."
+
+
+#define qgram_distance_doc \
+"qgram_distance(seq1, seq2, q=None)\n\
+\n\
+Compute the q-gram distance between the sequences `seq1` and `seq2`,\n\
+i.e. the number of q-grams (substrings of `q` items) which appear in only\n\
+one of them, counting repeated q-grams as many times as they appear:\n\
+\n\
+    >>> qgram_distance(\"abcd\", \"abce\", q=2)\n\
+    2\n\
+\n\
+The sequences are strings of the same type, or arrays of integers, and\n\
+either of them can be a `QGramProfile`. `q` applies to the sequences which\n\
+are not profiles; it defaults to the `q` of the other sequence if it is a\n\
+profile, and to 3 otherwise. The same holds true for `cosine` and\n\
+`overlap`."
+
+
+#define cosine_doc \
+"cosine(seq1, seq2, q=None)\n\
+\n\
+Compute the cosine distance between the q-gram profiles of the\n\
+sequences `seq1` and `seq2`, i.e. 1 minus the cosine of the angle of the\n\
+vectors of the counts of their q-grams.\n\
+\n\
+The return value is a float between 0 and 1, where 0 means equal q-grams\n\
+in the same proportions, and 1 no q-gram in common. It is 0.0 if both\n\
+sequences are shorter than `q`, and 1.0 if only one of them is."
+
+
+#define overlap_doc \
+"overlap(seq1, seq2, q=None)\n\
+\n\
+Compute the overlap distance between the q-gram profiles of the\n\
+sequences `seq1` and `seq2`, i.e. 1 minus the number of q-grams they have\n\
+in common divided by the number of q-grams of the shortest one.\n\
+\n\
+The return value is a float between 0 and 1, where 0 means that the\n\
+q-grams of one of the sequences all appear in the other one. It is 0.0 if\n\
+both sequences are shorter than `q`, and 1.0 if only one of them is."
+
+
+#define find_approx_doc \
+"find_approx(pattern, text, max_dist, starts=False)\n\
+\n\
+Search `text` for the substrings which are at Levenshtein distance\n\
+`max_dist` or less from `pattern`, and return an iterator over the pairs\n\
+(end, distance), where `text[:end]` is the text up to the end of a\n\
+substring, and `distance` the lowest distance of the substrings ending\n\
+there. With `starts` true, the iterator returns triples (start, end,\n\
+distance) instead, `text[start:end]` being the shortest of these\n\
+substrings:\n\
+\n\
+    >>> list(find_approx(\"needle\", \"a neddle, needles\", 1, starts=True))\n\
+    [(2, 8, 1), (10, 15, 1), (10, 16, 0), (10, 17, 1)]\n\
+\n\
+Every end position within the bound is returned, so that a match with a\n\
+few errors is usually reported at several consecutive ends.\n\
+\n\
+The pattern (which can be a `Pattern`) and the text are strings of the\n\
+same type, or arrays of integers. In the C implementation, the text is\n\
+scanned with the bit-parallel algorithm of Myers, in its semi-global form,\n\
+on as many 64 items words as needed to hold the pattern, and without\n\
+holding the GIL."
+
+
+#define grep_doc \
+"grep(source, patterns, max_dist, mode=\"line\", workers=0, chunk_size=1048576)\n\
+\n\
+Search the lines of a file or of a byte string for approximate matches of\n\
+one or several patterns, and return an iterator over the quadruples (lineno,\n\
+index, distance, line), where `lineno` is the number of the line from 0,\n\
+`index` the index of the pattern, and `line` the line itself, without its\n\
+newline:\n\
+\n\
+    >>> list(grep(b\"foo\\nbarr\\nbaz\\n\", [b\"bar\", b\"qux\"], 1))\n\
+    [(1, 0, 1, b'barr'), (2, 0, 1, b'baz')]\n\
+\n\
+    `source`: the path of a file, as a string or a path-like object, or an\n\
+    object supporting the buffer protocol, e.g. bytes or an `mmap.mmap`\n\
+    `patterns`: a byte string or a `Pattern` of one, or a sequence of them\n\
+    `max_dist`: highest distance of the matches\n\
+    `mode`: \"line\" to compare the whole lines with the patterns, with the\n\
+    Levenshtein distance; \"substring\" to look for the patterns in the lines,\n\
+    as `find_approx` does, `distance` being then the lowest distance of the\n\
+    substrings of the line\n\
+    `workers`: number of threads; 0 (the default) means one per CPU\n\
+    `chunk_size`: number of bytes handed to a thread at once\n\
+\n\
+The lines are separated by \"\\n\"; a \"\\r\" before it is part of the line.\n\
+The results are returned in the order of the lines, and of the patterns\n\
+for each line.\n\
+\n\
+In the C implementation, files are memory-mapped rather than read. The\n\
+text is cut into chunks, searched by a pool of threads without holding\n\
+the GIL, while the results of the previous chunks are returned. `workers`\n\
+and `chunk_size` are ignored in the pure Python implementation."
+
+
+#define cpu_features_doc \
+"cpu_features()\n\
+\n\
+Return the instruction sets the C kernels can use on this machine, as a\n\
+dictionary with the keys:\n\
+\n\
+    `isa`: the level the kernels are running at: \"baseline\", \"sse4.2\" or\n\
+    \"avx2\"\n\
+    `supported`: the levels available, from the lowest\n\
+    `features`: a dictionary mapping the relevant features of the CPU\n\
+    (\"popcnt\", \"sse4.2\", \"avx2\", \"bmi2\", \"avx512f\") to booleans\n\
+\n\
+The kernels are compiled for each level, and the highest one supported by\n\
+the CPU is selected once, when the module is loaded. The environment\n\
+variable DISTANCE_ISA can name a lower level, e.g. for comparing them in\n\
+benchmarks:\n\
+\n\
+    $ DISTANCE_ISA=baseline python bench/bench.py run\n\
+\n\
+Only builds made with GCC for x86 have levels above the baseline; the\n\
+features are then unknown, and reported as false. With the pure Python\n\
+implementation, `isa` is None and `supported` is empty."
+
+
+#define jaccard_join_doc \
+"jaccard_join(sets, threshold, others=None, workers=1)\n\
+\n\
+Find the pairs of sets of `sets` at Jaccard distance `threshold` or\n\
+less, and return them as three arrays of the same length: the index of\n\
+the first set of each pair, the index of the second one, and their\n\
+distance, as computed by `jaccard`:\n\
+\n\
+    >>> jaccard_join([{1, 2, 3}, {\"a\"}, {1, 2, 3, 4}], 0.3)\n\
+    (array('q', [0]), array('q', [2]), array('d', [0.25]))\n\
+\n\
+    `sets`: a sequence of iterables of hashable tokens, e.g. sets, lists,\n\
+    or strings, which are then sets of characters\n\
+    `threshold`: highest distance of the pairs, 0 <= threshold < 1\n\
+    `others`: if given, another sequence of sets, which the sets of `sets`\n\
+    are compared with instead of with each other\n\
+    `workers`: number of threads; 0 means one per CPU\n\
+\n\
+Without `others`, each pair is found once, the first index being lower\n\
+than the second one; with it, the first index is that of a set of\n\
+`sets`, and the second one that of a set of `others`. The pairs are sorted\n\
+by index. Empty sets are never part of a pair.\n\
+\n\
+The sets are compared only if they share one of their rarest tokens, and\n\
+have sizes and rare tokens in common enough for being close, which makes\n\
+the join much faster than comparing all the pairs when the threshold is\n\
+low. In the C implementation, the tokens are interned, and the sets\n\
+compared by `workers` threads without holding the GIL; arrays of\n\
+integers, such as those returned by `Vocabulary.encode`, are taken as\n\
+token ids without being hashed. `workers` is ignored in the pure Python\n\
+implementation."
+
+
+#define SetIndex_doc \
+"SetIndex(sets=())\n\
+\n\
+An index of sets of tokens, searched for the sets most similar to a\n\
+query set, as measured by `jaccard` or `sorensen`, without comparing it\n\
+with all of them.\n\
+\n\
+    `sets`: iterables of hashable tokens, e.g. sets, lists, or strings,\n\
+    which are then sets of characters\n\
+\n\
+The sets are numbered from 0, in the order in which they are added. Set\n\
+indexes support `len()`.\n\
+\n\
+In the C implementation, the tokens are mapped to integer ids, and each\n\
+token has the list of the sets it belongs to, stored as the differences\n\
+between successive indexes in a variable number of bytes; the tokens of\n\
+each set are stored the same way. A query reads the lists of its rarest\n\
+tokens first, computes the distance of each set met for the first time,\n\
+and stops as soon as the sets not met yet can't be closer than the `k`\n\
+found so far. The sets whose size can't give a distance low enough are\n\
+skipped."
+
+
+#define SetIndex_add_doc \
+"add(s)\n\
+\n\
+Add the set of the tokens of `s` to the index."
+
+
+#define SetIndex_topk_doc \
+"topk(query, k, metric=\"jaccard\", min_sim=0.0)\n\
+\n\
+Return the `k` sets of the index closest to the set of the tokens of\n\
+`query`, as a list of pairs (distance, index) sorted by distance, then\n\
+by index:\n\
+\n\
+    >>> index = SetIndex([{\"a\", \"b\", \"c\"}, {\"a\", \"b\"}, {\"x\", \"y\"}])\n\
+    >>> index.topk({\"a\", \"b\", \"d\"}, 2)\n\
+    [(0.33333333333333337, 1), (0.5, 0)]\n\
+\n\
+    `metric`: \"jaccard\" or \"sorensen\"; the distances are those\n\
+    computed by the function of this name\n\
+    `min_sim`: lowest similarity of the sets returned, 1 minus their\n\
+    distance, between 0 and 1\n\
+\n\
+The sets which share no token with the query are never returned, so\n\
+that fewer than `k` sets may be."
+
+
+#define BarcodeSet_doc \
+"BarcodeSet(barcodes)\n\
+\n\
+A whitelist of barcodes, which reads are assigned to.\n\
+\n\
+    `barcodes`: PackedDNA, or strings of bases\n\
+\n\
+The barcodes are numbered from 0, in their order. Barcode sets support\n\
+`len()`.\n\
+\n\
+In the C implementation, when all the barcodes have 32 bases or less, and\n\
+no N, they are stored in a hash table. A read is then looked up as it is,\n\
+and, if it isn't a barcode, so are the sequences at distance 1 of it,\n\
+which are derived from its packed bases by a few bit operations: these\n\
+lookups replace the comparison of the read with each barcode, which is\n\
+only done if no barcode is at distance 0 or 1, and `max_dist` is higher."
+
+
+#define BarcodeSet_assign_doc \
+"assign(reads, max_dist=1, metric=\"hamming\", workers=1)\n\
+\n\
+Assign each read of `reads` to its closest barcode, and return\n\
+two arrays: the index of the barcode of each read, -1 if no barcode\n\
+is at distance `max_dist` or less, and -2 if several barcodes are\n\
+at the lowest distance, and its distance, -1 if there is none:\n\
+\n\
+    >>> barcodes = BarcodeSet([\"ACGT\", \"TTGA\", \"ACGA\"])\n\
+    >>> barcodes.assign([\"ACGT\", \"TTGC\", \"ACGG\", \"CCCC\"])\n\
+    (array('q', [0, 1, -2, -1]), array('q', [0, 1, 1, -1]))\n\
+\n\
+    `reads`: PackedDNA, or strings of bases\n\
+    `max_dist`: highest distance of a barcode to a read, any\n\
+    distance if negative\n\
+    `metric`: \"hamming\", in which case only the barcodes of the\n\
+    length of a read are compared with it, or \"levenshtein\"\n\
+    `workers`: number of threads; 0 means one per CPU\n\
+\n\
+In the C implementation, the reads are packed, and then assigned by\n\
+`workers` threads without holding the GIL. `workers` is ignored in\n\
+the pure Python implementation."
+
+
+#define PackedDNA_doc \
+"PackedDNA(seq)\n\
+\n\
+A nucleotide sequence stored in 2 bits per base.\n\
+\n\
+    `seq`: a string of bases, A, C, G, T or N, in either case\n\
+\n\
+Packed sequences support `len()` and `str()`, which gives their bases in\n\
+upper case, and can be pickled. `hamming` and `levenshtein` compare two\n\
+packed sequences, or a packed sequence with a string of bases, which is\n\
+then packed, as the strings of their bases:\n\
+\n\
+    >>> levenshtein(PackedDNA(\"ACGTACGT\"), \"ACGAACG\")\n\
+    2\n\
+\n\
+In the C implementation, the bases are stored by blocks of 64, as two\n\
+words holding the low and the high bits of their codes; N, stored as A,\n\
+is flagged in a third word, which only the sequences with some N have.\n\
+Hamming distances are then computed 64 bases at a time, counting the bits\n\
+of the XOR of the words of the two sequences, and the bit-parallel\n\
+Levenshtein kernel computes its match vectors from the words, for\n\
+sequences of any length. The other arguments of these functions, `fold`\n\
+and `workers`, are ignored: the bases have a single case, and the\n\
+sequences are always compared in the calling thread."
+
+
+#define write_dawg_doc \
+"write_dawg(path, words, values=None)\n\
+\n\
+Write the strings `words` to a DAWG file, to be opened with `Dawg.open`.\n\
+\n\
+    `values`: integers to store with the words, in the same order\n\
+\n\
+The words are stored as a minimal automaton, in which the words sharing a\n\
+prefix share its edges, and the words sharing a suffix share its states:\n\
+the file is much smaller than the list of words. A word present several\n\
+times is stored once, with its first value. Building the automaton takes\n\
+time and memory, and is meant to be done once, offline."
+
+
+#define Dawg_doc \
+"Dawg(path)\n\
+\n\
+A read-only set of strings, stored in a file written by `write_dawg`,\n\
+to be searched for the ones close to a query with the Levenshtein distance.\n\
+\n\
+As with lexicons, the file is memory-mapped: opening it takes the same\n\
+time whatever its size, and processes opening the same file share its\n\
+memory. The automaton is searched as a `Trie`, keeping a row of the\n\
+Levenshtein matrix for each depth, and skipping the states from which no\n\
+word can be close enough to the query; in the C implementation, without\n\
+holding the GIL.\n\
+\n\
+Dawgs support `len()`, `in`, and indexing, which gives the words in\n\
+lexicographic order, and can be used as context managers, which close\n\
+them on exit."
+
+
+#define Dawg_open_doc \
+"open(path)\n\
+\n\
+Open the dawg stored in the file `path`."
+
+
+#define Dawg_close_doc \
+"close()\n\
+\n\
+Unmap the file. The dawg can't be used anymore afterwards."
+
+
+#define Dawg_get_doc \
+"get(word, default=None)\n\
+\n\
+Return the value stored with `word`, or `default` if the dawg doesn't\n\
+hold it. If `write_dawg` was given no values, the value of a word is its\n\
+index in the dawg."
+
+
+#define Dawg_search_doc \
+"search(query, max_dist=-1)\n\
+\n\
+Return the list of pairs (distance, word) for the words of the dawg\n\
+which Levenshtein distance from `query` is lower or equal to `max_dist`,\n\
+or for all the words if `max_dist` is negative; if `write_dawg` was given\n\
+values, the triples (distance, word, value).\n\
+\n\
+The words are returned in lexicographic order."
+
+
+#define Dawg_prefix_search_doc \
+"prefix_search(query, max_dist=-1)\n\
+\n\
+As `search`, for the words which have a prefix at distance\n\
+`max_dist` or less from `query`, e.g. to complete a query being typed.\n\
+The distance returned is the lowest distance of a prefix of the word."
@@ -0,0 +1,45 @@
+/* Instantiates the kernels (kernels.h) for the three item types. This file is
+meant to be included once per instruction set level, by libdistance.c, with
+KERNEL_ISA defined to the suffix of the level, e.g. `levenshtein_u8_avx2`, or
+undefined for the baseline, e.g. `levenshtein_u8`, and KERNEL_ISA_LEVEL to
+the level, which the instrumentation records. */
+
+#ifdef KERNEL_ISA
+	#define KERNEL_ISA_CAT_(sfx, isa) sfx##_##isa
+	#define KERNEL_ISA_CAT(sfx, isa) KERNEL_ISA_CAT_(sfx, isa)
+	#define KERNEL_ISA_SUFFIX(sfx) KERNEL_ISA_CAT(sfx, KERNEL_ISA)
+	#undef STAT_ISA
+	#define STAT_ISA KERNEL_ISA_LEVEL
+#else
+	#define KERNEL_ISA_SUFFIX(sfx) sfx
+#endif
+
+#define KERNEL_ITEM uint8_t
+#define KERNEL_SUFFIX KERNEL_ISA_SUFFIX(u8)
+#define KERNEL_TYPE DISTANCE_STATS_U8
+#define KERNEL_NARROW
+#include "kernels.h"
+#undef KERNEL_ITEM
+#undef KERNEL_SUFFIX
+#undef KERNEL_TYPE
+#undef KERNEL_NARROW
+
+#define KERNEL_ITEM uint16_t
+#define KERNEL_SUFFIX KERNEL_ISA_SUFFIX(u16)
+#define KERNEL_TYPE DISTANCE_STATS_U16
+#include "kernels.h"
+#undef KERNEL_ITEM
+#undef KERNEL_SUFFIX
+#undef KERNEL_TYPE
+
+#define KERNEL_ITEM uint32_t
+#define KERNEL_SUFFIX KERNEL_ISA_SUFFIX(u32)
+#define KERNEL_TYPE DISTANCE_STATS_U32
+#include "kernels.h"
+#undef KERNEL_ITEM
+#undef KERNEL_SUFFIX
+#undef KERNEL_TYPE
+
+#undef KERNEL_ISA_SUFFIX
+#undef STAT_ISA
+#define STAT_ISA DISTANCE_ISA_BASELINE
@@ -0,0 +1,217 @@
+#include "core.h"
+
+#ifndef JARO_C
+#define JARO_C
+
+// Best score which can be reached with `m` matches, that is, if there are no
+// transpositions at all.
+
+static double
+jaro_bound(dist_ssize_t m, dist_ssize_t len1, dist_ssize_t len2, dist_ssize_t prefix, double prefix_weight)
+{
+	double j = (m / (double)len1 + m / (double)len2 + 1.0) / 3.0;
+
+	return j + prefix * prefix_weight * (1.0 - j);
+}
+
+
+// Mask of the bits `lo` to `hi` (excluded) of a 64 bits word.
+
+#define JARO_RANGE(lo, hi) \
+	(((hi) - (lo) == 64 ? ~(uint64_t)0 : (((uint64_t)1 << ((hi) - (lo))) - 1)) << (lo))
+
+#endif
+
+
+/* Stores the Jaro-Winkler score (the plain Jaro score if `prefix_weight` is 0)
+in `score`, or -1 if `min_score` is positive or 0 and can't be reached. */
+
+static int
+jaro(unicode *seq1, unicode *seq2, dist_ssize_t len1, dist_ssize_t len2,
+     double prefix_weight, double min_score, double *score)
+{
+	dist_ssize_t i, j, k, lo, hi, window, prefix;
+	dist_ssize_t m = 0, t = 0;
+	uint64_t bits1 = 0, bits2 = 0;
+	char *flags;
+#ifdef SEQUENCE_COMP
+	int comp;
+#else
+	peq_t peq;
+	uint64_t cand;
+#endif
+
+	if (len1 < len2) {
+		SWAP(unicode *,    seq1, seq2);
+		SWAP(dist_ssize_t, len1, len2);
+	}
+
+	*score = -1.0;		// kept as is when stopping early because of `min_score`
+
+	if (len1 == 0) {
+		*score = 1.0;
+		return DISTANCE_OK;
+	}
+	if (len2 == 0) {
+		if (min_score <= 0.0)
+			*score = 0.0;
+		return DISTANCE_OK;
+	}
+
+	for (prefix = 0; prefix < 4 && prefix < len2; prefix++) {
+#ifdef SEQUENCE_COMP
+		comp = SEQUENCE_COMP(seq1, prefix, seq2, prefix);
+		if (comp == -1)
+			return DISTANCE_ECOMPARE;
+		if (!comp)
+#else
+		if (seq1[prefix] != seq2[prefix])
+#endif
+			break;
+	}
+
+	if (min_score >= 0.0 && jaro_bound(len2, len1, len2, prefix, prefix_weight) < min_score) {
+		STAT_ADD(JARO, exits_length, 1);
+		return DISTANCE_OK;
+	}
+
+	window = len1 / 2 - 1;
+	if (window < 0)
+		window = 0;
+
+	if (len1 <= 64) {
+
+#ifdef SEQUENCE_COMP
+		STAT_PATH(JARO, KERNEL_TYPE, DISTANCE_STATS_DP);
+#else
+		STAT_PATH(JARO, KERNEL_TYPE, DISTANCE_STATS_BITPAR);
+		// positions of the items of seq2, to find the matches of an item of
+		// seq1 by masking them with the current match window
+		peq_init(&peq);
+		for (j = 0; j < len2; j++)
+			peq_add(&peq, seq2[j], (uint64_t)1 << j);
+#endif
+		for (i = 0; i < len1; i++) {
+			lo = (i > window ? i - window : 0);
+			hi = (i + window + 1 < len2 ? i + window + 1 : len2);
+			if (lo >= hi)
+				break;
+			STAT_ADD(JARO, cells, hi - lo);
+#ifdef SEQUENCE_COMP
+			for (j = lo; j < hi; j++) {
+				if (bits2 & ((uint64_t)1 << j))
+					continue;
+				comp = SEQUENCE_COMP(seq1, i, seq2, j);
+				if (comp == -1)
+					return DISTANCE_ECOMPARE;
+				if (comp) {
+					bits1 |= (uint64_t)1 << i;
+					bits2 |= (uint64_t)1 << j;
+					m++;
+					break;
+				}
+			}
+#else
+			cand = peq_get(&peq, seq1[i]) & ~bits2 & JARO_RANGE(lo, hi);
+			if (cand) {
+				bits1 |= (uint64_t)1 << i;
+				bits2 |= cand & (~cand + 1);
+				m++;
+			}
+#endif
+			if (min_score >= 0.0 && jaro_bound(
+				(m + len1 - i - 1 < len2 ? m + len1 - i - 1 : len2),
+				len1, len2, prefix, prefix_weight) < min_score) {
+				STAT_ADD(JARO, exits_bound, 1);
+				return DISTANCE_OK;
+			}
+		}
+
+		// matched items are compared in order to count the transpositions
+		while (bits1) {
+			i = CTZ64(bits1);
+			j = CTZ64(bits2);
+#ifdef SEQUENCE_COMP
+			comp = SEQUENCE_COMP(seq1, i, seq2, j);
+			if (comp == -1)
+				return DISTANCE_ECOMPARE;
+			t += (!comp);
+#else
+			t += (seq1[i] != seq2[j]);
+#endif
+			bits1 &= bits1 - 1;
+			bits2 &= bits2 - 1;
+		}
+	}
+	else {
+
+		if ((flags = (char *)calloc(len1 + len2, 1)) == NULL)
+			return DISTANCE_ENOMEM;
+		STAT_PATH(JARO, KERNEL_TYPE, DISTANCE_STATS_DP);
+		STAT_ADD(JARO, bytes, len1 + len2);
+
+		// flags[0..len1[ for seq1, flags[len1..len1 + len2[ for seq2
+		for (i = 0; i < len1; i++) {
+			lo = (i > window ? i - window : 0);
+			hi = (i + window + 1 < len2 ? i + window + 1 : len2);
+			STAT_ADD(JARO, cells, (hi > lo ? hi - lo : 0));
+			for (j = lo; j < hi; j++) {
+				if (flags[len1 + j])
+					continue;
+#ifdef SEQUENCE_COMP
+				comp = SEQUENCE_COMP(seq1, i, seq2, j);
+				if (comp == -1) {
+					free(flags);
+					return DISTANCE_ECOMPARE;
+				}
+				if (comp) {
+#else
+				if (seq1[i] == seq2[j]) {
+#endif
+					flags[i] = flags[len1 + j] = 1;
+					m++;
+					break;
+				}
+			}
+			if (min_score >= 0.0 && jaro_bound(
+				(m + len1 - i - 1 < len2 ? m + len1 - i - 1 : len2),
+				len1, len2, prefix, prefix_weight) < min_score) {
+				STAT_ADD(JARO, exits_bound, 1);
+				free(flags);
+				return DISTANCE_OK;
+			}
+		}
+
+		for (i = 0, k = 0; i < len1; i++) {
+			if (!flags[i])
+				continue;
+			while (!flags[len1 + k])
+				k++;
+#ifdef SEQUENCE_COMP
+			comp = SEQUENCE_COMP(seq1, i, seq2, k);
+			if (comp == -1) {
+				free(flags);
+				return DISTANCE_ECOMPARE;
+			}
+			t += (!comp);
+#else
+			t += (seq1[i] != seq2[k]);
+#endif
+			k++;
+		}
+
+		free(flags);
+	}
+
+	if (m == 0)
+		*score = 0.0;
+	else {
+		t /= 2;
+		*score = (m / (double)len1 + m / (double)len2 + (m - t) / (double)m) / 3.0;
+		*score = *score + prefix * prefix_weight * (1.0 - *score);
+	}
+
+	if (min_score >= 0.0 && *score < min_score)
+		*score = -1.0;
+	return DISTANCE_OK;
+}
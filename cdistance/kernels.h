@@ -0,0 +1,93 @@
+/* Instantiates all the kernels for items of type `KERNEL_ITEM`, suffixing their
+names with `_KERNEL_SUFFIX`, e.g. `levenshtein_u8`. This file is meant to be
+included once per item type, with these macros defined:
+
+	KERNEL_ITEM			type of the items
+	KERNEL_SUFFIX		suffix of the functions names
+	KERNEL_TYPE			type of the items, for the instrumentation: one of
+						DISTANCE_STATS_U8, DISTANCE_STATS_U16, ...
+	KERNEL_NARROW		(optional) items are 8 bits wide, so that tables
+						indexed by item can be used
+	SEQUENCE_COMP		(optional) SEQUENCE_COMP(seq1, i, seq2, j) compares two
+						items, and returns 1 if they are equal, 0 if they are
+						not, and -1 on error; items are compared with `==`
+						otherwise
+
+The kernels test these macros to specialize their code for each type, e.g.
+bit-parallel algorithms are only used for items which can be compared with
+`==`, and the way their lookup tables are built depends on `KERNEL_NARROW`.
+Adding a new item type is a matter of including this file once more. */
+
+#ifndef KERNEL_NAME
+	#define KERNEL_CAT_(name, sfx) name##_##sfx
+	#define KERNEL_CAT(name, sfx) KERNEL_CAT_(name, sfx)
+	#define KERNEL_NAME(name) KERNEL_CAT(name, KERNEL_SUFFIX)
+#endif
+
+#define unicode KERNEL_ITEM
+
+#ifndef SEQUENCE_COMP
+	#include "peq.h"
+	#ifdef KERNEL_NARROW
+		#define peq_t struct peq_narrow
+		#define peq_init peq_narrow_init
+		#define peq_add peq_narrow_add
+		#define peq_get peq_narrow_get
+	#else
+		#define peq_t struct peq_hash
+		#define peq_init peq_hash_init
+		#define peq_add peq_hash_add
+		#define peq_get peq_hash_get
+	#endif
+#endif
+
+#define hamming KERNEL_NAME(hamming)
+#include "hamming.c"
+#undef hamming
+
+#define levenshtein KERNEL_NAME(levenshtein)
+#define levenshtein_bitpar KERNEL_NAME(levenshtein_bitpar)
+#define levenshtein_lce KERNEL_NAME(levenshtein_lce)
+#define levenshtein_diag KERNEL_NAME(levenshtein_diag)
+#define levenshtein_tile KERNEL_NAME(levenshtein_tile)
+#define nlevenshtein KERNEL_NAME(nlevenshtein)
+#include "levenshtein.c"
+#undef levenshtein
+#undef levenshtein_bitpar
+#undef levenshtein_lce
+#undef levenshtein_diag
+#undef levenshtein_tile
+#undef nlevenshtein
+
+#define lcsubstrings KERNEL_NAME(lcsubstrings)
+#define lcsubstrings_tile KERNEL_NAME(lcsubstrings_tile)
+#define common_substrings KERNEL_NAME(common_substrings)
+#include "lcsubstrings.c"
+#undef lcsubstrings
+#undef lcsubstrings_tile
+#undef common_substrings
+
+#define fastcomp KERNEL_NAME(fastcomp)
+#include "fastcomp.c"
+#undef fastcomp
+
+#define jaro KERNEL_NAME(jaro)
+#include "jaro.c"
+#undef jaro
+
+#define lcs KERNEL_NAME(lcs)
+#define lcs_bitpar KERNEL_NAME(lcs_bitpar)
+#define indel KERNEL_NAME(indel)
+#include "lcs.c"
+#undef lcs
+#undef lcs_bitpar
+#undef indel
+
+#ifndef SEQUENCE_COMP
+	#undef peq_t
+	#undef peq_init
+	#undef peq_add
+	#undef peq_get
+#endif
+
+#undef unicode
@@ -0,0 +1,170 @@
+#include "core.h"
+
+
+#ifndef SEQUENCE_COMP
+
+/* Bit-parallel algorithm of Allison and Dix, as formulated by Hyyrö: the
+row of the matrix for a prefix of `seq1` is stored as a bit vector `v` over
+`seq2`, in which the bits set to 0 mark the positions where the length of the
+longest common subsequence increases. A row is computed with
+
+	u = v & peq[item]
+	v = (v + u) | (v - u)
+
+and `v - u` is `v & ~u`, as `u` is a subset of `v`. When `seq2` is longer
+than 64 items, the vector spans several words, and the carry of the addition
+is propagated from one word to the next. */
+
+static dist_ssize_t
+lcs_bitpar(unicode *seq1, unicode *seq2, dist_ssize_t len1, dist_ssize_t len2)
+{
+	peq_t one, *peq = &one;
+	uint64_t stack_v, *v = &stack_v, u, x, sum, carry, last;
+	dist_ssize_t nblocks = (len2 + 63) / 64, i, j, b, len = 0;
+
+	assert(len2 > 0);
+	STAT_PATH(LCS, KERNEL_TYPE, DISTANCE_STATS_BITPAR);
+
+	if (nblocks > 1) {
+		peq = (peq_t *)malloc(nblocks * sizeof(peq_t));
+		v = (uint64_t *)malloc(nblocks * sizeof(uint64_t));
+		if (peq == NULL || v == NULL) {
+			free(peq);
+			free(v);
+			return -1;
+		}
+		STAT_ADD(LCS, bytes, nblocks * (sizeof(peq_t) + sizeof(uint64_t)));
+	}
+	for (b = 0; b < nblocks; b++) {
+		peq_init(&peq[b]);
+		v[b] = ~(uint64_t)0;
+	}
+	for (j = 0; j < len2; j++)
+		peq_add(&peq[j / 64], seq2[j], (uint64_t)1 << (j % 64));
+
+	for (i = 0; i < len1; i++) {
+		carry = 0;
+		for (b = 0; b < nblocks; b++) {
+			x = v[b];
+			u = x & peq_get(&peq[b], seq1[i]);
+			sum = x + u + carry;
+			carry = (sum < x || (carry && sum == x));
+			v[b] = sum | (x & ~u);
+		}
+	}
+	STAT_ADD(LCS, cells, len1 * len2);
+
+	// bits of the last word beyond `len2` stay set, as `peq` is 0 there
+	last = (len2 % 64 ? ((uint64_t)1 << (len2 % 64)) - 1 : ~(uint64_t)0);
+	for (b = 0; b < nblocks; b++)
+		len += POPCOUNT64(~v[b] & (b == nblocks - 1 ? last : ~(uint64_t)0));
+
+	if (nblocks > 1) {
+		free(peq);
+		free(v);
+	}
+	return len;
+}
+
+#endif
+
+
+/* Stores the length of the longest common subsequence of the two sequences
+in `len`. */
+
+static int
+lcs(unicode *seq1, unicode *seq2, dist_ssize_t len1, dist_ssize_t len2, dist_ssize_t *len)
+{
+#ifdef SEQUENCE_COMP
+	dist_ssize_t i, j, last, old, *row;
+	int comp;
+#else
+	dist_ssize_t common = 0;
+#endif
+
+	if (len1 < len2) {
+		SWAP(unicode *,    seq1, seq2);
+		SWAP(dist_ssize_t, len1, len2);
+	}
+
+#ifndef SEQUENCE_COMP
+	// a common prefix or suffix is part of a longest common subsequence
+	while (len2 > 0 && seq1[0] == seq2[0]) {
+		seq1++;
+		seq2++;
+		len1--;
+		len2--;
+		common++;
+	}
+	while (len2 > 0 && seq1[len1 - 1] == seq2[len2 - 1]) {
+		len1--;
+		len2--;
+		common++;
+	}
+	if (len2 == 0) {
+		*len = common;
+		return DISTANCE_OK;
+	}
+	if ((*len = lcs_bitpar(seq1, seq2, len1, len2)) == -1)
+		return DISTANCE_ENOMEM;
+	*len += common;
+	return DISTANCE_OK;
+#else
+	if (len2 == 0) {
+		*len = 0;
+		return DISTANCE_OK;
+	}
+	if ((row = (dist_ssize_t *)malloc((len2 + 1) * sizeof(dist_ssize_t))) == NULL)
+		return DISTANCE_ENOMEM;
+	STAT_PATH(LCS, KERNEL_TYPE, DISTANCE_STATS_DP);
+	STAT_ADD(LCS, bytes, (len2 + 1) * sizeof(dist_ssize_t));
+	STAT_ADD(LCS, cells, len1 * len2);
+
+	for (j = 0; j <= len2; j++)
+		row[j] = 0;
+	for (i = 1; i <= len1; i++) {
+		for (j = 1, last = 0; j <= len2; j++) {
+			old = row[j];
+			comp = SEQUENCE_COMP(seq1, i - 1, seq2, j - 1);
+			if (comp == -1) {
+				free(row);
+				return DISTANCE_ECOMPARE;
+			}
+			if (comp)
+				row[j] = last + 1;
+			else if (row[j - 1] > row[j])
+				row[j] = row[j - 1];
+			last = old;
+		}
+	}
+	*len = row[len2];
+	free(row);
+	return DISTANCE_OK;
+#endif
+}
+
+
+/* Stores the indel distance, i.e. the number of insertions and deletions
+needed to turn one sequence into the other, `len1 + len2 - 2 * lcs`, in
+`dist`, or -1 if `max_dist` is positive or 0 and the distance is higher than
+that. */
+
+static int
+indel(unicode *seq1, unicode *seq2, dist_ssize_t len1, dist_ssize_t len2,
+      dist_ssize_t max_dist, dist_ssize_t *dist)
+{
+	dist_ssize_t len;
+	int rv;
+
+	if (max_dist >= 0 && (len1 > len2 ? len1 - len2 : len2 - len1) > max_dist) {
+		STAT_ADD(LCS, exits_length, 1);
+		*dist = -1;
+		return DISTANCE_OK;
+	}
+	if ((rv = lcs(seq1, seq2, len1, len2, &len)) != DISTANCE_OK)
+		return rv;
+	*dist = len1 + len2 - 2 * len;
+	if (max_dist >= 0 && *dist > max_dist)
+		*dist = -1;
+	return DISTANCE_OK;
+}
@@ -1,41 +1,82 @@
-#include "distance.h"
+#include "core.h"
+#include "wavefront.h"
 
+#ifndef LCSUBSTRINGS_C
+#define LCSUBSTRINGS_C
 
-static UT_array *
-lcsubstrings(unicode *seq1, unicode *seq2,
-             Py_ssize_t len1, Py_ssize_t len2, Py_ssize_t *max_len)
+// Appends a position to a dynamic array of pairs.
+
+static int
+push_pair(struct distance_pair **pairs, dist_ssize_t *npairs, dist_ssize_t *alloc,
+          dist_ssize_t i, dist_ssize_t j)
+{
+	struct distance_pair *tmp;
+
+	if (*npairs == *alloc) {
+		*alloc = (*alloc ? 2 * *alloc : 8);
+		tmp = (struct distance_pair *)realloc(*pairs, *alloc * sizeof(struct distance_pair));
+		if (tmp == NULL)
+			return DISTANCE_ENOMEM;
+		STAT_ADD(LCSUBSTRINGS, bytes, (*alloc - *npairs) * sizeof(struct distance_pair));
+		*pairs = tmp;
+	}
+	(*pairs)[*npairs].i = i;
+	(*pairs)[*npairs].j = j;
+	(*npairs)++;
+	return DISTANCE_OK;
+}
+
+#endif
+
+
+/* Stores the length of the longest common substrings in `max_len`, and an
+array of their start positions in `pairs`, or NULL if there is none. */
+
+static int
+lcsubstrings(unicode *seq1, unicode *seq2, dist_ssize_t len1, dist_ssize_t len2,
+             dist_ssize_t *max_len, struct distance_pair **pairs, dist_ssize_t *npairs)
 {
-	Py_ssize_t i, j, mlen = -1;
-	Py_ssize_t old, last, *column;
-	UT_array *stack = NULL;
-	struct pair_t pos;
+	dist_ssize_t i, j, k, mlen = -1;
+	dist_ssize_t old, last, *column;
+	dist_ssize_t alloc = 0;
+	int swapped = 0, rv = DISTANCE_ENOMEM;
 #ifdef SEQUENCE_COMP
 	int comp;
 #endif
-	
-	assert(len1 >= len2);
-	
-	utarray_new(stack, &pair_icd);
-	
+
+	if (len1 < len2) {
+		SWAP(unicode *,    seq1, seq2);
+		SWAP(dist_ssize_t, len1, len2);
+		swapped = 1;
+	}
+
+	*pairs = NULL;
+	*npairs = 0;
+
 	if (len2 == 0) {
 		*max_len = 0;
-		return stack;
+		return DISTANCE_OK;
 	}
-	
-	if ((column = (Py_ssize_t *)malloc((len2 + 1) * sizeof(Py_ssize_t))) == NULL)
+
+	if ((column = (dist_ssize_t *)malloc((len2 + 1) * sizeof(dist_ssize_t))) == NULL)
 		goto On_Error;
-	
+	STAT_PATH(LCSUBSTRINGS, KERNEL_TYPE, DISTANCE_STATS_DP);
+	STAT_ADD(LCSUBSTRINGS, bytes, (len2 + 1) * sizeof(dist_ssize_t));
+	STAT_ADD(LCSUBSTRINGS, cells, len1 * len2);
+
 	last = 0;
 	for (j = 0; j < len2; j++)
 		column[j] = j;
-	
+
 	for (i = 0; i < len1; i++) {
 		for (j = 0; j < len2; j++) {
 			old = column[j];
 #ifdef SEQUENCE_COMP
 			comp = SEQUENCE_COMP(seq1, i, seq2, j);
-			if (comp == -1)
+			if (comp == -1) {
+				rv = DISTANCE_ECOMPARE;
 				goto On_Error;
+			}
 			if (comp) {
 #else
 			if (seq1[i] == seq2[j]) {
@@ -43,30 +84,169 @@ lcsubstrings(unicode *seq1, unicode *seq2,
 				column[j] = ((i == 0 || j == 0) ? 1 : (last + 1));
 				if (column[j] > mlen) {
 					mlen = column[j];
-					pos.i = i;
-					pos.j = j;
-					utarray_clear(stack);
-					utarray_push_back(stack, &pos);
-				}
-				else if (column[j] == mlen) {
-					pos.i = i;
-					pos.j = j;
-					utarray_push_back(stack, &pos);
+					*npairs = 0;
 				}
+				if (column[j] == mlen && push_pair(pairs, npairs, &alloc, i, j) != DISTANCE_OK)
+					goto On_Error;
 			}
 			else
 				column[j] = 0;
 			last = old;
 		}
 	}
-	
+
 	free(column);
 
+	if (mlen == -1)
+		mlen = 0;
+
+	// end positions to start positions, in the order of the arguments
+	for (k = 0; k < *npairs; k++) {
+		i = (*pairs)[k].i - mlen + 1;
+		j = (*pairs)[k].j - mlen + 1;
+		(*pairs)[k].i = (swapped ? j : i);
+		(*pairs)[k].j = (swapped ? i : j);
+	}
+
 	*max_len = mlen;
-	return stack;
-	
+	return DISTANCE_OK;
+
 	On_Error:
 		free(column);
-		utarray_free(stack);
-		return NULL;
+		free(*pairs);
+		*pairs = NULL;
+		*npairs = 0;
+		return rv;
+}
+
+
+#ifndef SEQUENCE_COMP
+
+/* A tile of the matrix of `lcsubstrings`, for distance_lcsubstrings_parallel
+(see wavefront.h). Only the substrings at least as long as the longest found
+so far by the other tiles are kept. */
+
+static void
+lcsubstrings_tile(struct wavefront *wf, dist_ssize_t ti, dist_ssize_t tj)
+{
+	const unicode *seq1 = (const unicode *)wf->seq1, *seq2 = (const unicode *)wf->seq2;
+	dist_ssize_t *bottom = wf->bottom, *right = wf->right;
+	dist_ssize_t i, j, i0, i1, j0, j1;
+	dist_ssize_t diag, next, cur, mlen;
+	struct distance_pair *pairs = NULL;
+	dist_ssize_t npairs = 0, alloc = 0;
+	int rv = DISTANCE_OK;
+
+	if (ti == 0 && tj == 0)
+		STAT_PATH(LCSUBSTRINGS, KERNEL_TYPE, DISTANCE_STATS_TILED);
+	diag = wavefront_bounds(wf, ti, tj, &i0, &i1, &j0, &j1);
+	if ((mlen = wavefront_max_len(wf)) < 1)
+		mlen = 1;
+
+	for (i = i0 + 1; i <= i1; i++) {
+		next = right[i];
+		for (j = j0 + 1; j <= j1; j++) {
+			cur = (seq1[i - 1] == seq2[j - 1] ? diag + 1 : 0);
+			diag = bottom[j];
+			bottom[j] = cur;
+			if (cur >= mlen && rv == DISTANCE_OK) {
+				if (cur > mlen) {
+					mlen = cur;
+					npairs = 0;
+				}
+				rv = push_pair(&pairs, &npairs, &alloc, i - 1, j - 1);
+			}
+		}
+		right[i] = bottom[j1];
+		diag = next;
+	}
+	WAVEFRONT_CORNER(wf, ti, tj) = bottom[j1];
+	STAT_ADD(LCSUBSTRINGS, cells, (i1 - i0) * (j1 - j0));
+
+	if (rv != DISTANCE_OK) {
+		free(pairs);
+		wavefront_fail(wf, rv);
+	}
+	else
+		wavefront_merge(wf, mlen, pairs, npairs, alloc);
+}
+
+#endif
+
+
+#ifdef SEQUENCE_COMP
+	#define SUBSTRINGS_EQUAL(i, j) SEQUENCE_COMP(seq1, i, seq2, j)
+#else
+	#define SUBSTRINGS_EQUAL(i, j) (seq1[i] == seq2[j])
+#endif
+
+/* Finds the next maximal common substring of at least `min_len` items, from
+the position saved in `cursor`, and stores its start positions in `pos` and
+its length in `len`, or 0 in `len` if there is none left.
+
+Maximal common substrings are the runs of equal items along the diagonals of
+the matrix of comparisons. A run of `min_len` items or more contains one of
+every `min_len` cells of its diagonal, so that only these cells are compared
+until a match is found; the run is then extended on both sides. */
+
+static int
+common_substrings(unicode *seq1, unicode *seq2, dist_ssize_t len1, dist_ssize_t len2,
+                  dist_ssize_t min_len, struct distance_cursor *cursor,
+                  struct distance_pair *pos, dist_ssize_t *len)
+{
+	dist_ssize_t i0, j0, n, q, l, r, cells = 0;
+	int comp;
+
+	*len = 0;
+	if (len1 == 0 || len2 == 0)
+		return DISTANCE_OK;
+
+	// diagonal `k` starts at (len1 - 1 - k, 0) for k < len1, at (0, k - len1 + 1) after
+	for (; cursor->diag < len1 + len2 - 1; cursor->diag++, cursor->pos = 0) {
+		i0 = (cursor->diag < len1 ? len1 - 1 - cursor->diag : 0);
+		j0 = (cursor->diag < len1 ? 0 : cursor->diag - len1 + 1);
+		n = (len1 - i0 < len2 - j0 ? len1 - i0 : len2 - j0);
+
+		// the cell before `cursor->pos` is a mismatch, or out of the matrix
+		while (cursor->pos + min_len <= n) {
+			q = cursor->pos + min_len - 1;
+			cells++;
+			if ((comp = SUBSTRINGS_EQUAL(i0 + q, j0 + q)) == -1)
+				goto On_Error;
+			if (!comp) {
+				cursor->pos = q + 1;
+				continue;
+			}
+			for (l = q; l > cursor->pos; l--) {
+				cells++;
+				if ((comp = SUBSTRINGS_EQUAL(i0 + l - 1, j0 + l - 1)) == -1)
+					goto On_Error;
+				if (!comp)
+					break;
+			}
+			for (r = q + 1; r < n; r++) {
+				cells++;
+				if ((comp = SUBSTRINGS_EQUAL(i0 + r, j0 + r)) == -1)
+					goto On_Error;
+				if (!comp)
+					break;
+			}
+			cursor->pos = r + 1;
+			if (r - l >= min_len) {
+				pos->i = i0 + l;
+				pos->j = j0 + l;
+				*len = r - l;
+				STAT_ADD(LCSUBSTRINGS, cells, cells);
+				return DISTANCE_OK;
+			}
+		}
+	}
+	STAT_ADD(LCSUBSTRINGS, cells, cells);
+	return DISTANCE_OK;
+
+	On_Error:
+		STAT_ADD(LCSUBSTRINGS, cells, cells);
+		return DISTANCE_ECOMPARE;
 }
+
+#undef SUBSTRINGS_EQUAL
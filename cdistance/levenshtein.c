@@ -1,4 +1,5 @@
-#include "distance.h"
+#include "core.h"
+#include "wavefront.h"
 
 #define MIN3(a, b, c) ((a) < (b) ? ((a) < (c) ? (a) : (c)) : ((b) < (c) ? (b) : (c)))
 #define MAX3(a, b, c) ((a) > (b) ? ((a) > (c) ? (a) : (c)) : ((b) > (c) ? (b) : (c)))
@@ -6,14 +7,14 @@
 #ifndef LEVENSHTEIN_C
 #define LEVENSHTEIN_C
 
-static Py_ssize_t
-minimum(const Py_ssize_t *column, Py_ssize_t len)
+static dist_ssize_t
+minimum(const dist_ssize_t *column, dist_ssize_t len)
 {
-	Py_ssize_t min;
+	dist_ssize_t min;
 
 	assert(len > 0);
 	min = column[--len];
-	while (len-- >= 0) {
+	while (len-- > 0) {
 		if (column[len] < min)
 			min = column[len];
 	}
@@ -21,36 +22,254 @@ minimum(const Py_ssize_t *column, Py_ssize_t len)
 	return min;
 }
 
+#ifdef DISTANCE_MULTIVERSION
+	#include <immintrin.h>
 #endif
 
-static Py_ssize_t
-levenshtein(unicode *seq1, unicode *seq2, Py_ssize_t len1, Py_ssize_t len2, Py_ssize_t max_dist)
+#endif
+
+
+#ifndef SEQUENCE_COMP
+
+/* Number of leading items `seq1` and `seq2` have in common, among the first
+`len`. Items are compared a word at a time, or 32 bytes at a time in the AVX2
+kernels, and the mismatching word is then scanned item by item. */
+
+static dist_ssize_t
+levenshtein_lce(const unicode *seq1, const unicode *seq2, dist_ssize_t len)
+{
+	const dist_ssize_t word = sizeof(uint64_t) / sizeof(unicode);
+	dist_ssize_t n = 0;
+	uint64_t w1, w2;
+
+#ifdef __AVX2__
+	const dist_ssize_t block = 32 / sizeof(unicode);
+	__m256i b1, b2;
+
+	while (n + block <= len) {
+		b1 = _mm256_loadu_si256((const __m256i *)(seq1 + n));
+		b2 = _mm256_loadu_si256((const __m256i *)(seq2 + n));
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(b1, b2)) != -1)
+			break;
+		n += block;
+	}
+#endif
+	while (n + word <= len) {
+		memcpy(&w1, seq1 + n, sizeof(uint64_t));
+		memcpy(&w2, seq2 + n, sizeof(uint64_t));
+		if (w1 != w2)
+			break;
+		n += word;
+	}
+	while (n < len && seq1[n] == seq2[n])
+		n++;
+	return n;
+}
+
+#endif
+
+
+/* Diagonal-transition algorithm of Landau and Vishkin (or Ukkonen), for
+`len1` >= `len2`: for each distance d = 0, 1, 2..., the furthest cell reachable
+with d edits is computed on each diagonal, from those reached with d - 1 edits,
+and then extended along the diagonal for as long as the items match. The cost
+is O((len1 + d) * d) in the worst case, and close to O(len1 + d * d) when the
+differences are scattered, whatever the length of the sequences. Stores in
+`dist` the distance, or -1 if it is higher than `bound`. */
+
+static NOINLINE int
+levenshtein_diag(unicode *seq1, unicode *seq2, dist_ssize_t len1, dist_ssize_t len2,
+                 dist_ssize_t bound, dist_ssize_t *dist)
+{
+	// furthest row reached on diagonal k = i - j, at index `bound + 1 + k`
+	dist_ssize_t *base, *prev, *cur, *tmp;
+	dist_ssize_t d, k, lo, hi, i, j, size, steps = 0;
+	const dist_ssize_t none = -len1 - 2;
+	const dist_ssize_t target = len1 - len2;
+
+#ifdef SEQUENCE_COMP
+	int comp;
+#endif
+
+	assert(len1 >= len2 && bound >= 0);
+	size = 2 * bound + 3;
+	if ((base = (dist_ssize_t *)malloc(2 * size * sizeof(dist_ssize_t))) == NULL)
+		return DISTANCE_ENOMEM;
+	STAT_PATH(LEVENSHTEIN, KERNEL_TYPE, DISTANCE_STATS_DIAG);
+	STAT_ADD(LEVENSHTEIN, bytes, 2 * size * sizeof(dist_ssize_t));
+	for (k = 0; k < 2 * size; k++)
+		base[k] = none;
+	prev = base + bound + 1;
+	cur = base + size + bound + 1;
+
+	for (d = 0; d <= bound; d++) {
+		lo = (d < len2 ? -d : -len2);
+		hi = (d < len1 ? d : len1);
+		for (k = lo; k <= hi; k++) {
+			if (d == 0)
+				i = 0;
+			else {
+				// substitution, deletion, insertion
+				i = prev[k] + 1;
+				if (prev[k - 1] + 1 > i)
+					i = prev[k - 1] + 1;
+				if (prev[k + 1] > i)
+					i = prev[k + 1];
+				if (i > len1)
+					i = len1;
+				if (i - k > len2)
+					i = len2 + k;
+			}
+			j = i - k;
+#ifdef SEQUENCE_COMP
+			while (i < len1 && j < len2) {
+				comp = SEQUENCE_COMP(seq1, i, seq2, j);
+				if (comp == -1) {
+					free(base);
+					return DISTANCE_ECOMPARE;
+				}
+				if (!comp)
+					break;
+				i++;
+				j++;
+			}
+#else
+			if (i < len1 && j < len2)
+				i += levenshtein_lce(seq1 + i, seq2 + j,
+					(len1 - i < len2 - j ? len1 - i : len2 - j));
+#endif
+			cur[k] = i;
+			if (k == target && i == len1) {
+				STAT_ADD(LEVENSHTEIN, cells, steps + hi - lo + 1);
+				free(base);
+				*dist = d;
+				return DISTANCE_OK;
+			}
+		}
+		steps += hi - lo + 1;
+		tmp = prev;
+		prev = cur;
+		cur = tmp;
+	}
+
+	STAT_ADD(LEVENSHTEIN, cells, steps);
+	STAT_ADD(LEVENSHTEIN, exits_bound, 1);
+	free(base);
+	*dist = -1;
+	return DISTANCE_OK;
+}
+
+
+#ifndef SEQUENCE_COMP
+
+/* Bit-parallel algorithm of Myers, as formulated by Hyyrö, for `len2` <= 64:
+the vertical and horizontal differences between adjacent cells are stored as
+bit vectors, and a whole column is computed with a few word operations.
+Returns the distance, or -1 if it is higher than `max_dist`. */
+
+static dist_ssize_t
+levenshtein_bitpar(unicode *seq1, unicode *seq2, dist_ssize_t len1, dist_ssize_t len2,
+                   dist_ssize_t max_dist)
+{
+	peq_t peq;
+	uint64_t pv, mv, ph, mh, xv, xh, eq, last;
+	dist_ssize_t i, j, dist = len2;
+
+	assert(len2 > 0 && len2 <= 64);
+	STAT_PATH(LEVENSHTEIN, KERNEL_TYPE, DISTANCE_STATS_BITPAR);
+
+	peq_init(&peq);
+	for (j = 0; j < len2; j++)
+		peq_add(&peq, seq2[j], (uint64_t)1 << j);
+
+	last = (uint64_t)1 << (len2 - 1);
+	pv = ~(uint64_t)0;
+	mv = 0;
+
+	for (i = 0; i < len1; i++) {
+		eq = peq_get(&peq, seq1[i]);
+		xv = eq | mv;
+		xh = (((eq & pv) + pv) ^ pv) | eq;
+		ph = mv | ~(xh | pv);
+		mh = pv & xh;
+		if (ph & last)
+			dist++;
+		else if (mh & last)
+			dist--;
+		// the first row is 0, 1, 2..., so its horizontal differences are +1
+		ph = (ph << 1) | 1;
+		mh <<= 1;
+		pv = mh | ~(xv | ph);
+		mv = ph & xv;
+		// the last cell decreases by at most 1 for each remaining item
+		if (max_dist >= 0 && dist - (len1 - i - 1) > max_dist) {
+			STAT_ADD(LEVENSHTEIN, cells, (i + 1) * len2);
+			STAT_ADD(LEVENSHTEIN, exits_bound, 1);
+			return -1;
+		}
+	}
+	STAT_ADD(LEVENSHTEIN, cells, len1 * len2);
+
+	if (max_dist >= 0 && dist > max_dist)
+		return -1;
+	return dist;
+}
+
+#endif
+
+
+/* Stores the distance in `dist`, or -1 if `max_dist` is positive or 0 and the
+distance is higher than that. */
+
+static int
+levenshtein(unicode *seq1, unicode *seq2, dist_ssize_t len1, dist_ssize_t len2,
+            dist_ssize_t max_dist, dist_ssize_t *dist)
 {
-	Py_ssize_t i, j;
-	Py_ssize_t last, old;
-	Py_ssize_t cost, dist = -2;
-	Py_ssize_t *column;
+	dist_ssize_t i, j;
+	dist_ssize_t last, old;
+	dist_ssize_t cost;
+	dist_ssize_t *column;
+	int rv;
 
 #ifdef SEQUENCE_COMP
 	int comp;
 #endif
 	
 	if (len1 < len2) {
-		SWAP(unicode *,  seq1, seq2);
-		SWAP(Py_ssize_t, len1, len2);
+		SWAP(unicode *,    seq1, seq2);
+		SWAP(dist_ssize_t, len1, len2);
 	}
 	
-	if (max_dist >= 0 && (len1 - len2) > max_dist)
-		return -1;
-	else {
-		if (len1 == 0)
-			return len2;
-		if (len2 == 0)
-			return len1;
+	if (max_dist >= 0 && (len1 - len2) > max_dist) {
+		STAT_ADD(LEVENSHTEIN, exits_length, 1);
+		*dist = -1;
+		return DISTANCE_OK;
+	}
+	if (len2 == 0) {
+		*dist = len1;
+		return DISTANCE_OK;
+	}
+#ifndef SEQUENCE_COMP
+	if (len2 <= 64) {
+		*dist = levenshtein_bitpar(seq1, seq2, len1, len2, max_dist);
+		return DISTANCE_OK;
+	}
+#endif
+	/* Near-identical sequences: with a small `max_dist`, the result of the
+	diagonal-transition algorithm is final; without, it is tried with a bound
+	of len2 / DIAG_RATIO, which costs a fraction of the dynamic programming
+	if the distance turns out to be higher. */
+	if (max_dist >= 0 ? max_dist <= len2 / DIAG_RATIO : len1 - len2 <= len2 / DIAG_RATIO) {
+		rv = levenshtein_diag(seq1, seq2, len1, len2,
+			max_dist >= 0 ? max_dist : len2 / DIAG_RATIO, dist);
+		if (rv != DISTANCE_OK || *dist >= 0 || max_dist >= 0)
+			return rv;
 	}
 
-	if ((column = (Py_ssize_t *) malloc((len2 + 1) * sizeof(Py_ssize_t))) == NULL)
-		return -2;
+	if ((column = (dist_ssize_t *) malloc((len2 + 1) * sizeof(dist_ssize_t))) == NULL)
+		return DISTANCE_ENOMEM;
+	STAT_PATH(LEVENSHTEIN, KERNEL_TYPE, DISTANCE_STATS_DP);
+	STAT_ADD(LEVENSHTEIN, bytes, (len2 + 1) * sizeof(dist_ssize_t));
 
 	for (j = 1 ; j <= len2; j++)
 		column[j] = j;
@@ -63,7 +282,7 @@ levenshtein(unicode *seq1, unicode *seq2, Py_ssize_t len1, Py_ssize_t len2, Py_s
 			comp = SEQUENCE_COMP(seq1, i - 1, seq2, j - 1);
 			if (comp == -1) {
 				free(column);
-				return -3;
+				return DISTANCE_ECOMPARE;
 			}
 			cost = (!comp);
 #else
@@ -76,63 +295,78 @@ levenshtein(unicode *seq1, unicode *seq2, Py_ssize_t len1, Py_ssize_t len2, Py_s
 			);
 			last = old;
 		}
+		STAT_ADD(LEVENSHTEIN, cells, len2);
 		if (max_dist >= 0 && minimum(column, len2 + 1) > max_dist) {
+			STAT_ADD(LEVENSHTEIN, exits_bound, 1);
 			free(column);
-			return -1;
+			*dist = -1;
+			return DISTANCE_OK;
 		}
 	}
 
-	dist = column[len2];
+	*dist = column[len2];
 	
 	free(column);
 	
-	if (max_dist >= 0 && dist > max_dist)
-		return -1;
-	return dist;
+	if (max_dist >= 0 && *dist > max_dist)
+		*dist = -1;
+	return DISTANCE_OK;
 }
 
 
-static double
-nlevenshtein(unicode *seq1, unicode *seq2, Py_ssize_t len1, Py_ssize_t len2, short method)
+static int
+nlevenshtein(unicode *seq1, unicode *seq2, dist_ssize_t len1, dist_ssize_t len2,
+             int method, double *dist)
 {
-	Py_ssize_t i, j;
+	dist_ssize_t i, j;
 	
 	// distance
-	Py_ssize_t ic, dc, rc;
-	Py_ssize_t last, old;
-	Py_ssize_t *column;
-	Py_ssize_t fdist;
+	dist_ssize_t ic, dc, rc;
+	dist_ssize_t last, old;
+	dist_ssize_t *column;
+	dist_ssize_t fdist;
 	
 	// length
-	Py_ssize_t lic, ldc, lrc;
-	Py_ssize_t llast, lold;
-	Py_ssize_t *length;
-	Py_ssize_t flen;
-
+	dist_ssize_t lic, ldc, lrc;
+	dist_ssize_t llast, lold;
+	dist_ssize_t *length;
+	dist_ssize_t flen;
+	
+	int rv;
 #ifdef SEQUENCE_COMP
 	int comp;
 #endif
 	
-	assert(len1 >= len2);
+	if (len1 < len2) {
+		SWAP(unicode *,    seq1, seq2);
+		SWAP(dist_ssize_t, len1, len2);
+	}
 	
-	if (len1 == 0) // len2 is 0 too, so the two sequences are identical
-		return 0.0;
-	if (len2 == 0) // completely different
-		return 1.0;
+	if (len1 == 0) { // len2 is 0 too, so the two sequences are identical
+		*dist = 0.0;
+		return DISTANCE_OK;
+	}
+	if (len2 == 0) { // completely different
+		*dist = 1.0;
+		return DISTANCE_OK;
+	}
 	
 	if (method == 1) {
-		fdist = levenshtein(seq1, seq2, len1, len2, -1);
-		if (fdist < 0)  // error
-			return fdist;
-		return fdist / (double)len1;
+		if ((rv = levenshtein(seq1, seq2, len1, len2, -1, &fdist)) != DISTANCE_OK)
+			return rv;
+		*dist = fdist / (double)len1;
+		return DISTANCE_OK;
 	}
 
-	if ((column = (Py_ssize_t *)malloc((len2 + 1) * sizeof(Py_ssize_t))) == NULL)
-		return -1;
-	if ((length = (Py_ssize_t *)malloc((len2 + 1) * sizeof(Py_ssize_t))) == NULL) {
+	if ((column = (dist_ssize_t *)malloc((len2 + 1) * sizeof(dist_ssize_t))) == NULL)
+		return DISTANCE_ENOMEM;
+	if ((length = (dist_ssize_t *)malloc((len2 + 1) * sizeof(dist_ssize_t))) == NULL) {
 		free(column);
-		return -1;
+		return DISTANCE_ENOMEM;
 	}
+	STAT_PATH(NLEVENSHTEIN, KERNEL_TYPE, DISTANCE_STATS_DP);
+	STAT_ADD(NLEVENSHTEIN, bytes, 2 * (len2 + 1) * sizeof(dist_ssize_t));
+	STAT_ADD(NLEVENSHTEIN, cells, len1 * len2);
 
 	for (j = 1 ; j <= len2; j++)
 		column[j] = length[j] = j;
@@ -151,7 +385,7 @@ nlevenshtein(unicode *seq1, unicode *seq2, Py_ssize_t len1, Py_ssize_t len2, sho
 			if (comp == -1) {
 				free(column);
 				free(length);
-				return -2;
+				return DISTANCE_ECOMPARE;
 			}
 			rc = last + (!comp);
 #else
@@ -176,5 +410,45 @@ nlevenshtein(unicode *seq1, unicode *seq2, Py_ssize_t len1, Py_ssize_t len2, sho
 	free(column);
 	free(length);
 	
-	return fdist / (double)flen;
+	*dist = fdist / (double)flen;
+	return DISTANCE_OK;
 }
+
+
+#ifndef SEQUENCE_COMP
+
+// A tile of the matrix of `levenshtein`, for distance_levenshtein_parallel
+// (see wavefront.h).
+
+static void
+levenshtein_tile(struct wavefront *wf, dist_ssize_t ti, dist_ssize_t tj)
+{
+	const unicode *seq1 = (const unicode *)wf->seq1, *seq2 = (const unicode *)wf->seq2;
+	dist_ssize_t *bottom = wf->bottom, *right = wf->right;
+	dist_ssize_t i, j, i0, i1, j0, j1;
+	dist_ssize_t diag, next, left, up;
+
+	if (ti == 0 && tj == 0)
+		STAT_PATH(LEVENSHTEIN, KERNEL_TYPE, DISTANCE_STATS_TILED);
+	diag = wavefront_bounds(wf, ti, tj, &i0, &i1, &j0, &j1);
+
+	for (i = i0 + 1; i <= i1; i++) {
+		left = next = right[i];
+		for (j = j0 + 1; j <= j1; j++) {
+			up = bottom[j];
+			left = MIN3(
+				up + 1,
+				left + 1,
+				diag + (seq1[i - 1] != seq2[j - 1])
+			);
+			diag = up;
+			bottom[j] = left;
+		}
+		right[i] = left;
+		diag = next;
+	}
+	WAVEFRONT_CORNER(wf, ti, tj) = bottom[j1];
+	STAT_ADD(LEVENSHTEIN, cells, (i1 - i0) * (j1 - j0));
+}
+
+#endif
@@ -0,0 +1,190 @@
+#define DISTANCE_BUILD
+#include "core.h"
+
+/* See distance/_lexicon.py for the layout of the file. The integers are read
+as they are, so that only little-endian hosts are supported; on the others,
+the version doesn't match, and the file is rejected. */
+
+#define LEXICON_MAGIC "DISTLEX"
+#define LEXICON_VERSION 1
+
+struct lexicon_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t width;
+	uint64_t count;
+	uint64_t max_len;
+};
+
+struct distance_lexicon {
+	struct file_map file;
+	int width;
+	dist_ssize_t count;
+	dist_ssize_t max_len;
+	const uint64_t *offsets;	// count + 1 of them
+	const uint64_t *lengths;	// max_len + 2 of them
+	const unsigned char *data;
+};
+
+
+// Checks the header, and that the tables and the data fit in the file.
+
+static int
+lexicon_parse(struct distance_lexicon *lex)
+{
+	const struct lexicon_header *h = (const struct lexicon_header *)lex->file.data;
+	uint64_t room;
+
+	if (lex->file.size < sizeof(struct lexicon_header))
+		return DISTANCE_EFORMAT;
+	room = lex->file.size - sizeof(struct lexicon_header);
+	if (memcmp(h->magic, LEXICON_MAGIC, 8) || h->version != LEXICON_VERSION)
+		return DISTANCE_EFORMAT;
+	if (h->width != 1 && h->width != 2 && h->width != 4)
+		return DISTANCE_EFORMAT;
+	// tables sizes, in 8 bytes words, without overflowing
+	if (h->count >= room / 8 || h->max_len >= room / 8
+		|| h->count + 1 + h->max_len + 2 > room / 8)
+		return DISTANCE_EFORMAT;
+	room -= (h->count + 1 + h->max_len + 2) * 8;
+
+	lex->width = (int)h->width;
+	lex->count = (dist_ssize_t)h->count;
+	lex->max_len = (dist_ssize_t)h->max_len;
+	lex->offsets = (const uint64_t *)(lex->file.data + sizeof(struct lexicon_header));
+	lex->lengths = lex->offsets + lex->count + 1;
+	lex->data = (const unsigned char *)(lex->lengths + lex->max_len + 2);
+	if (lex->offsets[lex->count] > room / lex->width)
+		return DISTANCE_EFORMAT;
+	return DISTANCE_OK;
+}
+
+
+DISTANCE_API int
+distance_lexicon_open(const char *path, struct distance_lexicon **lex)
+{
+	struct distance_lexicon *l;
+	int status;
+
+	if ((l = (struct distance_lexicon *)calloc(1, sizeof(struct distance_lexicon))) == NULL)
+		return DISTANCE_ENOMEM;
+	if ((status = file_map(&l->file, path)) != DISTANCE_OK) {
+		free(l);
+		return status;
+	}
+	if ((status = lexicon_parse(l)) != DISTANCE_OK) {
+		file_unmap(&l->file);
+		free(l);
+		return status;
+	}
+	*lex = l;
+	return DISTANCE_OK;
+}
+
+
+DISTANCE_API void
+distance_lexicon_close(struct distance_lexicon *lex)
+{
+	if (lex == NULL)
+		return;
+	file_unmap(&lex->file);
+	free(lex);
+}
+
+
+DISTANCE_API dist_ssize_t
+distance_lexicon_size(const struct distance_lexicon *lex)
+{
+	return lex->count;
+}
+
+
+DISTANCE_API int
+distance_lexicon_width(const struct distance_lexicon *lex)
+{
+	return lex->width;
+}
+
+
+DISTANCE_API const void *
+distance_lexicon_word(const struct distance_lexicon *lex, dist_ssize_t i, dist_ssize_t *len)
+{
+	uint64_t start, end;
+
+	if (i < 0 || i >= lex->count)
+		return NULL;
+	start = lex->offsets[i];
+	end = lex->offsets[i + 1];
+	// the last offset was checked when opening the file, not the others
+	if (start > end || end > lex->offsets[lex->count])
+		return NULL;
+	*len = (dist_ssize_t)(end - start);
+	return lex->data + start * lex->width;
+}
+
+
+DISTANCE_API int
+distance_lexicon_scan(const struct distance_lexicon *lex,
+	const void *query, int width, dist_ssize_t len, int metric, dist_ssize_t max_dist,
+	struct distance_hit **hits, dist_ssize_t *nhits)
+{
+	dist_ssize_t lo, hi, first, last, i, wlen, dist, cap = 0;
+	const void *word;
+	void *wide = NULL;
+	int status = DISTANCE_OK;
+
+	if (len < 0 || (width != 1 && width != 2 && width != 4)
+		|| metric < DISTANCE_METRIC_LEVENSHTEIN || metric > DISTANCE_METRIC_FASTCOMP_TRANSPOSITIONS)
+		return DISTANCE_EINVAL;
+
+	*hits = NULL;
+	*nhits = 0;
+
+	if (!metric_lengths(metric, len, max_dist, lex->max_len, &lo, &hi))
+		return DISTANCE_OK;
+	first = (dist_ssize_t)lex->lengths[lo];
+	last = (dist_ssize_t)lex->lengths[hi + 1];
+	if (first > last || last > lex->count)
+		return DISTANCE_EFORMAT;
+
+	/* The query and the words must have the same width: the narrowest is
+	widened, once for the query, for each word otherwise. */
+	if (width != lex->width) {
+		if ((wide = malloc(((width < lex->width ? len : lex->max_len) + 1) * 4)) == NULL)
+			return DISTANCE_ENOMEM;
+		if (width < lex->width) {
+			items_widen(wide, lex->width, query, width, len);
+			query = wide;
+			width = lex->width;
+		}
+	}
+
+	for (i = first; i < last; i++) {
+		if ((word = distance_lexicon_word(lex, i, &wlen)) == NULL || wlen > lex->max_len) {
+			status = DISTANCE_EFORMAT;
+			break;
+		}
+		if (width > lex->width) {
+			items_widen(wide, width, word, lex->width, wlen);
+			word = wide;
+		}
+		if (metric == DISTANCE_METRIC_HAMMING && wlen != len)
+			continue;
+
+		if ((status = items_compare(metric, width, query, len, word, wlen, max_dist, &dist)) != DISTANCE_OK)
+			break;
+		if (dist == -1 || (max_dist >= 0 && dist > max_dist))
+			continue;
+
+		if ((status = hits_append(hits, nhits, &cap, i, dist)) != DISTANCE_OK)
+			break;
+	}
+
+	free(wide);
+	if (status != DISTANCE_OK) {
+		free(*hits);
+		*hits = NULL;
+		*nhits = 0;
+	}
+	return status;
+}
@@ -0,0 +1,342 @@
+#define DISTANCE_BUILD
+#include "core.h"
+
+#include "instances.h"
+
+/* With GCC on x86, the kernels are compiled twice more, for SSE4.2 and for
+AVX2: mostly, the bit-parallel kernels then count bits with POPCNT and TZCNT
+rather than with library calls, and the loops over items are vectorized with
+wider registers. The helpers they share (peq.h...) are compiled once, for the
+baseline, and inlined. */
+
+#ifdef DISTANCE_MULTIVERSION
+
+#pragma GCC push_options
+#pragma GCC target("popcnt,sse4.2")
+#define KERNEL_ISA sse42
+#define KERNEL_ISA_LEVEL DISTANCE_ISA_SSE42
+#include "instances.h"
+#undef KERNEL_ISA
+#undef KERNEL_ISA_LEVEL
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("popcnt,sse4.2,avx2,bmi,bmi2")
+#define KERNEL_ISA avx2
+#define KERNEL_ISA_LEVEL DISTANCE_ISA_AVX2
+#include "instances.h"
+#undef KERNEL_ISA
+#undef KERNEL_ISA_LEVEL
+#pragma GCC pop_options
+
+#define KERNEL(name, sfx)										\
+	(cpu_level == DISTANCE_ISA_AVX2 ? name##_##sfx##_avx2		\
+		: cpu_level == DISTANCE_ISA_SSE42 ? name##_##sfx##_sse42	\
+		: name##_##sfx)
+
+#else
+
+#define KERNEL(name, sfx) name##_##sfx
+
+#endif
+
+
+// Public entry points: they check their arguments, and call the kernels of the
+// current instruction set level.
+
+#define DISTANCE_DEFINE(sfx, T)																					\
+																												\
+DISTANCE_API int																								\
+distance_hamming_##sfx(const T *seq1, const T *seq2, dist_ssize_t len, dist_ssize_t *dist)						\
+{																												\
+	int rv;																										\
+	if (len < 0)																								\
+		return DISTANCE_EINVAL;																					\
+	STAT_TIMED(hamming, rv, KERNEL(hamming, sfx)((T *)seq1, (T *)seq2, len, dist));								\
+	return rv;																									\
+}																												\
+																												\
+DISTANCE_API int																								\
+distance_levenshtein_##sfx(const T *seq1, const T *seq2,														\
+	dist_ssize_t len1, dist_ssize_t len2, dist_ssize_t max_dist, dist_ssize_t *dist)							\
+{																												\
+	int rv;																										\
+	if (len1 < 0 || len2 < 0)																					\
+		return DISTANCE_EINVAL;																					\
+	STAT_TIMED(levenshtein, rv, KERNEL(levenshtein, sfx)((T *)seq1, (T *)seq2,									\
+		len1, len2, max_dist, dist));																			\
+	return rv;																									\
+}																												\
+																												\
+DISTANCE_API int																								\
+distance_nlevenshtein_##sfx(const T *seq1, const T *seq2,														\
+	dist_ssize_t len1, dist_ssize_t len2, int method, double *dist)												\
+{																												\
+	int rv;																										\
+	if (len1 < 0 || len2 < 0 || (method != 1 && method != 2))													\
+		return DISTANCE_EINVAL;																					\
+	STAT_TIMED(nlevenshtein, rv, KERNEL(nlevenshtein, sfx)((T *)seq1, (T *)seq2,								\
+		len1, len2, method, dist));																				\
+	return rv;																									\
+}																												\
+																												\
+DISTANCE_API int																								\
+distance_fastcomp_##sfx(const T *seq1, const T *seq2,															\
+	dist_ssize_t len1, dist_ssize_t len2, int transpositions, int *dist)										\
+{																												\
+	int rv;																										\
+	if (len1 < 0 || len2 < 0)																					\
+		return DISTANCE_EINVAL;																					\
+	STAT_TIMED(fastcomp, rv, KERNEL(fastcomp, sfx)((T *)seq1, (T *)seq2,										\
+		len1, len2, transpositions, dist));																		\
+	return rv;																									\
+}																												\
+																												\
+DISTANCE_API int																								\
+distance_lcsubstrings_##sfx(const T *seq1, const T *seq2,														\
+	dist_ssize_t len1, dist_ssize_t len2, dist_ssize_t *max_len,												\
+	struct distance_pair **pairs, dist_ssize_t *npairs)															\
+{																												\
+	int rv;																										\
+	if (len1 < 0 || len2 < 0)																					\
+		return DISTANCE_EINVAL;																					\
+	STAT_TIMED(lcsubstrings, rv, KERNEL(lcsubstrings, sfx)((T *)seq1, (T *)seq2,								\
+		len1, len2, max_len, pairs, npairs));																	\
+	return rv;																									\
+}																												\
+																												\
+DISTANCE_API int																								\
+distance_common_substrings_##sfx(const T *seq1, const T *seq2,													\
+	dist_ssize_t len1, dist_ssize_t len2, dist_ssize_t min_len,													\
+	struct distance_cursor *cursor, struct distance_pair *pos, dist_ssize_t *len)								\
+{																												\
+	int rv;																										\
+	if (len1 < 0 || len2 < 0 || min_len < 1 || cursor->diag < 0 || cursor->pos < 0)							\
+		return DISTANCE_EINVAL;																					\
+	STAT_TIMED(lcsubstrings, rv, KERNEL(common_substrings, sfx)((T *)seq1, (T *)seq2,							\
+		len1, len2, min_len, cursor, pos, len));																\
+	return rv;																									\
+}																												\
+																												\
+DISTANCE_API int																								\
+distance_jaro_##sfx(const T *seq1, const T *seq2,																\
+	dist_ssize_t len1, dist_ssize_t len2, double prefix_weight, double min_score,								\
+	double *score)																								\
+{																												\
+	int rv;																										\
+	if (len1 < 0 || len2 < 0 || prefix_weight < 0.0 || prefix_weight > 0.25)									\
+		return DISTANCE_EINVAL;																					\
+	STAT_TIMED(jaro, rv, KERNEL(jaro, sfx)((T *)seq1, (T *)seq2,												\
+		len1, len2, prefix_weight, min_score, score));															\
+	return rv;																									\
+}																												\
+																												\
+DISTANCE_API int																								\
+distance_lcs_##sfx(const T *seq1, const T *seq2, dist_ssize_t len1, dist_ssize_t len2, dist_ssize_t *len)		\
+{																												\
+	int rv;																										\
+	if (len1 < 0 || len2 < 0)																					\
+		return DISTANCE_EINVAL;																					\
+	STAT_TIMED(lcs, rv, KERNEL(lcs, sfx)((T *)seq1, (T *)seq2, len1, len2, len));								\
+	return rv;																									\
+}																												\
+																												\
+DISTANCE_API int																								\
+distance_indel_##sfx(const T *seq1, const T *seq2,																\
+	dist_ssize_t len1, dist_ssize_t len2, dist_ssize_t max_dist, dist_ssize_t *dist)							\
+{																												\
+	int rv;																										\
+	if (len1 < 0 || len2 < 0)																					\
+		return DISTANCE_EINVAL;																					\
+	STAT_TIMED(indel, rv, KERNEL(indel, sfx)((T *)seq1, (T *)seq2, len1, len2, max_dist, dist));				\
+	return rv;																									\
+}
+
+DISTANCE_DEFINE(u8, uint8_t)
+DISTANCE_DEFINE(u16, uint16_t)
+DISTANCE_DEFINE(u32, uint32_t)
+
+
+// Helpers of the searches over lexicons, candidate sets and patterns (see
+// core.h).
+
+void
+items_widen(void *dst, int to, const void *src, int from, dist_ssize_t len)
+{
+	dist_ssize_t i;
+
+	for (i = 0; i < len; i++) {
+		if (to == 4)
+			((uint32_t *)dst)[i] = (from == 1 ? ((const uint8_t *)src)[i] : ((const uint16_t *)src)[i]);
+		else
+			((uint16_t *)dst)[i] = ((const uint8_t *)src)[i];
+	}
+}
+
+
+#define ITEMS_COMPARE(sfx, T)															\
+static int																				\
+items_compare_##sfx(const T *seq1, dist_ssize_t len1, const T *seq2, dist_ssize_t len2,	\
+	int metric, dist_ssize_t max_dist, dist_ssize_t *dist)								\
+{																						\
+	int status, fdist = -1;																\
+																						\
+	switch (metric) {																	\
+		case DISTANCE_METRIC_LEVENSHTEIN:												\
+			return distance_levenshtein_##sfx(seq1, seq2, len1, len2, max_dist, dist);	\
+		case DISTANCE_METRIC_HAMMING:													\
+			if (len1 != len2)															\
+				return DISTANCE_EINVAL;													\
+			return distance_hamming_##sfx(seq1, seq2, len1, dist);						\
+	}																					\
+	status = distance_fastcomp_##sfx(seq1, seq2, len1, len2,							\
+		metric == DISTANCE_METRIC_FASTCOMP_TRANSPOSITIONS, &fdist);						\
+	*dist = fdist;																		\
+	return status;																		\
+}
+
+ITEMS_COMPARE(u8, uint8_t)
+ITEMS_COMPARE(u16, uint16_t)
+ITEMS_COMPARE(u32, uint32_t)
+
+
+int
+items_compare(int metric, int width, const void *seq1, dist_ssize_t len1,
+	const void *seq2, dist_ssize_t len2, dist_ssize_t max_dist, dist_ssize_t *dist)
+{
+	switch (width) {
+		case 1:
+			return items_compare_u8(seq1, len1, seq2, len2, metric, max_dist, dist);
+		case 2:
+			return items_compare_u16(seq1, len1, seq2, len2, metric, max_dist, dist);
+	}
+	return items_compare_u32(seq1, len1, seq2, len2, metric, max_dist, dist);
+}
+
+
+// Tile kernels of the parallel entry points (see wavefront.h).
+
+wavefront_tile_t
+wavefront_kernel(int algo, int width)
+{
+	if (algo == WAVEFRONT_LCSUBSTRINGS) {
+		switch (width) {
+			case 1:
+				return KERNEL(lcsubstrings_tile, u8);
+			case 2:
+				return KERNEL(lcsubstrings_tile, u16);
+		}
+		return KERNEL(lcsubstrings_tile, u32);
+	}
+	switch (width) {
+		case 1:
+			return KERNEL(levenshtein_tile, u8);
+		case 2:
+			return KERNEL(levenshtein_tile, u16);
+	}
+	return KERNEL(levenshtein_tile, u32);
+}
+
+
+int
+metric_lengths(int metric, dist_ssize_t len, dist_ssize_t max_dist, dist_ssize_t max_len,
+	dist_ssize_t *lo, dist_ssize_t *hi)
+{
+	dist_ssize_t bound = metric_bound(metric, max_dist);
+
+	if (metric == DISTANCE_METRIC_HAMMING)
+		bound = 0;
+	*lo = 0;
+	*hi = max_len;
+	if (bound >= 0) {
+		*lo = (len > bound ? len - bound : 0);
+		if (bound < max_len && len + bound < max_len)
+			*hi = len + bound;
+	}
+	return *lo <= *hi;
+}
+
+
+int
+hits_append(struct distance_hit **hits, dist_ssize_t *nhits, dist_ssize_t *cap,
+	dist_ssize_t index, dist_ssize_t dist)
+{
+	struct distance_hit *tmp;
+
+	if (*nhits == *cap) {
+		*cap = (*cap ? 2 * *cap : 64);
+		if ((tmp = (struct distance_hit *)realloc(*hits, *cap * sizeof(struct distance_hit))) == NULL)
+			return DISTANCE_ENOMEM;
+		*hits = tmp;
+	}
+	(*hits)[*nhits].index = index;
+	(*hits)[*nhits].dist = dist;
+	(*nhits)++;
+	return DISTANCE_OK;
+}
+
+
+static int
+gram_cmp(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+
+void
+qgram_profile(uint32_t *grams, int q, const void *items, int width, dist_ssize_t len)
+{
+	dist_ssize_t i;
+	uint32_t h, item;
+	int j;
+
+	for (i = 0; i + q <= len; i++) {
+		h = 2166136261u;		// FNV-1a, on items rather than bytes
+		for (j = 0; j < q; j++) {
+			switch (width) {
+				case 1:
+					item = ((const uint8_t *)items)[i + j];
+					break;
+				case 2:
+					item = ((const uint16_t *)items)[i + j];
+					break;
+				default:
+					item = ((const uint32_t *)items)[i + j];
+			}
+			h = (h ^ item) * 16777619u;
+		}
+		grams[i] = h;
+	}
+	if (len >= q)
+		qsort(grams, len - q + 1, sizeof(uint32_t), gram_cmp);
+}
+
+
+DISTANCE_API void
+distance_free(void *ptr)
+{
+	free(ptr);
+}
+
+
+DISTANCE_API const char *
+distance_strerror(int status)
+{
+	switch (status) {
+		case DISTANCE_OK:
+			return "no error";
+		case DISTANCE_ENOMEM:
+			return "memory allocation failed";
+		case DISTANCE_ECOMPARE:
+			return "comparison of two items failed";
+		case DISTANCE_EINVAL:
+			return "invalid argument";
+		case DISTANCE_EIO:
+			return "input/output error";
+		case DISTANCE_EFORMAT:
+			return "invalid file format";
+	}
+	return "unknown error";
+}
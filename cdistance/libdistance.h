@@ -0,0 +1,680 @@
+#ifndef LIBDISTANCE_H
+#define LIBDISTANCE_H
+
+/* libdistance - the distance kernels, usable without Python.
+
+The functions are provided for sequences of 8, 16 and 32 bits items, with
+the suffixes `_u8`, `_u16` and `_u32`. For example, `distance_levenshtein_u8`
+works on byte strings, and `distance_levenshtein_u32` on UCS4 strings or on
+arrays of integer ids.
+
+All the functions return a status code, `DISTANCE_OK` on success, and store
+their result through their last argument(s). */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32) && defined(DISTANCE_SHARED)
+	#ifdef DISTANCE_BUILD
+		#define DISTANCE_API __declspec(dllexport)
+	#else
+		#define DISTANCE_API __declspec(dllimport)
+	#endif
+#else
+	#define DISTANCE_API
+#endif
+
+typedef ptrdiff_t dist_ssize_t;
+
+// Status codes
+
+#define DISTANCE_OK          0
+#define DISTANCE_ENOMEM     -1		// memory allocation failed
+#define DISTANCE_ECOMPARE   -2		// the comparison of two items failed
+#define DISTANCE_EINVAL     -3		// invalid argument
+#define DISTANCE_EIO        -4		// a file couldn't be read, see errno
+#define DISTANCE_EFORMAT    -5		// a file isn't in the expected format
+
+
+// Position of a common substring: start in the first sequence, start in the
+// second one.
+
+struct distance_pair {
+	dist_ssize_t i;
+	dist_ssize_t j;
+};
+
+// Position reached by `common_substrings`, to be zeroed before the first call.
+
+struct distance_cursor {
+	dist_ssize_t diag;
+	dist_ssize_t pos;
+};
+
+
+/* hamming: number of differing items between two sequences of length `len`.
+
+levenshtein: edit distance between the two sequences. If `max_dist` is
+positive or 0 and the distance is higher than that, the computation stops
+early and -1 is stored in `dist`.
+
+nlevenshtein: normalized edit distance, between 0 and 1. `method` is 1 for
+dividing by the length of the longest sequence, 2 for dividing by the length
+of the longest alignment.
+
+fastcomp: edit distance up to 2 included, -1 is stored if it is higher.
+If `transpositions` is non-zero, a transposition counts as one edit.
+
+lcsubstrings: length of the longest common substrings, and an array of
+their start positions, to be released with `distance_free`. `*pairs` is
+NULL if there is no common substring.
+
+common_substrings: next maximal common substring of at least `min_len` items
+(which is at least 1), i.e. a common substring which can't be extended on
+either side. Its start positions are stored in `pos`, and its length in `len`,
+or 0 if there is none left. The substrings are found diagonal by diagonal,
+by increasing `j - i`, and by increasing position along each diagonal;
+`cursor` keeps track of the position reached, so that they can be enumerated
+without storing them.
+
+jaro: Jaro-Winkler similarity, between 0 and 1; `prefix_weight` should be
+between 0 and 0.25, and 0 gives the plain Jaro similarity. If `min_score`
+is positive or 0 and the similarity is lower than that, the computation
+stops early and -1 is stored in `score`.
+
+lcs: length of the longest common subsequence of the two sequences.
+
+indel: number of insertions and deletions needed to turn one sequence into
+the other, i.e. `len1 + len2 - 2 * lcs`. If `max_dist` is positive or 0 and
+the distance is higher than that, -1 is stored in `dist`. */
+
+#define DISTANCE_DECLARE(sfx, T)														\
+DISTANCE_API int distance_hamming_##sfx(const T *seq1, const T *seq2,				\
+	dist_ssize_t len, dist_ssize_t *dist);												\
+DISTANCE_API int distance_levenshtein_##sfx(const T *seq1, const T *seq2,			\
+	dist_ssize_t len1, dist_ssize_t len2, dist_ssize_t max_dist, dist_ssize_t *dist);	\
+DISTANCE_API int distance_nlevenshtein_##sfx(const T *seq1, const T *seq2,			\
+	dist_ssize_t len1, dist_ssize_t len2, int method, double *dist);					\
+DISTANCE_API int distance_fastcomp_##sfx(const T *seq1, const T *seq2,				\
+	dist_ssize_t len1, dist_ssize_t len2, int transpositions, int *dist);				\
+DISTANCE_API int distance_lcsubstrings_##sfx(const T *seq1, const T *seq2,			\
+	dist_ssize_t len1, dist_ssize_t len2, dist_ssize_t *max_len,						\
+	struct distance_pair **pairs, dist_ssize_t *npairs);								\
+DISTANCE_API int distance_common_substrings_##sfx(const T *seq1, const T *seq2,		\
+	dist_ssize_t len1, dist_ssize_t len2, dist_ssize_t min_len,						\
+	struct distance_cursor *cursor, struct distance_pair *pos, dist_ssize_t *len);		\
+DISTANCE_API int distance_jaro_##sfx(const T *seq1, const T *seq2,					\
+	dist_ssize_t len1, dist_ssize_t len2, double prefix_weight, double min_score,		\
+	double *score);																	\
+DISTANCE_API int distance_lcs_##sfx(const T *seq1, const T *seq2,						\
+	dist_ssize_t len1, dist_ssize_t len2, dist_ssize_t *len);							\
+DISTANCE_API int distance_indel_##sfx(const T *seq1, const T *seq2,					\
+	dist_ssize_t len1, dist_ssize_t len2, dist_ssize_t max_dist, dist_ssize_t *dist);
+
+DISTANCE_DECLARE(u8, uint8_t)
+DISTANCE_DECLARE(u16, uint16_t)
+DISTANCE_DECLARE(u32, uint32_t)
+
+
+/* Parallel versions of levenshtein and lcsubstrings, for a single pair of long
+sequences of items of `width` bytes (1, 2 or 4). The matrix of the dynamic
+programming is cut into tiles, and the tiles of each anti-diagonal are computed
+by `nthreads` threads. The results are those of the functions above, including
+the order of the positions of lcsubstrings. Pairs of less than a few thousand
+items, and those which levenshtein compares along the diagonals (small
+`max_dist`, or near-identical sequences), are compared in the calling thread. */
+
+DISTANCE_API int distance_levenshtein_parallel(const void *seq1, const void *seq2, int width,
+	dist_ssize_t len1, dist_ssize_t len2, dist_ssize_t max_dist, int nthreads,
+	dist_ssize_t *dist);
+DISTANCE_API int distance_lcsubstrings_parallel(const void *seq1, const void *seq2, int width,
+	dist_ssize_t len1, dist_ssize_t len2, int nthreads,
+	dist_ssize_t *max_len, struct distance_pair **pairs, dist_ssize_t *npairs);
+
+
+/* Instruction sets. With GCC on x86, the kernels above are compiled for several
+levels of the instruction set, and the highest one supported by the CPU is
+selected when the library is loaded, unless the environment variable
+DISTANCE_ISA names a lower one. Other builds only have the baseline level.
+
+	DISTANCE_ISA_BASELINE	what the compiler targets by default
+	DISTANCE_ISA_SSE42		"sse4.2": SSE4.2 and POPCNT
+	DISTANCE_ISA_AVX2		"avx2": AVX2, BMI and BMI2
+
+distance_isa: level in use; distance_isa_max: highest level available.
+
+distance_set_isa: selects another level, e.g. for benchmarks; returns
+DISTANCE_EINVAL if it isn't available. It must not be called while kernels run
+in other threads.
+
+distance_isa_name, distance_isa_level: name of a level, NULL if there is no
+such level, and the reverse, -1 if there is no such name.
+
+distance_cpu_features: the DISTANCE_CPU_* flags of the features of the CPU,
+0 if the build has only the baseline level. */
+
+enum distance_isa_level {
+	DISTANCE_ISA_BASELINE,
+	DISTANCE_ISA_SSE42,
+	DISTANCE_ISA_AVX2,
+	DISTANCE_ISA_NLEVELS
+};
+
+#define DISTANCE_CPU_POPCNT		0x01
+#define DISTANCE_CPU_SSE42		0x02
+#define DISTANCE_CPU_AVX2		0x04
+#define DISTANCE_CPU_BMI2		0x08
+#define DISTANCE_CPU_AVX512F	0x10
+
+DISTANCE_API int distance_isa(void);
+DISTANCE_API int distance_isa_max(void);
+DISTANCE_API int distance_set_isa(int level);
+DISTANCE_API const char *distance_isa_name(int level);
+DISTANCE_API int distance_isa_level(const char *name);
+DISTANCE_API unsigned distance_cpu_features(void);
+
+
+/* Case folding, for comparing strings without regard to case: the items are
+read as code points, and mapped to a single code point each, so that the
+lengths and the positions are unchanged. DISTANCE_FOLD_ASCII only maps A-Z
+to a-z; DISTANCE_FOLD_SIMPLE applies the simple case folding of Unicode
+(CaseFolding.txt, statuses C and S).
+
+distance_fold: stores in `folded` a new buffer holding the folded items, to
+be released with `distance_free`, and their width in `folded_width`. This is
+`width`, except for 8 bits items which fold to U+03BC, which are widened to
+16 bits. If no item changes, nothing is allocated and `folded` is NULL.
+
+distance_fold_into: the same, into `buffer` rather than a new buffer, e.g. to
+reuse it for many sequences; it must hold DISTANCE_FOLD_SIZE(len, width)
+bytes. `folded_width` is set to 0 if no item changes. */
+
+enum distance_fold_mode {
+	DISTANCE_FOLD_NONE,
+	DISTANCE_FOLD_ASCII,
+	DISTANCE_FOLD_SIMPLE
+};
+
+#define DISTANCE_FOLD_SIZE(len, width) ((size_t)((len) + 1) * ((width) == 1 ? 2 : (width)))
+
+DISTANCE_API uint32_t distance_fold_char(uint32_t c, int fold);
+DISTANCE_API int distance_fold(const void *items, int width, dist_ssize_t len, int fold,
+	void **folded, int *folded_width);
+DISTANCE_API int distance_fold_into(const void *items, int width, dist_ssize_t len, int fold,
+	void *buffer, int *folded_width);
+
+
+/* One-vs-many searches, over lexicons and candidate sets: a query is compared
+with each stored sequence using `metric`, and the sequences which distance is
+lower or equal to `max_dist` (any distance if negative) are returned as an
+array of hits, to be released with `distance_free`. Only the sequences which
+length is compatible with `max_dist` are compared. */
+
+enum distance_metric {
+	DISTANCE_METRIC_LEVENSHTEIN,
+	DISTANCE_METRIC_HAMMING,		// only the sequences of the length of the query
+	DISTANCE_METRIC_FASTCOMP,		// only the sequences at distance 2 or less
+	DISTANCE_METRIC_FASTCOMP_TRANSPOSITIONS
+};
+
+struct distance_hit {
+	dist_ssize_t index;				// of the sequence in the lexicon or set
+	dist_ssize_t dist;
+};
+
+
+/* Lexicons: read-only lists of words stored in a file, which is mapped in
+memory rather than read. The words are sorted by length, and their items are
+8, 16 or 32 bits wide, `width` being 1, 2 or 4; see distance/_lexicon.py for
+the layout of the file.
+
+distance_lexicon_open: maps the file `path`; the lexicon is released with
+`distance_lexicon_close`.
+
+distance_lexicon_word: items and length of the word `i`, NULL if `i` is out of
+range.
+
+distance_lexicon_scan: compares `query`, made of items of `width` bytes, with
+the words of the lexicon; the hits are in the order of the lexicon. */
+
+struct distance_lexicon;
+
+DISTANCE_API int distance_lexicon_open(const char *path, struct distance_lexicon **lex);
+DISTANCE_API void distance_lexicon_close(struct distance_lexicon *lex);
+DISTANCE_API dist_ssize_t distance_lexicon_size(const struct distance_lexicon *lex);
+DISTANCE_API int distance_lexicon_width(const struct distance_lexicon *lex);
+DISTANCE_API const void *distance_lexicon_word(const struct distance_lexicon *lex,
+	dist_ssize_t i, dist_ssize_t *len);
+DISTANCE_API int distance_lexicon_scan(const struct distance_lexicon *lex,
+	const void *query, int width, dist_ssize_t len, int metric, dist_ssize_t max_dist,
+	struct distance_hit **hits, dist_ssize_t *nhits);
+
+
+/* Patterns: a query compiled for being compared with many sequences. The
+match vectors of the bit-parallel kernels (DISTANCE_PATTERN_PEQ) and the
+q-gram profile (DISTANCE_PATTERN_QGRAMS) are computed once, rather than for
+each comparison. The query is copied, and the sequences it is compared with
+can have items of any width.
+
+distance_pattern_levenshtein, distance_pattern_lcs, distance_pattern_indel:
+as `distance_levenshtein_*`, `distance_lcs_*` and `distance_indel_*`, with the
+query as the first sequence. The match vectors are used by lcs and indel
+whatever the length of the query, and by levenshtein for queries of at most
+64 items; the other comparisons fall back on the plain kernels.
+
+distance_pattern_qgrams: the q-gram profile and its `q`, NULL if it wasn't
+built. */
+
+enum distance_pattern_flags {
+	DISTANCE_PATTERN_PEQ = 1,
+	DISTANCE_PATTERN_QGRAMS = 2
+};
+
+struct distance_pattern;
+
+DISTANCE_API int distance_pattern_new(const void *items, int width, dist_ssize_t len,
+	int flags, int q, struct distance_pattern **pat);
+DISTANCE_API void distance_pattern_free(struct distance_pattern *pat);
+DISTANCE_API const void *distance_pattern_query(const struct distance_pattern *pat,
+	int *width, dist_ssize_t *len);
+DISTANCE_API const uint32_t *distance_pattern_qgrams(const struct distance_pattern *pat,
+	int *q, dist_ssize_t *ngrams);
+DISTANCE_API int distance_pattern_levenshtein(const struct distance_pattern *pat,
+	const void *items, int width, dist_ssize_t len, dist_ssize_t max_dist, dist_ssize_t *dist);
+DISTANCE_API int distance_pattern_lcs(const struct distance_pattern *pat,
+	const void *items, int width, dist_ssize_t len, dist_ssize_t *lcs);
+DISTANCE_API int distance_pattern_indel(const struct distance_pattern *pat,
+	const void *items, int width, dist_ssize_t len, dist_ssize_t max_dist, dist_ssize_t *dist);
+
+
+/* Scans: approximate search of the query of a pattern, which must have been
+built with DISTANCE_PATTERN_PEQ, in a text. A match is an end position in the
+text at which a substring ending there is at Levenshtein distance `max_dist`
+or less from the query, with the lowest such distance. If `starts` is set,
+the start of the shortest of these substrings is searched too; otherwise it
+is -1.
+
+distance_scan_next: stores the next matches, at most `cap` of them, in
+`matches`, in increasing order of their ends, and their number in `n`, which
+is 0 at the end of the text. The same text must be passed to every call, and
+the pattern must stay valid as long as the scan is used.
+
+distance_pattern_search: the lowest distance of the matches in a sequence,
+i.e. the lowest Levenshtein distance between the query and a substring of
+the sequence, without looking for their positions. It stops as soon as an
+exact match is found. If `max_dist` is positive or 0 and the distance is
+higher than that, -1 is stored in `dist`. */
+
+struct distance_match {
+	dist_ssize_t start;
+	dist_ssize_t end;				// exclusive
+	dist_ssize_t dist;
+};
+
+struct distance_scan;
+
+DISTANCE_API int distance_scan_new(const struct distance_pattern *pat, dist_ssize_t max_dist,
+	int starts, struct distance_scan **scan);
+DISTANCE_API void distance_scan_free(struct distance_scan *scan);
+DISTANCE_API int distance_scan_next(struct distance_scan *scan, const void *text, int width,
+	dist_ssize_t len, struct distance_match *matches, dist_ssize_t cap, dist_ssize_t *n);
+DISTANCE_API int distance_pattern_search(const struct distance_pattern *pat,
+	const void *items, int width, dist_ssize_t len, dist_ssize_t max_dist, dist_ssize_t *dist);
+
+
+/* Grep: approximate search of patterns, built with DISTANCE_PATTERN_PEQ, in
+the lines of a text of bytes, separated by '\n' which isn't part of them.
+
+distance_grep: compares the lines which start between the offsets `from`
+included and `to` excluded with each pattern, so that a text can be searched
+in chunks cut anywhere, e.g. by several threads. In DISTANCE_GREP_LINE mode, a
+line matches if it is at Levenshtein distance `max_dist` or less from the
+pattern; in DISTANCE_GREP_SUBSTRING mode, if one of its substrings is. The
+hits are in the order of the lines, then of the patterns, and are released
+with `distance_free`; the number of lines searched is stored in `nlines`. */
+
+enum distance_grep_mode {
+	DISTANCE_GREP_LINE,
+	DISTANCE_GREP_SUBSTRING
+};
+
+struct distance_line_hit {
+	dist_ssize_t line;				// among the lines searched, from 0
+	dist_ssize_t start;				// offsets of the line in the text
+	dist_ssize_t end;				// exclusive, without the newline
+	dist_ssize_t index;				// of the pattern
+	dist_ssize_t dist;				// lowest distance, in substring mode
+};
+
+DISTANCE_API int distance_grep(const struct distance_pattern *const *patterns,
+	dist_ssize_t npatterns, int mode, dist_ssize_t max_dist, const void *text, dist_ssize_t len,
+	dist_ssize_t from, dist_ssize_t to, struct distance_line_hit **hits, dist_ssize_t *nhits,
+	dist_ssize_t *nlines);
+
+
+/* Q-gram profiles: the multiset of the q-grams (substrings of `q` items) of a
+sequence, as the sorted array of their distinct 64 bits hashes with their
+counts. Profiles are compared by merging them, and can be reused for any
+number of comparisons; both must have been built with the same `q`.
+
+distance_profile_size: the number of q-grams, `len - q + 1`, and `q`.
+
+distance_qgram_distance: the number of q-grams which are in only one of the
+profiles, counted with their multiplicity (Ukkonen's q-gram distance).
+
+distance_cosine: 1 minus the cosine similarity of the vectors of counts.
+
+distance_overlap: 1 minus the number of q-grams in common divided by the size
+of the smallest profile.
+
+The last two are floats between 0 (equal) and 1; they are 0 for two empty
+profiles, and 1 if only one of them is empty. */
+
+struct distance_profile;
+
+DISTANCE_API int distance_profile_new(const void *items, int width, dist_ssize_t len, int q,
+	struct distance_profile **profile);
+DISTANCE_API void distance_profile_free(struct distance_profile *profile);
+DISTANCE_API dist_ssize_t distance_profile_size(const struct distance_profile *profile, int *q);
+DISTANCE_API int distance_qgram_distance(const struct distance_profile *p1,
+	const struct distance_profile *p2, dist_ssize_t *dist);
+DISTANCE_API int distance_cosine(const struct distance_profile *p1,
+	const struct distance_profile *p2, double *dist);
+DISTANCE_API int distance_overlap(const struct distance_profile *p1,
+	const struct distance_profile *p2, double *dist);
+
+
+/* Candidate sets: sequences grouped by length, each with the profile of its
+q-grams (substrings of `q` items). When searching with a bound, the buckets
+of incompatible lengths are skipped, and the candidates which don't share
+enough q-grams with the query are rejected before being compared, following
+the q-gram lemma: sequences at distance `k` share at least
+`max(len1, len2) - q + 1 - k * q` q-grams.
+
+distance_candidates_add: adds a sequence of items of `width` bytes. The items
+are not copied, and must stay valid as long as the set is used.
+
+distance_candidates_search: compares `query` with the candidates; the hits
+are in the order in which the candidates were added.
+
+distance_candidates_search_pattern: the same, for the query of a pattern
+(see below), the profile of which is reused if it was built with the `q` of
+the set. */
+
+struct distance_candidates;
+
+DISTANCE_API int distance_candidates_new(int q, struct distance_candidates **cs);
+DISTANCE_API void distance_candidates_free(struct distance_candidates *cs);
+DISTANCE_API int distance_candidates_add(struct distance_candidates *cs,
+	const void *items, int width, dist_ssize_t len);
+DISTANCE_API dist_ssize_t distance_candidates_size(const struct distance_candidates *cs);
+DISTANCE_API int distance_candidates_search(const struct distance_candidates *cs,
+	const void *query, int width, dist_ssize_t len, int metric, dist_ssize_t max_dist,
+	struct distance_hit **hits, dist_ssize_t *nhits);
+DISTANCE_API int distance_candidates_search_pattern(const struct distance_candidates *cs,
+	const struct distance_pattern *pat, int metric, dist_ssize_t max_dist,
+	struct distance_hit **hits, dist_ssize_t *nhits);
+
+
+/* Tries: sequences stored as a prefix tree, searched with the Levenshtein
+distance only. The search walks the tree keeping one row of the dynamic
+programming matrix per depth, so that the prefixes shared by several
+sequences are compared once, and skips the subtrees in which no sequence can
+be at distance `max_dist` or less.
+
+distance_trie_build: builds a trie from `count` sequences. Their items are
+of `widths[i]` bytes, or of `width` bytes if `widths` is NULL, and are copied.
+A sequence present several times is stored once, as the first of them.
+
+distance_trie_search: the hits are indexes in the sequences given to
+`distance_trie_build`, in the lexicographic order of the sequences. */
+
+struct distance_trie;
+
+DISTANCE_API int distance_trie_build(const void *const *items, const dist_ssize_t *lens,
+	const int *widths, int width, dist_ssize_t count, struct distance_trie **trie);
+DISTANCE_API void distance_trie_free(struct distance_trie *trie);
+DISTANCE_API dist_ssize_t distance_trie_size(const struct distance_trie *trie);
+DISTANCE_API int distance_trie_search(const struct distance_trie *trie,
+	const void *query, int width, dist_ssize_t len, dist_ssize_t max_dist,
+	struct distance_hit **hits, dist_ssize_t *nhits);
+
+
+/* Similarity joins: the pairs of sets of tokens at Jaccard distance
+`threshold` or less, for 0 <= threshold < 1. A collection of `nsets` sets is
+given as their tokens, one set after the other, and the `nsets + 1` offsets
+of the sets in `tokens`. The tokens are numbers lower than `ntokens`, e.g. the
+ids of a vocabulary; the duplicates of a set are ignored, and the empty sets
+are never part of a pair.
+
+distance_jaccard_join: joins the first collection with itself if `tokens2` is
+NULL, each pair being found once, with i < j; otherwise joins it with the
+second one, `i` being the index of a set of the first collection, and `j` of
+the second one. The sets are compared by `nthreads` threads. The pairs are
+sorted by `i`, then by `j`. */
+
+struct distance_join_pair {
+	dist_ssize_t i;
+	dist_ssize_t j;
+	double dist;
+};
+
+DISTANCE_API int distance_jaccard_join(const uint32_t *tokens1, const dist_ssize_t *offsets1,
+	dist_ssize_t nsets1, const uint32_t *tokens2, const dist_ssize_t *offsets2,
+	dist_ssize_t nsets2, dist_ssize_t ntokens, double threshold, int nthreads,
+	struct distance_join_pair **pairs, dist_ssize_t *npairs);
+
+
+/* Set indexes: sets of tokens, searched for the `k` ones closest to a query
+set, by Jaccard or Sorensen distance. The tokens are numbers, e.g. the ids of
+a vocabulary; the duplicates of a set are ignored.
+
+distance_set_index_add: adds a set, the index of which is the number of sets
+added before it.
+
+distance_set_index_topk: the `k` sets closest to the query, the similarity of
+which, 1 minus their distance, is `min_sim` or more, sorted by distance, then
+by index. The query is given as its tokens which may be in the index, and the
+number of its other tokens, `missing`. The sets which share no token with the
+query are never part of the result. */
+
+enum distance_set_metric {
+	DISTANCE_SET_JACCARD,
+	DISTANCE_SET_SORENSEN
+};
+
+struct distance_set_hit {
+	dist_ssize_t index;
+	double dist;
+};
+
+struct distance_set_index;
+
+DISTANCE_API int distance_set_index_new(struct distance_set_index **idx);
+DISTANCE_API void distance_set_index_free(struct distance_set_index *idx);
+DISTANCE_API int distance_set_index_add(struct distance_set_index *idx,
+	const uint32_t *tokens, dist_ssize_t len);
+DISTANCE_API dist_ssize_t distance_set_index_size(const struct distance_set_index *idx);
+DISTANCE_API int distance_set_index_topk(const struct distance_set_index *idx,
+	const uint32_t *tokens, dist_ssize_t len, dist_ssize_t missing, int metric, dist_ssize_t k,
+	double min_sim, struct distance_set_hit **hits, dist_ssize_t *nhits);
+
+
+/* Nucleotide sequences packed in 2 bits per base: A, C, G and T, by blocks of
+64 bases stored as two words, the low bits of the codes of the bases (A = 0,
+C = 1, G = 2, T = 3) and their high bits; `n` flags the positions of N, with a
+word per block, and is NULL if there are none. Lowercase bases are packed as
+uppercase ones. Two packed sequences compare as the strings of their bases.
+
+distance_dna_pack: packs `len` items of `width` bytes into a new sequence, to
+be released with `distance_dna_release`. Returns DISTANCE_EINVAL, storing the
+position of the first item which isn't a base in `bad`, if there is one.
+
+distance_dna_unpack: stores the `len` bases of a sequence, as bytes, in
+`bases`.
+
+distance_dna_hamming, distance_dna_levenshtein: as `distance_hamming_u8` and
+`distance_levenshtein_u8`. Hamming counts the bits of the XOR of the blocks,
+and Levenshtein runs the bit-parallel kernel, computing the match vectors of
+64 bases at once from their words. */
+
+struct distance_dna {
+	uint64_t *bits;					// two words per block
+	uint64_t *n;					// one word per block, or NULL
+	dist_ssize_t len;
+};
+
+DISTANCE_API int distance_dna_pack(const void *items, int width, dist_ssize_t len,
+	struct distance_dna *dna, dist_ssize_t *bad);
+DISTANCE_API int distance_dna_copy(const struct distance_dna *dna, struct distance_dna *copy);
+DISTANCE_API void distance_dna_release(struct distance_dna *dna);
+DISTANCE_API void distance_dna_unpack(const struct distance_dna *dna, uint8_t *bases);
+DISTANCE_API int distance_dna_hamming(const struct distance_dna *dna1,
+	const struct distance_dna *dna2, dist_ssize_t *dist);
+DISTANCE_API int distance_dna_levenshtein(const struct distance_dna *dna1,
+	const struct distance_dna *dna2, dist_ssize_t max_dist, dist_ssize_t *dist);
+
+
+/* Barcode sets: a whitelist of packed sequences, which reads are assigned to.
+
+distance_barcodes_new: copies `count` barcodes into a new set.
+
+distance_barcodes_assign: stores in `index` the index of the barcode closest
+to each read, by DISTANCE_METRIC_HAMMING (only the barcodes of the length of
+the read) or DISTANCE_METRIC_LEVENSHTEIN, and in `dist` its distance. The
+index is -1 if no barcode is at distance `max_dist` or less (any distance if
+negative), and -2 if several barcodes are at the lowest distance. The reads
+are split between `nthreads` threads. */
+
+struct distance_barcodes;
+
+DISTANCE_API int distance_barcodes_new(const struct distance_dna *barcodes, dist_ssize_t count,
+	struct distance_barcodes **bs);
+DISTANCE_API void distance_barcodes_free(struct distance_barcodes *bs);
+DISTANCE_API dist_ssize_t distance_barcodes_size(const struct distance_barcodes *bs);
+DISTANCE_API int distance_barcodes_assign(const struct distance_barcodes *bs,
+	const struct distance_dna *reads, dist_ssize_t nreads, int metric, dist_ssize_t max_dist,
+	int nthreads, dist_ssize_t *index, dist_ssize_t *dist);
+
+
+/* DAWGs: read-only sets of words stored in a file as a minimal automaton, which
+is mapped in memory rather than read; see distance/_dawg.py for the layout of
+the file. The words are numbered in lexicographic order, and their items are
+code points; a query is made of items of `width` bytes.
+
+distance_dawg_open: maps the file `path`; the dawg is released with
+`distance_dawg_close`.
+
+distance_dawg_values: the values stored with the words, NULL if there are none.
+
+distance_dawg_find: number of the word `key` in `*rank`, -1 if it isn't there.
+
+distance_dawg_word: items and length of the word `rank`; `items` must have
+room for `distance_dawg_max_len` items.
+
+distance_dawg_search: the words at Levenshtein distance `max_dist` or less
+from `query`, searched as in a trie; with `prefix`, the words which have a
+prefix at distance `max_dist` or less, with the lowest distance of their
+prefixes. The hits are the numbers of the words, in order. */
+
+struct distance_dawg;
+
+DISTANCE_API int distance_dawg_open(const char *path, struct distance_dawg **dawg);
+DISTANCE_API void distance_dawg_close(struct distance_dawg *dawg);
+DISTANCE_API dist_ssize_t distance_dawg_size(const struct distance_dawg *dawg);
+DISTANCE_API dist_ssize_t distance_dawg_max_len(const struct distance_dawg *dawg);
+DISTANCE_API const int64_t *distance_dawg_values(const struct distance_dawg *dawg);
+DISTANCE_API int distance_dawg_find(const struct distance_dawg *dawg, const void *key,
+	int width, dist_ssize_t len, dist_ssize_t *rank);
+DISTANCE_API int distance_dawg_word(const struct distance_dawg *dawg, dist_ssize_t rank,
+	uint32_t *items, dist_ssize_t *len);
+DISTANCE_API int distance_dawg_search(const struct distance_dawg *dawg,
+	const void *query, int width, dist_ssize_t len, dist_ssize_t max_dist, int prefix,
+	struct distance_hit **hits, dist_ssize_t *nhits);
+
+
+/* Instrumentation. If the library is built with DISTANCE_STATS defined, each
+thread counts, for every kernel, the calls, the dynamic programming cells
+evaluated, the early exits, the memory allocated, and the code paths taken
+per instruction set level, item type and algorithm, and the duration of one
+call in DISTANCE_STATS_SAMPLE is measured. Otherwise these functions are
+no-ops, and `distance_stats_enabled` returns 0.
+
+`distance_stats_read` sums the counters of all the threads into `stats`.
+The counters are updated without synchronization, so values read while
+other threads are running may be slightly off. */
+
+enum distance_stats_kernel {
+	DISTANCE_STATS_HAMMING,
+	DISTANCE_STATS_LEVENSHTEIN,
+	DISTANCE_STATS_NLEVENSHTEIN,
+	DISTANCE_STATS_FASTCOMP,
+	DISTANCE_STATS_LCSUBSTRINGS,
+	DISTANCE_STATS_JARO,
+	DISTANCE_STATS_LCS,				// lcs and indel
+	DISTANCE_STATS_NKERNELS
+};
+
+// Type of the items the kernel was called with.
+
+enum distance_stats_type {
+	DISTANCE_STATS_U8,
+	DISTANCE_STATS_U16,
+	DISTANCE_STATS_U32,
+	DISTANCE_STATS_SEQ,				// generic items, compared with a callback
+	DISTANCE_STATS_NTYPES
+};
+
+// Algorithm used.
+
+enum distance_stats_algo {
+	DISTANCE_STATS_DP,				// dynamic programming, or plain loops
+	DISTANCE_STATS_BITPAR,			// bit-parallel
+	DISTANCE_STATS_DIAG,			// diagonal transition (levenshtein)
+	DISTANCE_STATS_TILED,			// tiles computed by several threads
+	DISTANCE_STATS_NALGOS
+};
+
+#define DISTANCE_STATS_SAMPLE 64
+
+// Latency buckets: bucket `k` counts the calls which took less than 2^k ns
+// (and at least 2^(k - 1) ns), the last one the longer ones.
+
+#define DISTANCE_STATS_NBUCKETS 32
+
+struct distance_kernel_stats {
+	uint64_t calls;
+	uint64_t cells;
+	uint64_t exits_length;			// early exits because of the lengths alone
+	uint64_t exits_bound;			// early exits during the computation
+	uint64_t bytes;					// memory allocated
+	uint64_t paths[DISTANCE_ISA_NLEVELS][DISTANCE_STATS_NTYPES][DISTANCE_STATS_NALGOS];
+	uint64_t latency[DISTANCE_STATS_NBUCKETS];	// sampled calls
+};
+
+struct distance_stats {
+	struct distance_kernel_stats kernels[DISTANCE_STATS_NKERNELS];
+};
+
+DISTANCE_API int distance_stats_enabled(void);
+DISTANCE_API void distance_stats_read(struct distance_stats *stats);
+DISTANCE_API void distance_stats_reset(void);
+
+
+// Release memory allocated by the library.
+
+DISTANCE_API void distance_free(void *ptr);
+
+// Description of a status code.
+
+DISTANCE_API const char *distance_strerror(int status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,106 @@
+#define DISTANCE_BUILD
+#include "core.h"
+
+#ifdef _WIN32
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+
+int
+file_map(struct file_map *map, const char *path)
+{
+#ifdef _WIN32
+	HANDLE file;
+	LARGE_INTEGER size;
+
+	file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return DISTANCE_EIO;
+	if (!GetFileSizeEx(file, &size)) {
+		CloseHandle(file);
+		return DISTANCE_EIO;
+	}
+	if ((uint64_t)size.QuadPart > (size_t)-1) {
+		CloseHandle(file);
+		return DISTANCE_ENOMEM;
+	}
+	map->size = (size_t)size.QuadPart;
+	map->data = NULL;
+	map->mapping = NULL;
+	if (map->size == 0) {
+		CloseHandle(file);
+		return DISTANCE_OK;
+	}
+	map->mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (map->mapping == NULL)
+		return DISTANCE_EIO;
+	if ((map->data = MapViewOfFile(map->mapping, FILE_MAP_READ, 0, 0, 0)) == NULL) {
+		CloseHandle(map->mapping);
+		return DISTANCE_EIO;
+	}
+#else
+	struct stat st;
+	void *data;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) == -1)
+		return DISTANCE_EIO;
+	if (fstat(fd, &st) == -1) {
+		close(fd);
+		return DISTANCE_EIO;
+	}
+	if ((uint64_t)st.st_size > (size_t)-1) {
+		close(fd);
+		return DISTANCE_ENOMEM;
+	}
+	map->size = (size_t)st.st_size;
+	map->data = NULL;
+	if (map->size == 0) {
+		close(fd);
+		return DISTANCE_OK;
+	}
+	data = mmap(NULL, map->size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return DISTANCE_EIO;
+	map->data = (const unsigned char *)data;
+#endif
+	return DISTANCE_OK;
+}
+
+
+void
+file_unmap(struct file_map *map)
+{
+	if (map->data == NULL)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(map->data);
+	CloseHandle(map->mapping);
+#else
+	munmap((void *)map->data, map->size);
+#endif
+	map->data = NULL;
+}
+
+
+// Advises the system that the file will be read from start to end.
+
+void
+file_sequential(struct file_map *map)
+{
+#if !defined(_WIN32) && defined(MADV_SEQUENTIAL)
+	if (map->data != NULL)
+		madvise((void *)map->data, map->size, MADV_SEQUENTIAL);
+#endif
+}
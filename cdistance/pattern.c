@@ -0,0 +1,554 @@
+#define DISTANCE_BUILD
+#include "core.h"
+#include "peq.h"
+
+/* A query compiled for repeated comparisons. The match vectors of the
+bit-parallel kernels are built for each block of 64 items of the query, as
+in lcs.c, and kept with the pattern rather than rebuilt for every candidate;
+the q-gram profile is the one of candidates.c.
+
+The candidates are read with their own width, whatever the width of the
+query: the vectors of a query of 8 bits items are a table indexed by the
+item, in which wider items match nothing, and those of wider queries are the
+hash tables of peq.h. */
+
+struct peq_blocks {
+	dist_ssize_t nblocks;
+	struct peq_narrow *narrow;	// one table per block, for 8 bits items
+	struct peq_hash *hash;		// one table per block, for wider items
+};
+
+struct distance_pattern {
+	void *items;				// copy of the query
+	int width;
+	dist_ssize_t len;
+	struct peq_blocks peq;		// match vectors, if built
+	int q;						// q-gram profile, if built
+	uint32_t *grams;
+	dist_ssize_t ngrams;
+};
+
+
+static uint32_t
+text_item(const void *items, int width, dist_ssize_t i)
+{
+	switch (width) {
+		case 1:
+			return ((const uint8_t *)items)[i];
+		case 2:
+			return ((const uint16_t *)items)[i];
+	}
+	return ((const uint32_t *)items)[i];
+}
+
+
+static uint64_t
+blocks_get(const struct peq_blocks *peq, dist_ssize_t b, uint32_t item)
+{
+	if (peq->narrow != NULL)
+		return (item < 256 ? peq_narrow_get(&peq->narrow[b], item) : 0);
+	return peq_hash_get(&peq->hash[b], item);
+}
+
+
+// Builds the match vectors of `items`, read backwards if `reverse`.
+
+static int
+blocks_init(struct peq_blocks *peq, const void *items, int width, dist_ssize_t len, int reverse)
+{
+	dist_ssize_t j, b;
+	uint32_t item;
+
+	peq->nblocks = (len + 63) / 64;
+	if (width == 1) {
+		if ((peq->narrow = (struct peq_narrow *)malloc((peq->nblocks + 1) * sizeof(struct peq_narrow))) == NULL)
+			return DISTANCE_ENOMEM;
+		for (b = 0; b < peq->nblocks; b++)
+			peq_narrow_init(&peq->narrow[b]);
+	}
+	else {
+		if ((peq->hash = (struct peq_hash *)malloc((peq->nblocks + 1) * sizeof(struct peq_hash))) == NULL)
+			return DISTANCE_ENOMEM;
+		for (b = 0; b < peq->nblocks; b++)
+			peq_hash_init(&peq->hash[b]);
+	}
+	for (j = 0; j < len; j++) {
+		item = text_item(items, width, reverse ? len - 1 - j : j);
+		if (width == 1)
+			peq_narrow_add(&peq->narrow[j / 64], item, (uint64_t)1 << (j % 64));
+		else
+			peq_hash_add(&peq->hash[j / 64], item, (uint64_t)1 << (j % 64));
+	}
+	return DISTANCE_OK;
+}
+
+
+static void
+blocks_free(struct peq_blocks *peq)
+{
+	free(peq->narrow);
+	free(peq->hash);
+}
+
+
+#define STATS_TYPE(width) \
+	((width) == 1 ? DISTANCE_STATS_U8 : (width) == 2 ? DISTANCE_STATS_U16 : DISTANCE_STATS_U32)
+
+
+DISTANCE_API int
+distance_pattern_new(const void *items, int width, dist_ssize_t len, int flags, int q,
+	struct distance_pattern **pattern)
+{
+	struct distance_pattern *pat;
+
+	if (len < 0 || (width != 1 && width != 2 && width != 4)
+		|| ((flags & DISTANCE_PATTERN_QGRAMS) && (q < 1 || q > QGRAMS_MAX_Q)))
+		return DISTANCE_EINVAL;
+	if ((pat = (struct distance_pattern *)calloc(1, sizeof(struct distance_pattern))) == NULL)
+		return DISTANCE_ENOMEM;
+	pat->width = width;
+	pat->len = len;
+	if ((pat->items = malloc(len * width + 1)) == NULL)
+		goto On_Error;
+	memcpy(pat->items, items, len * width);
+
+	if ((flags & DISTANCE_PATTERN_PEQ) && blocks_init(&pat->peq, items, width, len, 0) != DISTANCE_OK)
+		goto On_Error;
+	if (flags & DISTANCE_PATTERN_QGRAMS) {
+		pat->q = q;
+		pat->ngrams = (len >= q ? len - q + 1 : 0);
+		if ((pat->grams = (uint32_t *)malloc((pat->ngrams + 1) * sizeof(uint32_t))) == NULL)
+			goto On_Error;
+		qgram_profile(pat->grams, q, items, width, len);
+	}
+	*pattern = pat;
+	return DISTANCE_OK;
+
+	On_Error:
+		distance_pattern_free(pat);
+		return DISTANCE_ENOMEM;
+}
+
+
+DISTANCE_API void
+distance_pattern_free(struct distance_pattern *pat)
+{
+	if (pat == NULL)
+		return;
+	free(pat->items);
+	blocks_free(&pat->peq);
+	free(pat->grams);
+	free(pat);
+}
+
+
+DISTANCE_API const void *
+distance_pattern_query(const struct distance_pattern *pat, int *width, dist_ssize_t *len)
+{
+	*width = pat->width;
+	*len = pat->len;
+	return pat->items;
+}
+
+
+DISTANCE_API const uint32_t *
+distance_pattern_qgrams(const struct distance_pattern *pat, int *q, dist_ssize_t *ngrams)
+{
+	*q = pat->q;
+	*ngrams = pat->ngrams;
+	return pat->grams;
+}
+
+
+/* Compares the query with `items` with a kernel of libdistance, both being
+read with the width of the widest. */
+
+static int
+pattern_fallback(const struct distance_pattern *pat, const void *items, int width,
+	dist_ssize_t len, int lcs, dist_ssize_t max_dist, dist_ssize_t *dist)
+{
+	const void *seq1 = pat->items, *seq2 = items;
+	void *copy = NULL;
+	int w = (width > pat->width ? width : pat->width), status;
+
+	if (w != pat->width || w != width) {
+		if ((copy = malloc((w == width ? pat->len : len) * w + 1)) == NULL)
+			return DISTANCE_ENOMEM;
+		if (w == width) {
+			items_widen(copy, w, pat->items, pat->width, pat->len);
+			seq1 = copy;
+		}
+		else {
+			items_widen(copy, w, items, width, len);
+			seq2 = copy;
+		}
+	}
+	switch (w) {
+		case 1:
+			status = (lcs ? distance_lcs_u8(seq1, seq2, pat->len, len, dist)
+				: distance_levenshtein_u8(seq1, seq2, pat->len, len, max_dist, dist));
+			break;
+		case 2:
+			status = (lcs ? distance_lcs_u16(seq1, seq2, pat->len, len, dist)
+				: distance_levenshtein_u16(seq1, seq2, pat->len, len, max_dist, dist));
+			break;
+		default:
+			status = (lcs ? distance_lcs_u32(seq1, seq2, pat->len, len, dist)
+				: distance_levenshtein_u32(seq1, seq2, pat->len, len, max_dist, dist));
+	}
+	free(copy);
+	return status;
+}
+
+
+// The algorithm of levenshtein_bitpar (levenshtein.c), for a query of at most
+// 64 items.
+
+static dist_ssize_t
+pattern_myers(const struct distance_pattern *pat, const void *items, int width,
+	dist_ssize_t len, dist_ssize_t max_dist)
+{
+	uint64_t pv = ~(uint64_t)0, mv = 0, ph, mh, xv, xh, eq;
+	uint64_t last = (uint64_t)1 << (pat->len - 1);
+	dist_ssize_t i, dist = pat->len;
+
+	STAT_PATH(LEVENSHTEIN, STATS_TYPE(width), DISTANCE_STATS_BITPAR);
+
+	for (i = 0; i < len; i++) {
+		eq = blocks_get(&pat->peq, 0, text_item(items, width, i));
+		xv = eq | mv;
+		xh = (((eq & pv) + pv) ^ pv) | eq;
+		ph = mv | ~(xh | pv);
+		mh = pv & xh;
+		if (ph & last)
+			dist++;
+		else if (mh & last)
+			dist--;
+		ph = (ph << 1) | 1;
+		mh <<= 1;
+		pv = mh | ~(xv | ph);
+		mv = ph & xv;
+		if (max_dist >= 0 && dist - (len - i - 1) > max_dist) {
+			STAT_ADD(LEVENSHTEIN, cells, (i + 1) * pat->len);
+			STAT_ADD(LEVENSHTEIN, exits_bound, 1);
+			return -1;
+		}
+	}
+	STAT_ADD(LEVENSHTEIN, cells, len * pat->len);
+
+	if (max_dist >= 0 && dist > max_dist)
+		return -1;
+	return dist;
+}
+
+
+DISTANCE_API int
+distance_pattern_levenshtein(const struct distance_pattern *pat, const void *items, int width,
+	dist_ssize_t len, dist_ssize_t max_dist, dist_ssize_t *dist)
+{
+	dist_ssize_t diff = (len > pat->len ? len - pat->len : pat->len - len);
+
+	if (len < 0 || (width != 1 && width != 2 && width != 4))
+		return DISTANCE_EINVAL;
+	if (max_dist >= 0 && diff > max_dist) {
+		STAT_ADD(LEVENSHTEIN, exits_length, 1);
+		*dist = -1;
+		return DISTANCE_OK;
+	}
+	if (pat->len == 0 || len == 0) {
+		*dist = diff;
+		return DISTANCE_OK;
+	}
+	if (pat->peq.nblocks == 1) {
+		STAT_TIMED(levenshtein, *dist, pattern_myers(pat, items, width, len, max_dist));
+		return DISTANCE_OK;
+	}
+	return pattern_fallback(pat, items, width, len, 0, max_dist, dist);
+}
+
+
+// The algorithm of lcs_bitpar (lcs.c).
+
+static dist_ssize_t
+pattern_allison_dix(const struct distance_pattern *pat, const void *items, int width,
+	dist_ssize_t len)
+{
+	uint64_t stack_v, *v = &stack_v, u, x, sum, carry, last;
+	dist_ssize_t nblocks = pat->peq.nblocks, i, b, lcs = 0;
+	uint32_t item;
+
+	STAT_PATH(LCS, STATS_TYPE(width), DISTANCE_STATS_BITPAR);
+
+	if (nblocks > 1) {
+		if ((v = (uint64_t *)malloc(nblocks * sizeof(uint64_t))) == NULL)
+			return -1;
+		STAT_ADD(LCS, bytes, nblocks * sizeof(uint64_t));
+	}
+	for (b = 0; b < nblocks; b++)
+		v[b] = ~(uint64_t)0;
+
+	for (i = 0; i < len; i++) {
+		item = text_item(items, width, i);
+		carry = 0;
+		for (b = 0; b < nblocks; b++) {
+			x = v[b];
+			u = x & blocks_get(&pat->peq, b, item);
+			sum = x + u + carry;
+			carry = (sum < x || (carry && sum == x));
+			v[b] = sum | (x & ~u);
+		}
+	}
+	STAT_ADD(LCS, cells, len * pat->len);
+
+	last = (pat->len % 64 ? ((uint64_t)1 << (pat->len % 64)) - 1 : ~(uint64_t)0);
+	for (b = 0; b < nblocks; b++)
+		lcs += POPCOUNT64(~v[b] & (b == nblocks - 1 ? last : ~(uint64_t)0));
+
+	if (nblocks > 1)
+		free(v);
+	return lcs;
+}
+
+
+DISTANCE_API int
+distance_pattern_lcs(const struct distance_pattern *pat, const void *items, int width,
+	dist_ssize_t len, dist_ssize_t *lcs)
+{
+	if (len < 0 || (width != 1 && width != 2 && width != 4))
+		return DISTANCE_EINVAL;
+	if (pat->len == 0 || len == 0) {
+		*lcs = 0;
+		return DISTANCE_OK;
+	}
+	if (pat->peq.nblocks == 0)
+		return pattern_fallback(pat, items, width, len, 1, -1, lcs);
+	STAT_TIMED(lcs, *lcs, pattern_allison_dix(pat, items, width, len));
+	return (*lcs == -1 ? DISTANCE_ENOMEM : DISTANCE_OK);
+}
+
+
+DISTANCE_API int
+distance_pattern_indel(const struct distance_pattern *pat, const void *items, int width,
+	dist_ssize_t len, dist_ssize_t max_dist, dist_ssize_t *dist)
+{
+	dist_ssize_t lcs;
+	int status;
+
+	if (len < 0 || (width != 1 && width != 2 && width != 4))
+		return DISTANCE_EINVAL;
+	if (max_dist >= 0 && (len > pat->len ? len - pat->len : pat->len - len) > max_dist) {
+		STAT_ADD(LCS, exits_length, 1);
+		*dist = -1;
+		return DISTANCE_OK;
+	}
+	if ((status = distance_pattern_lcs(pat, items, width, len, &lcs)) != DISTANCE_OK)
+		return status;
+	*dist = pat->len + len - 2 * lcs;
+	if (max_dist >= 0 && *dist > max_dist)
+		*dist = -1;
+	return DISTANCE_OK;
+}
+
+
+/* Approximate search of the query in a text, with the semi-global variant of
+the algorithm of Myers: the first row of the matrix is 0, so that a match can
+start anywhere in the text, and its last row gives, for each position of the
+text, the distance of the best match ending there. Queries of more than 64
+items span several blocks, the horizontal delta at the bottom of a block
+being carried to the next one (Hyyrö). The column is kept in the scan, so
+that the matches can be read in several calls.
+
+The start of a match is found by running the algorithm backwards from its
+end, in its global form, with the match vectors of the reversed query. */
+
+struct distance_scan {
+	const struct distance_pattern *pat;
+	dist_ssize_t max_dist;
+	dist_ssize_t pos;			// number of items of the text read
+	dist_ssize_t score;			// distance of the best match ending at `pos`
+	int started;				// whether the empty prefix of the text was looked at
+	uint64_t *pv, *mv;			// the column, one word per block
+	int starts;
+	struct peq_blocks rev;		// for the starts
+	uint64_t *rpv, *rmv;
+};
+
+
+// Computes a block of the next column, given the horizontal delta `hin` above
+// it. Returns the delta at the bit `high`.
+
+static int
+block_advance(uint64_t *pv, uint64_t *mv, uint64_t eq, int hin, uint64_t high)
+{
+	uint64_t xv, xh, ph, mh, neg = (hin < 0);
+	int hout;
+
+	xv = eq | *mv;
+	eq |= neg;
+	xh = (((eq & *pv) + *pv) ^ *pv) | eq;
+	ph = *mv | ~(xh | *pv);
+	mh = *pv & xh;
+	hout = ((ph & high) ? 1 : (mh & high) ? -1 : 0);
+	ph = (ph << 1) | (hin > 0);
+	mh = (mh << 1) | neg;
+	*pv = mh | ~(xv | ph);
+	*mv = ph & xv;
+	return hout;
+}
+
+
+// Computes the next column for `item`; returns the change of the last row.
+
+static int
+column_advance(const struct peq_blocks *peq, dist_ssize_t len, uint64_t *pv, uint64_t *mv,
+	uint32_t item, int hin)
+{
+	dist_ssize_t b, last = peq->nblocks - 1;
+
+	for (b = 0; b < last; b++)
+		hin = block_advance(&pv[b], &mv[b], blocks_get(peq, b, item), hin, (uint64_t)1 << 63);
+	return block_advance(&pv[last], &mv[last], blocks_get(peq, last, item), hin,
+		(uint64_t)1 << ((len - 1) % 64));
+}
+
+
+static void
+column_init(uint64_t *pv, uint64_t *mv, dist_ssize_t nblocks)
+{
+	dist_ssize_t b;
+
+	for (b = 0; b < nblocks; b++) {
+		pv[b] = ~(uint64_t)0;
+		mv[b] = 0;
+	}
+}
+
+
+DISTANCE_API int
+distance_scan_new(const struct distance_pattern *pat, dist_ssize_t max_dist, int starts,
+	struct distance_scan **scan)
+{
+	struct distance_scan *sc;
+	dist_ssize_t nblocks = pat->peq.nblocks;
+
+	if (max_dist < 0 || (pat->len > 0 && nblocks == 0))
+		return DISTANCE_EINVAL;
+	if ((sc = (struct distance_scan *)calloc(1, sizeof(struct distance_scan))) == NULL)
+		return DISTANCE_ENOMEM;
+	sc->pat = pat;
+	sc->max_dist = max_dist;
+	sc->score = pat->len;
+	sc->starts = starts;
+	sc->pv = (uint64_t *)malloc((nblocks + 1) * sizeof(uint64_t));
+	sc->mv = (uint64_t *)malloc((nblocks + 1) * sizeof(uint64_t));
+	if (sc->pv == NULL || sc->mv == NULL)
+		goto On_Error;
+	column_init(sc->pv, sc->mv, nblocks);
+	if (starts) {
+		sc->rpv = (uint64_t *)malloc((nblocks + 1) * sizeof(uint64_t));
+		sc->rmv = (uint64_t *)malloc((nblocks + 1) * sizeof(uint64_t));
+		if (sc->rpv == NULL || sc->rmv == NULL
+			|| blocks_init(&sc->rev, pat->items, pat->width, pat->len, 1) != DISTANCE_OK)
+			goto On_Error;
+	}
+	*scan = sc;
+	return DISTANCE_OK;
+
+	On_Error:
+		distance_scan_free(sc);
+		return DISTANCE_ENOMEM;
+}
+
+
+DISTANCE_API void
+distance_scan_free(struct distance_scan *scan)
+{
+	if (scan == NULL)
+		return;
+	free(scan->pv);
+	free(scan->mv);
+	free(scan->rpv);
+	free(scan->rmv);
+	blocks_free(&scan->rev);
+	free(scan);
+}
+
+
+// The start of the shortest match ending at `end` with distance `dist`.
+
+static dist_ssize_t
+scan_start(struct distance_scan *scan, const void *text, int width, dist_ssize_t end,
+	dist_ssize_t dist)
+{
+	const struct distance_pattern *pat = scan->pat;
+	dist_ssize_t score = pat->len, j;
+
+	if (score == dist || pat->len == 0)
+		return end;
+	column_init(scan->rpv, scan->rmv, scan->rev.nblocks);
+	for (j = 1; j <= end && j <= pat->len + dist; j++) {
+		score += column_advance(&scan->rev, pat->len, scan->rpv, scan->rmv,
+			text_item(text, width, end - j), 1);
+		if (score == dist)
+			break;
+	}
+	return end - j;
+}
+
+
+DISTANCE_API int
+distance_scan_next(struct distance_scan *scan, const void *text, int width, dist_ssize_t len,
+	struct distance_match *matches, dist_ssize_t cap, dist_ssize_t *n)
+{
+	const struct distance_pattern *pat = scan->pat;
+	struct distance_match *match;
+
+	if (len < 0 || cap < 1 || (width != 1 && width != 2 && width != 4))
+		return DISTANCE_EINVAL;
+	*n = 0;
+	while (*n < cap) {
+		if (scan->started) {
+			if (scan->pos >= len)
+				break;
+			if (pat->len > 0)
+				scan->score += column_advance(&pat->peq, pat->len, scan->pv, scan->mv,
+					text_item(text, width, scan->pos), 0);
+			scan->pos++;
+		}
+		scan->started = 1;
+		if (scan->score > scan->max_dist)
+			continue;
+		match = &matches[(*n)++];
+		match->end = scan->pos;
+		match->dist = scan->score;
+		match->start = (scan->starts ? scan_start(scan, text, width, scan->pos, scan->score) : -1);
+	}
+	return DISTANCE_OK;
+}
+
+
+DISTANCE_API int
+distance_pattern_search(const struct distance_pattern *pat, const void *items, int width,
+	dist_ssize_t len, dist_ssize_t max_dist, dist_ssize_t *dist)
+{
+	uint64_t words[8], *pv = words, *mv = words + 4;
+	dist_ssize_t nblocks = pat->peq.nblocks, score = pat->len, best = pat->len, i;
+
+	if (len < 0 || (width != 1 && width != 2 && width != 4) || (pat->len > 0 && nblocks == 0))
+		return DISTANCE_EINVAL;
+	if (nblocks > 4) {
+		if ((pv = (uint64_t *)malloc(2 * nblocks * sizeof(uint64_t))) == NULL)
+			return DISTANCE_ENOMEM;
+		mv = pv + nblocks;
+	}
+	column_init(pv, mv, nblocks);
+	for (i = 0; i < len && best > 0; i++) {
+		score += column_advance(&pat->peq, pat->len, pv, mv, text_item(items, width, i), 0);
+		if (score < best)
+			best = score;
+	}
+	if (pv != words)
+		free(pv);
+	*dist = (max_dist >= 0 && best > max_dist ? -1 : best);
+	return DISTANCE_OK;
+}
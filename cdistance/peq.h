@@ -0,0 +1,91 @@
+#ifndef PEQ_H
+#define PEQ_H
+
+/* Pattern match vectors ("Peq" in the papers of Myers and Hyyrö): for a
+sequence of at most 64 items, the positions at which each item occurs are
+stored as a 64 bits mask. They are the basis of the bit-parallel kernels.
+
+There are two implementations, and kernels.h picks one for each item type:
+for 8 bits items, a table indexed by the item; for wider items, a small open
+addressing hash table. Both are used through the same functions:
+
+	peq_init(&peq);
+	peq_add(&peq, item, bit);
+	mask = peq_get(&peq, item);		// 0 if `item` doesn't occur
+*/
+
+#include "core.h"
+
+
+struct peq_narrow {
+	uint64_t mask[256];
+};
+
+
+static void
+peq_narrow_init(struct peq_narrow *peq)
+{
+	memset(peq->mask, 0, sizeof(peq->mask));
+}
+
+
+static void
+peq_narrow_add(struct peq_narrow *peq, uint32_t item, uint64_t bit)
+{
+	peq->mask[item & 0xff] |= bit;
+}
+
+
+static uint64_t
+peq_narrow_get(const struct peq_narrow *peq, uint32_t item)
+{
+	return peq->mask[item & 0xff];
+}
+
+
+// At most 64 distinct items are stored, so the table is never more than half
+// full.
+
+#define PEQ_SLOTS 128
+
+struct peq_hash {
+	uint32_t key[PEQ_SLOTS];
+	uint64_t mask[PEQ_SLOTS];		// 0 for free slots
+};
+
+
+static size_t
+peq_hash_slot(const struct peq_hash *peq, uint32_t item)
+{
+	size_t h = (item * 2654435761u) >> 25;
+
+	while (peq->mask[h] && peq->key[h] != item)
+		h = (h + 1) & (PEQ_SLOTS - 1);
+	return h;
+}
+
+
+static void
+peq_hash_init(struct peq_hash *peq)
+{
+	memset(peq->mask, 0, sizeof(peq->mask));
+}
+
+
+static void
+peq_hash_add(struct peq_hash *peq, uint32_t item, uint64_t bit)
+{
+	size_t h = peq_hash_slot(peq, item);
+
+	peq->key[h] = item;
+	peq->mask[h] |= bit;
+}
+
+
+static uint64_t
+peq_hash_get(const struct peq_hash *peq, uint32_t item)
+{
+	return peq->mask[peq_hash_slot(peq, item)];
+}
+
+#endif
@@ -0,0 +1,208 @@
+#include "pool.h"
+
+#ifndef _WIN32
+	#include <unistd.h>
+#endif
+
+
+#ifdef _WIN32
+
+struct thread_start {
+	void *(*fn)(void *);
+	void *arg;
+};
+
+
+static DWORD WINAPI
+thread_trampoline(LPVOID p)
+{
+	struct thread_start start = *(struct thread_start *)p;
+
+	free(p);
+	start.fn(start.arg);
+	return 0;
+}
+
+#endif
+
+
+static int
+thread_create(thread_t *t, void *(*fn)(void *), void *arg)
+{
+#ifdef _WIN32
+	struct thread_start *start;
+
+	if ((start = (struct thread_start *)malloc(sizeof(struct thread_start))) == NULL)
+		return -1;
+	start->fn = fn;
+	start->arg = arg;
+	if ((*t = CreateThread(NULL, 0, thread_trampoline, start, 0, NULL)) == NULL) {
+		free(start);
+		return -1;
+	}
+	return 0;
+#else
+	return pthread_create(t, NULL, fn, arg);
+#endif
+}
+
+
+// Number of processors online, at least 1.
+
+int
+pool_cpu_count(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+
+	GetSystemInfo(&info);
+	return (int)info.dwNumberOfProcessors;
+#else
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return (n > 0 ? (int)n : 1);
+#endif
+}
+
+
+static void *
+pool_worker(void *p)
+{
+	struct pool *pool = (struct pool *)p;
+	struct pool_job *job;
+	dist_ssize_t i, start, end;
+
+	mutex_lock(&pool->mutex);
+	for (;;) {
+		while (pool->head == NULL && !pool->closing)
+			cond_wait(&pool->work, &pool->mutex);
+		if (pool->head == NULL)
+			break;
+
+		job = pool->head;
+		start = job->next;
+		end = (start + job->grain < job->size ? start + job->grain : job->size);
+		job->next = end;
+		if (end == job->size) {
+			pool->head = job->link;
+			if (pool->head == NULL)
+				pool->tail = NULL;
+		}
+
+		mutex_unlock(&pool->mutex);
+		for (i = start; i < end; i++)
+			job->run(job->arg, i);
+		mutex_lock(&pool->mutex);
+
+		if (job->order) {
+			for (i = start; i < end; i++)
+				job->order[job->done++] = i;
+		}
+		else
+			job->done += end - start;
+		cond_broadcast(&pool->done);
+	}
+	mutex_unlock(&pool->mutex);
+	STATS_THREAD_EXIT();
+
+	return NULL;
+}
+
+
+int
+pool_new(struct pool **pool, int nthreads)
+{
+	struct pool *p;
+
+	if (nthreads < 1)
+		return DISTANCE_EINVAL;
+	if ((p = (struct pool *)calloc(1, sizeof(struct pool))) == NULL)
+		return DISTANCE_ENOMEM;
+	if ((p->threads = (thread_t *)malloc(nthreads * sizeof(thread_t))) == NULL) {
+		free(p);
+		return DISTANCE_ENOMEM;
+	}
+	mutex_init(&p->mutex);
+	cond_init(&p->work);
+	cond_init(&p->done);
+
+	for (p->nthreads = 0; p->nthreads < nthreads; p->nthreads++) {
+		if (thread_create(&p->threads[p->nthreads], pool_worker, p) != 0) {
+			pool_free(p);
+			return DISTANCE_ENOMEM;
+		}
+	}
+
+	*pool = p;
+	return DISTANCE_OK;
+}
+
+
+// Stops the workers once all the jobs submitted are completed.
+
+void
+pool_free(struct pool *pool)
+{
+	int i;
+
+	mutex_lock(&pool->mutex);
+	pool->closing = 1;
+	cond_broadcast(&pool->work);
+	mutex_unlock(&pool->mutex);
+
+	for (i = 0; i < pool->nthreads; i++)
+		thread_join(pool->threads[i]);
+
+	cond_destroy(&pool->work);
+	cond_destroy(&pool->done);
+	mutex_destroy(&pool->mutex);
+	free(pool->threads);
+	free(pool);
+}
+
+
+void
+pool_submit(struct pool *pool, struct pool_job *job)
+{
+	job->next = job->done = 0;
+	job->link = NULL;
+	// small enough to balance the load, large enough to limit locking
+	job->grain = job->size / (pool->nthreads * 8);
+	if (job->grain < 1)
+		job->grain = 1;
+	if (job->grain > 64)
+		job->grain = 64;
+
+	if (job->size == 0)
+		return;
+
+	mutex_lock(&pool->mutex);
+	if (pool->tail)
+		pool->tail->link = job;
+	else
+		pool->head = job;
+	pool->tail = job;
+	cond_broadcast(&pool->work);
+	mutex_unlock(&pool->mutex);
+}
+
+
+// Waits until at least `count` items of the job are done, and returns the
+// number of items done.
+
+dist_ssize_t
+pool_wait(struct pool *pool, struct pool_job *job, dist_ssize_t count)
+{
+	dist_ssize_t done;
+
+	if (count > job->size)
+		count = job->size;
+
+	mutex_lock(&pool->mutex);
+	while (job->done < count)
+		cond_wait(&pool->done, &pool->mutex);
+	done = job->done;
+	mutex_unlock(&pool->mutex);
+
+	return done;
+}
@@ -0,0 +1,49 @@
+#ifndef POOL_H
+#define POOL_H
+
+/* A pool of worker threads, processing jobs made of independent items, e.g.
+computing the distance between a reference sequence and each sequence of an
+array. The item functions run without any lock held, and must not use the
+Python API.
+
+	struct pool_job job = {run, arg, size, order};
+	pool_submit(pool, &job);
+	...
+	pool_wait(pool, &job, job.size);		// until all items are done
+
+Several jobs can be submitted; they are processed in order, and the workers
+move on to the next job as soon as all the items of a job have been taken. */
+
+#include "core.h"
+#include "threads.h"
+
+struct pool_job {
+	void (*run)(void *arg, dist_ssize_t i);		// processes the item `i`
+	void *arg;
+	dist_ssize_t size;							// number of items
+	dist_ssize_t *order;		// if not NULL, receives the indexes of the
+								// items in the order they complete
+	// managed by the pool
+	dist_ssize_t next;			// next item to process
+	dist_ssize_t done;			// number of items completed
+	dist_ssize_t grain;			// number of items taken at once
+	struct pool_job *link;
+};
+
+struct pool {
+	int nthreads;
+	thread_t *threads;
+	mutex_t mutex;
+	cond_t work;				// a job was submitted, or the pool is closing
+	cond_t done;				// items were completed
+	struct pool_job *head, *tail;	// jobs with items left to take
+	int closing;
+};
+
+int pool_new(struct pool **pool, int nthreads);
+void pool_free(struct pool *pool);
+void pool_submit(struct pool *pool, struct pool_job *job);
+dist_ssize_t pool_wait(struct pool *pool, struct pool_job *job, dist_ssize_t count);
+int pool_cpu_count(void);
+
+#endif
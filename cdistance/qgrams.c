@@ -0,0 +1,195 @@
+#define DISTANCE_BUILD
+#include "core.h"
+#include <math.h>
+
+/* A profile is the multiset of the q-grams of a sequence, stored as the
+sorted array of their distinct hashes, with the number of occurrences of
+each. The hashes are those of the values of the items, so that sequences
+with items of different widths can be compared, and have 64 bits, so that
+collisions can be neglected: unlike the profiles of candidates.c, which only
+serve as a filter, these give the result.
+
+All the metrics are computed by a single merge of the two arrays. */
+
+struct distance_profile {
+	int q;
+	dist_ssize_t size;			// number of q-grams
+	dist_ssize_t count;			// number of distinct ones
+	uint64_t *hashes;
+	dist_ssize_t *counts;
+	double squares;				// sum of the squares of `counts`
+};
+
+
+static int
+hash_cmp(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+
+DISTANCE_API int
+distance_profile_new(const void *items, int width, dist_ssize_t len, int q,
+	struct distance_profile **profile)
+{
+	struct distance_profile *p;
+	dist_ssize_t i, k, n;
+	uint64_t h, item;
+	int j;
+
+	if (len < 0 || q < 1 || (width != 1 && width != 2 && width != 4))
+		return DISTANCE_EINVAL;
+	if ((p = (struct distance_profile *)calloc(1, sizeof(struct distance_profile))) == NULL)
+		return DISTANCE_ENOMEM;
+	p->q = q;
+	p->size = n = (len >= q ? len - q + 1 : 0);
+	p->hashes = (uint64_t *)malloc((n + 1) * sizeof(uint64_t));
+	p->counts = (dist_ssize_t *)malloc((n + 1) * sizeof(dist_ssize_t));
+	if (p->hashes == NULL || p->counts == NULL) {
+		distance_profile_free(p);
+		return DISTANCE_ENOMEM;
+	}
+
+	for (i = 0; i < n; i++) {
+		h = 14695981039346656037ull;		// FNV-1a, on items rather than bytes
+		for (j = 0; j < q; j++) {
+			switch (width) {
+				case 1:
+					item = ((const uint8_t *)items)[i + j];
+					break;
+				case 2:
+					item = ((const uint16_t *)items)[i + j];
+					break;
+				default:
+					item = ((const uint32_t *)items)[i + j];
+			}
+			h = (h ^ item) * 1099511628211ull;
+		}
+		p->hashes[i] = h;
+	}
+	qsort(p->hashes, n, sizeof(uint64_t), hash_cmp);
+
+	// run-length encoding of the sorted hashes, in place
+	for (i = 0, k = -1; i < n; i++) {
+		if (k >= 0 && p->hashes[k] == p->hashes[i])
+			p->counts[k]++;
+		else {
+			p->hashes[++k] = p->hashes[i];
+			p->counts[k] = 1;
+		}
+	}
+	p->count = k + 1;
+	for (k = 0; k < p->count; k++)
+		p->squares += (double)p->counts[k] * p->counts[k];
+
+	*profile = p;
+	return DISTANCE_OK;
+}
+
+
+DISTANCE_API void
+distance_profile_free(struct distance_profile *profile)
+{
+	if (profile == NULL)
+		return;
+	free(profile->hashes);
+	free(profile->counts);
+	free(profile);
+}
+
+
+DISTANCE_API dist_ssize_t
+distance_profile_size(const struct distance_profile *profile, int *q)
+{
+	if (q != NULL)
+		*q = profile->q;
+	return profile->size;
+}
+
+
+/* Stores the number of q-grams the profiles have in common, counting
+repeated ones as many times as they appear in both, in `common`, and the dot
+product of their counts in `dot`. The merge is written without branches on
+the hashes, which are unpredictable. */
+
+static void
+profile_merge(const struct distance_profile *p1, const struct distance_profile *p2,
+	dist_ssize_t *common, double *dot)
+{
+	const uint64_t *h1 = p1->hashes, *h2 = p2->hashes;
+	const dist_ssize_t *c1 = p1->counts, *c2 = p2->counts;
+	dist_ssize_t n1 = p1->count, n2 = p2->count, i = 0, j = 0, sum = 0, eq, m;
+	double prod = 0.0;
+	uint64_t a, b;
+
+	while (i < n1 && j < n2) {
+		a = h1[i];
+		b = h2[j];
+		eq = (a == b);
+		m = (c1[i] < c2[j] ? c1[i] : c2[j]);
+		sum += eq * m;
+		prod += (double)(eq * c1[i] * c2[j]);
+		i += (a <= b);
+		j += (a >= b);
+	}
+	*common = sum;
+	*dot = prod;
+}
+
+
+DISTANCE_API int
+distance_qgram_distance(const struct distance_profile *p1, const struct distance_profile *p2,
+	dist_ssize_t *dist)
+{
+	dist_ssize_t common;
+	double dot;
+
+	if (p1->q != p2->q)
+		return DISTANCE_EINVAL;
+	profile_merge(p1, p2, &common, &dot);
+	*dist = p1->size + p2->size - 2 * common;
+	return DISTANCE_OK;
+}
+
+
+DISTANCE_API int
+distance_cosine(const struct distance_profile *p1, const struct distance_profile *p2,
+	double *dist)
+{
+	dist_ssize_t common;
+	double dot;
+
+	if (p1->q != p2->q)
+		return DISTANCE_EINVAL;
+	if (p1->size == 0 || p2->size == 0) {
+		*dist = (p1->size == p2->size ? 0.0 : 1.0);
+		return DISTANCE_OK;
+	}
+	profile_merge(p1, p2, &common, &dot);
+	// exact for equal profiles; otherwise, rounding errors can't go below 0
+	*dist = 1.0 - dot / sqrt(p1->squares * p2->squares);
+	if (*dist < 0.0)
+		*dist = 0.0;
+	return DISTANCE_OK;
+}
+
+
+DISTANCE_API int
+distance_overlap(const struct distance_profile *p1, const struct distance_profile *p2,
+	double *dist)
+{
+	dist_ssize_t common;
+	double dot;
+
+	if (p1->q != p2->q)
+		return DISTANCE_EINVAL;
+	if (p1->size == 0 || p2->size == 0) {
+		*dist = (p1->size == p2->size ? 0.0 : 1.0);
+		return DISTANCE_OK;
+	}
+	profile_merge(p1, p2, &common, &dot);
+	*dist = 1.0 - (double)common / (p1->size < p2->size ? p1->size : p2->size);
+	return DISTANCE_OK;
+}
@@ -0,0 +1,383 @@
+#define DISTANCE_BUILD
+#include "core.h"
+
+/* An inverted index of sets of tokens. Each token has the list of the sets it
+belongs to, by increasing index, and each set the list of its tokens, by
+increasing id; both are stored as the differences between successive
+numbers, each in a variable number of bytes (7 bits per byte, the high bit
+marking the bytes which aren't the last one), so that a list of frequent
+tokens takes little more than a byte per set.
+
+A query visits the lists of its tokens from the shortest one, computing the
+exact distance of each set met for the first time from its list of tokens,
+and keeping the `k` closest ones. A set met after the `m` first tokens of the
+query doesn't have any of them, which bounds its distance; the search stops
+as soon as this bound shows that the sets not met yet can't be part of the
+result, before the lists of the most frequent tokens, which are the longest
+ones, are read. The sets the size of which can't give a distance low enough
+are skipped without reading their tokens. */
+
+struct postings {
+	uint8_t *data;
+	dist_ssize_t len, cap;		// in bytes
+	dist_ssize_t count;			// of the sets
+	uint32_t last;				// index of the last set added
+};
+
+struct distance_set_index {
+	struct postings *tokens;	// by token id
+	dist_ssize_t ntokens, tokens_cap;
+	uint8_t *data;				// tokens of the sets, one after the other
+	dist_ssize_t len, cap;
+	dist_ssize_t *offsets;		// of the sets in `data`, and of the end
+	uint32_t *sizes;
+	dist_ssize_t nsets, offsets_cap, sizes_cap;
+};
+
+
+static int
+grow(void *ptr, dist_ssize_t *cap, dist_ssize_t needed, size_t size)
+{
+	void *tmp;
+	dist_ssize_t n = (*cap ? *cap : 16);
+
+	if (needed <= *cap)
+		return DISTANCE_OK;
+	while (n < needed)
+		n *= 2;
+	if ((tmp = realloc(*(void **)ptr, n * size)) == NULL)
+		return DISTANCE_ENOMEM;
+	*(void **)ptr = tmp;
+	*cap = n;
+	return DISTANCE_OK;
+}
+
+
+static dist_ssize_t
+put_varint(uint8_t *out, uint32_t n)
+{
+	dist_ssize_t len = 0;
+
+	while (n >= 0x80) {
+		out[len++] = (uint8_t)(n | 0x80);
+		n >>= 7;
+	}
+	out[len++] = (uint8_t)n;
+	return len;
+}
+
+
+static const uint8_t *
+get_varint(const uint8_t *in, uint32_t *n)
+{
+	uint32_t v = *in & 0x7f;
+	int shift = 7;
+
+	while (*in++ & 0x80) {
+		v |= (uint32_t)(*in & 0x7f) << shift;
+		shift += 7;
+	}
+	*n = v;
+	return in;
+}
+
+
+DISTANCE_API int
+distance_set_index_new(struct distance_set_index **idx)
+{
+	if ((*idx = (struct distance_set_index *)calloc(1, sizeof(struct distance_set_index))) == NULL)
+		return DISTANCE_ENOMEM;
+	return DISTANCE_OK;
+}
+
+
+DISTANCE_API void
+distance_set_index_free(struct distance_set_index *idx)
+{
+	dist_ssize_t i;
+
+	if (idx == NULL)
+		return;
+	for (i = 0; i < idx->ntokens; i++)
+		free(idx->tokens[i].data);
+	free(idx->tokens);
+	free(idx->data);
+	free(idx->offsets);
+	free(idx->sizes);
+	free(idx);
+}
+
+
+DISTANCE_API dist_ssize_t
+distance_set_index_size(const struct distance_set_index *idx)
+{
+	return idx->nsets;
+}
+
+
+static int
+id_cmp(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+
+// Copies, sorts and deduplicates the ids of a set; returns the number left,
+// or -1.
+
+static dist_ssize_t
+sorted_ids(const uint32_t *tokens, dist_ssize_t len, uint32_t **ids)
+{
+	dist_ssize_t i, n = 0;
+
+	if ((*ids = (uint32_t *)malloc((len + 1) * sizeof(uint32_t))) == NULL)
+		return -1;
+	memcpy(*ids, tokens, len * sizeof(uint32_t));
+	qsort(*ids, len, sizeof(uint32_t), id_cmp);
+	for (i = 0; i < len; i++) {
+		if (n == 0 || (*ids)[i] != (*ids)[n - 1])
+			(*ids)[n++] = (*ids)[i];
+	}
+	return n;
+}
+
+
+DISTANCE_API int
+distance_set_index_add(struct distance_set_index *idx, const uint32_t *tokens, dist_ssize_t len)
+{
+	struct postings *p;
+	uint32_t *ids, set = (uint32_t)idx->nsets, prev = 0;
+	dist_ssize_t i, n, ntokens = idx->ntokens;
+	int status;
+
+	if (len < 0 || idx->nsets >= (dist_ssize_t)UINT32_MAX)
+		return DISTANCE_EINVAL;
+	if ((n = sorted_ids(tokens, len, &ids)) < 0)
+		return DISTANCE_ENOMEM;
+
+	// the room needed is reserved first, so that the index is left as it was
+	// on error
+	if (n > 0 && ids[n - 1] >= ntokens)
+		ntokens = (dist_ssize_t)ids[n - 1] + 1;
+	if ((status = grow(&idx->tokens, &idx->tokens_cap, ntokens,
+			sizeof(struct postings))) != DISTANCE_OK)
+		goto Done;
+	memset(idx->tokens + idx->ntokens, 0, (ntokens - idx->ntokens) * sizeof(struct postings));
+	idx->ntokens = ntokens;
+	for (i = 0; i < n; i++) {
+		p = &idx->tokens[ids[i]];
+		if ((status = grow(&p->data, &p->cap, p->len + 5, 1)) != DISTANCE_OK)
+			goto Done;
+	}
+	if ((status = grow(&idx->data, &idx->cap, idx->len + 5 * n, 1)) != DISTANCE_OK
+		|| (status = grow(&idx->offsets, &idx->offsets_cap, idx->nsets + 2,
+			sizeof(dist_ssize_t))) != DISTANCE_OK
+		|| (status = grow(&idx->sizes, &idx->sizes_cap, idx->nsets + 1,
+			sizeof(uint32_t))) != DISTANCE_OK)
+		goto Done;
+
+	idx->offsets[idx->nsets] = idx->len;
+	idx->sizes[idx->nsets] = (uint32_t)n;
+	for (i = 0; i < n; i++) {
+		idx->len += put_varint(idx->data + idx->len, ids[i] - prev);
+		prev = ids[i];
+		p = &idx->tokens[ids[i]];
+		p->len += put_varint(p->data + p->len, (p->count ? set - p->last : set));
+		p->last = set;
+		p->count++;
+	}
+	idx->nsets++;
+	idx->offsets[idx->nsets] = idx->len;
+
+	Done:
+		free(ids);
+		return status;
+}
+
+
+/* Similarity of a set of `n` tokens sharing `common` tokens with a query of
+`nq`, computed as `jaccard` and `sorensen` do in Python, so that 1 minus it
+is the same distance. `min_sim` is compared with the similarity, since the
+similarity obtained back from the distance may be slightly lower. It can only
+decrease with `n` and grow with `common`. */
+
+static double
+set_sim(int metric, dist_ssize_t common, dist_ssize_t nq, dist_ssize_t n)
+{
+	if (metric == DISTANCE_SET_JACCARD)
+		return (double)common / (double)(nq + n - common);
+	return (double)(2 * common) / (double)(nq + n);
+}
+
+
+// Tokens a set shares with the query, by merging their ids.
+
+static dist_ssize_t
+set_common(const struct distance_set_index *idx, dist_ssize_t set, const uint32_t *ids,
+	dist_ssize_t n)
+{
+	const uint8_t *data = idx->data + idx->offsets[set];
+	dist_ssize_t i = 0, k, common = 0;
+	uint32_t id = 0, delta;
+
+	for (k = 0; k < idx->sizes[set] && i < n; k++) {
+		data = get_varint(data, &delta);
+		id += delta;
+		while (i < n && ids[i] < id)
+			i++;
+		if (i < n && ids[i] == id) {
+			common++;
+			i++;
+		}
+	}
+	return common;
+}
+
+
+/* The `k` closest sets found so far, in a heap the root of which is the
+farthest one; of two sets at the same distance, the one added last is
+farther. */
+
+static int
+hit_after(const struct distance_set_hit *a, const struct distance_set_hit *b)
+{
+	return a->dist > b->dist || (a->dist == b->dist && a->index > b->index);
+}
+
+
+static void
+heap_push(struct distance_set_hit *heap, dist_ssize_t *n, dist_ssize_t k,
+	struct distance_set_hit hit)
+{
+	dist_ssize_t i, child;
+
+	if (*n < k) {
+		// sift up
+		for (i = (*n)++; i > 0 && hit_after(&hit, &heap[(i - 1) / 2]); i = (i - 1) / 2)
+			heap[i] = heap[(i - 1) / 2];
+		heap[i] = hit;
+		return;
+	}
+	if (!hit_after(&heap[0], &hit))
+		return;
+	// replaces the root, and sifts it down
+	for (i = 0; (child = 2 * i + 1) < *n; i = child) {
+		if (child + 1 < *n && hit_after(&heap[child + 1], &heap[child]))
+			child++;
+		if (!hit_after(&heap[child], &hit))
+			break;
+		heap[i] = heap[child];
+	}
+	heap[i] = hit;
+}
+
+
+static int
+set_hit_cmp(const void *a, const void *b)
+{
+	return hit_after((const struct distance_set_hit *)a, (const struct distance_set_hit *)b)
+		- hit_after((const struct distance_set_hit *)b, (const struct distance_set_hit *)a);
+}
+
+
+struct query_token {
+	dist_ssize_t count;			// of the sets which have it
+	uint32_t id;
+};
+
+
+static int
+query_token_cmp(const void *a, const void *b)
+{
+	const struct query_token *x = (const struct query_token *)a;
+	const struct query_token *y = (const struct query_token *)b;
+
+	if (x->count != y->count)
+		return (x->count > y->count) - (x->count < y->count);
+	return (x->id > y->id) - (x->id < y->id);
+}
+
+
+// Whether a set of similarity `sim` can be a hit.
+
+#define SET_HIT(sim) ((sim) >= min_sim && (nheap < k || 1 - (sim) <= heap[0].dist))
+
+DISTANCE_API int
+distance_set_index_topk(const struct distance_set_index *idx, const uint32_t *tokens,
+	dist_ssize_t len, dist_ssize_t missing, int metric, dist_ssize_t k, double min_sim,
+	struct distance_set_hit **hits, dist_ssize_t *nhits)
+{
+	struct query_token *order = NULL;
+	struct distance_set_hit *heap = NULL, hit;
+	const struct postings *p;
+	const uint8_t *data;
+	uint32_t *ids = NULL, set, delta;
+	uint64_t *seen = NULL;
+	dist_ssize_t i, j, n, nq, nheap = 0, common, bound;
+	double sim;
+	int status = DISTANCE_ENOMEM;
+
+	if (len < 0 || missing < 0 || k < 0 || !(min_sim >= 0 && min_sim <= 1)
+		|| (metric != DISTANCE_SET_JACCARD && metric != DISTANCE_SET_SORENSEN))
+		return DISTANCE_EINVAL;
+	if ((n = sorted_ids(tokens, len, &ids)) < 0)
+		return DISTANCE_ENOMEM;
+	nq = n + missing;
+	heap = (struct distance_set_hit *)malloc((k + 1) * sizeof(struct distance_set_hit));
+	order = (struct query_token *)malloc((n + 1) * sizeof(struct query_token));
+	// the sets met so far; the pages of the bitmap are only touched if needed
+	seen = (uint64_t *)calloc(idx->nsets / 64 + 1, sizeof(uint64_t));
+	if (heap == NULL || order == NULL || seen == NULL)
+		goto Done;
+
+	for (i = 0; i < n; i++) {
+		order[i].id = ids[i];
+		order[i].count = (ids[i] < idx->ntokens ? idx->tokens[ids[i]].count : 0);
+	}
+	qsort(order, n, sizeof(struct query_token), query_token_cmp);
+
+	for (i = 0; i < n && k > 0; i++) {
+		// the sets not met yet share none of the tokens visited, including
+		// those which are in no set
+		bound = nq - missing - i;
+		if (!SET_HIT(set_sim(metric, bound, nq, bound)))
+			break;
+		if (order[i].count == 0)
+			continue;
+
+		p = &idx->tokens[order[i].id];
+		data = p->data;
+		for (j = 0, set = 0; j < p->count; j++) {
+			data = get_varint(data, &delta);
+			set += delta;
+			if (seen[set / 64] & ((uint64_t)1 << (set % 64)))
+				continue;
+			seen[set / 64] |= (uint64_t)1 << (set % 64);
+			// the sizes of the sets are enough to reject most of them
+			common = (idx->sizes[set] < bound ? idx->sizes[set] : bound);
+			if (!SET_HIT(set_sim(metric, common, nq, idx->sizes[set])))
+				continue;
+			common = set_common(idx, set, ids, n);
+			sim = set_sim(metric, common, nq, idx->sizes[set]);
+			hit.dist = 1 - sim;
+			hit.index = set;
+			if (sim >= min_sim)
+				heap_push(heap, &nheap, k, hit);
+		}
+	}
+
+	qsort(heap, nheap, sizeof(struct distance_set_hit), set_hit_cmp);
+	*hits = heap;
+	*nhits = nheap;
+	heap = NULL;
+	status = DISTANCE_OK;
+
+	Done:
+		free(ids);
+		free(order);
+		free(heap);
+		free(seen);
+		return status;
+}
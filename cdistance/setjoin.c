@@ -0,0 +1,642 @@
+#define DISTANCE_BUILD
+#include "core.h"
+#include "pool.h"
+#include <math.h>
+
+/* Similarity join of sets of tokens (AllPairs, with the positional filter of
+PPJoin). The pairs at Jaccard distance `threshold` or less are those of
+similarity s = 1 - threshold or more, which share at least
+
+	ceil(s / (1 + s) * (nx + ny))
+
+tokens, and the sizes of which are within a factor s of each other. The
+tokens of each set are renamed by increasing number of sets they appear in,
+and sorted, so that if two sets share enough tokens, the rarest ones of each,
+their prefixes, have at least one in common (the prefix filter). Only the
+prefixes are indexed, and a set is compared with those which share a token of
+its prefix with it: the probe. The candidates are rejected as soon as the
+positions of the tokens they share show that they can't share enough of them
+(the positional filter), and the others are verified by merging the sets.
+
+In a self-join, the sets are probed by increasing size, each one against the
+smaller ones only, so that shorter prefixes of these are enough. The probes
+don't depend on each other, and are spread over the threads. */
+
+// Slack of the bounds computed with floats, which must not be too strict.
+#define SETJOIN_EPS 1e-9
+
+struct setjoin_side {
+	uint32_t *tokens;			// renamed and sorted, set after set
+	dist_ssize_t *offsets;		// of the sets, by increasing size
+	dist_ssize_t *index;		// index of the sets in the input
+	dist_ssize_t nsets;			// not empty
+};
+
+struct setjoin_posting {
+	dist_ssize_t set;			// in the order of the indexed side
+	uint32_t pos;				// of the token in the set
+	uint32_t size;				// of the set
+};
+
+// Tokens shared with the set probed, -1 if rejected, and the positions of the
+// last of them in both sets.
+
+struct setjoin_candidate {
+	int32_t count;
+	uint32_t i, j;
+};
+
+struct setjoin_part {
+	struct distance_join_pair *pairs;
+	dist_ssize_t npairs, alloc;
+	struct setjoin_candidate *cands;	// by indexed set
+	dist_ssize_t *touched;				// candidates of the probe
+	int status;
+};
+
+struct setjoin {
+	struct setjoin_side probe, indexed;		// the same side in a self-join
+	int self;
+	double threshold, sim;
+	dist_ssize_t *starts;					// of the postings of each token
+	struct setjoin_posting *postings;
+	struct setjoin_part *parts;
+	dist_ssize_t nparts;
+};
+
+
+static dist_ssize_t
+min_overlap(double sim, dist_ssize_t nx, dist_ssize_t ny)
+{
+	return (dist_ssize_t)ceil(sim / (1 + sim) * (double)(nx + ny) - SETJOIN_EPS);
+}
+
+
+static dist_ssize_t
+min_size(double sim, dist_ssize_t n)
+{
+	return (dist_ssize_t)ceil(sim * (double)n - SETJOIN_EPS);
+}
+
+
+/* Sorts the tokens of a set, and removes the duplicates; returns their number.
+The sets are mostly small, and sorted by insertion; the larger ones by a
+quicksort, the comparisons of which are inlined, unlike with qsort. */
+
+static void
+quicksort_tokens(uint32_t *tokens, dist_ssize_t n)
+{
+	dist_ssize_t i, j;
+	uint32_t a, b, c, pivot, t;
+
+	while (n > 16) {
+		// median of three
+		a = tokens[0];
+		b = tokens[n / 2];
+		c = tokens[n - 1];
+		pivot = (a < b ? (b < c ? b : a < c ? c : a) : (a < c ? a : b < c ? c : b));
+		for (i = 0, j = n - 1; ; i++, j--) {
+			while (tokens[i] < pivot)
+				i++;
+			while (tokens[j] > pivot)
+				j--;
+			if (i >= j)
+				break;
+			t = tokens[i];
+			tokens[i] = tokens[j];
+			tokens[j] = t;
+		}
+		// recursion on the smaller part only
+		if (j + 1 < n - j - 1) {
+			quicksort_tokens(tokens, j + 1);
+			tokens += j + 1;
+			n -= j + 1;
+		}
+		else {
+			quicksort_tokens(tokens + j + 1, n - j - 1);
+			n = j + 1;
+		}
+	}
+	for (i = 1; i < n; i++) {
+		t = tokens[i];
+		for (j = i; j > 0 && tokens[j - 1] > t; j--)
+			tokens[j] = tokens[j - 1];
+		tokens[j] = t;
+	}
+}
+
+
+static dist_ssize_t
+sort_tokens(uint32_t *tokens, dist_ssize_t n)
+{
+	dist_ssize_t i, j;
+
+	quicksort_tokens(tokens, n);
+	for (i = j = 0; i < n; i++) {
+		if (j == 0 || tokens[i] != tokens[j - 1])
+			tokens[j++] = tokens[i];
+	}
+	return j;
+}
+
+
+struct setjoin_size {
+	dist_ssize_t size, index;
+};
+
+
+static int
+size_cmp(const void *a, const void *b)
+{
+	const struct setjoin_size *x = (const struct setjoin_size *)a;
+	const struct setjoin_size *y = (const struct setjoin_size *)b;
+
+	if (x->size != y->size)
+		return (x->size > y->size) - (x->size < y->size);
+	return (x->index > y->index) - (x->index < y->index);
+}
+
+
+/* Copies the distinct tokens of the non-empty sets, by increasing size, and
+counts the sets each token appears in. */
+
+static int
+side_new(struct setjoin_side *side, const uint32_t *tokens, const dist_ssize_t *offsets,
+	dist_ssize_t nsets, dist_ssize_t ntokens, dist_ssize_t *freqs)
+{
+	struct setjoin_size *sizes;
+	uint32_t *tmp;
+	dist_ssize_t i, k, n, total = 0, first = offsets[0];
+	int status = DISTANCE_ENOMEM;
+
+	side->offsets = side->index = NULL;
+	side->nsets = 0;
+	sizes = (struct setjoin_size *)malloc((nsets + 1) * sizeof(struct setjoin_size));
+	tmp = (uint32_t *)malloc((offsets[nsets] - first + 1) * sizeof(uint32_t));
+	side->tokens = (uint32_t *)malloc((offsets[nsets] - first + 1) * sizeof(uint32_t));
+	if (sizes == NULL || tmp == NULL || side->tokens == NULL)
+		goto On_Error;
+
+	// the sets are deduplicated at their offset in the input
+	for (i = 0; i < nsets; i++) {
+		n = offsets[i + 1] - offsets[i];
+		for (k = 0; k < n; k++) {
+			if (tokens[offsets[i] + k] >= (uint64_t)ntokens) {
+				status = DISTANCE_EINVAL;
+				goto On_Error;
+			}
+			tmp[offsets[i] - first + k] = tokens[offsets[i] + k];
+		}
+		if ((n = sort_tokens(tmp + (offsets[i] - first), n)) == 0)
+			continue;
+		sizes[side->nsets].size = n;
+		sizes[side->nsets++].index = i;
+	}
+	qsort(sizes, side->nsets, sizeof(struct setjoin_size), size_cmp);
+
+	side->offsets = (dist_ssize_t *)malloc((side->nsets + 1) * sizeof(dist_ssize_t));
+	side->index = (dist_ssize_t *)malloc((side->nsets + 1) * sizeof(dist_ssize_t));
+	if (side->offsets == NULL || side->index == NULL)
+		goto On_Error;
+	for (i = 0; i < side->nsets; i++) {
+		side->offsets[i] = total;
+		side->index[i] = sizes[i].index;
+		memcpy(side->tokens + total, tmp + (offsets[sizes[i].index] - first),
+			sizes[i].size * sizeof(uint32_t));
+		for (k = 0; k < sizes[i].size; k++)
+			freqs[side->tokens[total + k]]++;
+		total += sizes[i].size;
+	}
+	side->offsets[side->nsets] = total;
+	free(sizes);
+	free(tmp);
+	return DISTANCE_OK;
+
+	On_Error:
+		free(sizes);
+		free(tmp);
+		free(side->tokens);
+		free(side->offsets);
+		free(side->index);
+		return status;
+}
+
+
+static void
+side_free(struct setjoin_side *side)
+{
+	free(side->tokens);
+	free(side->offsets);
+	free(side->index);
+}
+
+
+// Renames the tokens by their rank, and sorts the sets again.
+
+static void
+side_rename(struct setjoin_side *side, const uint32_t *ranks)
+{
+	dist_ssize_t i, k;
+
+	for (i = 0; i < side->nsets; i++) {
+		for (k = side->offsets[i]; k < side->offsets[i + 1]; k++)
+			side->tokens[k] = ranks[side->tokens[k]];
+		sort_tokens(side->tokens + side->offsets[i], side->offsets[i + 1] - side->offsets[i]);
+	}
+}
+
+
+static int
+rank_cmp(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+
+/* Ranks of the tokens, by increasing number of sets, then by value. They are
+sorted as 64 bits keys, the number of sets in the high bits. */
+
+static uint32_t *
+token_ranks(const dist_ssize_t *freqs, dist_ssize_t ntokens)
+{
+	uint64_t *keys;
+	uint32_t *ranks;
+	dist_ssize_t i;
+
+	keys = (uint64_t *)malloc((ntokens + 1) * sizeof(uint64_t));
+	ranks = (uint32_t *)malloc((ntokens + 1) * sizeof(uint32_t));
+	if (keys == NULL || ranks == NULL) {
+		free(keys);
+		free(ranks);
+		return NULL;
+	}
+	for (i = 0; i < ntokens; i++)
+		keys[i] = ((uint64_t)freqs[i] << 32) | (uint64_t)i;
+	qsort(keys, ntokens, sizeof(uint64_t), rank_cmp);
+	for (i = 0; i < ntokens; i++)
+		ranks[(uint32_t)keys[i]] = (uint32_t)i;
+	free(keys);
+	return ranks;
+}
+
+
+#define SET_SIZE(side, k) ((side)->offsets[(k) + 1] - (side)->offsets[k])
+
+/* Length of the prefix of an indexed set of `n` tokens. In a self-join, the
+sets probed are at least as large, and share more tokens with it. */
+
+static dist_ssize_t
+indexed_prefix(const struct setjoin *sj, dist_ssize_t n)
+{
+	dist_ssize_t prefix = n - (sj->self ? min_overlap(sj->sim, n, n) : min_size(sj->sim, n)) + 1;
+
+	return (prefix < n ? prefix : n);
+}
+
+
+/* Indexes the prefixes of the sets of `indexed`, by token; the postings of a
+token are in the order of the sets, hence by increasing size. */
+
+static int
+index_prefixes(struct setjoin *sj, dist_ssize_t ntokens)
+{
+	const struct setjoin_side *side = &sj->indexed;
+	struct setjoin_posting *posting;
+	dist_ssize_t i, k, n, prefix, *next;
+
+	sj->starts = (dist_ssize_t *)calloc(ntokens + 1, sizeof(dist_ssize_t));
+	next = (dist_ssize_t *)malloc((ntokens + 1) * sizeof(dist_ssize_t));
+	if (sj->starts == NULL || next == NULL) {
+		free(next);
+		return DISTANCE_ENOMEM;
+	}
+
+	for (i = 0, n = 0; i < side->nsets; i++) {
+		prefix = indexed_prefix(sj, SET_SIZE(side, i));
+		for (k = 0; k < prefix; k++)
+			sj->starts[side->tokens[side->offsets[i] + k] + 1]++;
+		n += prefix;
+	}
+	for (k = 0; k < ntokens; k++)
+		sj->starts[k + 1] += sj->starts[k];
+	memcpy(next, sj->starts, ntokens * sizeof(dist_ssize_t));
+
+	if ((sj->postings = (struct setjoin_posting *)malloc((n + 1) * sizeof(struct setjoin_posting))) == NULL) {
+		free(next);
+		return DISTANCE_ENOMEM;
+	}
+	for (i = 0; i < side->nsets; i++) {
+		prefix = indexed_prefix(sj, SET_SIZE(side, i));
+		for (k = 0; k < prefix; k++) {
+			posting = &sj->postings[next[side->tokens[side->offsets[i] + k]]++];
+			posting->set = i;
+			posting->pos = (uint32_t)k;
+			posting->size = (uint32_t)SET_SIZE(side, i);
+		}
+	}
+	free(next);
+	return DISTANCE_OK;
+}
+
+
+/* Whether the sets share `needed` tokens or more, and their Jaccard distance,
+knowing that they share `common` tokens before the positions `i` and `j`. The
+merge is written without branches on the tokens, and stops as soon as the
+overlap can't be reached anymore. */
+
+static int
+verify(const uint32_t *x, dist_ssize_t nx, const uint32_t *y, dist_ssize_t ny,
+	dist_ssize_t i, dist_ssize_t j, dist_ssize_t common, dist_ssize_t needed, double *dist)
+{
+	uint32_t a, b;
+
+	while (i < nx && j < ny) {
+		a = x[i];
+		b = y[j];
+		common += (a == b);
+		i += (a <= b);
+		j += (a >= b);
+		if (common + (nx - i < ny - j ? nx - i : ny - j) < needed)
+			return 0;
+	}
+	if (common < needed)
+		return 0;
+	*dist = 1.0 - (double)common / (double)(nx + ny - common);
+	return 1;
+}
+
+
+static int
+add_pair(struct setjoin_part *part, dist_ssize_t i, dist_ssize_t j, double dist)
+{
+	struct distance_join_pair *tmp;
+
+	if (part->npairs == part->alloc) {
+		part->alloc = (part->alloc ? 2 * part->alloc : 64);
+		tmp = (struct distance_join_pair *)realloc(part->pairs,
+			part->alloc * sizeof(struct distance_join_pair));
+		if (tmp == NULL)
+			return DISTANCE_ENOMEM;
+		part->pairs = tmp;
+	}
+	part->pairs[part->npairs].i = i;
+	part->pairs[part->npairs].j = j;
+	part->pairs[part->npairs++].dist = dist;
+	return DISTANCE_OK;
+}
+
+
+// First posting of `list`, of `n` postings, the set of which has `size` tokens
+// or more.
+
+static dist_ssize_t
+first_posting(const struct setjoin_posting *list, dist_ssize_t n, dist_ssize_t size)
+{
+	dist_ssize_t lo = 0, hi = n, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if ((dist_ssize_t)list[mid].size < size)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+
+// Compares the set `x` of the probed side with the indexed sets it may be
+// close to.
+
+static int
+probe(struct setjoin *sj, struct setjoin_part *part, dist_ssize_t x)
+{
+	const struct setjoin_side *side = &sj->indexed;
+	const struct setjoin_posting *list;
+	struct setjoin_candidate *cand;
+	const uint32_t *tokens = sj->probe.tokens + sj->probe.offsets[x];
+	dist_ssize_t nx = SET_SIZE(&sj->probe, x), ny, i, k, n, y, prefix, lo, hi, ntouched = 0;
+	double dist;
+	int status = DISTANCE_OK;
+
+	lo = min_size(sj->sim, nx);
+	hi = (dist_ssize_t)floor((double)nx / sj->sim + SETJOIN_EPS);
+	prefix = nx - lo + 1;
+	if (prefix > nx)
+		prefix = nx;
+
+	for (i = 0; i < prefix; i++) {
+		list = sj->postings + sj->starts[tokens[i]];
+		n = sj->starts[tokens[i] + 1] - sj->starts[tokens[i]];
+		for (k = first_posting(list, n, lo); k < n; k++) {
+			y = list[k].set;
+			if (sj->self ? y >= x : (dist_ssize_t)list[k].size > hi)
+				break;
+			cand = &part->cands[y];
+			if (cand->count < 0)
+				continue;
+			if (cand->count == 0)
+				part->touched[ntouched++] = y;
+			// positional filter: the tokens after these two can't all be shared
+			ny = list[k].size;
+			if (cand->count + (nx - i < ny - list[k].pos ? nx - i : ny - list[k].pos)
+					< min_overlap(sj->sim, nx, ny)) {
+				cand->count = -1;
+				continue;
+			}
+			cand->count++;
+			cand->i = (uint32_t)i;
+			cand->j = list[k].pos;
+		}
+	}
+
+	// the tokens before the last ones shared are all in the prefixes
+	for (k = 0; k < ntouched; k++) {
+		y = part->touched[k];
+		cand = &part->cands[y];
+		if (cand->count > 0 && status == DISTANCE_OK && verify(tokens, nx,
+				side->tokens + side->offsets[y], SET_SIZE(side, y), cand->i + 1, cand->j + 1,
+				cand->count, min_overlap(sj->sim, nx, SET_SIZE(side, y)), &dist)
+				&& dist <= sj->threshold) {
+			// the pairs of a self-join are given with the first set first
+			if (sj->self && side->index[y] < sj->probe.index[x])
+				status = add_pair(part, side->index[y], sj->probe.index[x], dist);
+			else
+				status = add_pair(part, sj->probe.index[x], side->index[y], dist);
+		}
+		cand->count = 0;
+	}
+	return status;
+}
+
+
+// The probes are spread over the parts by their rank, so that each part gets
+// sets of all sizes.
+
+static void
+probe_part(void *arg, dist_ssize_t t)
+{
+	struct setjoin *sj = (struct setjoin *)arg;
+	struct setjoin_part *part = &sj->parts[t];
+	dist_ssize_t x;
+
+	part->cands = (struct setjoin_candidate *)calloc(sj->indexed.nsets + 1,
+		sizeof(struct setjoin_candidate));
+	part->touched = (dist_ssize_t *)malloc((sj->indexed.nsets + 1) * sizeof(dist_ssize_t));
+	if (part->cands == NULL || part->touched == NULL) {
+		part->status = DISTANCE_ENOMEM;
+		goto Done;
+	}
+	for (x = t; x < sj->probe.nsets; x += sj->nparts) {
+		if ((part->status = probe(sj, part, x)) != DISTANCE_OK)
+			break;
+	}
+
+	Done:
+		free(part->cands);
+		free(part->touched);
+}
+
+
+static int
+join_pair_cmp(const void *a, const void *b)
+{
+	const struct distance_join_pair *x = (const struct distance_join_pair *)a;
+	const struct distance_join_pair *y = (const struct distance_join_pair *)b;
+
+	if (x->i != y->i)
+		return (x->i > y->i) - (x->i < y->i);
+	return (x->j > y->j) - (x->j < y->j);
+}
+
+
+// Probes the sets, and gathers the pairs found by the parts.
+
+static int
+run_probes(struct setjoin *sj, int nthreads, struct distance_join_pair **pairs,
+	dist_ssize_t *npairs)
+{
+	struct pool *pool;
+	struct pool_job job;
+	dist_ssize_t t, total = 0;
+	int status = DISTANCE_OK;
+
+	sj->nparts = (nthreads < sj->probe.nsets ? nthreads : sj->probe.nsets);
+	if (sj->nparts < 1)
+		sj->nparts = 1;
+	if ((sj->parts = (struct setjoin_part *)calloc(sj->nparts, sizeof(struct setjoin_part))) == NULL)
+		return DISTANCE_ENOMEM;
+
+	if (sj->nparts == 1)
+		probe_part(sj, 0);
+	else {
+		if ((status = pool_new(&pool, (int)sj->nparts)) != DISTANCE_OK)
+			goto Done;
+		job.run = probe_part;
+		job.arg = sj;
+		job.size = sj->nparts;
+		job.order = NULL;
+		pool_submit(pool, &job);
+		pool_wait(pool, &job, job.size);
+		pool_free(pool);
+	}
+
+	for (t = 0; t < sj->nparts; t++) {
+		if (sj->parts[t].status != DISTANCE_OK)
+			status = sj->parts[t].status;
+		total += sj->parts[t].npairs;
+	}
+	if (status != DISTANCE_OK)
+		goto Done;
+	if ((*pairs = (struct distance_join_pair *)malloc((total + 1) * sizeof(struct distance_join_pair))) == NULL) {
+		status = DISTANCE_ENOMEM;
+		goto Done;
+	}
+	for (t = 0, total = 0; t < sj->nparts; t++) {
+		memcpy(*pairs + total, sj->parts[t].pairs,
+			sj->parts[t].npairs * sizeof(struct distance_join_pair));
+		total += sj->parts[t].npairs;
+	}
+	if (total > 1)
+		qsort(*pairs, total, sizeof(struct distance_join_pair), join_pair_cmp);
+	*npairs = total;
+
+	Done:
+		for (t = 0; t < sj->nparts; t++)
+			free(sj->parts[t].pairs);
+		free(sj->parts);
+		return status;
+}
+
+
+static int
+check_sets(const uint32_t *tokens, const dist_ssize_t *offsets, dist_ssize_t nsets)
+{
+	dist_ssize_t i;
+
+	if (nsets < 0 || tokens == NULL || offsets == NULL || offsets[0] < 0)
+		return 0;
+	for (i = 0; i < nsets; i++) {
+		if (offsets[i + 1] < offsets[i])
+			return 0;
+	}
+	return 1;
+}
+
+
+DISTANCE_API int
+distance_jaccard_join(const uint32_t *tokens1, const dist_ssize_t *offsets1, dist_ssize_t nsets1,
+	const uint32_t *tokens2, const dist_ssize_t *offsets2, dist_ssize_t nsets2,
+	dist_ssize_t ntokens, double threshold, int nthreads,
+	struct distance_join_pair **pairs, dist_ssize_t *npairs)
+{
+	struct setjoin sj;
+	dist_ssize_t *freqs;
+	uint32_t *ranks = NULL;
+	int status;
+
+	if (!check_sets(tokens1, offsets1, nsets1) || (tokens2 && !check_sets(tokens2, offsets2, nsets2))
+		|| ntokens < 0 || ntokens > (dist_ssize_t)UINT32_MAX + 1 || nthreads < 1
+		|| !(threshold >= 0 && threshold < 1))
+		return DISTANCE_EINVAL;
+	if ((freqs = (dist_ssize_t *)calloc(ntokens + 1, sizeof(dist_ssize_t))) == NULL)
+		return DISTANCE_ENOMEM;
+
+	memset(&sj, 0, sizeof(sj));
+	sj.self = (tokens2 == NULL);
+	sj.threshold = threshold;
+	sj.sim = 1 - threshold;
+	if ((status = side_new(&sj.probe, tokens1, offsets1, nsets1, ntokens, freqs)) != DISTANCE_OK) {
+		free(freqs);
+		return status;
+	}
+	if (sj.self)
+		sj.indexed = sj.probe;
+	else if ((status = side_new(&sj.indexed, tokens2, offsets2, nsets2, ntokens, freqs)) != DISTANCE_OK) {
+		side_free(&sj.probe);
+		free(freqs);
+		return status;
+	}
+
+	if ((ranks = token_ranks(freqs, ntokens)) == NULL) {
+		status = DISTANCE_ENOMEM;
+		goto Done;
+	}
+	side_rename(&sj.probe, ranks);
+	if (!sj.self)
+		side_rename(&sj.indexed, ranks);
+	if ((status = index_prefixes(&sj, ntokens)) == DISTANCE_OK)
+		status = run_probes(&sj, nthreads, pairs, npairs);
+
+	Done:
+		free(freqs);
+		free(ranks);
+		free(sj.starts);
+		free(sj.postings);
+		side_free(&sj.probe);
+		if (!sj.self)
+			side_free(&sj.indexed);
+		return status;
+}
@@ -0,0 +1,166 @@
+#define DISTANCE_BUILD
+#include "core.h"
+#include "stats.h"
+
+#ifdef DISTANCE_STATS
+
+#include <time.h>
+
+/* Each thread has its own block of counters, so that incrementing them
+needs neither atomics nor locks. The blocks are chained in a global list
+when created. The workers of the pools, which are started for a call or an
+iterator, add their counts to `stats_exited` and free their block when they
+exit (see stats_unregister); the blocks of the other threads are kept. */
+
+THREAD_LOCAL struct stats_block *stats_local = NULL;
+
+static struct stats_block *stats_blocks = NULL;
+static struct distance_stats stats_exited;
+static mutex_t stats_mutex = MUTEX_INIT;
+
+// Used if a block can't be allocated; shared between threads then.
+static struct stats_block stats_fallback;
+
+
+struct stats_block *
+stats_register(void)
+{
+	struct stats_block *b;
+
+	if ((b = (struct stats_block *)calloc(1, sizeof(struct stats_block))) == NULL)
+		return stats_local = &stats_fallback;
+
+	mutex_lock(&stats_mutex);
+	b->next = stats_blocks;
+	stats_blocks = b;
+	mutex_unlock(&stats_mutex);
+
+	return stats_local = b;
+}
+
+
+uint64_t
+stats_clock(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER freq, count;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return (uint64_t)(count.QuadPart * (1e9 / freq.QuadPart));
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+#endif
+}
+
+
+void
+stats_latency(struct distance_kernel_stats *ks, uint64_t ns)
+{
+	int k = 0;
+
+	while (ns && k < DISTANCE_STATS_NBUCKETS - 1) {
+		ns >>= 1;
+		k++;
+	}
+	ks->latency[k]++;
+}
+
+
+static void
+stats_sum(struct distance_stats *dst, const struct distance_stats *src)
+{
+	const uint64_t *s = (const uint64_t *)src;
+	uint64_t *d = (uint64_t *)dst;
+	size_t i;
+
+	// the structure is made of uint64_t only
+	for (i = 0; i < sizeof(struct distance_stats) / sizeof(uint64_t); i++)
+		d[i] += s[i];
+}
+
+
+void
+stats_unregister(void)
+{
+	struct stats_block *b = stats_local, **link;
+
+	if (b == NULL || b == &stats_fallback)
+		return;
+	mutex_lock(&stats_mutex);
+	for (link = &stats_blocks; *link != b; link = &(*link)->next)
+		;
+	*link = b->next;
+	stats_sum(&stats_exited, &b->stats);
+	mutex_unlock(&stats_mutex);
+
+	free(b);
+	stats_local = NULL;
+}
+
+
+DISTANCE_API int
+distance_stats_enabled(void)
+{
+	return 1;
+}
+
+
+DISTANCE_API void
+distance_stats_read(struct distance_stats *stats)
+{
+	struct stats_block *b;
+
+	memset(stats, 0, sizeof(struct distance_stats));
+	mutex_lock(&stats_mutex);
+	for (b = stats_blocks; b != NULL; b = b->next)
+		stats_sum(stats, &b->stats);
+	stats_sum(stats, &stats_exited);
+	mutex_unlock(&stats_mutex);
+	stats_sum(stats, &stats_fallback.stats);
+}
+
+
+DISTANCE_API void
+distance_stats_reset(void)
+{
+	struct stats_block *b;
+
+	// the sampling phase is reset as well, so that it doesn't depend on the
+	// calls made before
+	mutex_lock(&stats_mutex);
+	for (b = stats_blocks; b != NULL; b = b->next) {
+		memset(&b->stats, 0, sizeof(struct distance_stats));
+		memset(b->ticks, 0, sizeof(b->ticks));
+	}
+	memset(&stats_exited, 0, sizeof(struct distance_stats));
+	mutex_unlock(&stats_mutex);
+	memset(&stats_fallback.stats, 0, sizeof(struct distance_stats));
+	memset(stats_fallback.ticks, 0, sizeof(stats_fallback.ticks));
+}
+
+#else
+
+DISTANCE_API int
+distance_stats_enabled(void)
+{
+	return 0;
+}
+
+
+DISTANCE_API void
+distance_stats_read(struct distance_stats *stats)
+{
+	memset(stats, 0, sizeof(struct distance_stats));
+}
+
+
+DISTANCE_API void
+distance_stats_reset(void)
+{
+}
+
+#endif
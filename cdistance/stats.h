@@ -0,0 +1,85 @@
+#ifndef STATS_H
+#define STATS_H
+
+/* Instrumentation of the kernels (see libdistance.h). The macros below expand
+to nothing unless DISTANCE_STATS is defined, so that they cost nothing in
+normal builds:
+
+	STAT_ADD(kernel, field, n)		add `n` to a counter of `kernel`
+	STAT_PATH(kernel, type, algo)	count a call taking a given code path, at
+									the level STAT_ISA the code is compiled for
+	STAT_TIMED(kernel, rv, call)	evaluate `rv = call`, counting the call,
+									and measuring its duration if sampled
+	STATS_THREAD_EXIT()				release the counters of a thread about
+									to exit, keeping its counts
+
+Kernels are named by their suffix, e.g. STAT_ADD(LEVENSHTEIN, cells, n), or
+by the name of their function, e.g. STAT_TIMED(levenshtein, rv, call). */
+
+#include "libdistance.h"
+
+#define DISTANCE_STATS_hamming DISTANCE_STATS_HAMMING
+#define DISTANCE_STATS_levenshtein DISTANCE_STATS_LEVENSHTEIN
+#define DISTANCE_STATS_nlevenshtein DISTANCE_STATS_NLEVENSHTEIN
+#define DISTANCE_STATS_fastcomp DISTANCE_STATS_FASTCOMP
+#define DISTANCE_STATS_lcsubstrings DISTANCE_STATS_LCSUBSTRINGS
+#define DISTANCE_STATS_common_substrings DISTANCE_STATS_LCSUBSTRINGS
+#define DISTANCE_STATS_jaro DISTANCE_STATS_JARO
+#define DISTANCE_STATS_lcs DISTANCE_STATS_LCS
+#define DISTANCE_STATS_indel DISTANCE_STATS_LCS
+
+// Redefined by instances.h for the kernels of the other levels.
+#define STAT_ISA DISTANCE_ISA_BASELINE
+
+#ifdef DISTANCE_STATS
+
+#include "threads.h"
+
+// Counters of the current thread, allocated and registered on first use.
+
+struct stats_block {
+	struct distance_stats stats;
+	unsigned ticks[DISTANCE_STATS_NKERNELS];	// for sampling
+	struct stats_block *next;
+};
+
+extern THREAD_LOCAL struct stats_block *stats_local;
+
+struct stats_block *stats_register(void);
+void stats_unregister(void);
+uint64_t stats_clock(void);
+void stats_latency(struct distance_kernel_stats *ks, uint64_t ns);
+
+#define STATS_BLOCK() (stats_local ? stats_local : stats_register())
+#define STATS_KERNEL(kernel) (&STATS_BLOCK()->stats.kernels[DISTANCE_STATS_##kernel])
+
+#define STAT_ADD(kernel, field, n) (STATS_KERNEL(kernel)->field += (n))
+#define STAT_PATH(kernel, type, algo) (STATS_KERNEL(kernel)->paths[STAT_ISA][type][algo]++)
+#define STATS_THREAD_EXIT() stats_unregister()
+
+#define STAT_TIMED(kernel, rv, call)												\
+do {																				\
+	struct stats_block *stats_b = STATS_BLOCK();									\
+	struct distance_kernel_stats *stats_k =											\
+		&stats_b->stats.kernels[DISTANCE_STATS_##kernel];							\
+	uint64_t stats_t0;																\
+	stats_k->calls++;																\
+	if (++stats_b->ticks[DISTANCE_STATS_##kernel] % DISTANCE_STATS_SAMPLE == 0) {	\
+		stats_t0 = stats_clock();													\
+		rv = call;																	\
+		stats_latency(stats_k, stats_clock() - stats_t0);							\
+	}																				\
+	else																			\
+		rv = call;																	\
+} while (0)
+
+#else
+
+#define STAT_ADD(kernel, field, n) ((void)0)
+#define STAT_PATH(kernel, type, algo) ((void)0)
+#define STAT_TIMED(kernel, rv, call) (rv = call)
+#define STATS_THREAD_EXIT() ((void)0)
+
+#endif
+
+#endif
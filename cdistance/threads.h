@@ -0,0 +1,68 @@
+#ifndef THREADS_H
+#define THREADS_H
+
+/* Minimal portability layer over POSIX and Windows threads, for the parts of
+libdistance which need them. Like core.h, it doesn't depend on Python. */
+
+#ifdef _WIN32
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#include <windows.h>
+#else
+	#include <pthread.h>
+#endif
+
+
+// Thread-local storage class.
+
+#if defined(_MSC_VER)
+	#define THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+	#define THREAD_LOCAL __thread
+#else
+	#define THREAD_LOCAL _Thread_local
+#endif
+
+
+// Mutexes, initialized statically with MUTEX_INIT, or with mutex_init.
+// Condition variables.
+// Threads, created with `thread_create` (see pool.c).
+
+#ifdef _WIN32
+	typedef SRWLOCK mutex_t;
+	#define MUTEX_INIT SRWLOCK_INIT
+	#define mutex_init(m) (InitializeSRWLock(m), 0)
+	#define mutex_destroy(m) ((void)0)
+	#define mutex_lock(m) AcquireSRWLockExclusive(m)
+	#define mutex_unlock(m) ReleaseSRWLockExclusive(m)
+
+	typedef CONDITION_VARIABLE cond_t;
+	#define cond_init(c) (InitializeConditionVariable(c), 0)
+	#define cond_destroy(c) ((void)0)
+	#define cond_wait(c, m) SleepConditionVariableSRW((c), (m), INFINITE, 0)
+	#define cond_signal(c) WakeConditionVariable(c)
+	#define cond_broadcast(c) WakeAllConditionVariable(c)
+
+	typedef HANDLE thread_t;
+	#define thread_join(t) (WaitForSingleObject((t), INFINITE), CloseHandle(t))
+#else
+	typedef pthread_mutex_t mutex_t;
+	#define MUTEX_INIT PTHREAD_MUTEX_INITIALIZER
+	#define mutex_init(m) pthread_mutex_init((m), NULL)
+	#define mutex_destroy(m) pthread_mutex_destroy(m)
+	#define mutex_lock(m) pthread_mutex_lock(m)
+	#define mutex_unlock(m) pthread_mutex_unlock(m)
+
+	typedef pthread_cond_t cond_t;
+	#define cond_init(c) pthread_cond_init((c), NULL)
+	#define cond_destroy(c) pthread_cond_destroy(c)
+	#define cond_wait(c, m) pthread_cond_wait((c), (m))
+	#define cond_signal(c) pthread_cond_signal(c)
+	#define cond_broadcast(c) pthread_cond_broadcast(c)
+
+	typedef pthread_t thread_t;
+	#define thread_join(t) pthread_join((t), NULL)
+#endif
+
+#endif
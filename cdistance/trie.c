@@ -0,0 +1,295 @@
+#define DISTANCE_BUILD
+#include "core.h"
+
+/* The trie is stored as arrays, its nodes being numbered in depth-first
+order, which is the lexicographic order of the prefixes they stand for. A
+node is described by its item, its depth, the end of its subtree (the first
+node which isn't one of its descendants), and the word it terminates, if any.
+The nodes are walked in order, and the subtree of a node is skipped by
+jumping to its end; the parent of a node is the last node seen at the depth
+above, so that the Levenshtein rows can be kept in a stack indexed by depth.
+
+Items are stored as 32 bits values whatever the width of the words, and
+compared by value. */
+
+struct distance_trie {
+	uint32_t *items;			// item of each node, none for the root
+	uint32_t *depth;
+	uint32_t *end;
+	dist_ssize_t *word;			// index of the word ending at the node, or -1
+	dist_ssize_t nnodes;
+	dist_ssize_t nwords;		// distinct words
+	dist_ssize_t max_depth;
+};
+
+struct trie_words {
+	const void *const *items;
+	const dist_ssize_t *lens;
+	const int *widths;
+	int width;
+};
+
+
+static uint32_t
+trie_item(const struct trie_words *w, dist_ssize_t i, dist_ssize_t j)
+{
+	switch (w->widths ? w->widths[i] : w->width) {
+		case 1:
+			return ((const uint8_t *)w->items[i])[j];
+		case 2:
+			return ((const uint16_t *)w->items[i])[j];
+	}
+	return ((const uint32_t *)w->items[i])[j];
+}
+
+
+// Length of the common prefix of the words `a` and `b`, and their order.
+
+static dist_ssize_t
+trie_prefix(const struct trie_words *w, dist_ssize_t a, dist_ssize_t b, int *cmp)
+{
+	dist_ssize_t j, len = (w->lens[a] < w->lens[b] ? w->lens[a] : w->lens[b]);
+	uint32_t x, y;
+
+	for (j = 0; j < len; j++) {
+		x = trie_item(w, a, j);
+		y = trie_item(w, b, j);
+		if (x != y) {
+			*cmp = (x < y ? -1 : 1);
+			return j;
+		}
+	}
+	*cmp = (w->lens[a] > w->lens[b]) - (w->lens[a] < w->lens[b]);
+	return len;
+}
+
+
+// Merge sort of the word indexes, stable, so that the first of equal words
+// comes first.
+
+static void
+trie_sort(const struct trie_words *w, dist_ssize_t *index, dist_ssize_t *tmp, dist_ssize_t n)
+{
+	dist_ssize_t h = n / 2, i = 0, j = h, k = 0;
+	int cmp;
+
+	if (n < 2)
+		return;
+	trie_sort(w, index, tmp, h);
+	trie_sort(w, index + h, tmp, n - h);
+	while (i < h && j < n) {
+		trie_prefix(w, index[i], index[j], &cmp);
+		tmp[k++] = (cmp <= 0 ? index[i++] : index[j++]);
+	}
+	while (i < h)
+		tmp[k++] = index[i++];
+	while (j < n)
+		tmp[k++] = index[j++];
+	memcpy(index, tmp, n * sizeof(dist_ssize_t));
+}
+
+
+static void
+trie_free(struct distance_trie *trie)
+{
+	free(trie->items);
+	free(trie->depth);
+	free(trie->end);
+	free(trie->word);
+	free(trie);
+}
+
+
+DISTANCE_API int
+distance_trie_build(const void *const *items, const dist_ssize_t *lens, const int *widths,
+	int width, dist_ssize_t count, struct distance_trie **trie)
+{
+	struct trie_words w = {items, lens, widths, width};
+	struct distance_trie *t;
+	dist_ssize_t *index = NULL, *tmp = NULL, *path = NULL;
+	dist_ssize_t i, j, n, prefix, nnodes = 1, max_len = 0;
+	int cmp, status = DISTANCE_ENOMEM;
+
+	if (count < 0)
+		return DISTANCE_EINVAL;
+	for (i = 0; i < count; i++) {
+		if (lens[i] < 0)
+			return DISTANCE_EINVAL;
+		if (lens[i] > max_len)
+			max_len = lens[i];
+	}
+	if ((t = (struct distance_trie *)calloc(1, sizeof(struct distance_trie))) == NULL)
+		return DISTANCE_ENOMEM;
+	if ((index = (dist_ssize_t *)malloc((count + 1) * sizeof(dist_ssize_t))) == NULL
+		|| (tmp = (dist_ssize_t *)malloc((count + 1) * sizeof(dist_ssize_t))) == NULL
+		|| (path = (dist_ssize_t *)malloc((max_len + 1) * sizeof(dist_ssize_t))) == NULL)
+		goto On_Exit;
+
+	for (i = 0; i < count; i++)
+		index[i] = i;
+	trie_sort(&w, index, tmp, count);
+
+	// number of nodes: one per item not shared with the previous word
+	for (i = 0; i < count; i++) {
+		prefix = (i ? trie_prefix(&w, index[i - 1], index[i], &cmp) : 0);
+		nnodes += lens[index[i]] - prefix;
+	}
+	if (nnodes > (dist_ssize_t)UINT32_MAX) {
+		status = DISTANCE_EINVAL;
+		goto On_Exit;
+	}
+	if ((t->items = (uint32_t *)malloc(nnodes * sizeof(uint32_t))) == NULL
+		|| (t->depth = (uint32_t *)malloc(nnodes * sizeof(uint32_t))) == NULL
+		|| (t->end = (uint32_t *)malloc(nnodes * sizeof(uint32_t))) == NULL
+		|| (t->word = (dist_ssize_t *)malloc(nnodes * sizeof(dist_ssize_t))) == NULL)
+		goto On_Exit;
+
+	// `path[d]` is the node at depth `d` on the path to the current word
+	t->items[0] = 0;
+	t->depth[0] = 0;
+	t->word[0] = -1;
+	path[0] = 0;
+	n = 1;
+	for (i = 0; i < count; i++) {
+		prefix = (i ? trie_prefix(&w, index[i - 1], index[i], &cmp) : 0);
+		if (i && prefix == lens[index[i]] && prefix == lens[index[i - 1]])
+			continue;		// duplicate
+		// the nodes below the common prefix are complete
+		for (j = (i ? lens[index[i - 1]] : 0); j > prefix; j--)
+			t->end[path[j]] = (uint32_t)n;
+		for (j = prefix; j < lens[index[i]]; j++) {
+			t->items[n] = trie_item(&w, index[i], j);
+			t->depth[n] = (uint32_t)(j + 1);
+			t->word[n] = -1;
+			path[j + 1] = n++;
+		}
+		t->word[path[lens[index[i]]]] = index[i];
+		t->nwords++;
+	}
+	for (j = (count ? lens[index[count - 1]] : 0); j >= 0; j--)
+		t->end[path[j]] = (uint32_t)n;
+	t->nnodes = n;
+	t->max_depth = max_len;
+	status = DISTANCE_OK;
+
+	On_Exit:
+		free(index);
+		free(tmp);
+		free(path);
+		if (status != DISTANCE_OK)
+			trie_free(t);
+		else
+			*trie = t;
+		return status;
+}
+
+
+DISTANCE_API void
+distance_trie_free(struct distance_trie *trie)
+{
+	if (trie != NULL)
+		trie_free(trie);
+}
+
+
+DISTANCE_API dist_ssize_t
+distance_trie_size(const struct distance_trie *trie)
+{
+	return trie->nwords;
+}
+
+
+DISTANCE_API int
+distance_trie_search(const struct distance_trie *trie, const void *query, int width,
+	dist_ssize_t len, dist_ssize_t max_dist, struct distance_hit **hits, dist_ssize_t *nhits)
+{
+	const void *items[1];
+	struct trie_words w = {items, &len, NULL, width};
+	dist_ssize_t rows, d, i, j, lo, hi, min, cost, cap = 0, inf;
+	dist_ssize_t *stack, *prev, *row;
+	uint32_t *q, item;
+	int status = DISTANCE_OK;
+
+	if (len < 0 || (width != 1 && width != 2 && width != 4))
+		return DISTANCE_EINVAL;
+
+	*hits = NULL;
+	*nhits = 0;
+
+	// with a bound, the nodes deeper than `len + max_dist + 1` are never reached
+	rows = trie->max_depth;
+	if (max_dist >= 0 && max_dist < rows && len + max_dist + 1 < rows)
+		rows = len + max_dist + 1;
+	inf = (max_dist >= 0 ? max_dist + 1 : len + rows + 1);
+	if ((stack = (dist_ssize_t *)malloc((rows + 1) * (len + 2) * sizeof(dist_ssize_t))) == NULL)
+		return DISTANCE_ENOMEM;
+	if ((q = (uint32_t *)malloc((len + 1) * sizeof(uint32_t))) == NULL) {
+		free(stack);
+		return DISTANCE_ENOMEM;
+	}
+	items[0] = query;
+	for (j = 0; j < len; j++)
+		q[j] = trie_item(&w, 0, j);
+
+	// row of the root; each row has a sentinel after its last cell
+	for (j = 0; j <= len; j++)
+		stack[j] = j;
+	stack[len + 1] = inf;
+	if (trie->word[0] >= 0 && (max_dist < 0 || len <= max_dist)
+		&& (status = hits_append(hits, nhits, &cap, trie->word[0], len)) != DISTANCE_OK)
+		goto On_Exit;
+
+	for (i = 1; i < trie->nnodes; ) {
+		d = trie->depth[i];
+		item = trie->items[i];
+		prev = stack + (d - 1) * (len + 2);
+		row = prev + (len + 2);
+
+		/* Only the cells at most `max_dist` away from the diagonal can hold a
+		value lower or equal to `max_dist`; the others are set to `inf`. */
+		lo = 1;
+		hi = len;
+		if (max_dist >= 0) {
+			lo = (d > max_dist ? d - max_dist : 1);
+			hi = (d + max_dist < len ? d + max_dist : len);
+		}
+		row[0] = d;
+		min = (lo == 1 ? d : inf);
+		if (lo > 1)
+			row[lo - 1] = inf;
+		for (j = lo; j <= hi; j++) {
+			cost = prev[j - 1] + (q[j - 1] != item);
+			if (prev[j] + 1 < cost)
+				cost = prev[j] + 1;
+			if (row[j - 1] + 1 < cost)
+				cost = row[j - 1] + 1;
+			if (max_dist >= 0 && cost > inf)
+				cost = inf;
+			row[j] = cost;
+			if (cost < min)
+				min = cost;
+		}
+		row[hi + 1] = inf;
+
+		// no word below this node is close enough
+		if (max_dist >= 0 && min > max_dist) {
+			i = trie->end[i];
+			continue;
+		}
+		// the last cell is out of the band when the node is too shallow
+		if (trie->word[i] >= 0 && hi == len && (max_dist < 0 || row[len] <= max_dist)
+			&& (status = hits_append(hits, nhits, &cap, trie->word[i], row[len])) != DISTANCE_OK)
+			goto On_Exit;
+		i++;
+	}
+
+	On_Exit:
+		free(stack);
+		free(q);
+		if (status != DISTANCE_OK) {
+			free(*hits);
+			*hits = NULL;
+			*nhits = 0;
+		}
+		return status;
+}
@@ -0,0 +1,318 @@
+#define DISTANCE_BUILD
+#include "wavefront.h"
+#include "pool.h"
+
+/* Shorter sequences, or pairs of sequences, are compared by a single thread,
+as the tiles would be too small for the threads to be worth starting. The
+tiles are cut so that each anti-diagonal has several of them per thread. */
+
+#define WAVEFRONT_MIN_LEN 4096
+#define WAVEFRONT_MIN_TILE 256
+#define WAVEFRONT_MAX_TILE 4096
+
+
+// Bounds of the tile (ti, tj) (see wavefront.h), and value of its top left cell.
+
+dist_ssize_t
+wavefront_bounds(const struct wavefront *wf, dist_ssize_t ti, dist_ssize_t tj,
+	dist_ssize_t *i0, dist_ssize_t *i1, dist_ssize_t *j0, dist_ssize_t *j1)
+{
+	*i0 = ti * wf->size;
+	*i1 = (*i0 + wf->size < wf->len1 ? *i0 + wf->size : wf->len1);
+	*j0 = tj * wf->size;
+	*j1 = (*j0 + wf->size < wf->len2 ? *j0 + wf->size : wf->len2);
+
+	if (ti == 0)
+		return wf->gap * *j0;
+	if (tj == 0)
+		return wf->gap * *i0;
+	return WAVEFRONT_CORNER(wf, ti - 1, tj - 1);
+}
+
+
+// Records the first error of the tiles.
+
+void
+wavefront_fail(struct wavefront *wf, int status)
+{
+	mutex_lock(&wf->mutex);
+	if (wf->status == DISTANCE_OK)
+		wf->status = status;
+	mutex_unlock(&wf->mutex);
+}
+
+
+dist_ssize_t
+wavefront_max_len(struct wavefront *wf)
+{
+	dist_ssize_t max_len;
+
+	mutex_lock(&wf->mutex);
+	max_len = wf->max_len;
+	mutex_unlock(&wf->mutex);
+	return max_len;
+}
+
+
+/* Merges the longest common substrings found by a tile, of length `max_len`,
+with those found so far, and takes ownership of `pairs`. */
+
+void
+wavefront_merge(struct wavefront *wf, dist_ssize_t max_len,
+	struct distance_pair *pairs, dist_ssize_t npairs, dist_ssize_t alloc)
+{
+	struct distance_pair *tmp;
+
+	if (npairs == 0) {
+		free(pairs);
+		return;
+	}
+	mutex_lock(&wf->mutex);
+	if (max_len > wf->max_len) {
+		free(wf->pairs);
+		wf->pairs = pairs;
+		wf->npairs = npairs;
+		wf->alloc = alloc;
+		wf->max_len = max_len;
+		pairs = NULL;
+	}
+	else if (max_len == wf->max_len) {
+		if (wf->npairs + npairs > wf->alloc) {
+			tmp = (struct distance_pair *)realloc(wf->pairs,
+				(wf->npairs + npairs) * sizeof(struct distance_pair));
+			if (tmp == NULL) {
+				if (wf->status == DISTANCE_OK)
+					wf->status = DISTANCE_ENOMEM;
+				goto Done;
+			}
+			wf->pairs = tmp;
+			wf->alloc = wf->npairs + npairs;
+		}
+		memcpy(wf->pairs + wf->npairs, pairs, npairs * sizeof(struct distance_pair));
+		wf->npairs += npairs;
+	}
+	Done:
+		mutex_unlock(&wf->mutex);
+		free(pairs);
+}
+
+
+static void
+wavefront_step(void *arg, dist_ssize_t k)
+{
+	struct wavefront *wf = (struct wavefront *)arg;
+
+	wf->tile(wf, wf->first + k, wf->diag - (wf->first + k));
+}
+
+
+/* Computes the whole matrix with `nthreads` threads. On success, the last row
+and column of the matrix are left in `bottom` and `right`, to be released
+with wavefront_release. */
+
+static int
+wavefront_run(struct wavefront *wf, int nthreads)
+{
+	struct pool *pool;
+	struct pool_job job;
+	dist_ssize_t i, last, shorter = (wf->len1 < wf->len2 ? wf->len1 : wf->len2);
+	int status;
+
+	wf->size = shorter / (4 * (dist_ssize_t)nthreads);
+	if (wf->size < WAVEFRONT_MIN_TILE)
+		wf->size = WAVEFRONT_MIN_TILE;
+	if (wf->size > WAVEFRONT_MAX_TILE)
+		wf->size = WAVEFRONT_MAX_TILE;
+	wf->ntiles1 = (wf->len1 + wf->size - 1) / wf->size;
+	wf->ntiles2 = (wf->len2 + wf->size - 1) / wf->size;
+	if (nthreads > (shorter + wf->size - 1) / wf->size)
+		nthreads = (int)((shorter + wf->size - 1) / wf->size);
+
+	wf->bottom = (dist_ssize_t *)malloc((wf->len2 + 1) * sizeof(dist_ssize_t));
+	wf->right = (dist_ssize_t *)malloc((wf->len1 + 1) * sizeof(dist_ssize_t));
+	wf->corners = (dist_ssize_t *)malloc((wf->ntiles1 + wf->ntiles2 - 1) * sizeof(dist_ssize_t));
+	wf->pairs = NULL;
+	wf->npairs = wf->alloc = wf->max_len = 0;
+	wf->status = DISTANCE_OK;
+	if (wf->bottom == NULL || wf->right == NULL || wf->corners == NULL) {
+		status = DISTANCE_ENOMEM;
+		goto On_Error;
+	}
+	for (i = 0; i <= wf->len2; i++)
+		wf->bottom[i] = wf->gap * i;
+	for (i = 0; i <= wf->len1; i++)
+		wf->right[i] = wf->gap * i;
+
+	mutex_init(&wf->mutex);
+	if ((status = pool_new(&pool, nthreads)) != DISTANCE_OK) {
+		mutex_destroy(&wf->mutex);
+		goto On_Error;
+	}
+	job.run = wavefront_step;
+	job.arg = wf;
+	job.order = NULL;
+	for (wf->diag = 0; wf->diag < wf->ntiles1 + wf->ntiles2 - 1; wf->diag++) {
+		wf->first = (wf->diag < wf->ntiles2 ? 0 : wf->diag - wf->ntiles2 + 1);
+		last = (wf->diag < wf->ntiles1 ? wf->diag : wf->ntiles1 - 1);
+		job.size = last - wf->first + 1;
+		pool_submit(pool, &job);
+		pool_wait(pool, &job, job.size);
+	}
+	pool_free(pool);
+	mutex_destroy(&wf->mutex);
+
+	if ((status = wf->status) == DISTANCE_OK)
+		return DISTANCE_OK;
+
+	On_Error:
+		free(wf->bottom);
+		free(wf->right);
+		free(wf->corners);
+		free(wf->pairs);
+		return status;
+}
+
+
+static void
+wavefront_release(struct wavefront *wf)
+{
+	free(wf->bottom);
+	free(wf->right);
+	free(wf->corners);
+}
+
+
+static int
+pair_cmp(const void *a, const void *b)
+{
+	const struct distance_pair *x = (const struct distance_pair *)a;
+	const struct distance_pair *y = (const struct distance_pair *)b;
+
+	if (x->i != y->i)
+		return (x->i > y->i) - (x->i < y->i);
+	return (x->j > y->j) - (x->j < y->j);
+}
+
+
+// Public entry points (see libdistance.h).
+
+static int
+wavefront_levenshtein(const void *seq1, const void *seq2, int width,
+	dist_ssize_t len1, dist_ssize_t len2, int nthreads, dist_ssize_t *dist)
+{
+	struct wavefront wf;
+	int status;
+
+	wf.seq1 = seq1;
+	wf.seq2 = seq2;
+	wf.len1 = len1;
+	wf.len2 = len2;
+	wf.gap = 1;
+	wf.tile = wavefront_kernel(WAVEFRONT_LEVENSHTEIN, width);
+	if ((status = wavefront_run(&wf, nthreads)) != DISTANCE_OK)
+		return status;
+	*dist = wf.bottom[len2];
+	wavefront_release(&wf);
+	return DISTANCE_OK;
+}
+
+
+DISTANCE_API int
+distance_levenshtein_parallel(const void *seq1, const void *seq2, int width,
+	dist_ssize_t len1, dist_ssize_t len2, dist_ssize_t max_dist, int nthreads,
+	dist_ssize_t *dist)
+{
+	dist_ssize_t shorter = (len1 < len2 ? len1 : len2);
+	dist_ssize_t bound = shorter / DIAG_RATIO;
+	int status;
+
+	if (len1 < 0 || len2 < 0 || nthreads < 1 || (width != 1 && width != 2 && width != 4))
+		return DISTANCE_EINVAL;
+	if (nthreads == 1 || shorter < WAVEFRONT_MIN_LEN || (max_dist >= 0 && max_dist <= bound))
+		return items_compare(DISTANCE_METRIC_LEVENSHTEIN, width, seq1, len1, seq2, len2,
+			max_dist, dist);
+	if (max_dist >= 0 && (len1 > len2 ? len1 - len2 : len2 - len1) > max_dist) {
+		*dist = -1;
+		return DISTANCE_OK;
+	}
+
+	// near-identical sequences are compared faster along the diagonals
+	status = items_compare(DISTANCE_METRIC_LEVENSHTEIN, width, seq1, len1, seq2, len2,
+		bound, dist);
+	if (status != DISTANCE_OK || *dist >= 0)
+		return status;
+
+	STAT_TIMED(levenshtein, status, wavefront_levenshtein(seq1, seq2, width, len1, len2,
+		nthreads, dist));
+	if (status == DISTANCE_OK && max_dist >= 0 && *dist > max_dist)
+		*dist = -1;
+	return status;
+}
+
+
+static int
+wavefront_lcsubstrings(const void *seq1, const void *seq2, int width,
+	dist_ssize_t len1, dist_ssize_t len2, int nthreads,
+	dist_ssize_t *max_len, struct distance_pair **pairs, dist_ssize_t *npairs)
+{
+	struct wavefront wf;
+	dist_ssize_t k, i, j;
+	int status, swapped = 0;
+
+	// as in lcsubstrings, the positions are sorted by row of the longer sequence
+	if (len1 < len2) {
+		SWAP(const void *, seq1, seq2);
+		SWAP(dist_ssize_t, len1, len2);
+		swapped = 1;
+	}
+	wf.seq1 = seq1;
+	wf.seq2 = seq2;
+	wf.len1 = len1;
+	wf.len2 = len2;
+	wf.gap = 0;
+	wf.tile = wavefront_kernel(WAVEFRONT_LCSUBSTRINGS, width);
+	if ((status = wavefront_run(&wf, nthreads)) != DISTANCE_OK)
+		return status;
+	wavefront_release(&wf);
+
+	if (wf.npairs > 0)
+		qsort(wf.pairs, wf.npairs, sizeof(struct distance_pair), pair_cmp);
+	for (k = 0; k < wf.npairs; k++) {
+		i = wf.pairs[k].i - wf.max_len + 1;
+		j = wf.pairs[k].j - wf.max_len + 1;
+		wf.pairs[k].i = (swapped ? j : i);
+		wf.pairs[k].j = (swapped ? i : j);
+	}
+	*max_len = wf.max_len;
+	*pairs = wf.pairs;
+	*npairs = wf.npairs;
+	return DISTANCE_OK;
+}
+
+
+DISTANCE_API int
+distance_lcsubstrings_parallel(const void *seq1, const void *seq2, int width,
+	dist_ssize_t len1, dist_ssize_t len2, int nthreads,
+	dist_ssize_t *max_len, struct distance_pair **pairs, dist_ssize_t *npairs)
+{
+	int status;
+
+	if (len1 < 0 || len2 < 0 || nthreads < 1 || (width != 1 && width != 2 && width != 4))
+		return DISTANCE_EINVAL;
+	if (nthreads == 1 || len1 < WAVEFRONT_MIN_LEN || len2 < WAVEFRONT_MIN_LEN) {
+		switch (width) {
+			case 1:
+				return distance_lcsubstrings_u8((const uint8_t *)seq1, (const uint8_t *)seq2,
+					len1, len2, max_len, pairs, npairs);
+			case 2:
+				return distance_lcsubstrings_u16((const uint16_t *)seq1, (const uint16_t *)seq2,
+					len1, len2, max_len, pairs, npairs);
+		}
+		return distance_lcsubstrings_u32((const uint32_t *)seq1, (const uint32_t *)seq2,
+			len1, len2, max_len, pairs, npairs);
+	}
+
+	STAT_TIMED(lcsubstrings, status, wavefront_lcsubstrings(seq1, seq2, width, len1, len2,
+		nthreads, max_len, pairs, npairs));
+	return status;
+}
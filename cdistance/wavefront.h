@@ -0,0 +1,64 @@
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+/* Parallel computation of the dynamic programming matrix of a single pair of
+long sequences (wavefront.c). The matrix is cut into square tiles, and the
+tiles of an anti-diagonal, which don't depend on each other, are computed by a
+pool of threads; the next anti-diagonal is started once they are all done.
+
+The tiles pass their results on through three arrays: the last row computed
+of each column, `bottom`, the last column computed of each row, `right`, and
+the bottom right cell of the last tile of each diagonal of tiles, `corners`.
+The tile (ti, tj), of rows i0 + 1..i1 and columns j0 + 1..j1, is computed from
+the row i0 in bottom[j0 + 1..j1], the column j0 in right[i0 + 1..i1], and the
+cell (i0, j0), which it replaces with the row i1, the column j1, and the cell
+(i1, j1). The cells of the first row and column are `gap` times their index.
+
+The tile kernels (levenshtein_tile in levenshtein.c, lcsubstrings_tile in
+lcsubstrings.c) are instantiated for each item type like the other kernels,
+and selected by wavefront_kernel (libdistance.c). */
+
+#include "core.h"
+#include "threads.h"
+
+struct wavefront {
+	const void *seq1, *seq2;
+	dist_ssize_t len1, len2;
+	dist_ssize_t gap;
+	void (*tile)(struct wavefront *wf, dist_ssize_t ti, dist_ssize_t tj);
+
+	// managed by wavefront_run
+	dist_ssize_t size;					// of the tiles
+	dist_ssize_t ntiles1, ntiles2;
+	dist_ssize_t *bottom;				// len2 + 1 cells
+	dist_ssize_t *right;				// len1 + 1 cells
+	dist_ssize_t *corners;				// ntiles1 + ntiles2 - 1 cells
+	dist_ssize_t diag, first;			// anti-diagonal being computed
+
+	// shared by the tiles, under `mutex`: the first error, and for
+	// lcsubstrings, the longest common substrings found so far (end positions)
+	mutex_t mutex;
+	int status;
+	dist_ssize_t max_len;
+	struct distance_pair *pairs;
+	dist_ssize_t npairs, alloc;
+};
+
+typedef void (*wavefront_tile_t)(struct wavefront *wf, dist_ssize_t ti, dist_ssize_t tj);
+
+enum {
+	WAVEFRONT_LEVENSHTEIN,
+	WAVEFRONT_LCSUBSTRINGS
+};
+
+#define WAVEFRONT_CORNER(wf, ti, tj) ((wf)->corners[(ti) - (tj) + (wf)->ntiles2 - 1])
+
+wavefront_tile_t wavefront_kernel(int algo, int width);
+dist_ssize_t wavefront_bounds(const struct wavefront *wf, dist_ssize_t ti, dist_ssize_t tj,
+	dist_ssize_t *i0, dist_ssize_t *i1, dist_ssize_t *j0, dist_ssize_t *j1);
+void wavefront_fail(struct wavefront *wf, int status);
+dist_ssize_t wavefront_max_len(struct wavefront *wf);
+void wavefront_merge(struct wavefront *wf, dist_ssize_t max_len,
+	struct distance_pair *pairs, dist_ssize_t npairs, dist_ssize_t alloc);
+
+#endif
@@ -1,14 +1,20 @@
 "Utilities for comparing sequences"
 
 __all__ = ["hamming", "levenshtein", "nlevenshtein", "jaccard", "sorensen",
-	"fast_comp", "lcsubstrings", "ilevenshtein", "ifast_comp"]
+	"fast_comp", "lcsubstrings", "ilevenshtein", "ifast_comp", "jaro",
+	"jaro_winkler", "ijaro", "ijaro_winkler", "stats", "reset_stats", "Lexicon",
+	"write_lexicon", "CandidateSet", "Trie", "lcs_length", "indel_distance",
+	"iindel_distance", "common_substrings", "Vocabulary",
+	"compile_query", "Pattern", "QGramProfile", "qgram_distance", "cosine", "overlap",
+	"find_approx", "grep", "cpu_features", "jaccard_join", "SetIndex",
+	"PackedDNA", "BarcodeSet", "Dawg", "write_dawg"]
 
 try:
 	from .cdistance import *
 except ImportError:
 	from ._pyimports import *
 
-from ._pyimports import jaccard, sorensen
+from ._pyimports import jaccard, sorensen, write_lexicon, write_dawg
 
 def quick_levenshtein(str1, str2):
 	return fast_comp(str1, str2, transpositions=False)
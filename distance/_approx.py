@@ -0,0 +1,69 @@
+# -*- coding: utf-8 -*-
+
+from ._qgrams import _items
+
+
+def find_approx(pattern, text, max_dist, starts=False):
+	"""Search `text` for the substrings which are at Levenshtein distance
+	`max_dist` or less from `pattern`, and return an iterator over the pairs
+	(end, distance), where `text[:end]` is the text up to the end of a
+	substring, and `distance` the lowest distance of the substrings ending
+	there. With `starts` true, the iterator returns triples (start, end,
+	distance) instead, `text[start:end]` being the shortest of these
+	substrings:
+
+		>>> list(find_approx("needle", "a neddle, needles", 1, starts=True))
+		[(2, 8, 1), (10, 15, 1), (10, 16, 0), (10, 17, 1)]
+
+	Every end position within the bound is returned, so that a match with a
+	few errors is usually reported at several consecutive ends.
+
+	The pattern (which can be a `Pattern`) and the text are strings of the
+	same type, or arrays of integers. In the C implementation, the text is
+	scanned with the bit-parallel algorithm of Myers, in its semi-global form,
+	on as many 64 items words as needed to hold the pattern, and without
+	holding the GIL.
+	"""
+	if max_dist < 0:
+		raise ValueError("expected a positive `max_dist`, or 0")
+	type1, pattern = _items(pattern)
+	type2, text = _items(text)
+	if type1 != type2:
+		raise ValueError("expected a text of the same type as the pattern")
+	return _find(pattern, text, max_dist, starts)
+
+
+def _find(pattern, text, max_dist, starts):
+	m = len(pattern)
+	# last column of the matrix; its first row is 0 whatever the column
+	col = list(range(m + 1))
+	for end in range(len(text) + 1):
+		if end > 0:
+			item, diag = text[end - 1], 0
+			for i in range(1, m + 1):
+				cost = diag + (pattern[i - 1] != item)
+				diag = col[i]
+				col[i] = min(cost, col[i] + 1, col[i - 1] + 1)
+		dist = col[m]
+		if dist > max_dist:
+			continue
+		if starts:
+			yield _start(pattern, text, end, dist), end, dist
+		else:
+			yield end, dist
+
+
+def _start(pattern, text, end, dist):
+	# the same, backwards from `end`, in its global form
+	m = len(pattern)
+	col = list(range(m + 1))
+	length = 0
+	while col[m] != dist:
+		length += 1
+		item, diag = text[end - length], col[0]
+		col[0] = length
+		for i in range(1, m + 1):
+			cost = diag + (pattern[m - i] != item)
+			diag = col[i]
+			col[i] = min(cost, col[i] + 1, col[i - 1] + 1)
+	return end - length
@@ -0,0 +1,77 @@
+# -*- coding: utf-8 -*-
+
+from array import array
+
+from ._dna import PackedDNA
+from ._levenshtein import levenshtein
+
+_DNA_METRICS = ("hamming", "levenshtein")
+
+
+class BarcodeSet(object):
+	"""A whitelist of barcodes, which reads are assigned to.
+
+		`barcodes`: PackedDNA, or strings of bases
+
+	The barcodes are numbered from 0, in their order. Barcode sets support
+	`len()`.
+
+	In the C implementation, when all the barcodes have 32 bases or less, and
+	no N, they are stored in a hash table. A read is then looked up as it is,
+	and, if it isn't a barcode, so are the sequences at distance 1 of it,
+	which are derived from its packed bases by a few bit operations: these
+	lookups replace the comparison of the read with each barcode, which is
+	only done if no barcode is at distance 0 or 1, and `max_dist` is higher.
+	"""
+
+	def __init__(self, barcodes):
+		self._codes = [str(PackedDNA(seq)) for seq in barcodes]
+
+	def __len__(self):
+		return len(self._codes)
+
+	def assign(self, reads, max_dist=1, metric="hamming", workers=1):
+		"""Assign each read of `reads` to its closest barcode, and return
+		two arrays: the index of the barcode of each read, -1 if no barcode
+		is at distance `max_dist` or less, and -2 if several barcodes are
+		at the lowest distance, and its distance, -1 if there is none:
+
+			>>> barcodes = BarcodeSet(["ACGT", "TTGA", "ACGA"])
+			>>> barcodes.assign(["ACGT", "TTGC", "ACGG", "CCCC"])
+			(array('q', [0, 1, -2, -1]), array('q', [0, 1, 1, -1]))
+
+			`reads`: PackedDNA, or strings of bases
+			`max_dist`: highest distance of a barcode to a read, any
+			distance if negative
+			`metric`: "hamming", in which case only the barcodes of the
+			length of a read are compared with it, or "levenshtein"
+			`workers`: number of threads; 0 means one per CPU
+
+		In the C implementation, the reads are packed, and then assigned by
+		`workers` threads without holding the GIL. `workers` is ignored in
+		the pure Python implementation.
+		"""
+		if metric not in _DNA_METRICS:
+			raise ValueError("expected one of hamming, levenshtein for `metric`")
+		if workers < 0:
+			raise ValueError("expected a positive number of workers, or 0")
+		indexes, dists = array("q"), array("q")
+		for read in reads:
+			read = str(PackedDNA(read))
+			best, dist = -1, -1
+			for i, code in enumerate(self._codes):
+				if metric == "hamming":
+					if len(code) != len(read):
+						continue
+					d = sum(c1 != c2 for c1, c2 in zip(read, code))
+				else:
+					d = levenshtein(read, code)
+				if max_dist >= 0 and d > max_dist:
+					continue
+				if best == -1 or d < dist:
+					best, dist = i, d
+				elif d == dist:
+					best = -2
+			indexes.append(best)
+			dists.append(dist)
+		return indexes, dists
@@ -0,0 +1,106 @@
+# -*- coding: utf-8 -*-
+
+from collections import Counter
+
+from ._lexicon import _metrics
+from ._levenshtein import levenshtein
+from ._simpledists import hamming
+from ._fastcomp import fast_comp
+from ._pattern import _query
+
+
+def _profile(seq, q):
+	return Counter(seq[i:i + q] for i in range(len(seq) - q + 1))
+
+
+class CandidateSet(object):
+	"""A set of strings to be searched for the ones close to a query, as with
+	`ilevenshtein`, but without comparing all of them.
+
+		`seqs`: the strings, either unicode or byte strings
+		`q`: length of the q-grams, between 1 and 8
+
+	The strings are grouped by length, and the profile of their q-grams
+	(substrings of length `q`) is computed once. When searching with a bound,
+	only the strings which length is compatible with it are looked at, and
+	those which don't share enough q-grams with the query are rejected before
+	computing their distance: strings at distance `k` share at least
+	`max(len1, len2) - q + 1 - k * q` q-grams.
+
+	Candidate sets support `len()` and indexing.
+	"""
+
+	def __init__(self, seqs, q=2):
+		if not 1 <= q <= 8:
+			raise ValueError("expected a value between 1 and 8 for `q`")
+		self._q = q
+		self._seqs, self._profiles, self._buckets = [], [], {}
+		self._type = None
+		for seq in seqs:
+			self.add(seq)
+
+	def _check(self, seq):
+		if not isinstance(seq, (type(u""), bytes)):
+			raise ValueError("expected unicode or byte strings")
+		if self._type is not None and not isinstance(seq, self._type):
+			raise ValueError("type mismatch between the strings of the set")
+
+	def add(self, seq):
+		"""Add the string `seq` to the set.
+		"""
+		self._check(seq)
+		self._type = type(seq)
+		self._buckets.setdefault(len(seq), []).append(len(self._seqs))
+		self._seqs.append(seq)
+		self._profiles.append(_profile(seq, self._q))
+
+	def __len__(self):
+		return len(self._seqs)
+
+	def __getitem__(self, i):
+		return self._seqs[i]
+
+	def search(self, query, max_dist=-1, metric="levenshtein"):
+		"""Return the list of pairs (distance, string) for the strings of the set
+		which distance from `query` is lower or equal to `max_dist`, or for all
+		the strings if `max_dist` is negative.
+
+			`metric`: "levenshtein", "hamming" or "fast_comp", as in
+			`Lexicon.scan`
+
+		The pairs are returned in the order in which the strings were added.
+		"""
+		compiled, query = query, _query(query)
+		if metric not in _metrics:
+			raise ValueError("expected one of %s for `metric`" % ", ".join(_metrics))
+		self._check(query)
+		bound = max_dist
+		if metric == "fast_comp" and not 0 <= max_dist <= 2:
+			bound = 2
+		lengths = self._buckets
+		if metric == "hamming":
+			lengths = [len(query)]
+		elif bound >= 0:
+			lengths = range(max(len(query) - bound, 0), len(query) + bound + 1)
+
+		q, profile, hits = self._q, None, []
+		if getattr(compiled, "q", None) == q:
+			profile = compiled._profile
+		for l in lengths:
+			for i in self._buckets.get(l, ()):
+				needed = max(len(query), l) - q + 1 - bound * q
+				if bound >= 0 and needed > 0:
+					if profile is None:
+						profile = _profile(query, q)
+					if sum((profile & self._profiles[i]).values()) < needed:
+						continue
+				seq = self._seqs[i]
+				if metric == "levenshtein":
+					dist = levenshtein(query, seq, max_dist=max_dist)
+				elif metric == "hamming":
+					dist = hamming(query, seq)
+				else:
+					dist = fast_comp(query, seq)
+				if dist != -1 and (max_dist < 0 or dist <= max_dist):
+					hits.append((i, dist))
+		return [(dist, self._seqs[i]) for i, dist in sorted(hits)]
@@ -0,0 +1,324 @@
+# -*- coding: utf-8 -*-
+
+import mmap, struct
+
+from ._pattern import _query
+
+# Layout of a DAWG file, all integers being little-endian:
+#
+#	header		magic, version, flags (1 if the words have values),
+#				number of states, of edges and of words, length of the
+#				longest word
+#	first		uint32 * (nstates + 1): index of the first edge of each state
+#	info		uint32 * nstates: number of words accepted from each state,
+#				shifted left by one, the low bit telling if the state is final
+#	labels		uint32 * nedges: code point of each edge, sorted by state
+#	targets		uint32 * nedges: state each edge leads to
+#	values		int64 * count, after padding to 8 bytes, if flags & 1
+#
+# The root is the state 0. The words are numbered in lexicographic order; the
+# number of a word, obtained by adding up the words accepted before it while
+# walking the automaton, is the index of its value.
+
+_MAGIC = b"DISTDAWG"
+_VERSION = 1
+_VALUES = 1
+_HEADER = struct.Struct("<8sIIQQQQ")
+_U32 = struct.Struct("<I")
+_I64 = struct.Struct("<q")
+
+
+def _minimize(words):
+	# the states of the minimal automaton of the sorted, distinct `words`, as
+	# tuples (final, labels, targets, count), the root last
+	states, register = [], {}
+
+	def freeze(node):
+		# returns the number of the state equivalent to `node`
+		final, labels, targets = node
+		key = (final, tuple(labels), tuple(targets))
+		state = register.get(key)
+		if state is None:
+			count = final + sum(states[t][3] for t in targets)
+			state = register[key] = len(states)
+			states.append((final, labels, targets, count))
+		return state
+
+	# the nodes on the path to the previous word, which aren't frozen yet
+	path = [[False, [], []]]
+	prev = u""
+	for word in words:
+		common, n = 0, min(len(prev), len(word))
+		while common < n and prev[common] == word[common]:
+			common += 1
+		while len(path) > common + 1:
+			node = path.pop()
+			path[-1][2][-1] = freeze(node)
+		for c in word[common:]:
+			path[-1][1].append(ord(c))
+			path[-1][2].append(None)
+			path.append([False, [], []])
+		path[-1][0] = True
+		prev = word
+	while len(path) > 1:
+		node = path.pop()
+		path[-1][2][-1] = freeze(node)
+	freeze(path[0])
+	return states
+
+
+def write_dawg(path, words, values=None):
+	"""Write the strings `words` to a DAWG file, to be opened with `Dawg.open`.
+
+		`values`: integers to store with the words, in the same order
+
+	The words are stored as a minimal automaton, in which the words sharing a
+	prefix share its edges, and the words sharing a suffix share its states:
+	the file is much smaller than the list of words. A word present several
+	times is stored once, with its first value. Building the automaton takes
+	time and memory, and is meant to be done once, offline.
+	"""
+	words = list(words)
+	for word in words:
+		if not isinstance(word, type(u"")):
+			raise ValueError("expected unicode strings")
+	if values is not None:
+		values = list(values)
+		if len(values) != len(words):
+			raise ValueError("expected as many values as words")
+
+	# the distinct words in lexicographic order, the sort being stable
+	order = sorted(range(len(words)), key=words.__getitem__)
+	keys, vals = [], []
+	for i in order:
+		if keys and keys[-1] == words[i]:
+			continue
+		keys.append(words[i])
+		if values is not None:
+			vals.append(values[i])
+	if len(keys) >= 1 << 31:
+		raise ValueError("too many words")
+
+	# numbered from the root, which comes last, so that it is the state 0
+	states = _minimize(keys)
+	n = len(states)
+	first, info, labels, targets = [0], [], [], []
+	for final, labs, dests, count in reversed(states):
+		labels.extend(labs)
+		targets.extend(n - 1 - t for t in dests)
+		first.append(len(labels))
+		info.append(count << 1 | final)
+	if n >= 1 << 32 or len(labels) >= 1 << 32:
+		raise ValueError("too many words")
+	max_len = max([len(k) for k in keys] or [0])
+
+	try:
+		packed_values = struct.pack("<%dq" % len(vals), *vals)
+	except struct.error:
+		raise ValueError("expected 64 bits signed integers as values")
+	with open(path, "wb") as f:
+		f.write(_HEADER.pack(_MAGIC, _VERSION, _VALUES if values is not None else 0,
+			n, len(labels), len(keys), max_len))
+		for table in (first, info, labels, targets):
+			f.write(struct.pack("<%dI" % len(table), *table))
+		if values is not None:
+			if (2 * n + 1 + 2 * len(labels)) % 2:
+				f.write(b"\0" * 4)
+			f.write(packed_values)
+
+
+class Dawg(object):
+	"""A read-only set of strings, stored in a file written by `write_dawg`,
+	to be searched for the ones close to a query with the Levenshtein distance.
+
+	As with lexicons, the file is memory-mapped: opening it takes the same
+	time whatever its size, and processes opening the same file share its
+	memory. The automaton is searched as a `Trie`, keeping a row of the
+	Levenshtein matrix for each depth, and skipping the states from which no
+	word can be close enough to the query; in the C implementation, without
+	holding the GIL.
+
+	Dawgs support `len()`, `in`, and indexing, which gives the words in
+	lexicographic order, and can be used as context managers, which close
+	them on exit.
+	"""
+
+	def __init__(self, path):
+		with open(path, "rb") as f:
+			self._map = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+		try:
+			self._parse()
+		except:
+			self._map.close()
+			raise
+
+	def _parse(self):
+		size = len(self._map)
+		if size < _HEADER.size:
+			raise ValueError("invalid dawg file")
+		magic, version, flags, nstates, nedges, count, max_len = _HEADER.unpack_from(self._map)
+		if magic != _MAGIC or version != _VERSION or flags & ~_VALUES:
+			raise ValueError("invalid dawg file")
+		if not 0 < nstates < 1 << 32 or nedges >= 1 << 32 or max_len >= nstates:
+			raise ValueError("invalid dawg file")
+		self._nstates, self._nedges, self._count, self._max_len = nstates, nedges, count, max_len
+		self._first = _HEADER.size
+		self._info = self._first + 4 * (nstates + 1)
+		self._labels = self._info + 4 * nstates
+		self._targets = self._labels + 4 * nedges
+		end = self._targets + 4 * nedges
+		self._values = None
+		if flags & _VALUES:
+			self._values = end = (end + 7) // 8 * 8
+			end += 8 * count
+		if end > size or self._words(0) != count:
+			raise ValueError("invalid dawg file")
+
+	def _u32(self, table, i):
+		return _U32.unpack_from(self._map, table + 4 * i)[0]
+
+	def _words(self, state):
+		return self._u32(self._info, state) >> 1
+
+	def _final(self, state):
+		return self._u32(self._info, state) & 1
+
+	def _edges(self, state):
+		# pairs (label, target) of the edges of `state`
+		start, end = self._u32(self._first, state), self._u32(self._first, state + 1)
+		if start > end or end > self._nedges:
+			raise ValueError("invalid dawg file")
+		edges = [(self._u32(self._labels, e), self._u32(self._targets, e)) for e in range(start, end)]
+		for label, target in edges:
+			if target >= self._nstates:
+				raise ValueError("invalid dawg file")
+		return edges
+
+	def _rank(self, word):
+		# number of `word`, -1 if it isn't in the dawg
+		state, rank = 0, 0
+		for c in word:
+			rank += self._final(state)
+			for label, target in self._edges(state):
+				if label == ord(c):
+					state = target
+					break
+				rank += self._words(target)
+			else:
+				return -1
+		return rank if self._final(state) else -1
+
+	def _subtree(self, state, word):
+		# the words accepted from `state`, in order, prefixed with `word`
+		if len(word) > self._max_len:
+			raise ValueError("invalid dawg file")
+		if self._final(state):
+			yield word
+		for label, target in self._edges(state):
+			for w in self._subtree(target, word + chr(label)):
+				yield w
+
+	@classmethod
+	def open(cls, path):
+		"""Open the dawg stored in the file `path`.
+		"""
+		return cls(path)
+
+	def close(self):
+		"""Unmap the file. The dawg can't be used anymore afterwards.
+		"""
+		self._map.close()
+
+	def __enter__(self):
+		return self
+
+	def __exit__(self, *exc):
+		self.close()
+
+	def __len__(self):
+		return self._count
+
+	def __getitem__(self, i):
+		if i < 0:
+			i += self._count
+		if not 0 <= i < self._count:
+			raise IndexError("dawg index out of range")
+		state, word = 0, u""
+		while len(word) <= self._max_len:
+			if self._final(state):
+				if i == 0:
+					return word
+				i -= 1
+			for label, target in self._edges(state):
+				if i < self._words(target):
+					state, word = target, word + chr(label)
+					break
+				i -= self._words(target)
+			else:
+				break
+		raise ValueError("invalid dawg file")
+
+	def __contains__(self, word):
+		return isinstance(word, type(u"")) and self._rank(word) >= 0
+
+	def get(self, word, default=None):
+		"""Return the value stored with `word`, or `default` if the dawg doesn't
+		hold it. If `write_dawg` was given no values, the value of a word is its
+		index in the dawg.
+		"""
+		if not isinstance(word, type(u"")):
+			raise ValueError("expected a unicode string")
+		rank = self._rank(word)
+		if rank < 0:
+			return default
+		if self._values is None:
+			return rank
+		return _I64.unpack_from(self._map, self._values + 8 * rank)[0]
+
+	def _search(self, query, max_dist, prefix):
+		query = _query(query)
+		if not isinstance(query, type(u"")):
+			raise ValueError("expected a unicode string as query")
+		hits = []
+		# the nodes to visit, with their row of the Levenshtein matrix and the
+		# lowest distance of the prefixes above them, the first one on top
+		stack = [(0, u"", list(range(len(query) + 1)), len(query))]
+		while stack:
+			state, word, row, best = stack.pop()
+			if len(word) > self._max_len:
+				raise ValueError("invalid dawg file")
+			best, low = min(best, row[-1]), min(row)
+			if prefix and (max_dist < 0 or best <= max_dist) and low >= best:
+				# the deeper prefixes can't be closer to the query
+				hits.extend((best, w) for w in self._subtree(state, word))
+				continue
+			if max_dist >= 0 and low > max_dist:
+				continue
+			dist = best if prefix else row[-1]
+			if self._final(state) and (max_dist < 0 or dist <= max_dist):
+				hits.append((dist, word))
+			for label, target in reversed(self._edges(state)):
+				c, below = chr(label), [row[0] + 1]
+				for j in range(1, len(query) + 1):
+					below.append(min(row[j - 1] + (query[j - 1] != c), row[j] + 1, below[j - 1] + 1))
+				stack.append((target, word + c, below, best))
+		if self._values is not None:
+			return [(dist, word, self.get(word)) for dist, word in hits]
+		return hits
+
+	def search(self, query, max_dist=-1):
+		"""Return the list of pairs (distance, word) for the words of the dawg
+		which Levenshtein distance from `query` is lower or equal to `max_dist`,
+		or for all the words if `max_dist` is negative; if `write_dawg` was given
+		values, the triples (distance, word, value).
+
+		The words are returned in lexicographic order.
+		"""
+		return self._search(query, max_dist, False)
+
+	def prefix_search(self, query, max_dist=-1):
+		"""As `search`, for the words which have a prefix at distance
+		`max_dist` or less from `query`, e.g. to complete a query being typed.
+		The distance returned is the lowest distance of a prefix of the word.
+		"""
+		return self._search(query, max_dist, True)
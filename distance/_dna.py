@@ -0,0 +1,77 @@
+# -*- coding: utf-8 -*-
+
+_BASES = "ACGTN"
+_CODES = dict((c, k) for k, c in enumerate(_BASES))
+_CODES.update((c.lower(), k) for c, k in list(_CODES.items()))
+
+
+class PackedDNA(object):
+	"""A nucleotide sequence stored in 2 bits per base.
+
+		`seq`: a string of bases, A, C, G, T or N, in either case
+
+	Packed sequences support `len()` and `str()`, which gives their bases in
+	upper case, and can be pickled. `hamming` and `levenshtein` compare two
+	packed sequences, or a packed sequence with a string of bases, which is
+	then packed, as the strings of their bases:
+
+		>>> levenshtein(PackedDNA("ACGTACGT"), "ACGAACG")
+		2
+
+	In the C implementation, the bases are stored by blocks of 64, as two
+	words holding the low and the high bits of their codes; N, stored as A,
+	is flagged in a third word, which only the sequences with some N have.
+	Hamming distances are then computed 64 bases at a time, counting the bits
+	of the XOR of the words of the two sequences, and the bit-parallel
+	Levenshtein kernel computes its match vectors from the words, for
+	sequences of any length. The other arguments of these functions, `fold`
+	and `workers`, are ignored: the bases have a single case, and the
+	sequences are always compared in the calling thread.
+	"""
+
+	def __init__(self, seq):
+		if isinstance(seq, PackedDNA):
+			seq = str(seq)
+		if isinstance(seq, bytes):
+			seq = seq.decode("latin-1")
+		if not isinstance(seq, type(u"")):
+			raise ValueError("expected a PackedDNA, or a string of bases")
+		# the low and the high bits of the codes, and the positions of N
+		self._lo = self._hi = self._n = 0
+		for i, c in enumerate(seq):
+			code = _CODES.get(c)
+			if code is None:
+				raise ValueError("expected A, C, G, T or N at position %d" % i)
+			if code == 4:
+				self._n |= 1 << i
+			else:
+				self._lo |= (code & 1) << i
+				self._hi |= (code >> 1) << i
+		self._len = len(seq)
+
+	def __len__(self):
+		return self._len
+
+	def __str__(self):
+		return "".join(_BASES[4 if (self._n >> i) & 1 else
+			((self._lo >> i) & 1) | (((self._hi >> i) & 1) << 1)] for i in range(self._len))
+
+	def __repr__(self):
+		return "PackedDNA(%r)" % str(self)
+
+	def __reduce__(self):
+		return (PackedDNA, (str(self),))
+
+
+def _packed_pair(seq1, seq2):
+	# both sequences packed if one of them is, None otherwise
+	if not isinstance(seq1, PackedDNA) and not isinstance(seq2, PackedDNA):
+		return None
+	return PackedDNA(seq1), PackedDNA(seq2)
+
+
+def _packed_hamming(dna1, dna2):
+	if len(dna1) != len(dna2):
+		raise ValueError("expected two objects of the same length")
+	diff = (dna1._lo ^ dna2._lo) | (dna1._hi ^ dna2._hi) | (dna1._n ^ dna2._n)
+	return bin(diff).count("1")
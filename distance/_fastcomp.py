@@ -1,6 +1,8 @@
 # -*- coding: utf-8 -*-
 
-def fast_comp(seq1, seq2, transpositions=False):
+from ._fold import _fold_pair
+
+def fast_comp(seq1, seq2, transpositions=False, fold="none"):
 	"""Compute the distance between the two sequences `seq1` and `seq2` up to a
 	maximum of 2 included, and return it. If the edit distance between the two
 	sequences is higher than that, -1 is returned.
@@ -18,7 +20,10 @@ def fast_comp(seq1, seq2, transpositions=False):
 
 	The algorithm comes from `http://writingarchives.sakura.ne.jp/fastcomp`.
 	I've added transpositions support to the original code.
+
+	`fold` has the same sense as in `levenshtein`.
 	"""
+	seq1, seq2 = _fold_pair(seq1, seq2, fold)
 	replace, insert, delete = "r", "i", "d"
 
 	L1, L2  = len(seq1), len(seq2)
@@ -0,0 +1,42 @@
+# -*- coding: utf-8 -*-
+
+from ._pattern import _query
+
+_FOLDS = ("none", "ascii", "simple")
+_ASCII = dict((c, c + 32) for c in range(ord("A"), ord("Z") + 1))
+_STRINGS = (type(u""), bytes)
+_simple = {}
+
+
+def _simple_char(c):
+	# the folded case, if it is a single character, or the lower case
+	for folded in (c.casefold(), c.lower()):
+		if len(folded) == 1:
+			return folded
+	return c
+
+
+def _fold(seq, fold):
+	if fold not in _FOLDS:
+		raise ValueError("expected one of none, ascii, simple for `fold`")
+	if fold == "none":
+		return seq
+	if isinstance(seq, bytes):
+		return seq.lower()
+	if not isinstance(seq, type(u"")):
+		raise ValueError("expected strings, for folding their case")
+	if fold == "ascii":
+		return seq.translate(_ASCII)
+	for c in seq:
+		if c not in _simple:
+			_simple[c] = _simple_char(c)
+	return u"".join(_simple[c] for c in seq)
+
+
+def _fold_pair(seq1, seq2, fold):
+	seq1 = _query(seq1)
+	if fold not in _FOLDS:
+		raise ValueError("expected one of none, ascii, simple for `fold`")
+	if fold != "none" and not any(isinstance(seq1, t) and isinstance(seq2, t) for t in _STRINGS):
+		raise ValueError("expected two strings of the same type, for folding their case")
+	return _fold(seq1, fold), _fold(seq2, fold)
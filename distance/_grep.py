@@ -0,0 +1,83 @@
+# -*- coding: utf-8 -*-
+
+import mmap
+
+from ._levenshtein import levenshtein
+from ._pattern import Pattern, _query
+from ._approx import _find
+
+
+def grep(source, patterns, max_dist, mode="line", workers=0, chunk_size=1048576):
+	"""Search the lines of a file or of a byte string for approximate matches of
+	one or several patterns, and return an iterator over the quadruples (lineno,
+	index, distance, line), where `lineno` is the number of the line from 0,
+	`index` the index of the pattern, and `line` the line itself, without its
+	newline:
+
+		>>> list(grep(b"foo\\nbarr\\nbaz\\n", [b"bar", b"qux"], 1))
+		[(1, 0, 1, b'barr'), (2, 0, 1, b'baz')]
+
+		`source`: the path of a file, as a string or a path-like object, or an
+		object supporting the buffer protocol, e.g. bytes or an `mmap.mmap`
+		`patterns`: a byte string or a `Pattern` of one, or a sequence of them
+		`max_dist`: highest distance of the matches
+		`mode`: "line" to compare the whole lines with the patterns, with the
+		Levenshtein distance; "substring" to look for the patterns in the lines,
+		as `find_approx` does, `distance` being then the lowest distance of the
+		substrings of the line
+		`workers`: number of threads; 0 (the default) means one per CPU
+		`chunk_size`: number of bytes handed to a thread at once
+
+	The lines are separated by "\\n"; a "\\r" before it is part of the line.
+	The results are returned in the order of the lines, and of the patterns
+	for each line.
+
+	In the C implementation, files are memory-mapped rather than read. The
+	text is cut into chunks, searched by a pool of threads without holding
+	the GIL, while the results of the previous chunks are returned. `workers`
+	and `chunk_size` are ignored in the pure Python implementation.
+	"""
+	if max_dist < 0:
+		raise ValueError("expected a positive `max_dist`, or 0")
+	if mode not in ("line", "substring"):
+		raise ValueError("expected one of line, substring for `mode`")
+	if workers < 0:
+		raise ValueError("expected a positive number of workers, or 0")
+	if chunk_size < 1:
+		raise ValueError("expected a positive `chunk_size`")
+	if isinstance(patterns, (bytes, Pattern)):
+		patterns = [patterns]
+	patterns = [_query(pattern) for pattern in patterns]
+	if not all(isinstance(pattern, bytes) for pattern in patterns):
+		raise ValueError("expected byte strings as patterns")
+	return _grep(_text(source), patterns, max_dist, mode)
+
+
+def _text(source):
+	if isinstance(source, type(u"")) or hasattr(source, "__fspath__"):
+		with open(source, "rb") as f:
+			try:
+				return mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+			except ValueError:		# empty file
+				return b""
+	if isinstance(source, (bytes, mmap.mmap)):
+		return source
+	return bytes(memoryview(source))
+
+
+def _grep(text, patterns, max_dist, mode):
+	start, lineno = 0, 0
+	while start < len(text):
+		end = text.find(b"\n", start)
+		if end == -1:
+			end = len(text)
+		line = text[start:end]
+		for index, pattern in enumerate(patterns):
+			if mode == "line":
+				dist = levenshtein(pattern, line, max_dist=max_dist)
+			else:
+				dists = [d for _, d in _find(pattern, line, max_dist, False)]
+				dist = min(dists) if dists else -1
+			if dist != -1:
+				yield lineno, index, dist, line
+		start, lineno = end + 1, lineno + 1
@@ -1,6 +1,56 @@
-from ._pyimports import levenshtein, fast_comp
+from ._pyimports import levenshtein, fast_comp, jaro, jaro_winkler, indel_distance
+from ._pattern import _query
+from ._fold import _fold
 
-def ilevenshtein(seq1, seqs, max_dist=-1):
+def _check_parallel(workers, chunk_size):
+	if workers < 0:
+		raise ValueError("expected a positive number of workers, or 0")
+	if chunk_size < 1:
+		raise ValueError("expected a positive `chunk_size`")
+
+
+def _results(compare, seqs, out, dense):
+	if out is None:
+		return _pairs(compare, seqs, dense)
+	if not isinstance(out, tuple) or len(out) != 2:
+		raise ValueError("expected a pair of arrays (indices, distances) for `out`")
+	if len(out[0]) != len(out[1]) or len(out[0]) == 0:
+		raise ValueError("expected two arrays of the same non-zero length for `out`")
+	# the index of the last sequence must fit, when it is known
+	itemsize = getattr(out[0], "itemsize", 8)
+	if itemsize < 8 and hasattr(seqs, "__len__") and len(seqs) - 1 >= 1 << (8 * itemsize - 1):
+		raise ValueError("the array of indices of `out` is too narrow for `seqs`")
+	return _fill(compare, seqs, out[0], out[1], dense)
+
+
+def _pairs(compare, seqs, dense):
+	for seq2 in seqs:
+		dist = compare(seq2)
+		if dist != -1 or dense:
+			yield dist, seq2
+
+
+def _fill(compare, seqs, indices, dists, dense):
+	n = 0
+	for i, seq2 in enumerate(seqs):
+		try:
+			dist = compare(seq2)
+			if dist != -1 or dense:
+				indices[n], dists[n] = i, dist
+				n += 1
+		except Exception:
+			# the results written so far are returned first
+			if n:
+				yield n
+			raise
+		if n == len(indices):
+			yield n
+			n = 0
+	if n:
+		yield n
+
+
+def ilevenshtein(seq1, seqs, max_dist=-1, workers=1, ordered=True, chunk_size=1024, out=None, dense=False, fold="none"):
 	"""Compute the Levenshtein distance between the sequence `seq1` and the series
 	of	sequences `seqs`.
 	
@@ -14,14 +64,51 @@ def ilevenshtein(seq1, seqs, max_dist=-1):
 	The sequence objects in `seqs` are expected to be of the same kind than
 	the reference sequence in the C implementation; the same holds true for
 	`ifast_comp`.
+	
+	In the C implementation, the distances can be computed by a pool of
+	threads, without holding the GIL:
+	
+		`workers`: number of threads; 0 means one per CPU, and 1 (the default)
+		computes the distances in the calling thread
+		`ordered`: if false, the results are returned as soon as they are
+		computed, rather than in the order of `seqs`
+		`chunk_size`: number of sequences handed to the threads at once; at most
+		twice as many sequences are read ahead of the consumer
+	
+	Only strings are processed in parallel; other sequences are compared in
+	the calling thread whatever the value of `workers`. These parameters are
+	accepted but ignored in the pure Python implementation; the same holds
+	true for `ifast_comp`.
+	
+	Creating a pair for each result can be avoided by passing two arrays of
+	signed integers of the same length, e.g. `array.array("q")` or numpy
+	arrays, as `out`:
+	
+		`out`: a pair (indices, distances); the positions of the results in
+		`seqs` and their distances are written to the start of these arrays,
+		and the iterator returns the number of results written each time they
+		are full, and once more for the last results; an error met once
+		some results were written is raised by the next iteration
+		`dense`: if true, a result is returned for every sequence of `seqs`,
+		with a distance of -1 for those beyond `max_dist`
+	
+		>>> indices, dists = array("q", [0] * 2), array("q", [0] * 2)
+		>>> for n in ilevenshtein("foo", ["fo", "bar", "foob"], 1, out=(indices, dists)):
+		...     print(list(indices[:n]), list(dists[:n]))
+		[0, 2] [1, 1]
+	
+	The arrays are locked until the iterator is destroyed. With several
+	workers and `ordered` false, the indices are not in increasing order.
+	
+	`fold` has the same sense as in `levenshtein`; the sequences of `seqs` are
+	returned as they are. The same holds true for the other iterators.
 	"""
-	for seq2 in seqs:
-		dist = levenshtein(seq1, seq2, max_dist=max_dist)
-		if dist != -1:
-			yield dist, seq2
+	_check_parallel(workers, chunk_size)
+	seq1 = _fold(_query(seq1), fold)
+	return _results(lambda seq2: levenshtein(seq1, _fold(seq2, fold), max_dist=max_dist), seqs, out, dense)
 
 
-def ifast_comp(seq1, seqs, transpositions=False):
+def ifast_comp(seq1, seqs, transpositions=False, workers=1, ordered=True, chunk_size=1024, out=None, dense=False, fold="none"):
 	"""Return an iterator over all the sequences in `seqs` which distance from
 	`seq1` is lower or equal to 2. The sequences which distance from the
 	reference sequence is higher than that are dropped.
@@ -29,6 +116,8 @@ def ifast_comp(seq1, seqs, transpositions=False):
 		`seq1`: the reference sequence.
 		`seqs`: a series of sequences (can be a generator)
 		`transpositions` has the same sense than in `fast_comp`.
+		`workers`, `ordered`, `chunk_size`, `out` and `dense` have the same
+		sense than in `ilevenshtein`.
 	
 	The return value is a series of pairs (distance, sequence).
 	
@@ -39,7 +128,62 @@ def ifast_comp(seq1, seqs, transpositions=False):
 		>>> sorted(g)
 		[(0, 'foo'), (1, 'fo'), (1, 'foob')]
 	"""
+	_check_parallel(workers, chunk_size)
+	seq1 = _fold(_query(seq1), fold)
+	return _results(lambda seq2: fast_comp(seq1, _fold(seq2, fold), transpositions), seqs, out, dense)
+
+
+def iindel_distance(seq1, seqs, max_dist=-1, workers=1, ordered=True, chunk_size=1024, out=None, dense=False, fold="none"):
+	"""Compute the indel distance between the sequence `seq1` and the series
+	of sequences `seqs`.
+	
+		`seq1`: the reference sequence
+		`seqs`: a series of sequences (can be a generator)
+		`max_dist`: if provided and >= 0, only the sequences which distance from
+		the reference sequence is lower or equal to this value will be returned.
+		`workers`, `ordered`, `chunk_size`, `out` and `dense` have the same
+		sense than in `ilevenshtein`.
+	
+	The return value is a series of pairs (distance, sequence).
+	"""
+	_check_parallel(workers, chunk_size)
+	if fold != "none":
+		seq1 = _fold(_query(seq1), fold)
+	return _results(lambda seq2: indel_distance(seq1, _fold(seq2, fold), max_dist=max_dist), seqs, out, dense)
+
+
+def ijaro(seq1, seqs, min_score=None, fold="none"):
+	"""Compute the Jaro similarity between the sequence `seq1` and the series
+	of sequences `seqs`.
+	
+		`seq1`: the reference sequence
+		`seqs`: a series of sequences (can be a generator)
+		`min_score`: if provided, only the sequences which similarity with the
+		reference sequence is higher or equal to this value will be returned.
+	
+	The return value is a series of pairs (similarity, sequence).
+	"""
+	seq1 = _fold(_query(seq1), fold)
 	for seq2 in seqs:
-		dist = fast_comp(seq1, seq2, transpositions)
-		if dist != -1:
-			yield dist, seq2
+		score = jaro(seq1, _fold(seq2, fold), min_score)
+		if score != -1.0:
+			yield score, seq2
+
+
+def ijaro_winkler(seq1, seqs, prefix_weight=0.1, min_score=None, fold="none"):
+	"""Compute the Jaro-Winkler similarity between the sequence `seq1` and the
+	series of sequences `seqs`.
+	
+		`seq1`: the reference sequence
+		`seqs`: a series of sequences (can be a generator)
+		`prefix_weight` has the same sense than in `jaro_winkler`.
+		`min_score`: if provided, only the sequences which similarity with the
+		reference sequence is higher or equal to this value will be returned.
+	
+	The return value is a series of pairs (similarity, sequence).
+	"""
+	seq1 = _fold(_query(seq1), fold)
+	for seq2 in seqs:
+		score = jaro_winkler(seq1, _fold(seq2, fold), prefix_weight, min_score)
+		if score != -1.0:
+			yield score, seq2
@@ -0,0 +1,103 @@
+# -*- coding: utf-8 -*-
+
+from ._fold import _fold_pair
+
+def jaro(seq1, seq2, min_score=None, fold="none"):
+	"""Compute the Jaro similarity between the two sequences `seq1` and `seq2`.
+
+	Two items are said to match if they are equal and not farther than
+	`max(len(seq1), len(seq2)) // 2 - 1` positions apart. With `m` the number of
+	matching items and `t` half the number of matching items which are not in
+	the same order in both sequences, the similarity is computed as:
+
+		1.0                                                if len(seq1) == len(seq2) == 0
+		0.0                                                if m == 0
+		(m / len(seq1) + m / len(seq2) + (m - t) / m) / 3  otherwise
+
+	The return value is a float between 0 and 1, where 1 means equal, and 0
+	totally different. For example:
+
+		>>> jaro("martha", "marhta")
+		0.9444444444444445
+
+	If `min_score` is provided, the computation stops as soon as it is clear
+	that the similarity will be lower than this value, and -1.0 is returned.
+
+	`fold` has the same sense as in `levenshtein`.
+	"""
+	seq1, seq2 = _fold_pair(seq1, seq2, fold)
+	return jaro_winkler(seq1, seq2, 0.0, min_score)
+
+
+def jaro_winkler(seq1, seq2, prefix_weight=0.1, min_score=None, fold="none"):
+	"""Compute the Jaro-Winkler similarity between the two sequences `seq1` and
+	`seq2`.
+
+	This is the Jaro similarity (see `jaro`), raised for sequences which have a
+	common prefix. With `l` the length of this prefix, up to a maximum of 4, the
+	similarity is computed as:
+
+		jaro + l * prefix_weight * (1 - jaro)
+
+	`prefix_weight` should be between 0 and 0.25 included, so that the return
+	value is a float between 0 and 1, where 1 means equal, and 0 totally
+	different. For example:
+
+		>>> jaro_winkler("martha", "marhta")
+		0.9611111111111111
+
+	If `min_score` is provided, the computation stops as soon as it is clear
+	that the similarity will be lower than this value, and -1.0 is returned.
+
+	`fold` has the same sense as in `levenshtein`.
+	"""
+	seq1, seq2 = _fold_pair(seq1, seq2, fold)
+	if not 0.0 <= prefix_weight <= 0.25:
+		raise ValueError("expected a value between 0 and 0.25 for `prefix_weight`")
+
+	L1, L2 = len(seq1), len(seq2)
+	if L1 < L2:
+		L1, L2 = L2, L1
+		seq1, seq2 = seq2, seq1
+
+	if L1 == 0:
+		return 1.0
+
+	prefix = 0
+	while prefix < 4 and prefix < L2 and seq1[prefix] == seq2[prefix]:
+		prefix += 1
+
+	def bound(m):
+		# best score reachable with `m` matches, if there are no transpositions
+		j = (m / float(L1) + m / float(L2) + 1.0) / 3.0
+		return j + prefix * prefix_weight * (1.0 - j)
+
+	if L2 == 0:
+		return -1.0 if min_score is not None and min_score > 0.0 else 0.0
+	if min_score is not None and bound(L2) < min_score:
+		return -1.0
+
+	window = max(L1 // 2 - 1, 0)
+	flags1, flags2 = [False] * L1, [False] * L2
+	m = 0
+	for i in range(L1):
+		for j in range(max(i - window, 0), min(i + window + 1, L2)):
+			if not flags2[j] and seq1[i] == seq2[j]:
+				flags1[i] = flags2[j] = True
+				m += 1
+				break
+		if min_score is not None and bound(min(m + L1 - i - 1, L2)) < min_score:
+			return -1.0
+
+	if m == 0:
+		score = 0.0
+	else:
+		matched1 = [seq1[i] for i in range(L1) if flags1[i]]
+		matched2 = [seq2[j] for j in range(L2) if flags2[j]]
+		t = sum(c1 != c2 for c1, c2 in zip(matched1, matched2)) // 2
+		score = (m / float(L1) + m / float(L2) + (m - t) / float(m)) / 3.0
+		score = score + prefix * prefix_weight * (1.0 - score)
+
+	if min_score is not None and score < min_score:
+		return -1.0
+	return score
@@ -0,0 +1,74 @@
+# -*- coding: utf-8 -*-
+
+from ._pattern import _query, _match_vectors
+from ._fold import _fold_pair
+
+
+def lcs_length(seq1, seq2, fold="none"):
+	"""Compute the length of the longest common subsequence of the two
+	sequences `seq1` and `seq2`, i.e. the highest number of items which appear
+	in both sequences in the same order, not necessarily contiguously. For
+	example:
+	
+		>>> lcs_length("abcd", "acbd")
+		3
+	
+	The items of the sequences are expected to be hashable.
+	
+	In the C implementation, strings are compared with the bit-parallel
+	algorithm of Allison and Dix, on as many 64 bits words as needed to hold
+	the shortest sequence.
+
+	`fold` has the same sense as in `levenshtein`.
+	"""
+	if fold != "none":
+		seq1, seq2 = _fold_pair(seq1, seq2, fold)
+	peq = getattr(seq1, "_peq", None)
+	if peq is not None:
+		# the vectors of the query were computed when it was compiled
+		seq1, seq2 = seq2, seq1.seq
+	else:
+		seq1 = _query(seq1)
+		if len(seq1) < len(seq2):
+			seq1, seq2 = seq2, seq1
+		# the same algorithm, on Python integers of `len(seq2)` bits
+		peq = _match_vectors(seq2)
+	mask = (1 << len(seq2)) - 1
+	v = mask
+	for item in seq1:
+		u = v & peq.get(item, 0)
+		v = ((v + u) | (v - u)) & mask
+	return len(seq2) - bin(v).count("1")
+
+
+def indel_distance(seq1, seq2, normalized=False, max_dist=-1, fold="none"):
+	"""Compute the indel distance between the two sequences `seq1` and `seq2`,
+	i.e. the number of insertions and deletions necessary for transforming one
+	sequence into the other. It is related to the longest common subsequence
+	by:
+	
+		indel_distance = len(seq1) + len(seq2) - 2 * lcs_length
+	
+	If `normalized` evaluates to `True`, the distance is divided by the sum of
+	the lengths of the sequences, and is a float between 0 (equal) and 1 (no
+	item in common); it is 0.0 if both sequences are empty.
+	
+	`max_dist` has the same sense as in `levenshtein`, and is ignored when the
+	distance is normalized.
+
+	`fold` has the same sense as in `levenshtein`.
+	"""
+	if fold != "none":
+		seq1, seq2 = _fold_pair(seq1, seq2, fold)
+	query, seq1 = seq1, _query(seq1)
+	len1, len2 = len(seq1), len(seq2)
+	if normalized:
+		if len1 + len2 == 0:
+			return 0.0
+		return (len1 + len2 - 2 * lcs_length(query, seq2)) / float(len1 + len2)
+	if max_dist >= 0 and abs(len1 - len2) > max_dist:
+		return -1
+	dist = len1 + len2 - 2 * lcs_length(query, seq2)
+	if max_dist >= 0 and dist > max_dist:
+		return -1
+	return dist
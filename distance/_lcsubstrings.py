@@ -1,9 +1,11 @@
 # -*- coding: utf-8 -*-
 
 from array import array
+from ._pattern import _query
+from ._fold import _fold_pair
 
 
-def lcsubstrings(seq1, seq2, positions=False):
+def lcsubstrings(seq1, seq2, positions=False, fold="none", workers=1):
 	"""Find the longest common substring(s) in the sequences `seq1` and `seq2`.
 	
 	If positions evaluates to `True` only their positions will be returned,
@@ -19,13 +21,24 @@ def lcsubstrings(seq1, seq2, positions=False):
 		{'dent'}
 		>>> lcsubstrings("sedentar", "dentist", positions=True)
 		(4, [(2, 0)])
+	
+	`fold` has the same sense as in `levenshtein`; the substrings are then
+	returned as they are in the shortest sequence, or in `seq2` if both have
+	the same length.
+	
+	`workers` has the same sense as in `levenshtein`: with the C extension,
+	long strings are compared by several threads, and the result is the same,
+	positions included.
 	"""
+	orig1, orig2 = _query(seq1), seq2
+	seq1, seq2 = _fold_pair(seq1, seq2, fold)
 	L1, L2 = len(seq1), len(seq2)
 	ms = []
 	mlen = last = 0
 	if L1 < L2:
 		seq1, seq2 = seq2, seq1
 		L1, L2 = L2, L1
+		orig2 = orig1
 	
 	column = array('L', range(L2))
 	
@@ -48,4 +61,47 @@ def lcsubstrings(seq1, seq2, positions=False):
 	
 	if positions:
 		return (mlen, tuple((i - mlen + 1, j - mlen + 1) for i, j in ms if ms))
-	return set(seq1[i - mlen + 1:i + 1] for i, _ in ms if ms)
+	return set(orig2[j - mlen + 1:j + 1] for _, j in ms if ms)
+
+
+def common_substrings(seq1, seq2, min_len=1, fold="none"):
+	"""Return an iterator over the maximal common substrings of the sequences
+	`seq1` and `seq2` which are at least `min_len` items long, as triples
+	(start pos in seq1, start pos in seq2, length). A common substring is
+	maximal if it can't be extended on either side.
+	
+	Unlike `lcsubstrings`, all the common substrings are returned, not only the
+	longest ones, and they are computed as they are consumed rather than
+	stored: memory use doesn't depend on their number. They are returned
+	diagonal by diagonal, i.e. by increasing `pos in seq2 - pos in seq1`, then
+	by increasing position.
+	
+		>>> list(common_substrings("sedentar", "dentist", min_len=2))
+		[(2, 0, 4)]
+	
+	Only one item out of `min_len` needs to be compared until a match is
+	found, so that a high `min_len` makes the search faster.
+
+	`fold` has the same sense as in `levenshtein`.
+	"""
+	seq1, seq2 = _fold_pair(seq1, seq2, fold)
+	if min_len < 1:
+		raise ValueError("expected a positive `min_len`")
+	len1, len2 = len(seq1), len(seq2)
+	for diag in range(len1 + len2 - 1):
+		i0, j0 = max(len1 - 1 - diag, 0), max(diag - len1 + 1, 0)
+		n = min(len1 - i0, len2 - j0)
+		pos = 0
+		while pos + min_len <= n:
+			q = pos + min_len - 1
+			if seq1[i0 + q] != seq2[j0 + q]:
+				pos = q + 1
+				continue
+			l, r = q, q + 1
+			while l > pos and seq1[i0 + l - 1] == seq2[j0 + l - 1]:
+				l -= 1
+			while r < n and seq1[i0 + r] == seq2[j0 + r]:
+				r += 1
+			pos = r + 1
+			if r - l >= min_len:
+				yield i0 + l, j0 + l, r - l
@@ -1,9 +1,11 @@
 # -*- coding: utf-8 -*-
 
 from array import array
+from ._fold import _fold_pair
+from ._dna import _packed_pair
 
 
-def levenshtein(seq1, seq2, normalized=False, max_dist=-1):
+def levenshtein(seq1, seq2, normalized=False, max_dist=-1, fold="none", workers=1):
 	"""Compute the absolute Levenshtein distance between the two sequences
 	`seq1` and `seq2`.
 	
@@ -32,7 +34,36 @@ def levenshtein(seq1, seq2, normalized=False, max_dist=-1):
 	The `normalized` parameter is here for backward compatibility; providing
 	it will result in a call to `nlevenshtein`, which should be used directly
 	instead. 
+	
+	Strings can be compared regardless of their case with `fold`:
+	
+		"none": the items are compared as they are (the default)
+		"ascii": the ASCII letters are lowercased
+		"simple": the simple case folding of Unicode, which maps every
+		character to a single one, e.g. "Σ" and "ς" to "σ", but leaves "ß"
+		as it is
+	
+		>>> levenshtein("Straße", "STRASSE", fold="simple")
+		2
+	
+	Byte strings are only folded as ASCII, as their encoding is unknown; other
+	sequences can't be folded. The strings are folded before being compared,
+	into a copy which is only made if some character changes.
+	
+	In the C implementation, two long strings can be compared by several
+	threads, without holding the GIL, with `workers`: the number of threads,
+	0 meaning one per CPU. The matrix of the computation is then cut into
+	tiles, which are computed along its anti-diagonals. Strings of less than
+	a few thousand characters are compared in the calling thread, as are
+	near-identical strings. This parameter is accepted but ignored in the pure
+	Python implementation.
+
+	Nucleotide sequences can be compared as `PackedDNA`.
 	"""
+	pair = _packed_pair(seq1, seq2)
+	if pair is not None:
+		seq1, seq2 = str(pair[0]), str(pair[1])
+	seq1, seq2 = _fold_pair(seq1, seq2, fold)
 	if normalized:
 		return nlevenshtein(seq1, seq2, method=1)
 		
@@ -69,7 +100,7 @@ def levenshtein(seq1, seq2, normalized=False, max_dist=-1):
 	return column[len2]
 
 
-def nlevenshtein(seq1, seq2, method=1):
+def nlevenshtein(seq1, seq2, method=1, fold="none"):
 	"""Compute the normalized Levenshtein distance between `seq1` and `seq2`.
 	
 	Two normalization methods are provided. For both of them, the normalized
@@ -95,7 +126,10 @@ def nlevenshtein(seq1, seq2, method=1):
 	Heeringa, "Measuring Dialect Pronunciation Differences using Levenshtein
 	Distance", 2004, p. 130 sq, which is available online at:
 	http://www.let.rug.nl/~heeringa/dialectology/thesis/thesis.pdf
+
+	`fold` has the same sense as in `levenshtein`.
 	"""
+	seq1, seq2 = _fold_pair(seq1, seq2, fold)
 	
 	if seq1 == seq2:
 		return 0.0
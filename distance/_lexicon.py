@@ -0,0 +1,164 @@
+# -*- coding: utf-8 -*-
+
+import mmap, struct
+
+from ._levenshtein import levenshtein
+from ._simpledists import hamming
+from ._fastcomp import fast_comp
+from ._pattern import _query
+
+# Layout of a lexicon file, all integers being little-endian:
+#
+#	header		magic, version, width of the items (1, 2 or 4 bytes),
+#				number of words, length of the longest word
+#	offsets		uint64 * (count + 1): start of each word in `data`, in items
+#	lengths		uint64 * (max_len + 2): index of the first word of each length
+#	data		the words, as UCS1, UCS2 or UCS4 strings
+#
+# The words are sorted by length, so that a scan only needs to look at the
+# words which length is compatible with the query.
+
+MAGIC = b"DISTLEX\0"
+VERSION = 1
+HEADER = struct.Struct("<8sIIQQ")
+
+_codecs = {1: "latin-1", 2: "utf-16-le", 4: "utf-32-le"}
+_metrics = ("levenshtein", "hamming", "fast_comp")
+
+
+def write_lexicon(path, words):
+	"""Write the strings `words` to a lexicon file, to be opened with
+	`Lexicon.open`.
+
+	The words are stored sorted by length, the words of the same length
+	keeping their relative order. Each character is stored on 1, 2 or 4 bytes,
+	depending on the widest character of the whole lexicon.
+	"""
+	words = sorted(words, key=len)
+	max_char = max([max(map(ord, w)) for w in words if w] or [0])
+	width = 1 if max_char < 0x100 else 2 if max_char < 0x10000 else 4
+	max_len = len(words[-1]) if words else 0
+
+	offsets, lengths = [0], []
+	for i, w in enumerate(words):
+		offsets.append(offsets[-1] + len(w))
+		while len(lengths) <= len(w):
+			lengths.append(i)
+	while len(lengths) < max_len + 2:
+		lengths.append(len(words))
+
+	with open(path, "wb") as f:
+		f.write(HEADER.pack(MAGIC, VERSION, width, len(words), max_len))
+		f.write(struct.pack("<%dQ" % len(offsets), *offsets))
+		f.write(struct.pack("<%dQ" % len(lengths), *lengths))
+		for w in words:
+			f.write(w.encode(_codecs[width], "surrogatepass"))
+
+
+class Lexicon(object):
+	"""A read-only list of strings, stored in a file written by `write_lexicon`.
+
+	The file is memory-mapped rather than read: opening a lexicon is fast
+	whatever its size, and processes opening the same file share its memory.
+	In the C implementation, the words are compared without creating Python
+	objects for them.
+
+	Lexicons support `len()`, indexing, and can be used as context managers,
+	which close them on exit.
+	"""
+
+	def __init__(self, path):
+		with open(path, "rb") as f:
+			self._map = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+		try:
+			self._parse()
+		except:
+			self._map.close()
+			raise
+
+	def _parse(self):
+		size = len(self._map)
+		if size < HEADER.size:
+			raise ValueError("invalid lexicon file")
+		magic, version, width, count, max_len = HEADER.unpack_from(self._map)
+		if magic != MAGIC or version != VERSION or width not in _codecs:
+			raise ValueError("invalid lexicon file")
+		start = HEADER.size + 8 * (count + 1) + 8 * (max_len + 2)
+		if start > size:
+			raise ValueError("invalid lexicon file")
+		self._width, self._count, self._max_len = width, count, max_len
+		self._offsets = struct.unpack_from("<%dQ" % (count + 1), self._map, HEADER.size)
+		self._lengths = struct.unpack_from("<%dQ" % (max_len + 2), self._map,
+			HEADER.size + 8 * (count + 1))
+		self._data = start
+		if start + self._offsets[-1] * width > size:
+			raise ValueError("invalid lexicon file")
+
+	@classmethod
+	def open(cls, path):
+		"""Open the lexicon stored in the file `path`.
+		"""
+		return cls(path)
+
+	def close(self):
+		"""Unmap the file. The lexicon can't be used anymore afterwards.
+		"""
+		self._map.close()
+
+	def __enter__(self):
+		return self
+
+	def __exit__(self, *exc):
+		self.close()
+
+	def __len__(self):
+		return self._count
+
+	def __getitem__(self, i):
+		if i < 0:
+			i += self._count
+		if not 0 <= i < self._count:
+			raise IndexError("lexicon index out of range")
+		start = self._data + self._offsets[i] * self._width
+		end = self._data + self._offsets[i + 1] * self._width
+		return self._map[start:end].decode(_codecs[self._width], "surrogatepass")
+
+	def scan(self, query, metric="levenshtein", max_dist=-1):
+		"""Compare the string `query` with the words of the lexicon, and return
+		the list of pairs (distance, word) for the words which distance is lower
+		or equal to `max_dist`, or for all the words if `max_dist` is negative.
+
+			`metric`: "levenshtein", "hamming" (only the words of the same length
+			as the query are compared) or "fast_comp" (only the words at distance
+			2 or less are returned)
+
+		The pairs are returned in the order of the lexicon, i.e. by increasing
+		length of the words. Only the words which length is compatible with
+		`max_dist` are compared.
+		"""
+		query = _query(query)
+		if metric not in _metrics:
+			raise ValueError("expected one of %s for `metric`" % ", ".join(_metrics))
+		lo, hi = 0, self._max_len
+		if metric == "hamming":
+			lo = hi = len(query)
+		elif metric == "fast_comp":
+			lo, hi = len(query) - 2, len(query) + 2
+		elif max_dist >= 0:
+			lo, hi = len(query) - max_dist, len(query) + max_dist
+		lo, hi = max(lo, 0), min(hi, self._max_len)
+
+		hits = []
+		if lo > hi:
+			return hits
+		for i in range(self._lengths[lo], self._lengths[hi + 1]):
+			word = self[i]
+			if metric == "levenshtein":
+				dist = levenshtein(query, word, max_dist=max_dist)
+			elif metric == "hamming":
+				dist = hamming(query, word)
+			else:
+				dist = fast_comp(query, word)
+			if dist != -1 and (max_dist < 0 or dist <= max_dist):
+				hits.append((dist, word))
+		return hits
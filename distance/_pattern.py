@@ -0,0 +1,83 @@
+# -*- coding: utf-8 -*-
+
+from collections import Counter
+
+_metrics = ("levenshtein", "lcs_length", "indel_distance", "qgrams")
+
+
+def _match_vectors(seq):
+	# positions of each item in `seq`, as the bits of a Python integer
+	peq = {}
+	for j, item in enumerate(seq):
+		peq[item] = peq.get(item, 0) | (1 << j)
+	return peq
+
+
+class Pattern(object):
+	"""A query compiled for being compared with many sequences, as returned by
+	`compile_query`.
+
+		`seq`: the query
+		`metrics`: names of the metrics to prepare the query for, among
+		"levenshtein", "lcs_length", "indel_distance" and "qgrams"; all of them
+		by default
+		`q`: length of the q-grams of the profile, between 1 and 8
+
+	The functions of the module which compare two sequences, the iterators,
+	and the searches of lexicons, candidate sets and tries accept a pattern in
+	place of their first sequence. In the C implementation, the match vectors
+	of the bit-parallel kernels of `levenshtein` (for queries of at most 64
+	items), `lcs_length` and `indel_distance` are then computed once rather
+	than for each comparison, and `CandidateSet.search` reuses the q-gram
+	profile of the query if it was built with the `q` of the set. These only
+	apply to strings compared with strings of the same type, and to arrays of
+	integers (see `Vocabulary`); other sequences are compared as usual.
+
+	Patterns can be pickled, e.g. for being sent to other processes. Lists
+	are stored as tuples, and arrays are copied, so that the query can't
+	change after it is compiled.
+	"""
+
+	def __init__(self, seq, metrics=None, q=2):
+		if not 1 <= q <= 8:
+			raise ValueError("expected a value between 1 and 8 for `q`")
+		if isinstance(seq, Pattern):
+			raise ValueError("the query is compiled already")
+		metrics = _metrics if metrics is None else tuple(metrics)
+		for name in metrics:
+			if name not in _metrics:
+				raise ValueError("unknown metric: %r" % (name,))
+		if isinstance(seq, list):
+			seq = tuple(seq)
+		elif hasattr(seq, "typecode"):
+			seq = seq[:]
+		self.seq, self.metrics, self.q = seq, metrics, q
+		# only `lcs_length` and `indel_distance` use them here
+		self._peq = self._profile = None
+		if "lcs_length" in metrics or "indel_distance" in metrics:
+			try:
+				self._peq = _match_vectors(seq)
+			except TypeError:
+				pass
+		if "qgrams" in metrics and isinstance(seq, (type(u""), bytes)):
+			self._profile = Counter(seq[i:i + q] for i in range(len(seq) - q + 1))
+
+	def __len__(self):
+		return len(self.seq)
+
+
+def compile_query(seq, metrics=None, q=2):
+	"""Return a `Pattern` for comparing `seq` with many sequences, with the
+	structures the metrics in `metrics` need computed once.
+
+		>>> query = compile_query("kitten", metrics=["levenshtein"])
+		>>> [levenshtein(query, word) for word in ("sitting", "mitten")]
+		[3, 1]
+
+	See `Pattern` for the parameters.
+	"""
+	return Pattern(seq, metrics, q)
+
+
+def _query(seq):
+	return seq.seq if isinstance(seq, Pattern) else seq
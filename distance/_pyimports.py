@@ -1,5 +1,21 @@
 from ._fastcomp import *
+from ._jaro import *
 from ._lcsubstrings import *
 from ._levenshtein import *
 from ._simpledists import *
+from ._lcs import *
 from ._iterators import *
+from ._stats import *
+from ._lexicon import *
+from ._candidates import *
+from ._trie import *
+from ._vocabulary import *
+from ._pattern import *
+from ._qgrams import *
+from ._approx import *
+from ._grep import *
+from ._setjoin import *
+from ._setindex import *
+from ._dna import *
+from ._barcodes import *
+from ._dawg import *
@@ -0,0 +1,119 @@
+# -*- coding: utf-8 -*-
+
+from collections import Counter
+from math import sqrt
+
+from ._pattern import _query
+
+_default_q = 3
+
+
+def _items(seq):
+	# the type of `seq` and its items, for strings and arrays of integers
+	seq = _query(seq)
+	if isinstance(seq, type(u"")):
+		return "u", seq
+	if isinstance(seq, bytes):
+		return "b", seq
+	try:
+		view = memoryview(seq)
+	except TypeError:
+		view = None
+	if view is None or view.ndim != 1 or view.format.lstrip("@=") not in ("B", "H", "I", "L"):
+		raise ValueError("expected a string or an array of integers (see Vocabulary)")
+	return "i", tuple(view.tolist())
+
+
+def _check_q(q):
+	if q is not None and q < 1:
+		raise ValueError("expected a positive `q`")
+
+
+class QGramProfile(object):
+	"""The profile of the q-grams (substrings of `q` items) of a sequence, for
+	being compared with `qgram_distance`, `cosine` and `overlap` without
+	extracting its q-grams again.
+
+		`seq`: a string, or an array of integers (see `Vocabulary`)
+		`q`: length of the q-grams, 3 by default
+
+	Profiles support `len()`, which is the number of q-grams of the sequence,
+	`len(seq) - q + 1`.
+
+	In the C implementation, a profile is the sorted array of the hashes of
+	the distinct q-grams, with their counts, and is compared with another one
+	by merging them. The hashes have 64 bits, which makes collisions
+	negligible.
+	"""
+
+	def __init__(self, seq, q=None):
+		_check_q(q)
+		self.q = _default_q if q is None else q
+		self._type, items = _items(seq)
+		self._len = max(len(items) - self.q + 1, 0)
+		self._counts = Counter(items[i:i + self.q] for i in range(self._len))
+		self._squares = sum(c * c for c in self._counts.values())
+
+	def __len__(self):
+		return self._len
+
+
+def _profiles(seq1, seq2, q):
+	_check_q(q)
+	if q is None:
+		q = next((seq.q for seq in (seq1, seq2) if isinstance(seq, QGramProfile)), _default_q)
+	p1, p2 = [seq if isinstance(seq, QGramProfile) else QGramProfile(seq, q) for seq in (seq1, seq2)]
+	if p1._type != p2._type:
+		raise ValueError("expected two sequences of the same type")
+	if p1.q != p2.q:
+		raise ValueError("expected profiles with the same `q`")
+	return p1, p2
+
+
+def qgram_distance(seq1, seq2, q=None):
+	"""Compute the q-gram distance between the sequences `seq1` and `seq2`,
+	i.e. the number of q-grams (substrings of `q` items) which appear in only
+	one of them, counting repeated q-grams as many times as they appear:
+
+		>>> qgram_distance("abcd", "abce", q=2)
+		2
+
+	The sequences are strings of the same type, or arrays of integers, and
+	either of them can be a `QGramProfile`. `q` applies to the sequences which
+	are not profiles; it defaults to the `q` of the other sequence if it is a
+	profile, and to 3 otherwise. The same holds true for `cosine` and
+	`overlap`.
+	"""
+	p1, p2 = _profiles(seq1, seq2, q)
+	return len(p1) + len(p2) - 2 * sum((p1._counts & p2._counts).values())
+
+
+def cosine(seq1, seq2, q=None):
+	"""Compute the cosine distance between the q-gram profiles of the
+	sequences `seq1` and `seq2`, i.e. 1 minus the cosine of the angle of the
+	vectors of the counts of their q-grams.
+
+	The return value is a float between 0 and 1, where 0 means equal q-grams
+	in the same proportions, and 1 no q-gram in common. It is 0.0 if both
+	sequences are shorter than `q`, and 1.0 if only one of them is.
+	"""
+	p1, p2 = _profiles(seq1, seq2, q)
+	if not len(p1) or not len(p2):
+		return 0.0 if len(p1) == len(p2) else 1.0
+	dot = sum(c * p2._counts[gram] for gram, c in p1._counts.items() if gram in p2._counts)
+	return max(1.0 - dot / sqrt(float(p1._squares) * p2._squares), 0.0)
+
+
+def overlap(seq1, seq2, q=None):
+	"""Compute the overlap distance between the q-gram profiles of the
+	sequences `seq1` and `seq2`, i.e. 1 minus the number of q-grams they have
+	in common divided by the number of q-grams of the shortest one.
+
+	The return value is a float between 0 and 1, where 0 means that the
+	q-grams of one of the sequences all appear in the other one. It is 0.0 if
+	both sequences are shorter than `q`, and 1.0 if only one of them is.
+	"""
+	p1, p2 = _profiles(seq1, seq2, q)
+	if not len(p1) or not len(p2):
+		return 0.0 if len(p1) == len(p2) else 1.0
+	return 1.0 - sum((p1._counts & p2._counts).values()) / float(min(len(p1), len(p2)))
@@ -0,0 +1,87 @@
+# -*- coding: utf-8 -*-
+
+from ._simpledists import jaccard, sorensen
+from ._pattern import _query
+
+
+_set_metrics = {"jaccard": jaccard, "sorensen": sorensen}
+
+# similarity of two sets, from the number of their tokens and of those they
+# share; `min_sim` is compared with it rather than with 1 minus the distance,
+# which may be slightly lower
+_set_sims = {
+	"jaccard": lambda common, n1, n2: common / float(n1 + n2 - common),
+	"sorensen": lambda common, n1, n2: 2 * common / float(n1 + n2),
+}
+
+
+class SetIndex(object):
+	"""An index of sets of tokens, searched for the sets most similar to a
+	query set, as measured by `jaccard` or `sorensen`, without comparing it
+	with all of them.
+
+		`sets`: iterables of hashable tokens, e.g. sets, lists, or strings,
+		which are then sets of characters
+
+	The sets are numbered from 0, in the order in which they are added. Set
+	indexes support `len()`.
+
+	In the C implementation, the tokens are mapped to integer ids, and each
+	token has the list of the sets it belongs to, stored as the differences
+	between successive indexes in a variable number of bytes; the tokens of
+	each set are stored the same way. A query reads the lists of its rarest
+	tokens first, computes the distance of each set met for the first time,
+	and stops as soon as the sets not met yet can't be closer than the `k`
+	found so far. The sets whose size can't give a distance low enough are
+	skipped.
+	"""
+
+	def __init__(self, sets=()):
+		self._sets, self._postings = [], {}
+		for s in sets:
+			self.add(s)
+
+	def add(self, s):
+		"""Add the set of the tokens of `s` to the index.
+		"""
+		s = set(_query(s))
+		for token in s:
+			self._postings.setdefault(token, []).append(len(self._sets))
+		self._sets.append(s)
+
+	def __len__(self):
+		return len(self._sets)
+
+	def topk(self, query, k, metric="jaccard", min_sim=0.0):
+		"""Return the `k` sets of the index closest to the set of the tokens of
+		`query`, as a list of pairs (distance, index) sorted by distance, then
+		by index:
+
+			>>> index = SetIndex([{"a", "b", "c"}, {"a", "b"}, {"x", "y"}])
+			>>> index.topk({"a", "b", "d"}, 2)
+			[(0.33333333333333337, 1), (0.5, 0)]
+
+			`metric`: "jaccard" or "sorensen"; the distances are those
+			computed by the function of this name
+			`min_sim`: lowest similarity of the sets returned, 1 minus their
+			distance, between 0 and 1
+
+		The sets which share no token with the query are never returned, so
+		that fewer than `k` sets may be.
+		"""
+		if metric not in _set_metrics:
+			raise ValueError("expected one of jaccard, sorensen for `metric`")
+		if k < 0:
+			raise ValueError("expected a positive `k`, or 0")
+		if not 0 <= min_sim <= 1:
+			raise ValueError("expected a value between 0 and 1 for `min_sim`")
+		query, func, sim = set(_query(query)), _set_metrics[metric], _set_sims[metric]
+		candidates = set()
+		for token in query:
+			candidates.update(self._postings.get(token, ()))
+		hits = []
+		for i in candidates:
+			s = self._sets[i]
+			if sim(len(query & s), len(query), len(s)) >= min_sim:
+				hits.append((func(query, s), i))
+		return sorted(hits)[:k]
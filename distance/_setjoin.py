@@ -0,0 +1,75 @@
+# -*- coding: utf-8 -*-
+
+from array import array
+from math import ceil
+
+from ._simpledists import jaccard
+
+
+def jaccard_join(sets, threshold, others=None, workers=1):
+	"""Find the pairs of sets of `sets` at Jaccard distance `threshold` or
+	less, and return them as three arrays of the same length: the index of
+	the first set of each pair, the index of the second one, and their
+	distance, as computed by `jaccard`:
+
+		>>> jaccard_join([{1, 2, 3}, {"a"}, {1, 2, 3, 4}], 0.3)
+		(array('q', [0]), array('q', [2]), array('d', [0.25]))
+
+		`sets`: a sequence of iterables of hashable tokens, e.g. sets, lists,
+		or strings, which are then sets of characters
+		`threshold`: highest distance of the pairs, 0 <= threshold < 1
+		`others`: if given, another sequence of sets, which the sets of `sets`
+		are compared with instead of with each other
+		`workers`: number of threads; 0 means one per CPU
+
+	Without `others`, each pair is found once, the first index being lower
+	than the second one; with it, the first index is that of a set of
+	`sets`, and the second one that of a set of `others`. The pairs are sorted
+	by index. Empty sets are never part of a pair.
+
+	The sets are compared only if they share one of their rarest tokens, and
+	have sizes and rare tokens in common enough for being close, which makes
+	the join much faster than comparing all the pairs when the threshold is
+	low. In the C implementation, the tokens are interned, and the sets
+	compared by `workers` threads without holding the GIL; arrays of
+	integers, such as those returned by `Vocabulary.encode`, are taken as
+	token ids without being hashed. `workers` is ignored in the pure Python
+	implementation.
+	"""
+	if not 0 <= threshold < 1:
+		raise ValueError("expected a threshold between 0 and 1, 1 excluded")
+	if workers < 0:
+		raise ValueError("expected a positive number of workers, or 0")
+	left = [set(s) for s in sets]
+	right = left if others is None else [set(s) for s in others]
+	sim = 1 - threshold
+
+	# the tokens are ordered by increasing number of sets
+	freqs = {}
+	for s in (left if others is None else left + right):
+		for token in s:
+			freqs[token] = freqs.get(token, 0) + 1
+	ranks = dict((token, k) for k, token in enumerate(sorted(freqs, key=freqs.get)))
+	def ordered(s):
+		return sorted(s, key=ranks.get)
+
+	index = {}
+	for j, s in enumerate(right):
+		for token in ordered(s)[:len(s) - int(ceil(sim * len(s) - 1e-9)) + 1]:
+			index.setdefault(token, []).append(j)
+
+	pairs = set()
+	for i, s in enumerate(left):
+		candidates = set()
+		for token in ordered(s)[:len(s) - int(ceil(sim * len(s) - 1e-9)) + 1]:
+			candidates.update(index.get(token, ()))
+		for j in candidates:
+			if others is None and j <= i:
+				continue
+			dist = jaccard(s, right[j])
+			if dist <= threshold:
+				pairs.add((i, j, dist))
+
+	pairs = sorted(pairs)
+	return (array("q", [i for i, j, dist in pairs]), array("q", [j for i, j, dist in pairs]),
+		array("d", [dist for i, j, dist in pairs]))
@@ -1,6 +1,10 @@
 # -*- coding: utf-8 -*-
 
-def hamming(seq1, seq2, normalized=False):
+from ._pattern import _query
+from ._fold import _fold_pair
+from ._dna import _packed_pair, _packed_hamming
+
+def hamming(seq1, seq2, normalized=False, fold="none"):
 	"""Compute the Hamming distance between the two sequences `seq1` and `seq2`.
 	The Hamming distance is the number of differing items in two ordered
 	sequences of the same length. If the sequences submitted do not have the
@@ -13,13 +17,21 @@ def hamming(seq1, seq2, normalized=False):
 	
 		0.0                         if len(seq1) == 0
 		hamming_dist / len(seq1)    otherwise
+
+	`fold` has the same sense as in `levenshtein`. Nucleotide sequences
+	can be compared as `PackedDNA`.
 	"""
-	L = len(seq1)
-	if L != len(seq2):
-		raise ValueError("expected two strings of the same length")
+	pair = _packed_pair(seq1, seq2)
+	if pair is not None:
+		L, dist = len(pair[0]), _packed_hamming(*pair)
+	else:
+		seq1, seq2 = _fold_pair(seq1, seq2, fold)
+		L = len(seq1)
+		if L != len(seq2):
+			raise ValueError("expected two strings of the same length")
+		dist = sum(c1 != c2 for c1, c2 in zip(seq1, seq2))
 	if L == 0:
 		return 0.0 if normalized else 0  # equal
-	dist = sum(c1 != c2 for c1, c2 in zip(seq1, seq2))
 	if normalized:
 		return dist / float(L)
 	return dist
@@ -30,6 +42,7 @@ def jaccard(seq1, seq2):
 	
 	The return value is a float between 0 and 1, where 0 means equal, and 1 totally different.
 	"""
+	seq1 = _query(seq1)
 	set1, set2 = set(seq1), set(seq2)
 	return 1 - len(set1 & set2) / float(len(set1 | set2))
 
@@ -40,5 +53,6 @@ def sorensen(seq1, seq2):
 	
 	The return value is a float between 0 and 1, where 0 means equal, and 1 totally different.
 	"""
+	seq1 = _query(seq1)
 	set1, set2 = set(seq1), set(seq2)
 	return 1 - (2 * len(set1 & set2) / float(len(set1) + len(set2)))
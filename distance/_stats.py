@@ -0,0 +1,57 @@
+# -*- coding: utf-8 -*-
+
+def stats():
+	"""Return the counters collected by the C kernels since the module was
+	loaded, or since the last call to `reset_stats`.
+	
+	The return value is a dictionary mapping the name of each kernel
+	("levenshtein", "fast_comp", "jaro"...) to a dictionary with the keys:
+	
+		`calls`: number of calls
+		`cells`: number of dynamic programming cells (or items) evaluated
+		`early_exits`: number of calls which stopped early, by reason:
+		"length" when the lengths alone exceed the limit, "bound" when the
+		limit is exceeded during the computation
+		`bytes_allocated`: total size of the memory allocated
+		`paths`: number of calls per item type, algorithm and instruction set
+		level the kernel was compiled for (see `cpu_features`), e.g.
+		"u8/bitpar/avx2"
+		`latency_ns`: durations of a sample of the calls (one in 64), as a
+		dictionary mapping upper bounds in nanoseconds to numbers of calls
+	
+	Kernels which were never called are omitted. Counters are kept per thread,
+	and summed when this function is called.
+	
+	The counters are only collected if the C extension was built with
+	`--with-stats`; otherwise, and with the pure Python implementation, an
+	empty dictionary is returned.
+	"""
+	return {}
+
+def reset_stats():
+	"""Reset the counters returned by `stats` to zero.
+	"""
+
+
+def cpu_features():
+	"""Return the instruction sets the C kernels can use on this machine, as a
+	dictionary with the keys:
+	
+		`isa`: the level the kernels are running at: "baseline", "sse4.2" or
+		"avx2"
+		`supported`: the levels available, from the lowest
+		`features`: a dictionary mapping the relevant features of the CPU
+		("popcnt", "sse4.2", "avx2", "bmi2", "avx512f") to booleans
+	
+	The kernels are compiled for each level, and the highest one supported by
+	the CPU is selected once, when the module is loaded. The environment
+	variable DISTANCE_ISA can name a lower level, e.g. for comparing them in
+	benchmarks:
+	
+		$ DISTANCE_ISA=baseline python bench/bench.py run
+	
+	Only builds made with GCC for x86 have levels above the baseline; the
+	features are then unknown, and reported as false. With the pure Python
+	implementation, `isa` is None and `supported` is empty.
+	"""
+	return {"isa": None, "supported": [], "features": {}}
@@ -0,0 +1,80 @@
+# -*- coding: utf-8 -*-
+
+from ._pattern import _query
+
+
+class Trie(object):
+	"""A set of strings stored as a prefix tree, to be searched for the ones
+	close to a query with the Levenshtein distance.
+
+		`seqs`: the strings, either unicode or byte strings
+
+	The search walks the tree keeping a row of the Levenshtein matrix for each
+	depth: the prefixes shared by several strings are compared with the query
+	only once, and the subtrees in which no string can be close enough to the
+	query are skipped. This makes looking up a word in a large vocabulary
+	cheaper than comparing it with each word, as `ilevenshtein` does.
+
+	A string present several times is only returned once. Tries support
+	`len()` and indexing, which give the strings as they were passed.
+	"""
+
+	def __init__(self, seqs):
+		self._seqs = list(seqs)
+		self._type = None
+		for seq in self._seqs:
+			self._check(seq)
+			self._type = type(seq)
+		# the distinct strings, in order, each with its first index
+		first = {}
+		for i, seq in enumerate(self._seqs):
+			first.setdefault(seq, i)
+		self._words = sorted(first.items())
+
+	def _check(self, seq):
+		if not isinstance(seq, (type(u""), bytes)):
+			raise ValueError("expected unicode or byte strings")
+		if self._type is not None and not isinstance(seq, self._type):
+			raise ValueError("type mismatch between the strings of the trie")
+
+	def __len__(self):
+		return len(self._seqs)
+
+	def __getitem__(self, i):
+		return self._seqs[i]
+
+	def search(self, query, max_dist=-1):
+		"""Return the list of pairs (distance, string) for the strings of the trie
+		which Levenshtein distance from `query` is lower or equal to `max_dist`,
+		or for all the strings if `max_dist` is negative.
+
+		The pairs are returned in the lexicographic order of the strings.
+		"""
+		query = _query(query)
+		self._check(query)
+		rows = [list(range(len(query) + 1))]
+		prev, pruned, hits = None, None, []
+		for word, i in self._words:
+			# the rows of the prefix shared with the previous word are kept
+			common = 0
+			if prev is not None:
+				n = min(len(prev), len(word))
+				while common < n and prev[common] == word[common]:
+					common += 1
+			prev = word
+			if pruned is not None and common >= pruned:
+				continue
+			pruned = None
+			del rows[common + 1:]
+			for d in range(common + 1, len(word) + 1):
+				above, row = rows[-1], [d]
+				for j in range(1, len(query) + 1):
+					cost = above[j - 1] + (query[j - 1:j] != word[d - 1:d])
+					row.append(min(cost, above[j] + 1, row[j - 1] + 1))
+				rows.append(row)
+				if max_dist >= 0 and min(row) > max_dist:
+					pruned = d
+					break
+			if pruned is None and (max_dist < 0 or rows[-1][-1] <= max_dist):
+				hits.append((rows[-1][-1], self._seqs[i]))
+		return hits
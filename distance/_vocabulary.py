@@ -0,0 +1,69 @@
+# -*- coding: utf-8 -*-
+
+from array import array
+
+
+class Vocabulary(object):
+	"""A mapping of hashable tokens to dense integer ids, to encode sequences
+	of tokens, e.g. tokenized sentences, into arrays of integers.
+
+		`tokens`: tokens to give the first ids to, in order
+
+	Lists and tuples are compared item by item with the Python API, hashing
+	and comparing the same tokens again on every call. Arrays of unsigned
+	integers are compared like strings instead, without touching Python
+	objects, so that encoding a corpus once makes every later comparison much
+	cheaper. The distance functions and the iterators accept the encoded
+	arrays; two sequences must be encoded with the same vocabulary to be
+	compared.
+
+	Vocabularies support `len()`, `in` and indexing, which gives the token of
+	an id.
+	"""
+
+	def __init__(self, tokens=()):
+		self._ids, self._tokens = {}, []
+		for token in tokens:
+			self._id(token, True)
+
+	def _id(self, token, add):
+		i = self._ids.get(token)
+		if i is None:
+			if not add:
+				raise KeyError(token)
+			if len(self._tokens) == 0xffffffff:
+				raise OverflowError("too many tokens in the vocabulary")
+			i = self._ids[token] = len(self._tokens)
+			self._tokens.append(token)
+		return i
+
+	def __len__(self):
+		return len(self._tokens)
+
+	def __contains__(self, token):
+		return token in self._ids
+
+	def __getitem__(self, i):
+		return self._tokens[i]
+
+	def encode(self, seq, add=True):
+		"""Return the ids of the tokens of `seq` as an array of unsigned integers.
+		The tokens not in the vocabulary yet are given new ids, unless `add` is
+		false, in which case a `KeyError` is raised for them.
+
+		The array is of type "B", "H" or "I", the smallest that can hold the ids
+		of all the tokens of the vocabulary.
+		"""
+		ids = [self._id(token, add) for token in seq]
+		n = len(self._tokens)
+		return array("B" if n <= 0x100 else "H" if n <= 0x10000 else "I", ids)
+
+	def decode(self, ids):
+		"""Return the list of the tokens which ids are in `ids`.
+		"""
+		rv = []
+		for i in ids:
+			if not 0 <= i < len(self._tokens):
+				raise IndexError("no such id in the vocabulary")
+			rv.append(self._tokens[i])
+		return rv
@@ -24,24 +24,6 @@ this_dir = os.path.dirname(os.path.abspath(__file__))
 pkg_dir  = os.path.join(this_dir, "distance")
 cpkg_dir  = os.path.join(this_dir, "cdistance")
 
-ctypes = ["unicode", "byte", "array"]
-
-cfunctions = {
-	"levenshtein": ["levenshtein", "nlevenshtein"],
-	"hamming": ["hamming"],
-	"lcsubstrings": ["lcsubstrings"],
-	"fastcomp": ["fastcomp"],
-}
-
-sequence_compare = """\
-#define SEQUENCE_COMPARE(s1, i1, s2, i2) \\
-(PyObject_RichCompareBool( \\
-	PySequence_Fast_GET_ITEM((s1), (i1)), \\
-	PySequence_Fast_GET_ITEM((s2), (i2)), \\
-	Py_EQ) \\
-)
-"""
-
 def make_c_doc():
 	buff = []
 	py_sources = [f for f in os.listdir(pkg_dir) if f.endswith('.py')]
@@ -55,45 +37,37 @@ def make_c_doc():
 	return join_str.join(buff) + '\n'
 
 
-def parse_tree(tree, content):
+def parse_tree(tree, content, prefix=""):
 	for node in ast.iter_child_nodes(tree):
+		if isinstance(node, _ast.ClassDef):
+			# methods are documented as `Class_method_doc`, and the class itself
+			# with the signature of its constructor
+			for doc_string in parse_tree(node, content, node.name + "_"):
+				yield doc_string
+			continue
 		if not isinstance(node, _ast.FunctionDef):
 			continue
+		name, label = prefix + node.name, node.name
 		doc_string = ast.get_docstring(node)
+		if prefix and node.name == "__init__":
+			name = label = tree.name
+			doc_string = ast.get_docstring(tree)
 		if not doc_string:
 			continue
-		func_def = re.findall("def\s%s\s*(.+?)\s*:" % node.name, content)
+		func_def = re.findall("def\s%s\s*(\(.+?)\s*:" % node.name, content)
 		assert func_def and len(func_def) == 1
-		func_def = node.name + func_def[0] + 2 * '\\n\\\n'
+		func_def = re.sub(r"^\((self|cls)(, )?", "(", func_def[0])
+		func_def = label + func_def.replace('"', '\\"') + 2 * '\\n\\\n'
+		doc_string = doc_string.rstrip().replace('\\', '\\\\')
 		doc_string = doc_string.replace('\n', '\\n\\\n').replace('"', '\\"')
 		doc_string = doc_string.replace('\n' + 8 * ' ', '\n' + 4 * ' ')
-		doc_string = '#define %s_doc \\\n"%s%s"\n' % (node.name, func_def, doc_string)
+		doc_string = '#define %s_doc \\\n"%s%s"\n' % (name, func_def, doc_string)
 		yield doc_string
 
 
-def format_header():
-	yield sequence_compare
-	for cfile, cfuncs in cfunctions.items():
-		for ctype in ctypes:
-			if ctype == "array":
-				yield("#define SEQUENCE_COMP SEQUENCE_COMPARE")
-			yield('#define unicode %(type)s' % dict(type=ctype))
-			for cfunc in cfuncs:
-				yield("#define %(function)s %(tcode)s%(function)s" % dict(function=cfunc, tcode=ctype[0]))
-			yield('#include "%(file)s.c"' % dict(file=cfile))
-			yield("#undef unicode")
-			for cfunc in cfuncs:
-				yield("#undef %(function)s" % dict(function=cfunc))
-			if ctype == "array":
-				yield("#undef SEQUENCE_COMP")
-			yield("")
-
-
 def prepare():
 	with open(os.path.join(cpkg_dir, "includes.h"), "w") as f:
 		f.write(make_c_doc())
-		f.write(4 * '\n')
-		f.write('\n'.join(format_header()))
 
 
 args = sys.argv[1:]
@@ -101,9 +75,23 @@ if "prepare" in args:
 	prepare()
 	sys.exit()
 
+# `--with-stats` compiles the instrumentation of the kernels in, see
+# `distance.stats()`.
+macros = []
+if "--with-stats" in args:
+	args.remove("--with-stats")
+	macros.append(("DISTANCE_STATS", None))
+
 if "--with-c" in args:
 	args.remove("--with-c")
-	ext_modules = [Extension('distance.cdistance', sources=["cdistance/distance.c"])]
+	ext_modules = [Extension('distance.cdistance',
+		sources=["cdistance/distance.c", "cdistance/libdistance.c", "cdistance/stats.c",
+			"cdistance/pool.c", "cdistance/lexicon.c", "cdistance/candidates.c",
+			"cdistance/trie.c", "cdistance/pattern.c", "cdistance/qgrams.c",
+			"cdistance/mapping.c", "cdistance/grep.c", "cdistance/fold.c",
+			"cdistance/cpu.c", "cdistance/wavefront.c", "cdistance/setjoin.c",
+			"cdistance/setindex.c", "cdistance/dna.c", "cdistance/dawg.c"],
+		define_macros=macros)]
 else:
 	sys.stderr.write("notice: no C support available\n")
 	ext_modules = []
@@ -1,4 +1,4 @@
-import os, sys
+import os, sys, pickle
 from array import array
 try:
 	from distance import cdistance
@@ -119,6 +119,103 @@ def levenshtein(func, t, **kwargs):
 	assert func(t("a"), t("b"), max_dist=0) == -1
 	assert func(t("a"), t("b"), max_dist=1) == 1
 	assert func(t("foo"), t("bar"), max_dist=-1) == 3
+	
+	# long sequences, on both sides of the word size
+	assert func(t("ab" * 32), t("ba" * 32)) == 2
+	assert func(t("ab" * 40), t("ba" * 40)) == 2
+	assert func(t("a" * 64), t("b" * 60), max_dist=63) == -1
+
+	# near-identical sequences, compared along the diagonals, or by dynamic
+	# programming if the distance is too high for that
+	s1 = "abcdefghij" * 50
+	s2 = s1[:100] + "x" + s1[101:300] + s1[302:] + "yz"
+	assert func(t(s1), t(s2)) == func(t(s2), t(s1)) == 5
+	assert func(t(s1), t(s2), max_dist=5) == 5
+	assert func(t(s1), t(s2), max_dist=4) == -1
+	assert func(t(s1), t(s1[::-1])) == 402
+
+	# long strings, computed by several threads in the C implementation
+	if t in (t_unicode, t_bytes) and kwargs["lang"] == "C":
+		s1 = "".join("abcd"[i * i % 7 % 4] for i in range(5000))
+		s2 = "".join("abcd"[i * i % 11 % 4] for i in range(4500))
+		assert func(t(s1), t(s2), workers=3) == func(t(s1), t(s2))
+		assert func(t(s1), t(s2), max_dist=100, workers=0) == -1
+		try:
+			func(t(s1), t(s2), workers=-1)
+			assert False
+		except ValueError: pass
+
+	# unicode strings with items of different widths
+	if t is t_unicode:
+		assert func(u"abc", u"ab\u20ac") == 1
+		assert func(u"\U0001f600bc", u"ab\u20ac") == 2
+	
+	# case folding
+	if t in (t_unicode, t_bytes):
+		assert func(t("FooBar"), t("foobaz"), fold="ascii") == 1
+		assert func(t("FooBar"), t("foobaz"), fold="none") == 3
+		assert func(t("FooBar"), t("foobar"), normalized=True, fold="ascii") == 0.0
+		# longer than the buffers used for short strings
+		assert func(t("FooBar" * 300), t("foobaz" * 300), fold="ascii") == 300
+	if t is t_unicode:
+		assert func(u"\xc9COLE", u"\xe9cole", fold="ascii") == 1
+		assert func(u"\xc9COLE", u"\xe9cole", fold="simple") == 0
+		# MICRO SIGN, folded beyond the first 256 code points
+		assert func(u"\xb5m", u"\u039cM", fold="simple") == 0
+		assert func(u"\U00010400", u"\U00010428", fold="simple") == 0
+		assert func(u"Stra\xdfe", u"STRASSE", fold="simple") == 2
+	else:
+		try:
+			func(t("a"), t("a"), fold="ascii")
+			assert t is t_bytes
+		except ValueError: pass
+	try:
+		func(t("a"), t("a"), fold="full")
+		assert False
+	except ValueError: pass
+
+
+def common_substrings(func, t, **kwargs):
+	assert list(func(t(""), t("foo"))) == list(func(t("foo"), t(""))) == []
+	assert list(func(t("sedentar"), t("dentist"), min_len=2)) == [(2, 0, 4)]
+	assert list(func(t("abcxabc"), t("abc"), min_len=3)) == [(4, 0, 3), (0, 0, 3)]
+	assert list(func(t("abab"), t("ab"))) == [(2, 0, 2), (0, 0, 2)]
+	# lazy
+	itor = func(t("ab" * 500), t("ab" * 500), min_len=100)
+	assert next(itor) == (900, 0, 100)
+	if t in (t_unicode, t_bytes):
+		# the folded strings outlive the call
+		itor = func(t("xABCx"), t("abc"), min_len=3, fold="ascii")
+		func(t("DEFG"), t("defg"), fold="ascii")
+		assert list(itor) == [(1, 0, 3)]
+	try:
+		list(func(t("foo"), t("foo"), min_len=0))
+		assert False
+	except ValueError: pass
+
+
+def lcs_length(func, t, **kwargs):
+	assert func(t(""), t("")) == func(t("abc"), t("")) == 0
+	assert func(t("abcd"), t("acbd")) == func(t("acbd"), t("abcd")) == 3
+	assert func(t("abc"), t("xyz")) == 0
+	# several 64 bits words
+	assert func(t("ab" * 100), t("ba" * 100)) == 199
+	assert func(t("abc" * 50), t("cab" * 70)) == 150
+	if t is t_unicode:
+		assert func(u"\U0001f600bc", u"ab\u20acc") == 2
+
+
+def indel_distance(func, t, **kwargs):
+	assert func(t(""), t("")) == 0
+	assert func(t("abcd"), t("acbd")) == 2
+	assert func(t("abc"), t("abxc")) == 1
+	assert func(t("ab" * 100), t("ba" * 100)) == 2
+	assert func(t("abc"), t("xyz"), max_dist=5) == -1
+	assert func(t("abc"), t("abcdef"), max_dist=2) == -1
+	assert func(t("abcd"), t("acbd"), max_dist=2) == 2
+	assert func(t(""), t(""), normalized=True) == 0.0
+	assert func(t("abcd"), t("acbd"), normalized=True) == 0.25
+	assert func(t("abc"), t("xyz"), normalized=True) == 1.0
 
 
 def nlevenshtein(func, t, **kwargs):
@@ -188,6 +285,84 @@ def lcsubstrings(func, t, **kwargs):
 		if t is not list: raise
 	assert func(t("abcdef"), t("cdba"), True) == func(t("cdba"), t("abcdef"), True)
 
+	# long strings, computed by several threads in the C implementation, with
+	# ties across tiles
+	if t in (t_unicode, t_bytes) and kwargs["lang"] == "C":
+		s1 = "abcde" * 1000 + "x" + "abcde" * 1000
+		s2 = "y" + "abcde" * 900 + "z" + "abcde" * 900
+		mlen, pos = func(t(s1), t(s2), True, workers=3)
+		assert (mlen, pos) == func(t(s1), t(s2), True)
+		assert mlen == 4500 and len(pos) == 404 and pos[-1] == (5501, 4502)
+		assert func(t(s2), t(s1), True, workers=3) == func(t(s2), t(s1), True)
+
+
+def jaro(func, t, **kwargs):
+
+	# types; only for c
+	if kwargs["lang"] == "C":
+		try:
+			func(1, t("foo"))
+		except ValueError:
+			pass
+		try:
+			func(t("foo"), 1)
+		except ValueError:
+			pass
+
+	# empty strings
+	assert func(t(""), t("")) == 1.0
+	assert func(t(""), t("abc")) == func(t("abc"), t("")) == 0.0
+
+	# common
+	assert func(t("abc"), t("abc")) == 1.0
+	assert func(t("abc"), t("xyz")) == 0.0
+	assert func(t("martha"), t("marhta")) == func(t("marhta"), t("martha")) == 0.9444444444444445
+	assert func(t("dixon"), t("dicksonx")) == 0.7666666666666666
+
+	# long sequences (no bitmask)
+	assert func(t("ab" * 40), t("ba" * 40)) == 0.8333333333333334
+
+	# score limit
+	assert func(t("martha"), t("marhta"), min_score=0.9) == 0.9444444444444445
+	assert func(t("martha"), t("marhta"), min_score=0.95) == -1.0
+	assert func(t("abc"), t("xyz"), min_score=0.1) == -1.0
+
+
+def jaro_winkler(func, t, **kwargs):
+
+	# types; only for c
+	if kwargs["lang"] == "C":
+		try:
+			func(1, t("foo"))
+		except ValueError:
+			pass
+		try:
+			func(t("foo"), 1)
+		except ValueError:
+			pass
+
+	# empty strings
+	assert func(t(""), t("")) == 1.0
+	assert func(t(""), t("abc")) == func(t("abc"), t("")) == 0.0
+
+	# common
+	assert func(t("martha"), t("marhta")) == 0.9611111111111111
+	assert func(t("dixon"), t("dicksonx")) == 0.8133333333333332
+	assert func(t("dixon"), t("dicksonx"), prefix_weight=0.0) == 0.7666666666666666
+
+	# prefix weight
+	try:
+		func(t("foo"), t("bar"), prefix_weight=0.3)
+	except ValueError:
+		pass
+	else:
+		assert False
+
+	# score limit
+	assert func(t("martha"), t("marhta"), min_score=0.96) == 0.9611111111111111
+	assert func(t("martha"), t("marhta"), min_score=0.97) == -1.0
+	assert func(t("ab" * 40), t("xy" * 40), min_score=0.5) == -1.0
+
 
 def itors_common(func, t, **kwargs):
 
@@ -207,12 +382,73 @@ def itors_common(func, t, **kwargs):
 	assert next(itor) == (1, t("ba"))
 
 
+def itors_parallel(func, t, **kwargs):
+	seqs = [t(s) for s in ("aa", "ab", "abcd", "ba", "", "a", "aaa", "b\u00e9", "a\u20ac")]
+	serial = list(func(t("aa"), seqs))
+	for chunk_size in (1, 3, 1024):
+		assert list(func(t("aa"), seqs, workers=4, chunk_size=chunk_size)) == serial
+		itor = func(t("aa"), seqs, workers=4, ordered=False, chunk_size=chunk_size)
+		assert sorted(itor) == sorted(serial)
+	assert list(func(t("aa"), iter(seqs), workers=0)) == serial
+	# stopped before exhaustion
+	itor = func(t("aa"), seqs * 100, workers=2, chunk_size=7)
+	assert next(itor) == serial[0]
+	del itor
+	for kw in ({"workers": -1}, {"chunk_size": 0}):
+		try:
+			list(func(t("aa"), seqs, **kw))
+			assert False
+		except ValueError: pass
+	# results written to arrays
+	indices, dists = array("q", [0] * 4), array("i", [0] * 4)
+	for workers in (1, 2):
+		rv = []
+		for n in func(t("aa"), seqs, out=(indices, dists), workers=workers, chunk_size=2):
+			rv += [(dists[i], seqs[indices[i]]) for i in range(n)]
+		assert rv == serial
+	dense = list(func(t("aa"), seqs, dense=True))
+	assert len(dense) == len(seqs) and [r for r in dense if r[0] != -1] == serial
+	assert sum(func(t("aa"), seqs, out=(indices, dists), dense=True)) == len(seqs)
+	try:
+		func(t("aa"), seqs, out=(indices, array("q", [0] * 3)))
+		assert False
+	except ValueError: pass
+	# the results written before an error are returned first
+	itor = func(t("aa"), [seqs[0], None], out=(indices, dists), dense=True)
+	assert next(itor) == 1
+	try:
+		next(itor)
+		assert False
+	except (ValueError, TypeError): pass
+	try:
+		func(t("aa"), seqs * 40000, out=(array("h", [0] * 4), dists))
+		assert False
+	except ValueError: pass
+
+
 def ilevenshtein(func, t, **kwargs):
 	itors_common(lambda a, b: func(a, b, max_dist=2), t, **kwargs)
+	itors_parallel(lambda a, b, **kw: func(a, b, max_dist=2, **kw), t, **kwargs)
+	if t in (t_unicode, t_bytes):
+		seqs = [t("FOO"), t("bar"), t("Fob")]
+		for workers in (1, 2):
+			assert list(func(t("foo"), seqs, max_dist=1, fold="ascii", workers=workers,
+				chunk_size=1)) == [(0, t("FOO")), (1, t("Fob"))]
+		# the buffers of the folded candidates grow, and are reused
+		seqs = [t("FOO"), t("F" * 100 + "OO"), t("Fo"), t("FOOX" * 50), t("foO")] * 3
+		for workers in (1, 2):
+			assert [d for d, s in func(t("foo"), seqs, max_dist=1, fold="ascii",
+				workers=workers, chunk_size=2)] == [0, 1, 0] * 3
+	if t is t_unicode:
+		seqs = [u"\xb5M", u"\u039c" * 300, u"\xb5m\u20ac", u"\u039cm"]
+		for workers in (1, 2):
+			assert list(func(u"\u03bcm", seqs, max_dist=1, fold="simple", workers=workers,
+				chunk_size=1)) == [(0, u"\xb5M"), (1, u"\xb5m\u20ac"), (0, u"\u039cm")]
 	
 
 def ifast_comp(func, t, **kwargs):
 	itors_common(func, t, **kwargs)
+	itors_parallel(func, t, **kwargs)
 	#transpositions
 	g = func(t("abc"), [t("bac")], transpositions=False)
 	assert next(g) == (2, t('bac'))
@@ -220,9 +456,428 @@ def ifast_comp(func, t, **kwargs):
 	assert next(g) == (1, t("bac"))
 	
 
+def iindel_distance(func, t, **kwargs):
+	itors_parallel(lambda a, b, **kw: func(a, b, max_dist=2, **kw), t, **kwargs)
+	g = func(t("abcd"), [t("acbd"), t("abcdef"), t("x"), t("")], max_dist=2)
+	assert list(g) == [(2, t("acbd")), (2, t("abcdef"))]
+
+
+def ijaro(func, t, **kwargs):
+	g = func(t("martha"), [t("marhta"), t("xyz"), t("martha")])
+	assert next(g) == (0.9444444444444445, t("marhta"))
+	assert next(g) == (0.0, t("xyz"))
+	g = func(t("martha"), [t("marhta"), t("xyz"), t("martha")], min_score=0.95)
+	assert next(g) == (1.0, t("martha"))
+
+
+def ijaro_winkler(func, t, **kwargs):
+	g = func(t("martha"), [t("marhta"), t("xyz"), t("martha")], min_score=0.9)
+	assert next(g) == (0.9611111111111111, t("marhta"))
+	assert next(g) == (1.0, t("martha"))
+	g = func(t("dixon"), [t("dicksonx")], prefix_weight=0.0)
+	assert next(g) == (0.7666666666666666, t("dicksonx"))
+
+
+def stats(func, t, **kwargs):
+
+	mod = cdistance if kwargs["lang"] == "C" else pydistance
+	mod.reset_stats()
+	for i in range(64):
+		mod.levenshtein(t("kitten"), t("sitting"))
+	mod.levenshtein(t("a"), t("abcd"), max_dist=1)
+	counters = func()
+	assert isinstance(counters, dict)
+	
+	# only collected by the C extension built with --with-stats
+	if counters:
+		assert counters["levenshtein"]["calls"] == 65
+		assert counters["levenshtein"]["early_exits"]["length"] == 1
+		assert sum(counters["levenshtein"]["latency_ns"].values()) == 1
+		# counted at the level the kernels ran at, the sequences of objects
+		# being only compared by the baseline ones
+		isa = mod.cpu_features()["isa"]
+		for path in counters["levenshtein"]["paths"]:
+			type, algo, level = path.split("/")
+			assert level == (isa if type != "seq" else "baseline")
+		# kept once the workers which counted them have exited
+		mod.reset_stats()
+		list(mod.ilevenshtein(t("kitten"), [t("sitting")] * 100, workers=4, chunk_size=10))
+		assert func()["levenshtein"]["calls"] == 100
+		mod.reset_stats()
+		assert func() == {}
+
+
+def cpu_features(func, t, **kwargs):
+	features = func()
+	assert set(features) == set(["isa", "supported", "features"])
+	if kwargs["lang"] != "C" or t is not t_bytes:
+		return
+	import subprocess
+	assert features["isa"] == features["supported"][-1]
+	assert features["supported"][0] == "baseline"
+	# the same results at every level
+	script = ("from distance import cdistance as d; print([d.cpu_features()['isa'], "
+		"d.levenshtein(b'ab' * 40, b'ba' * 40), d.lcs_length(u'ab\u20ac' * 30, u'ba' * 50), "
+		"d.hamming(b'abc' * 9, b'abd' * 9), d.jaro(b'martha', b'marhta')])")
+	env = dict(os.environ)
+	env["PYTHONPATH"] = os.path.dirname(os.path.dirname(os.path.abspath(cdistance.__file__)))
+	for level in features["supported"]:
+		env["DISTANCE_ISA"] = level
+		out = subprocess.check_output([sys.executable, "-c", script], env=env)
+		assert out.decode().strip() == str([level, 2, 60, 9, 0.9444444444444445])
+
+
+def Lexicon(func, t, **kwargs):
+	if t is not t_unicode:
+		return
+	import tempfile
+	from distance import write_lexicon
+	
+	fd, path = tempfile.mkstemp()
+	os.close(fd)
+	try:
+		write_lexicon(path, [t("foobar"), t("foo"), t("fo"), t("bar"), t("f\u20acoo")])
+		with func.open(path) as lex:
+			assert len(lex) == 5
+			assert [lex[i] for i in range(len(lex))] == ["fo", "foo", "bar", "f\u20acoo", "foobar"]
+			assert lex[-1] == "foobar"
+			assert lex.scan("foo", max_dist=1) == [(1, "fo"), (0, "foo"), (1, "f\u20acoo")]
+			assert lex.scan("baz", metric="hamming", max_dist=1) == [(1, "bar")]
+			assert lex.scan("foob", metric="fast_comp") == [(2, "fo"), (1, "foo"), (2, "f\u20acoo"), (2, "foobar")]
+			assert len(lex.scan("x")) == 5
+			try:
+				lex.scan("foo", metric="jaro")
+				assert False
+			except ValueError: pass
+		
+		with open(path, "wb") as f:
+			f.write(b"not a lexicon" * 10)
+		try:
+			func(path)
+			assert False
+		except ValueError: pass
+	finally:
+		os.remove(path)
+
+
+def CandidateSet(func, t, **kwargs):
+	if t is t_unicode or t is t_bytes:
+		words = [t(w) for w in ("foobar", "foo", "fo", "bar", "foob", "ab" * 50, "ab" * 48 + "ba")]
+		cs = func(words, q=2)
+		assert len(cs) == 7 and cs[1] == t("foo")
+		assert cs.search(t("foo"), max_dist=1) == [(0, t("foo")), (1, t("fo")), (1, t("foob"))]
+		assert cs.search(t("baz"), metric="hamming", max_dist=1) == [(1, t("bar"))]
+		assert cs.search(t("fob"), metric="fast_comp") == [(1, t("foo")), (1, t("fo")), (1, t("foob"))]
+		assert cs.search(t("ab" * 49), max_dist=2) == [(2, t("ab" * 50)), (2, t("ab" * 48 + "ba"))]
+		assert len(cs.search(t("x"))) == 7
+		cs.add(t("fox"))
+		assert cs.search(t("fox"), max_dist=0) == [(0, t("fox"))]
+		try:
+			func(words, q=0)
+			assert False
+		except ValueError: pass
+	else:
+		try:
+			func([t("foo")])
+			assert False
+		except ValueError: pass
+
+
+def Trie(func, t, **kwargs):
+	if t is t_unicode or t is t_bytes:
+		words = [t(w) for w in ("foobar", "foo", "fo", "bar", "foob", "", "foo")]
+		trie = func(words)
+		assert len(trie) == 7 and trie[1] == t("foo")
+		assert trie.search(t("foo"), max_dist=1) == [(1, t("fo")), (0, t("foo")), (1, t("foob"))]
+		assert trie.search(t("fooba"), max_dist=1) == [(1, t("foob")), (1, t("foobar"))]
+		assert trie.search(t("x"), max_dist=0) == []
+		assert trie.search(t("ba")) == [(2, t("")), (1, t("bar")), (2, t("fo")), (3, t("foo")),
+			(4, t("foob")), (4, t("foobar"))]
+		assert func([]).search(t("foo")) == []
+	else:
+		try:
+			func([t("foo")])
+			assert False
+		except ValueError: pass
+
+
+def Vocabulary(func, t, **kwargs):
+	if not (t is t_unicode or t is t_bytes):
+		try:
+			func().encode([t("unhashable")])
+			assert t is tuple
+		except TypeError: pass
+		return
+	mod = cdistance if kwargs["lang"] == "C" else pydistance
+	s1, s2 = t("the cat sat on the mat").split(), t("a cat sat on a mat").split()
+	vocab = func([s1[0]])
+	a1, a2 = vocab.encode(s1), vocab.encode(s2)
+	assert list(a1) == [0, 1, 2, 3, 0, 4] and a1.typecode == "B"
+	assert len(vocab) == 6 and vocab[5] == s2[0] and s2[0] in vocab
+	assert vocab.decode(a2) == s2
+	for name in ("hamming", "levenshtein", "fast_comp", "lcs_length", "indel_distance", "jaro"):
+		f = getattr(mod, name)
+		assert f(a1, a2) == f(s1, s2)
+	assert list(mod.ilevenshtein(a1, [a2, a1])) == [(2, a2), (0, a1)]
+	big = func(range(300))
+	assert big.encode([1, 299]).typecode == "H" and list(big.encode((299,))) == [299]
+	try:
+		vocab.encode(t("the dog").split(), add=False)
+		assert False
+	except KeyError: pass
+	assert len(vocab) == 6
+	try:
+		vocab.decode([6])
+		assert False
+	except IndexError: pass
+
+def compile_query(func, t, **kwargs):
+	mod = cdistance if kwargs["lang"] == "C" else pydistance
+	query, seqs = t("kitten"), [t(s) for s in ("sitting", "mitten", "", "kitten" * 20)]
+	pat = func(query)
+	assert len(pat) == 6 and list(pat.seq) == list(query)
+	for seq in seqs:
+		for name in ("levenshtein", "lcs_length", "indel_distance", "hamming", "jaro"):
+			f = getattr(mod, name)
+			try:
+				assert f(pat, seq) == f(query, seq)
+			except ValueError: pass
+		assert mod.levenshtein(pat, seq, max_dist=1) == mod.levenshtein(query, seq, max_dist=1)
+		assert mod.indel_distance(pat, seq, normalized=True) == mod.indel_distance(query, seq, normalized=True)
+	assert list(mod.ilevenshtein(pat, seqs, max_dist=2)) == [(1, seqs[1])]
+	assert list(mod.iindel_distance(func(query, metrics=["indel_distance"]), seqs)) == \
+		list(mod.iindel_distance(query, seqs))
+	assert pickle.loads(pickle.dumps(pat)).seq == pat.seq
+	for kwargs in ({"metrics": ["foo"]}, {"q": 0}):
+		try:
+			func(query, **kwargs)
+			assert False
+		except ValueError: pass
+	if t is t_unicode or t is t_bytes:
+		cs = mod.CandidateSet(seqs, q=3)
+		assert cs.search(func(query, q=3), 2) == cs.search(query, 2) == [(1, seqs[1])]
+		assert mod.Trie(seqs).search(pat, 1) == [(1, seqs[1])]
+
+def qgram_distance(func, t, **kwargs):
+	if not (t is t_unicode or t is t_bytes):
+		try:
+			func(t("abc"), t("abd"))
+			assert False
+		except ValueError: pass
+		return
+	assert func(t("abcd"), t("abce"), q=2) == 2
+	assert func(t("abab"), t("ab"), q=2) == 2
+	assert func(t("ab"), t("ab")) == 0
+	assert func(t(""), t("abcd")) == 2
+	try:
+		func(t("abc"), t("abc"), q=0)
+		assert False
+	except ValueError: pass
+
+
+def QGramProfile(func, t, **kwargs):
+	mod = cdistance if kwargs["lang"] == "C" else pydistance
+	if not (t is t_unicode or t is t_bytes):
+		try:
+			func(t("abc"))
+			assert False
+		except ValueError: pass
+		return
+	p = func(t("abcabc"), 2)
+	assert len(p) == 5 and p.q == 2 and len(func(t("ab"))) == 0
+	assert mod.cosine(p, t("abcabc")) == 0.0
+	assert mod.cosine(p, t("xyz")) == 1.0
+	assert abs(mod.cosine(p, t("abc")) - (1 - 4 / (3 * 2 ** 0.5))) < 1e-12
+	assert mod.overlap(p, t("abc")) == 0.0
+	assert mod.overlap(t("abcd"), t("abxy"), q=2) == 1 - 1 / 3.
+	assert mod.qgram_distance(p, func(t("abc"), 2)) == 3
+	assert mod.cosine(t(""), t("")) == mod.overlap(t(""), t("")) == 0.0
+	ints = array("H", [1, 2, 3, 1, 2, 3])
+	assert mod.cosine(ints, array("B", [1, 2, 3])) == mod.cosine(t("abcabc"), t("abc"))
+	for args in ((p, t("abc"), 3), (t("abc"), ints)):
+		try:
+			mod.cosine(*args)
+			assert False
+		except ValueError: pass
+
+def find_approx(func, t, **kwargs):
+	mod = cdistance if kwargs["lang"] == "C" else pydistance
+	if not (t is t_unicode or t is t_bytes):
+		try:
+			func(t("ab"), t("xaby"), 0)
+			assert False
+		except ValueError: pass
+		return
+	assert list(func(t("needle"), t("a needles"), 1)) == [(7, 1), (8, 0), (9, 1)]
+	assert list(func(t("needle"), t("a neddle, needles"), 1, starts=True)) == \
+		[(2, 8, 1), (10, 15, 1), (10, 16, 0), (10, 17, 1)]
+	assert list(func(t("ab"), t("xy"), 1, starts=True)) == []
+	assert list(func(t(""), t("ab"), 0)) == [(0, 0), (1, 0), (2, 0)]
+	# several blocks, and a compiled pattern
+	pattern = t("abcdefghij" * 10)
+	text = t("xyz") + pattern[:50] + t("q") + pattern[50:] + t("xyz")
+	assert list(func(pattern, text, 1, starts=True)) == [(3, 104, 1)]
+	assert list(func(mod.compile_query(pattern), text, 0)) == []
+	for args in ((t("ab"), t("ab"), -1), (t("ab"), array("B", [1]), 1)):
+		try:
+			func(*args)
+			assert False
+		except ValueError: pass
+
+def grep(func, t, **kwargs):
+	mod = cdistance if kwargs["lang"] == "C" else pydistance
+	if t is not t_bytes:
+		try:
+			func(b"ab", t("ab"), 1)
+			assert False
+		except ValueError: pass
+		return
+	import tempfile
+	
+	text = b"foo\nbarr\nbaz\r\n\nfoo bar"
+	assert list(func(text, [b"bar", b"qux"], 2)) == [(1, 0, 1, b"barr"), (2, 0, 2, b"baz\r")]
+	assert list(func(text, b"bar", 0, mode="substring")) == [(1, 0, 0, b"barr"), (4, 0, 0, b"foo bar")]
+	assert list(func(text, [b"", mod.compile_query(b"fo")], 1)) == [(0, 1, 1, b"foo"), (3, 0, 0, b"")]
+	# chunks cut anywhere in the lines, and a memory-mapped file
+	fd, path = tempfile.mkstemp()
+	os.close(fd)
+	try:
+		with open(path, "wb") as f:
+			f.write(text * 50)
+		expected = list(func(text * 50, b"bar", 0, "substring", workers=1))
+		assert len(expected) == 100
+		assert list(func(path, b"bar", 0, "substring", workers=3, chunk_size=7)) == expected
+	finally:
+		os.remove(path)
+	for args in ((text, b"ab", -1), (text, b"ab", 1, "word"), (text, [b"ab", None], 1)):
+		try:
+			func(*args)
+			assert False
+		except (ValueError, TypeError): pass
+
+def jaccard_join(func, t, **kwargs):
+	sets = [t("abcd"), t("abce"), t(""), t("xyz"), t("abcdd"), t("zyx")]
+	left, right, dists = func(sets, 0.4)
+	assert list(zip(left, right)) == [(0, 1), (0, 4), (1, 4), (3, 5)]
+	assert list(dists) == [pydistance.jaccard(sets[i], sets[j]) for i, j in zip(left, right)]
+	assert list(zip(*func(sets, 0.0, workers=2)[:2])) == [(0, 4), (3, 5)]
+	left, right, dists = func([t("abce"), t("q")], 0.5, others=sets)
+	assert list(zip(left, right)) == [(0, 0), (0, 1), (0, 4)]
+	ints = [array("I", [1, 2, 3, 4]), array("B", [1, 2, 3, 5]), array("H", [2, 3, 4, 1, 1])]
+	assert list(zip(*func(ints, 0.4)[:2])) == [(0, 1), (0, 2), (1, 2)]
+	for args in ((sets, 1.0), (sets, -0.5), (sets, 0.5, None, -1)):
+		try:
+			func(*args)
+			assert False
+		except ValueError: pass
+
+
+def SetIndex(func, t, **kwargs):
+	index = func([t("abcd"), t("abce"), t(""), t("xyz")])
+	index.add(t("abcdd"))
+	assert len(index) == 5
+	assert index.topk(t("abcd"), 2) == [(0.0, 0), (0.0, 4)]
+	assert index.topk(t("abcd"), 3) == [(0.0, 0), (0.0, 4), (pydistance.jaccard("abcd", "abce"), 1)]
+	assert index.topk(t("abq"), 5, metric="sorensen") == [(pydistance.sorensen("abq", "abcd"), i) for i in (0, 1, 4)]
+	assert index.topk(t("abce"), 5, min_sim=0.7) == [(0.0, 1)]
+	# at the exact threshold, although 1 - 0.8 < 0.2
+	assert func([t("abcde")]).topk(t("a"), 1, min_sim=0.2) == [(0.8, 0)]
+	assert index.topk(t("qrs"), 5) == [] and index.topk(t("abcd"), 0) == []
+	for args in ((t("ab"), -1), (t("ab"), 1, "cosine"), (t("ab"), 1, "jaccard", 1.5)):
+		try:
+			index.topk(*args)
+			assert False
+		except ValueError: pass
+
+
+def PackedDNA(func, t, **kwargs):
+	mod = cdistance if kwargs["lang"] == "C" else pydistance
+	if not (t is t_unicode or t is t_bytes):
+		try:
+			func(t("ACGT"))
+			assert False
+		except ValueError: pass
+		return
+	seq = "ACGTN" * 20 + "acgt"
+	dna = func(t(seq))
+	assert len(dna) == 104 and str(dna) == seq.upper()
+	assert pickle.loads(pickle.dumps(dna)).__reduce__() == dna.__reduce__()
+	assert mod.hamming(dna, t(seq[:-1] + "a")) == 1
+	assert mod.levenshtein(func(t("ACGTACGT")), t("ACGAACG")) == 2
+	assert mod.levenshtein(dna, t(seq[::-1])) == pydistance.levenshtein(seq.upper(), seq[::-1].upper())
+	assert mod.levenshtein(func(t("")), t("ACG"), normalized=True) == 1.0
+	try:
+		func(t("ACGU"))
+		assert False
+	except ValueError: pass
+
+
+def BarcodeSet(func, t, **kwargs):
+	if not (t is t_unicode or t is t_bytes):
+		return
+	codes = func([t("ACGT"), t("TTGA"), t("ACGA")])
+	assert len(codes) == 3
+	reads = [t("ACGT"), t("TTGC"), t("ACGG"), t("CCCC")]
+	index, dist = codes.assign(reads)
+	assert list(index) == [0, 1, -2, -1] and list(dist) == [0, 1, 1, -1]
+	index, dist = codes.assign(reads + [t("ACG"), t("TTGAA")], metric="levenshtein", workers=2)
+	assert list(index)[4:] == [-2, 1] and list(dist)[4:] == [1, 1]
+	index, dist = codes.assign(reads, max_dist=0)
+	assert list(index) == [0, -1, -1, -1]
+	try:
+		codes.assign(reads, metric="jaccard")
+		assert False
+	except ValueError: pass
+
+
+def Dawg(func, t, **kwargs):
+	if t is not t_unicode:
+		return
+	import tempfile
+	from distance import write_dawg
+	
+	fd, path = tempfile.mkstemp()
+	os.close(fd)
+	try:
+		words = [t("foobar"), t("foo"), t("fo"), t("bar"), t("f\u20acoo"), t("foo")]
+		write_dawg(path, words)
+		with func.open(path) as dawg:
+			assert len(dawg) == 5
+			assert [dawg[i] for i in range(len(dawg))] == ["bar", "fo", "foo", "foobar", "f\u20acoo"]
+			assert "foo" in dawg and "foob" not in dawg and dawg.get("foob") is None
+			assert dawg.search("foo", max_dist=1) == [(1, "fo"), (0, "foo"), (1, "f\u20acoo")]
+			assert [dist for dist, word in dawg.search("fob")] == [pydistance.levenshtein("fob", w) for w in dawg]
+			assert dawg.prefix_search("fob", max_dist=1) == [(1, "fo"), (1, "foo"), (1, "foobar")]
+			assert dawg.prefix_search("foob", max_dist=0) == [(0, "foobar")]
+			assert dawg.search("") == [(len(w), w) for w in dawg]
+		
+		write_dawg(path, words, values=[1, 2, 3, 4, 5, -6])
+		with func(path) as dawg:
+			assert dawg.get("foo") == 2 and dawg.get("bar") == 4
+			assert dawg.search("fo", max_dist=0) == [(0, "fo", 3)]
+			try:
+				dawg.search(b"foo")
+				assert False
+			except ValueError: pass
+		
+		with open(path, "wb") as f:
+			f.write(b"not a dawg" * 10)
+		try:
+			func(path)
+			assert False
+		except ValueError: pass
+	finally:
+		os.remove(path)
+
+
 write = lambda s: sys.stderr.write(s + '\n')
 
-tests = ["hamming", "fast_comp", "levenshtein", "lcsubstrings", "nlevenshtein", "ilevenshtein", "ifast_comp"]
+tests = ["hamming", "fast_comp", "levenshtein", "lcsubstrings", "nlevenshtein", "ilevenshtein", "ifast_comp",
+	"jaro", "jaro_winkler", "ijaro", "ijaro_winkler", "stats", "Lexicon",
+	"CandidateSet", "Trie", "lcs_length", "indel_distance", "iindel_distance",
+	"common_substrings", "Vocabulary", "compile_query", "qgram_distance", "QGramProfile",
+	"find_approx", "grep", "cpu_features", "jaccard_join", "SetIndex",
+	"PackedDNA", "BarcodeSet", "Dawg"]
 
 
 def run_test(name):